@@ -0,0 +1,721 @@
+#include "stdafx.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "MissionCommands.h"
+#include "VMState.h"
+#include "BVMRunner.h"
+
+#define BVM_FRAMES_PER_SECOND 60
+
+static bool ReadBVMInt( const std::vector< char >& buffer, uint32_t pos, int& value )
+{
+	if( (size_t)pos + 4 > buffer.size( ) )
+		return false;
+
+	value = ReadLE< int32_t >( buffer, pos );
+	return true;
+}
+
+bool LoadBVMImage( const std::wstring& path, BVMImage& image )
+{
+	std::vector< char >& buffer = image.buffer;
+	if( !CacheReadFile( path, buffer ) || buffer.size( ) < 0x40 )
+		return false;
+
+	//Same header check as CMissionScript::Read, either byte order
+	if( memcmp( buffer.data( ), "BVM ", 4 ) && memcmp( buffer.data( ), " MVB", 4 ) )
+		return false;
+
+	int varCount, varTable, fnCount, fnTable, codeStart, fnData, strings;
+	if( !ReadBVMInt( buffer, 0x18, varCount ) || !ReadBVMInt( buffer, 0x1c, varTable ) )
+		return false;
+	if( !ReadBVMInt( buffer, 0x20, fnCount ) || !ReadBVMInt( buffer, 0x24, fnTable ) )
+		return false;
+	if( !ReadBVMInt( buffer, 0x30, codeStart ) || !ReadBVMInt( buffer, 0x34, fnData ) || !ReadBVMInt( buffer, 0x38, strings ) )
+		return false;
+	if( codeStart < 0 || strings < codeStart || strings > (int)buffer.size( ) || varCount < 0 || fnCount < 0 )
+		return false;
+
+	image.variables.clear( );
+	for( int i = 0; i < varCount; i++ )
+	{
+		int name;
+		if( !ReadBVMInt( buffer, varTable + i * 4, name ) )
+			return false;
+		image.variables.push_back( ReadUnicode( buffer, name ) );
+	}
+
+	//Function code ends where the pointer stubs start
+	int fnDataEnd = 0;
+	if( fnCount > 0 && !ReadBVMInt( buffer, fnTable, fnDataEnd ) )
+		return false;
+	fnDataEnd += fnData;
+
+	//16 bytes per function: stub pointer, name, unknown, argument count and return flag
+	image.functions.clear( );
+	for( int i = 0; i < fnCount; i++ )
+	{
+		int entry = fnTable + i * 16;
+		int stub, name;
+		if( !ReadBVMInt( buffer, entry, stub ) || !ReadBVMInt( buffer, entry + 4, name ) || entry + 14 > (int)buffer.size( ) )
+			return false;
+		stub += fnData;
+		if( stub < 0 || stub + 3 > (int)buffer.size( ) )
+			return false;
+
+		//Each stub is a call back into the function, the offset is always negative
+		int rel = (int)( 0xFFFF0000u | (unsigned char)buffer[stub + 1] | ( (unsigned char)buffer[stub + 2] << 8 ) );
+
+		BVMFunctionInfo fn;
+		fn.name = ReadUnicode( buffer, name );
+		fn.entry = stub + rel;
+		fn.start = fn.entry - 4;
+		fn.end = fnDataEnd;
+		fn.stub = stub;
+		fn.argCount = buffer[entry + 12];
+		fn.doesReturn = buffer[entry + 13] != 0;
+		image.functions.push_back( fn );
+	}
+
+	for( size_t i = 0; i < image.functions.size( ); i++ )
+	{
+		for( size_t j = 0; j < image.functions.size( ); j++ )
+		{
+			if( image.functions[j].start > image.functions[i].start && image.functions[j].start < image.functions[i].end )
+				image.functions[i].end = image.functions[j].start;
+		}
+	}
+
+	image.codeStart = codeStart;
+	image.codeEnd = strings;
+	image.program.decode( (const unsigned char*)buffer.data( ) + codeStart, strings - codeStart );
+	return true;
+}
+
+int BVMImage::FindInstruction( uint32_t offset ) const
+{
+	if( offset < codeStart )
+		return -1;
+	return program.find( offset - codeStart );
+}
+
+int BVMImage::FindFunction( uint32_t offset ) const
+{
+	for( size_t i = 0; i < functions.size( ); i++ )
+	{
+		if( offset >= functions[i].start && offset < functions[i].end )
+			return (int)i;
+	}
+	return -1;
+}
+
+//Function of every decoded instruction, -1 outside the function table
+static std::vector< int > InstructionOwners( const BVMImage& image )
+{
+	std::vector< int > owners( image.program.instructions.size( ), -1 );
+	for( size_t i = 0; i < owners.size( ); i++ )
+	{
+		uint32_t offset = image.codeStart + image.program.instructions[i].offset;
+		if( i > 0 && owners[i - 1] >= 0 && offset < image.functions[owners[i - 1]].end )
+			owners[i] = owners[i - 1];
+		else
+			owners[i] = image.FindFunction( offset );
+	}
+	return owners;
+}
+
+//A taken backward jump and the instructions it repeats
+struct BVMLoop
+{
+	size_t head;
+	size_t tail;
+	uint64_t iterations;
+	uint64_t instructions;
+};
+
+//Every loop that ran, most expensive first
+static std::vector< BVMLoop > FindHotLoops( const BVMImage& image, const BVMProfile& profile )
+{
+	std::vector< BVMLoop > loops;
+	const std::vector< BVMInstruction >& instructions = image.program.instructions;
+	for( size_t i = 0; i < instructions.size( ); i++ )
+	{
+		int target = instructions[i].operand;
+		bool isJump = instructions[i].handler == BVM_JZ || instructions[i].handler == BVM_JNZ || instructions[i].handler == BVM_JMP;
+		if( !isJump || target < 0 || (size_t)target > i || profile.jumps_taken[i] == 0 )
+			continue;
+
+		//Functions end by jumping back to their return block, that isn't a loop
+		uint32_t head = image.codeStart + instructions[target].offset;
+		int fn = image.FindFunction( head );
+		if( fn >= 0 && image.functions[fn].start == head )
+			continue;
+
+		BVMLoop loop;
+		loop.head = target;
+		loop.tail = i;
+		loop.iterations = profile.jumps_taken[i];
+		loop.instructions = 0;
+		for( size_t j = loop.head; j <= loop.tail; j++ )
+			loop.instructions += profile.hits[j];
+		loops.push_back( loop );
+	}
+
+	std::sort( loops.begin( ), loops.end( ), []( const BVMLoop& a, const BVMLoop& b ) { return a.instructions > b.instructions; } );
+	return loops;
+}
+
+static std::string FunctionName( const BVMImage& image, int fn )
+{
+	return fn >= 0 ? WideToUTF8( image.functions[fn].name ) : "[initialisers]";
+}
+
+std::string BVMProfileToJSON( const BVMImage& image, const BVMProfile& profile, const std::vector< BVMRunResult >& runs )
+{
+	const std::vector< BVMInstruction >& instructions = image.program.instructions;
+	std::vector< int > owners = InstructionOwners( image );
+
+	uint64_t total = 0;
+	uint64_t opcodes[64] = { 0 };
+	std::vector< uint64_t > fnInstructions( image.functions.size( ), 0 );
+	std::vector< int > fnCovered( image.functions.size( ), 0 );
+	std::vector< int > fnDecoded( image.functions.size( ), 0 );
+	for( size_t i = 0; i < instructions.size( ); i++ )
+	{
+		total += profile.hits[i];
+		if( instructions[i].opcode < 64 )
+			opcodes[instructions[i].opcode] += profile.hits[i];
+
+		if( owners[i] >= 0 )
+		{
+			fnInstructions[owners[i]] += profile.hits[i];
+			fnDecoded[owners[i]]++;
+			if( profile.hits[i] )
+				fnCovered[owners[i]]++;
+		}
+	}
+
+	std::string out = "{\n";
+	out += "\t\"instructions\": " + std::to_string( total ) + ",\n";
+
+	out += "\t\"runs\": [";
+	for( size_t i = 0; i < runs.size( ); i++ )
+	{
+		out += i ? ",\n\t\t" : "\n\t\t";
+		out += "{ \"name\": " + JSONString( runs[i].name );
+		out += ", \"completed\": " + std::string( runs[i].completed ? "true" : "false" );
+		out += ", \"stop\": " + JSONString( runs[i].stopReason );
+		out += ", \"offset\": " + std::to_string( runs[i].stopOffset );
+		out += ", \"instructions\": " + std::to_string( runs[i].instructions ) + " }";
+	}
+	out += "\n\t],\n";
+
+	out += "\t\"opcodes\": {";
+	bool first = true;
+	for( int op = 0; op < 64; op++ )
+	{
+		if( !opcodes[op] )
+			continue;
+		char name[8];
+		snprintf( name, sizeof( name ), "0x%02X", op );
+		out += first ? "\n\t\t\"" : ",\n\t\t\"";
+		out += std::string( name ) + "\": " + std::to_string( opcodes[op] );
+		first = false;
+	}
+	out += "\n\t},\n";
+
+	out += "\t\"functions\": [";
+	for( size_t i = 0; i < image.functions.size( ); i++ )
+	{
+		out += i ? ",\n\t\t" : "\n\t\t";
+		out += "{ \"name\": " + JSONString( image.functions[i].name );
+		out += ", \"offset\": " + std::to_string( image.functions[i].start );
+		out += ", \"instructions\": " + std::to_string( fnInstructions[i] );
+		out += ", \"covered\": " + std::to_string( fnCovered[i] );
+		out += ", \"decoded\": " + std::to_string( fnDecoded[i] ) + " }";
+	}
+	out += "\n\t],\n";
+
+	std::vector< BVMLoop > loops = FindHotLoops( image, profile );
+	out += "\t\"hot_loops\": [";
+	for( size_t i = 0; i < loops.size( ); i++ )
+	{
+		out += i ? ",\n\t\t" : "\n\t\t";
+		int fn = owners[loops[i].head];
+		out += "{ \"function\": " + ( fn >= 0 ? JSONString( image.functions[fn].name ) : std::string( "\"[initialisers]\"" ) );
+		out += ", \"head\": " + std::to_string( image.codeStart + instructions[loops[i].head].offset );
+		out += ", \"back_edge\": " + std::to_string( image.codeStart + instructions[loops[i].tail].offset );
+		out += ", \"iterations\": " + std::to_string( loops[i].iterations );
+		out += ", \"instructions\": " + std::to_string( loops[i].instructions ) + " }";
+	}
+	out += "\n\t],\n";
+
+	out += "\t\"executed_offsets\": [";
+	first = true;
+	for( size_t i = 0; i < instructions.size( ); i++ )
+	{
+		if( !profile.hits[i] )
+			continue;
+		out += first ? "" : ", ";
+		out += std::to_string( image.codeStart + instructions[i].offset );
+		first = false;
+	}
+	out += "]\n}\n";
+
+	return out;
+}
+
+std::string BVMProfileToFolded( const BVMImage& image, const BVMProfile& profile )
+{
+	const std::vector< BVMInstruction >& instructions = image.program.instructions;
+	std::vector< int > owners = InstructionOwners( image );
+
+	//Loops become frames under their function, outer loops first
+	std::vector< BVMLoop > loops = FindHotLoops( image, profile );
+	std::sort( loops.begin( ), loops.end( ), []( const BVMLoop& a, const BVMLoop& b ) { return a.head != b.head ? a.head < b.head : a.tail > b.tail; } );
+
+	std::vector< std::string > frames( instructions.size( ) );
+	for( size_t i = 0; i < loops.size( ); i++ )
+	{
+		char frame[32];
+		snprintf( frame, sizeof( frame ), ";loop@0x%X", image.codeStart + instructions[loops[i].head].offset );
+		for( size_t j = loops[i].head; j <= loops[i].tail; j++ )
+			frames[j] += frame;
+	}
+
+	std::map< std::string, uint64_t > stacks;
+	for( size_t i = 0; i < instructions.size( ); i++ )
+	{
+		if( !profile.hits[i] )
+			continue;
+
+		//Folded stacks split on ';' and the last space
+		std::string name = FunctionName( image, owners[i] );
+		std::replace( name.begin( ), name.end( ), ';', '_' );
+		std::replace( name.begin( ), name.end( ), ' ', '_' );
+		stacks[name + frames[i]] += profile.hits[i];
+	}
+
+	std::string out;
+	for( auto it = stacks.begin( ); it != stacks.end( ); ++it )
+		out += it->first + " " + std::to_string( it->second ) + "\n";
+	return out;
+}
+
+static std::wstring DescribeStop( const BVMImage& image, const VMState& state, const std::exception& e )
+{
+	const BVMInstruction& instruction = image.program.instructions[state.fault_instruction];
+	if( state.fault_instruction + 1 == image.program.instructions.size( ) )
+		return L"ran past the end of the code";
+	if( instruction.handler == BVM_INVALID )
+	{
+		wchar_t text[48];
+		swprintf( text, 48, L"unsupported opcode 0x%02X", instruction.opcode );
+		return text;
+	}
+	if( dynamic_cast< const BVM_host_exception* >( &e ) )
+	{
+		wchar_t text[48];
+		swprintf( text, 48, L"no stub for %X 0x%x", instruction.opcode & 0x3F, instruction.operand );
+		return text;
+	}
+
+	std::string reason( e.what( ) );
+	return std::wstring( reason.begin( ), reason.end( ) );
+}
+
+BVMStubHost::BVMStubHost( ) : image( nullptr ), frame( 0 )
+{
+	//2C 0x28 and 0x2A create an EventFactor_Wait, see Documents/Custom_Command_types.txt
+	BVMStub wait;
+	wait.setsArgs = true;
+	wait.argTypes.push_back( L"float" );
+	wait.waits = true;
+	SetStub( 0, 0x28, wait );
+	SetStub( 0, 0x2A, wait );
+}
+
+void BVMStubHost::SetCommands( int language, std::shared_ptr< const CMissionCommandTable > commands )
+{
+	m_commands[language & 3] = commands;
+}
+
+void BVMStubHost::SetStub( int language, uint32_t command, const BVMStub& stub )
+{
+	m_stubs[( (uint64_t)( language & 3 ) << 32 ) | command] = stub;
+}
+
+bool BVMStubHost::LoadStubs( const std::wstring& path )
+{
+	std::vector< char > bytes;
+	if( !CacheReadFile( path, bytes ) )
+		return false;
+
+	std::wstring text = UTF8ToWide( std::string( bytes.begin( ), bytes.end( ) ) );
+	if( text.size( ) > 0 && text[0] == 0xFEFF )
+		text.erase( 0, 1 );
+
+	std::wstringstream lines( text );
+	std::wstring line;
+	int lineNum = 0;
+	while( std::getline( lines, line ) )
+	{
+		lineNum++;
+		size_t comment = line.find( L"//" );
+		if( comment != std::wstring::npos )
+			line.erase( comment );
+
+		std::wstringstream words( line );
+		std::wstring language, command;
+		if( !( words >> language ) )
+			continue;
+
+		size_t lang = std::wstring::npos;
+		if( language.size( ) == 2 && language[0] == L'2' )
+			lang = std::wstring( L"CDEF" ).find( (wchar_t)towupper( language[1] ) );
+		if( lang == std::wstring::npos || !( words >> command ) )
+		{
+			LogError( ) << path << L"(" << lineNum << L"): expected 2C, 2D, 2E or 2F and a command\n";
+			continue;
+		}
+
+		BVMStub stub;
+		bool valid = true;
+		std::wstring word;
+		bool readArgs = false;
+		while( words >> word )
+		{
+			if( word == L"name" )
+			{
+				readArgs = false;
+				valid = valid && ( words >> stub.name );
+			}
+			else if( word == L"args" )
+			{
+				readArgs = true;
+				stub.setsArgs = true;
+			}
+			else if( word == L"wait" )
+			{
+				readArgs = false;
+				stub.waits = true;
+			}
+			else if( word == L"=" )
+			{
+				readArgs = false;
+				std::wstring value;
+				valid = valid && ( words >> value );
+				stub.setsReturn = true;
+
+				//Floats are returned as their bits, same as the compiler stores them
+				if( value.find( L'.' ) != std::wstring::npos || value.back( ) == L'f' )
+				{
+					float f = wcstof( value.c_str( ), nullptr );
+					memcpy( &stub.returnValue, &f, sizeof( f ) );
+					stub.returnType = L"float";
+				}
+				else
+				{
+					stub.returnValue = (int32_t)wcstol( value.c_str( ), nullptr, 0 );
+					stub.returnType = L"int";
+				}
+			}
+			else if( readArgs )
+				stub.argTypes.push_back( word );
+			else
+				valid = false;
+		}
+
+		if( !valid )
+		{
+			LogError( ) << path << L"(" << lineNum << L"): couldn't read stub\n";
+			continue;
+		}
+		SetStub( (int)lang, (uint32_t)wcstoul( command.c_str( ), nullptr, 0 ), stub );
+	}
+
+	return true;
+}
+
+//Argument text the way the decompiler prints it, strings are looked up in the image
+static std::wstring FormatHostArg( const BVMImage *image, const std::wstring& type, int32_t value )
+{
+	std::wstring lower = ConvertToLower( type );
+	if( lower.find( L"float" ) != std::wstring::npos )
+	{
+		float f;
+		memcpy( &f, &value, sizeof( f ) );
+		return std::to_wstring( f );
+	}
+	if( image && ( lower.find( L"str" ) != std::wstring::npos || lower.find( L"char" ) != std::wstring::npos ) && value > 0 && (size_t)value < image->buffer.size( ) )
+		return L"\"" + ReadUnicode( image->buffer, value ) + L"\"";
+
+	return std::to_wstring( value );
+}
+
+bool BVMStubHost::call( VMState& state, int language, uint32_t command )
+{
+	const MissionCommand *definition = m_commands[language] ? m_commands[language]->Find( (int)command ) : nullptr;
+	auto stub = m_stubs.find( ( (uint64_t)language << 32 ) | command );
+	if( !definition && stub == m_stubs.end( ) )
+		return false;
+
+	std::wstring name;
+	std::vector< std::wstring > argTypes;
+	std::wstring returnType;
+	BVMHostCall call;
+	call.frame = frame;
+	call.language = language;
+	call.command = command;
+	call.returned = false;
+	call.result = 0;
+	if( definition )
+	{
+		name = definition->name;
+		argTypes = definition->argTypes;
+		returnType = definition->returnType;
+		call.returned = definition->doesReturn;
+	}
+	if( stub != m_stubs.end( ) )
+	{
+		if( !stub->second.name.empty( ) )
+			name = stub->second.name;
+		if( stub->second.setsArgs )
+			argTypes = stub->second.argTypes;
+		if( stub->second.setsReturn )
+		{
+			call.returned = true;
+			call.result = stub->second.returnValue;
+			returnType = stub->second.returnType;
+		}
+	}
+
+	//Same text as the decompiler's ReadCommand, unnamed commands keep their id
+	if( name.empty( ) )
+	{
+		wchar_t id[32];
+		swprintf( id, 32, L"%X( 0x%x", 0x2C + language, command );
+		call.text = id;
+	}
+	else
+		call.text = name + L"(";
+	for( size_t i = 0; i < argTypes.size( ); i++ )
+	{
+		int32_t value;
+		if( !state.pop( value ) )
+			throw BVM_stack_exception( );
+		call.args.push_back( value );
+		call.text += ( i || name.empty( ) ? L", " : L" " ) + FormatHostArg( image, argTypes[i], value );
+	}
+	call.text += L" )";
+
+	if( stub != m_stubs.end( ) && stub->second.waits && call.args.size( ) > 0 )
+	{
+		//The game waits trunc( seconds * 60 ) frames
+		float seconds;
+		memcpy( &seconds, &call.args[0], sizeof( seconds ) );
+		if( seconds > 0.0f )
+			frame += (uint64_t)std::trunc( seconds * BVM_FRAMES_PER_SECOND );
+	}
+
+	if( call.returned )
+	{
+		if( !state.push( call.result ) )
+			throw BVM_stack_overflow_exception( );
+		call.text += L" -> " + FormatHostArg( image, returnType, call.result );
+	}
+
+	calls.push_back( call );
+	return true;
+}
+
+//Command names and argument counts from the same files the decompiler uses
+static void SetupStubHost( BVMStubHost& host, const BVMImage& image )
+{
+	host.image = &image;
+	host.SetCommands( 0, CMissionCommandTable::Load( L"EDF5_2C_MissionCommands.jsonaml" ) );
+	host.SetCommands( 1, CMissionCommandTable::Load( L"EDF5_2D_MissionCommands.jsonaml" ) );
+}
+
+//Runs the initialisers, then one function or every function through its stub. Statics keep their values between runs.
+static std::vector< BVMRunResult > RunBVMImage( const BVMImage& image, VMState& state, const BVMStubHost& host, const std::wstring& function, uint64_t instructionLimit )
+{
+	std::vector< BVMRunResult > runs;
+	auto runFrom = [&]( const std::wstring& name, int entry, int argCount )
+	{
+		BVMRunResult result;
+		result.name = name;
+		result.completed = false;
+		result.stopOffset = 0;
+
+		uint64_t before = state.instructions_executed;
+		state.stack_size = 0;
+		state.relative_RAS_idx = state.relative_RAS_start + state.relative_RAS.size( );
+		state.instruction_limit = before + instructionLimit;
+		try
+		{
+			if( entry < 0 )
+				throw BVM_unimplemented_exception( );
+
+			//The game passes arguments on the stack, zero stands in for each
+			for( int i = 0; i < argCount; i++ )
+				state.push( 0 );
+			state.run( image.program, entry );
+			result.completed = true;
+			result.stopReason = L"exit";
+		}
+		catch( const std::exception& e )
+		{
+			result.stopReason = entry < 0 ? L"entry is not an instruction" : DescribeStop( image, state, e );
+			if( entry >= 0 )
+				result.stopOffset = image.codeStart + image.program.instructions[state.fault_instruction].offset;
+		}
+		result.instructions = state.instructions_executed - before;
+		result.callsEnd = host.calls.size( );
+
+		LogLine line = LogInfo( );
+		line << result.name << L": " << result.instructions << L" instructions, " << result.stopReason;
+		if( !result.completed )
+			line << L" at 0x" << std::hex << result.stopOffset << std::dec;
+		line << L"\n";
+
+		runs.push_back( result );
+	};
+
+	runFrom( L"[initialisers]", 0, 0 );
+	for( size_t i = 0; i < image.functions.size( ); i++ )
+	{
+		if( function.empty( ) || image.functions[i].name == function )
+			runFrom( image.functions[i].name, image.FindInstruction( image.functions[i].stub ), image.functions[i].argCount );
+	}
+
+	if( runs.size( ) == 1 && !function.empty( ) )
+		LogError( ) << L"No function named " << function << L"\n";
+
+	return runs;
+}
+
+static std::wstring BVMBaseName( const std::wstring& path )
+{
+	size_t lastindex = path.find_last_of( L'.' );
+	return lastindex != std::wstring::npos ? path.substr( 0, lastindex ) : path;
+}
+
+int RunBVMProfile( const std::wstring& path, const std::wstring& function, uint64_t instructionLimit )
+{
+	BVMImage image;
+	if( !LoadBVMImage( path, image ) )
+	{
+		LogError( ) << L"Couldn't load " << path << L"\n";
+		return 1;
+	}
+
+	BVMStubHost host;
+	SetupStubHost( host, image );
+
+	VMState state( image.variables );
+	state.string_base = image.codeEnd;
+	state.host = &host;
+	BVMProfile profile;
+	profile.reset( image.program );
+	state.profile = &profile;
+
+	std::vector< BVMRunResult > runs = RunBVMImage( image, state, host, function, instructionLimit );
+
+	std::vector< BVMLoop > loops = FindHotLoops( image, profile );
+	std::vector< int > owners = InstructionOwners( image );
+	for( size_t i = 0; i < loops.size( ) && i < 5; i++ )
+	{
+		LogInfo( ) << L"Hot loop in " << UTF8ToWide( FunctionName( image, owners[loops[i].head] ) )
+			<< L" at 0x" << std::hex << image.codeStart + image.program.instructions[loops[i].head].offset << std::dec
+			<< L": " << loops[i].iterations << L" iterations, " << loops[i].instructions << L" instructions\n";
+	}
+
+	std::wstring base = BVMBaseName( path );
+	std::string json = BVMProfileToJSON( image, profile, runs );
+	std::string folded = BVMProfileToFolded( image, profile );
+	std::ofstream jsonFile( ToFilePath( base + L".profile.json" ), std::ios::binary );
+	jsonFile.write( json.data( ), json.size( ) );
+	std::ofstream foldedFile( ToFilePath( base + L".folded" ), std::ios::binary );
+	foldedFile.write( folded.data( ), folded.size( ) );
+	if( !jsonFile || !foldedFile )
+	{
+		LogError( ) << L"Couldn't write the profile next to " << base << L"\n";
+		return 1;
+	}
+
+	LogInfo( ) << L"Profile written to " << base << L".profile.json and " << base << L".folded\n";
+	return 0;
+}
+
+int RunBVMSimulation( const std::wstring& path, const std::wstring& stubPath, const std::wstring& function, uint64_t instructionLimit )
+{
+	BVMImage image;
+	if( !LoadBVMImage( path, image ) )
+	{
+		LogError( ) << L"Couldn't load " << path << L"\n";
+		return 1;
+	}
+
+	BVMStubHost host;
+	SetupStubHost( host, image );
+	if( !stubPath.empty( ) && !host.LoadStubs( stubPath ) )
+	{
+		LogError( ) << L"Couldn't read stubs from " << stubPath << L"\n";
+		return 1;
+	}
+
+	VMState state( image.variables );
+	state.string_base = image.codeEnd;
+	state.host = &host;
+
+	std::vector< BVMRunResult > runs = RunBVMImage( image, state, host, function, instructionLimit );
+
+	//Frame numbers and results only, so two builds can be diffed
+	std::wstring text;
+	size_t call = 0;
+	int failed = 0;
+	for( size_t i = 0; i < runs.size( ); i++ )
+	{
+		text += L"== " + runs[i].name + L"\n";
+		for( ; call < runs[i].callsEnd; call++ )
+			text += L"[" + std::to_wstring( host.calls[call].frame ) + L"] " + host.calls[call].text + L"\n";
+		text += L"-- " + runs[i].stopReason;
+		if( !runs[i].completed )
+		{
+			wchar_t offset[16];
+			swprintf( offset, 16, L" at 0x%x", runs[i].stopOffset );
+			text += offset;
+			failed++;
+		}
+		text += L"\n";
+	}
+
+	std::string utf8 = WideToUTF8( text );
+	std::wstring base = BVMBaseName( path );
+	std::ofstream callsFile( ToFilePath( base + L".calls.txt" ), std::ios::binary );
+	callsFile.write( utf8.data( ), utf8.size( ) );
+	if( !callsFile )
+	{
+		LogError( ) << L"Couldn't write " << base << L".calls.txt\n";
+		return 1;
+	}
+
+	LogInfo( ) << host.calls.size( ) << L" host calls over " << host.frame << L" frames (" << host.frame / (double)BVM_FRAMES_PER_SECOND << L" s), written to " << base << L".calls.txt\n";
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+//A function from the .bvm function table. Offsets are in the file.
+struct BVMFunctionInfo
+{
+	std::wstring name;
+	uint32_t start; //Return block the function jumps back to
+	uint32_t entry; //First instruction when called
+	uint32_t end;
+	uint32_t stub; //Call and exit the game runs the function through
+	int argCount;
+	bool doesReturn;
+};
+
+//Compiled mission loaded for running outside the game
+struct BVMImage
+{
+	std::vector< char > buffer;
+	std::vector< std::wstring > variables;
+	std::vector< BVMFunctionInfo > functions;
+
+	//Static initialisers up to the string table, decoded as one program with offsets from codeStart
+	uint32_t codeStart;
+	uint32_t codeEnd;
+	BVMProgram program;
+
+	//Instruction index of a file offset, -1 if none starts there
+	int FindInstruction( uint32_t offset ) const;
+	//Function whose bytes contain a file offset, -1 for the initialisers
+	int FindFunction( uint32_t offset ) const;
+};
+
+//Reads the header, function table and code of a .bvm. False if it isn't one.
+bool LoadBVMImage( const std::wstring& path, BVMImage& image );
+
+//How one profiled run ended
+struct BVMRunResult
+{
+	std::wstring name;
+	bool completed;
+	std::wstring stopReason;
+	uint32_t stopOffset;
+	uint64_t instructions;
+	size_t callsEnd; //Host calls made up to the end of this run
+};
+
+//Stand-in for one host command, anything it doesn't set comes from the command definitions
+struct BVMStub
+{
+	BVMStub( ) : setsArgs( false ), setsReturn( false ), returnValue( 0 ), waits( false ){};
+
+	std::wstring name;
+	bool setsArgs;
+	std::vector< std::wstring > argTypes;
+	bool setsReturn;
+	std::wstring returnType;
+	int32_t returnValue;
+	//Takes seconds as a float first argument and moves the virtual clock on
+	bool waits;
+};
+
+//One answered host call, arguments in the order the decompiler prints them
+struct BVMHostCall
+{
+	uint64_t frame;
+	int language;
+	uint32_t command;
+	std::vector< int32_t > args;
+	bool returned;
+	int32_t result;
+	std::wstring text;
+};
+
+//Answers 2C / 2D calls without the game: pops the arguments, records the call and pushes a set value.
+//Time only moves when a wait command runs, so every run of a mission gives the same calls.
+class BVMStubHost : public BVMHost
+{
+public:
+	BVMStubHost( );
+
+	void SetCommands( int language, std::shared_ptr< const CMissionCommandTable > commands );
+	void SetStub( int language, uint32_t command, const BVMStub& stub );
+	//One "2C 0x28 [name Name] [args type...] [wait] [= value]" per line, // starts a comment. False if it can't be read.
+	bool LoadStubs( const std::wstring& path );
+
+	bool call( VMState& state, int language, uint32_t command ) override;
+
+	//Strings are read from here when set
+	const BVMImage *image;
+	//Virtual clock in game frames, 60 a second
+	uint64_t frame;
+	std::vector< BVMHostCall > calls;
+
+private:
+	std::shared_ptr< const CMissionCommandTable > m_commands[4];
+	std::unordered_map< uint64_t, BVMStub > m_stubs;
+};
+
+//Per opcode and per function counts, hot loops and executed offsets
+std::string BVMProfileToJSON( const BVMImage& image, const BVMProfile& profile, const std::vector< BVMRunResult >& runs );
+//One "function;loop@offset count" line per stack, for flamegraph.pl and speedscope
+std::string BVMProfileToFolded( const BVMImage& image, const BVMProfile& profile );
+
+//Runs the initialisers and then one function, or every function, writing <path>.profile.json and <path>.folded.
+//Each run stops at instructionLimit instructions. Returns 0 if the file loaded.
+int RunBVMProfile( const std::wstring& path, const std::wstring& function, uint64_t instructionLimit );
+
+//Same runs with host calls answered by stubs, writing the calls to <path>.calls.txt for diffing between builds.
+//Returns 0 if every run reached its exit.
+int RunBVMSimulation( const std::wstring& path, const std::wstring& stubPath, const std::wstring& function, uint64_t instructionLimit );
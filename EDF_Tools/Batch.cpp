@@ -0,0 +1,180 @@
+#include "stdafx.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include "util.h"
+#include "Log.h"
+#include "FileIO.h"
+#include "Batch.h"
+
+std::vector< std::wstring > FindBatchInputs( const std::wstring& directory, const std::vector< std::wstring >& extensions, bool recursive )
+{
+	std::vector< std::wstring > files;
+	for( const std::wstring& path : ListFiles( directory, L"", recursive ) )
+	{
+		size_t lastindex = path.find_last_of( L'.' );
+		if( lastindex == std::wstring::npos )
+			continue;
+
+		std::wstring extension = ConvertToLower( path.substr( lastindex + 1 ) );
+		for( size_t i = 0; i < extensions.size( ); ++i )
+		{
+			if( extension == ConvertToLower( extensions[i] ) )
+			{
+				files.push_back( path );
+				break;
+			}
+		}
+	}
+	return files;
+}
+
+static double MillisecondsSince( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now( ) - start ).count( );
+}
+
+//what( ) isn't always UTF-8, keep it readable either way
+static std::wstring ErrorText( const char *what )
+{
+	try
+	{
+		return UTF8ToWide( what );
+	}
+	catch( const std::exception& )
+	{
+		std::string text = what;
+		return std::wstring( text.begin( ), text.end( ) );
+	}
+}
+
+BatchSummary RunBatch( const std::vector< std::wstring >& files, const BatchConverter& convert, int threads )
+{
+	BatchSummary summary;
+	summary.failed = 0;
+	summary.bytes = 0;
+	summary.ms = 0.0;
+
+	summary.files.resize( files.size( ) );
+	for( size_t i = 0; i < files.size( ); ++i )
+	{
+		summary.files[i].path = files[i];
+		summary.files[i].bytes = GetFileLength( files[i] );
+		summary.files[i].ms = 0.0;
+		summary.files[i].ok = false;
+	}
+
+	//Stable, so equal sizes keep the listing order
+	std::stable_sort( summary.files.begin( ), summary.files.end( ), []( const BatchFileResult& a, const BatchFileResult& b ) { return a.bytes > b.bytes; } );
+
+	if( threads <= 0 )
+		threads = std::thread::hardware_concurrency( );
+	if( threads <= 0 )
+		threads = 1;
+	if( threads > (int)files.size( ) )
+		threads = (int)files.size( );
+	summary.threads = threads;
+
+	if( files.size( ) == 0 )
+		return summary;
+
+	std::atomic< int > next( 0 );
+	auto worker = [&]( )
+	{
+		for( int i = next++; i < (int)summary.files.size( ); i = next++ )
+		{
+			BatchFileResult& result = summary.files[i];
+			auto start = std::chrono::steady_clock::now( );
+
+			//Nothing thrown by one file should stop the others
+			try
+			{
+				result.ok = convert( result.path );
+			}
+			catch( const std::exception& e )
+			{
+				result.error = ErrorText( e.what( ) );
+			}
+			catch( ... )
+			{
+				result.error = L"unknown exception";
+			}
+
+			result.ms = MillisecondsSince( start );
+			//Whatever the file logged goes out together
+			Log::Flush( );
+		}
+	};
+
+	auto batchStart = std::chrono::steady_clock::now( );
+
+	std::vector< std::thread > pool;
+	for( int i = 1; i < threads; ++i )
+		pool.push_back( std::thread( worker ) );
+	worker( );
+	for( size_t i = 0; i < pool.size( ); ++i )
+		pool[i].join( );
+
+	summary.ms = MillisecondsSince( batchStart );
+
+	for( size_t i = 0; i < summary.files.size( ); ++i )
+	{
+		if( !summary.files[i].ok )
+			++summary.failed;
+		summary.bytes += summary.files[i].bytes;
+	}
+
+	return summary;
+}
+
+void PrintBatchSummary( const BatchSummary& summary )
+{
+	for( size_t i = 0; i < summary.files.size( ); ++i )
+	{
+		const BatchFileResult& result = summary.files[i];
+		LogLine line( result.ok ? LogLevel::Info : LogLevel::Warning );
+		line << result.path << L": " << ( result.ok ? L"" : L"FAILED, " );
+		if( !result.error.empty( ) )
+			line << result.error << L", ";
+		line << (long long)result.ms << L" ms\n";
+	}
+
+	LogInfo( ) << L"Converted " << summary.files.size( ) - summary.failed << L" of " << summary.files.size( ) << L" files"
+		<< L" in " << (long long)summary.ms << L" ms on " << summary.threads << L" threads"
+		<< L" (" << MegabytesPerSecond( summary.bytes, summary.ms ) << L" MB/s)\n";
+}
+
+std::string BatchSummaryToJSON( const BatchSummary& summary )
+{
+	std::string out = "{\n";
+	out += "\t\"files\": " + std::to_string( summary.files.size( ) ) + ",\n";
+	out += "\t\"failed\": " + std::to_string( summary.failed ) + ",\n";
+	out += "\t\"threads\": " + std::to_string( summary.threads ) + ",\n";
+	out += "\t\"bytes\": " + std::to_string( summary.bytes ) + ",\n";
+	out += "\t\"ms\": " + JSONNumber( summary.ms ) + ",\n";
+	out += "\t\"mb_per_second\": " + JSONNumber( MegabytesPerSecond( summary.bytes, summary.ms ) ) + ",\n";
+
+	out += "\t\"results\": [";
+	for( size_t i = 0; i < summary.files.size( ); i++ )
+	{
+		const BatchFileResult& result = summary.files[i];
+		out += i ? ",\n\t\t" : "\n\t\t";
+		out += "{ \"path\": " + JSONString( result.path );
+		out += ", \"ok\": " + std::string( result.ok ? "true" : "false" );
+		out += ", \"bytes\": " + std::to_string( result.bytes );
+		out += ", \"ms\": " + JSONNumber( result.ms );
+		out += ", \"mb_per_second\": " + JSONNumber( MegabytesPerSecond( result.bytes, result.ms ) );
+		if( !result.error.empty( ) )
+			out += ", \"error\": " + JSONString( result.error );
+		out += " }";
+	}
+	out += "\n\t]\n}\n";
+
+	return out;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+//How one file of a batch went
+struct BatchFileResult
+{
+	std::wstring path;
+	uint64_t bytes;
+	double ms;
+	bool ok;
+	std::wstring error; //What the converter threw, empty if it returned
+};
+
+struct BatchSummary
+{
+	std::vector< BatchFileResult > files; //In the order they were started
+	int threads;
+	int failed;
+	uint64_t bytes;
+	double ms; //Wall clock for the whole run
+};
+
+//Converts one file, returning false or throwing marks it as failed
+typedef std::function< bool( const std::wstring& path ) > BatchConverter;
+
+//Files under a folder with any of the extensions (no dot, any case)
+std::vector< std::wstring > FindBatchInputs( const std::wstring& directory, const std::vector< std::wstring >& extensions, bool recursive );
+
+//Runs convert over every file on a pool of threads, largest files first so a big one doesn't start last and run alone.
+//A file that fails or throws is recorded and the rest carry on. threads <= 0 uses one per core.
+BatchSummary RunBatch( const std::vector< std::wstring >& files, const BatchConverter& convert, int threads = 0 );
+
+//One line per file and the totals
+void PrintBatchSummary( const BatchSummary& summary );
+//Totals, throughput and every file with its size, time and error
+std::string BatchSummaryToJSON( const BatchSummary& summary );
@@ -0,0 +1,581 @@
+#include "stdafx.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <functional>
+#include <locale>
+#include <codecvt>
+#include <filesystem>
+#include <system_error>
+#include "util.h"
+#include "Log.h"
+#include "FileIO.h"
+#include "MissionCommands.h"
+#include "MissionScript.h"
+#include "VMState.h"
+#include "ByteStream.h"
+#include "Benchmark.h"
+
+#define BENCH_COMPILE_NAME L"bench_compile"
+#define BENCH_NUM_STATICS 8
+#define BENCH_NUM_LOCALS 8
+
+static std::wstring BenchValue( BenchRandom& rng )
+{
+	switch( rng.Next( 5 ) )
+	{
+	case 0:
+		return ToString( rng.Next( 500 ) );
+	case 1:
+		return ToString( rng.Next( 100 ) ) + L".5f";
+	case 2:
+		return L"x" + ToString( rng.Next( BENCH_NUM_LOCALS ) );
+	case 3:
+		return L"gV" + ToString( rng.Next( BENCH_NUM_STATICS ) );
+	default:
+		return L"\"text " + ToString( rng.Next( 64 ) ) + L"\"";
+	}
+}
+
+//Calls stay near the caller, call offsets are limited to 16 bits
+static int BenchCallee( BenchRandom& rng, int fn, int functions )
+{
+	int callee = fn + rng.Next( 5 ) - 2;
+	return std::min( std::max( callee, 0 ), functions - 1 );
+}
+
+static void BenchStatement( std::wstring& out, BenchRandom& rng, int fn, int functions, bool allowBlocks, const std::wstring& indent )
+{
+	std::wstring local = L"x" + ToString( rng.Next( BENCH_NUM_LOCALS ) );
+
+	switch( rng.Next( allowBlocks ? 8 : 5 ) )
+	{
+	case 0:
+		out += indent + local + L" = " + local + L" + " + ToString( rng.Next( 9 ) + 1 ) + L";\n";
+		break;
+	case 1:
+		out += indent + L"2C( " + ToString( rng.Next( 0x300 ) ) + L", " + BenchValue( rng ) + L", " + BenchValue( rng ) + L" );\n";
+		break;
+	case 2:
+		out += indent + L"2D( " + ToString( rng.Next( 0x120 ) ) + L" );\n";
+		break;
+	case 3:
+		out += indent + L"Fn" + ToString( BenchCallee( rng, fn, functions ) ) + L"( " + ToString( rng.Next( 10 ) ) + L", 1.0f );\n";
+		break;
+	case 4:
+		out += indent + L"// note " + ToString( rng.Next( 100 ) ) + L"\n";
+		break;
+	case 5:
+		out += indent + L"if( " + local + L" < " + ToString( rng.Next( 10 ) ) + L" )\n" + indent + L"{\n";
+		BenchStatement( out, rng, fn, functions, false, indent + L"\t" );
+		out += indent + L"}\n" + indent + L"else\n" + indent + L"{\n";
+		BenchStatement( out, rng, fn, functions, false, indent + L"\t" );
+		out += indent + L"}\n";
+		break;
+	case 6:
+		out += indent + L"while( " + local + L" < " + ToString( rng.Next( 10 ) ) + L" )\n" + indent + L"{\n";
+		out += indent + L"\t" + local + L" = " + local + L" + 1;\n";
+		BenchStatement( out, rng, fn, functions, false, indent + L"\t" );
+		out += indent + L"}\n";
+		break;
+	default:
+		out += indent + local + L" = " + BenchValue( rng ) + L";\n";
+		break;
+	}
+}
+
+std::wstring GenerateBenchmarkScript( int functions, int statements, unsigned int seed )
+{
+	BenchRandom rng( seed );
+	std::wstring out = L"// generated benchmark mission\n#define MAXV 20\n";
+
+	for( int i = 0; i < BENCH_NUM_STATICS; i++ )
+		out += L"static int gV" + ToString( i ) + L";\n";
+
+	out += L"initialize Mission()\n{\n";
+	for( int i = 0; i < BENCH_NUM_STATICS; i++ )
+		out += L"\tgV" + ToString( i ) + L"(" + ToString( rng.Next( 100 ) ) + L");\n";
+	out += L"}\n";
+
+	for( int fn = 0; fn < functions; fn++ )
+	{
+		out += L"void Fn" + ToString( fn ) + L"( int p0, float p1 )\n{\n";
+
+		//Locals are set up front so every later read resolves
+		for( int i = 0; i < BENCH_NUM_LOCALS; i++ )
+			out += L"\tx" + ToString( i ) + L" = " + ToString( i ) + L";\n";
+
+		for( int i = 0; i < statements; i++ )
+			BenchStatement( out, rng, fn, functions, true, L"\t" );
+
+		out += L"}\n";
+	}
+
+	return out;
+}
+
+//One Write with the console muted, in milliseconds
+static double TimeCompile( const std::wstring& path, int *cachedFunctions )
+{
+	//The compiler logs every function, keep that out of the timing
+	LogLevel level = Log::level;
+	Log::level = LogLevel::None;
+
+	auto start = std::chrono::steady_clock::now( );
+	std::unique_ptr< CMissionScript > script = std::make_unique< CMissionScript >( );
+	script->Write( path, 0 );
+	if( cachedFunctions )
+		*cachedFunctions = script->GetNumCachedFunctions( );
+	script.reset( );
+	auto end = std::chrono::steady_clock::now( );
+
+	Log::level = level;
+
+	return std::chrono::duration< double, std::milli >( end - start ).count( );
+}
+
+int RunCompileBenchmark( int functions, int statements, int runs )
+{
+	std::wstring source = GenerateBenchmarkScript( functions, statements );
+	size_t lines = std::count( source.begin( ), source.end( ), L'\n' );
+
+	std::wstring path = BENCH_COMPILE_NAME;
+	WriteUTF16File( ( path + L".txt" ).c_str( ), source );
+
+	LogInfo( ) << L"Compile benchmark: " << functions << L" functions, " << lines << L" lines, " << runs << L" runs\n";
+
+	//Full compiles, the cache would turn every run after the first into a relink
+	bool useCache = CMissionScript::bUseCompileCache;
+	CMissionScript::bUseCompileCache = false;
+
+	double best = 0.0;
+	double total = 0.0;
+	for( int run = 0; run < runs; run++ )
+	{
+		double ms = TimeCompile( path, nullptr );
+		total += ms;
+		if( run == 0 || ms < best )
+			best = ms;
+
+		LogInfo( ) << L"Run " << run + 1 << L": " << ms << L" ms\n";
+	}
+
+	if( runs > 0 )
+	{
+		LogInfo( ) << L"Best " << best << L" ms, mean " << total / runs << L" ms, ";
+		LogInfo( ) << (long long)( lines / ( best / 1000.0 ) ) << L" lines/s\n";
+
+		//The runs above compile functions on the pool, compare against one thread
+		int threads = CMissionScript::iCompileThreads;
+		CMissionScript::iCompileThreads = 1;
+		double single = TimeCompile( path, nullptr );
+		CMissionScript::iCompileThreads = threads;
+		LogInfo( ) << L"One thread " << single << L" ms, " << single / best << L"x with " << std::thread::hardware_concurrency( ) << L" cores\n";
+	}
+
+	//Incremental: warm the cache, change one line in the middle function and compile again
+	if( functions > 0 )
+	{
+		CMissionScript::bUseCompileCache = true;
+		//No cache to begin with is fine
+		std::error_code error;
+		std::filesystem::remove( ToFilePath( path + L".txt.cache" ), error );
+		double cold = TimeCompile( path, nullptr );
+
+		std::wstring header = L"void Fn" + ToString( functions / 2 ) + L"( int p0, float p1 )\n{\n";
+		size_t pos = source.find( header );
+		if( pos != std::wstring::npos )
+			source.insert( pos + header.size( ), L"\tx0 = x0 + 1;\n" );
+		WriteUTF16File( ( path + L".txt" ).c_str( ), source );
+
+		int cached = 0;
+		double warm = TimeCompile( path, &cached );
+		LogInfo( ) << L"Cache: first compile " << cold << L" ms, one function edited " << warm << L" ms (" << cached << L" of " << functions << L" functions reused)\n";
+	}
+
+	CMissionScript::bUseCompileCache = useCache;
+
+	LogInfo( ) << L"Output left in " << path << L".txt / " << path << L".bvm\n";
+
+	return 0;
+}
+
+//Counts RAS[0] up to iterations while mixing it into RAS[1]. Returns the code and the expected RAS[1].
+static std::vector< unsigned char > GenerateBenchmarkLoop( int iterations, int *expected )
+{
+	std::vector< unsigned char > code;
+	auto emit = [&code]( std::initializer_list< int > bytes )
+	{
+		for( int byte : bytes )
+			code.push_back( (unsigned char)byte );
+	};
+	auto patchJump = [&code]( size_t opcodePos, size_t target )
+	{
+		int ofs = (int)target - (int)opcodePos;
+		code[opcodePos + 1] = ofs & 0xFF;
+		code[opcodePos + 2] = ( ofs >> 8 ) & 0xFF;
+	};
+
+	emit( { 0x15, 0x56, 0x00 } ); //i = 0
+	emit( { 0x15, 0x56, 0x01 } ); //acc = 0
+
+	size_t loop = code.size( );
+	emit( { 0x54, 0x00, 0xD5 } ); //i < iterations
+	emit( { iterations & 0xFF, ( iterations >> 8 ) & 0xFF, ( iterations >> 16 ) & 0xFF, ( iterations >> 24 ) & 0xFF } );
+	emit( { 0x20, 0x00 } );
+	size_t exitJump = code.size( );
+	emit( { 0xA6, 0x00, 0x00 } );
+
+	emit( { 0x54, 0x01, 0x54, 0x00, 0x04, 0x00, 0x55, 0x07, 0x10, 0x56, 0x01 } ); //acc = ( acc + i ) ^ 7
+	emit( { 0x54, 0x00, 0x33, 0x04, 0x00, 0x56, 0x00 } ); //i = i + 1
+
+	size_t backJump = code.size( );
+	emit( { 0xA8, 0x00, 0x00 } );
+	patchJump( backJump, loop );
+	patchJump( exitJump, code.size( ) );
+	emit( { 0x30 } );
+
+	unsigned int acc = 0;
+	for( int i = 0; i < iterations; i++ )
+		acc = ( acc + i ) ^ 7;
+	*expected = (int)acc;
+
+	return code;
+}
+
+int RunVMBenchmark( int iterations, int runs )
+{
+	int expected;
+	std::vector< unsigned char > code = GenerateBenchmarkLoop( iterations, &expected );
+
+	auto start = std::chrono::steady_clock::now( );
+	BVMProgram program;
+	program.decode( code.data( ), code.size( ) );
+	double decodeMs = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now( ) - start ).count( );
+
+	LogInfo( ) << L"BVM benchmark: " << iterations << L" loop iterations, " << program.instructions.size( ) - 1 << L" instructions decoded in " << decodeMs << L" ms\n";
+
+	std::vector< std::wstring > names = { L"i", L"acc" };
+	double best = 0.0;
+	for( int run = 0; run < runs; run++ )
+	{
+		VMState state( names );
+
+		start = std::chrono::steady_clock::now( );
+		state.run( program );
+		double ms = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now( ) - start ).count( );
+
+		if( (int)state.static_RAS[0].value != iterations || (int)state.static_RAS[1].value != expected )
+		{
+			LogWarning( ) << L"Run " << run + 1 << L": wrong result\n";
+			return 1;
+		}
+
+		if( run == 0 || ms < best )
+			best = ms;
+		LogInfo( ) << L"Run " << run + 1 << L": " << ms << L" ms, " << state.instructions_executed << L" instructions, ";
+		LogInfo( ) << state.instructions_executed / ( ms * 1000.0 ) << L" M instructions/s\n";
+	}
+
+	return 0;
+}
+
+//Copies of the byte helpers ByteReader / ByteWriter replaced, kept here to compare against
+static void LegacyRead4Bytes( unsigned char *chunk, const std::vector< char >& buf, int pos )
+{
+	chunk[3] = buf[pos];
+	chunk[2] = buf[pos + 1];
+	chunk[1] = buf[pos + 2];
+	chunk[0] = buf[pos + 3];
+}
+
+static void LegacyRead4BytesReversed( unsigned char *chunk, const std::vector< char >& buf, int pos )
+{
+	chunk[0] = buf[pos];
+	chunk[1] = buf[pos + 1];
+	chunk[2] = buf[pos + 2];
+	chunk[3] = buf[pos + 3];
+}
+
+static int LegacyGetIntFromChunk( unsigned char *chunk )
+{
+	int num = 0;
+	for( int i = 0; i < 4; i++ )
+	{
+		num <<= 8;
+		num |= chunk[i];
+	}
+	return num;
+}
+
+static char *LegacyIntToBytes( int i )
+{
+	char *bytes = (char*)malloc( sizeof( char ) * 4 );
+	unsigned long n = i;
+	bytes[0] = n & 0xFF;
+	bytes[1] = ( n >> 8 ) & 0xFF;
+	bytes[2] = ( n >> 16 ) & 0xFF;
+	bytes[3] = ( n >> 24 ) & 0xFF;
+	return bytes;
+}
+
+//Best of runs for one pass over the buffer, in ns per value. The pass returns a checksum so it can't be optimised out.
+template< typename F > static double TimeBytePass( int runs, size_t values, F pass, uint64_t *checksum )
+{
+	double best = 0.0;
+	for( int run = 0; run < runs; run++ )
+	{
+		auto start = std::chrono::steady_clock::now( );
+		*checksum = pass( );
+		double ns = std::chrono::duration< double, std::nano >( std::chrono::steady_clock::now( ) - start ).count( );
+		if( run == 0 || ns < best )
+			best = ns;
+	}
+	return best / values;
+}
+
+static bool ReportBytePass( const wchar_t *name, int runs, size_t values, std::function< uint64_t( ) > legacy, std::function< uint64_t( ) > current )
+{
+	uint64_t legacySum, currentSum;
+	double legacyNs = TimeBytePass( runs, values, legacy, &legacySum );
+	double currentNs = TimeBytePass( runs, values, current, &currentSum );
+
+	LogInfo( ) << name << L": helpers " << legacyNs << L" ns, ByteStream " << currentNs << L" ns, " << legacyNs / currentNs << L"x";
+	if( legacySum != currentSum )
+	{
+		LogInfo( ) << L" - results differ!\n";
+		return false;
+	}
+	LogInfo( ) << L"\n";
+	return true;
+}
+
+int RunByteBenchmark( int values, int runs )
+{
+	if( values <= 0 )
+		return 1;
+
+	BenchRandom rng( 1 );
+	std::vector< char > buffer( (size_t)values * 4 );
+	for( char& byte : buffer )
+		byte = (char)rng.Next( 256 );
+
+	LogInfo( ) << L"Byte benchmark: " << values << L" values, best of " << runs << L" runs, ns per value\n";
+
+	bool ok = true;
+
+	ok &= ReportBytePass( L"int32 LE read", runs, values, [&]( )
+	{
+		uint64_t sum = 0;
+		unsigned char seg[4];
+		for( int i = 0; i < values; i++ )
+		{
+			LegacyRead4Bytes( seg, buffer, i * 4 );
+			sum += (uint32_t)LegacyGetIntFromChunk( seg );
+		}
+		return sum;
+	}, [&]( )
+	{
+		uint64_t sum = 0;
+		ByteReaderLE reader( buffer );
+		for( int i = 0; i < values; i++ )
+			sum += (uint32_t)reader.Get< int32_t >( i * 4 );
+		return sum;
+	} );
+
+	ok &= ReportBytePass( L"int32 BE read", runs, values, [&]( )
+	{
+		uint64_t sum = 0;
+		unsigned char seg[4];
+		for( int i = 0; i < values; i++ )
+		{
+			LegacyRead4BytesReversed( seg, buffer, i * 4 );
+			sum += (uint32_t)LegacyGetIntFromChunk( seg );
+		}
+		return sum;
+	}, [&]( )
+	{
+		uint64_t sum = 0;
+		ByteReaderBE reader( buffer );
+		for( int i = 0; i < values; i++ )
+			sum += (uint32_t)reader.Get< int32_t >( i * 4 );
+		return sum;
+	} );
+
+	//Floats are summed as their bits, random bytes make NaNs
+	ok &= ReportBytePass( L"float BE read", runs, values, [&]( )
+	{
+		uint64_t sum = 0;
+		unsigned char seg[4];
+		for( int i = 0; i < values; i++ )
+		{
+			LegacyRead4Bytes( seg, buffer, i * 4 );
+			float f;
+			memcpy( &f, &seg, sizeof( f ) );
+			uint32_t bits;
+			memcpy( &bits, &f, sizeof( bits ) );
+			sum += bits;
+		}
+		return sum;
+	}, [&]( )
+	{
+		uint64_t sum = 0;
+		ByteReaderBE reader( buffer );
+		for( int i = 0; i < values; i++ )
+		{
+			float f = reader.Get< float >( i * 4 );
+			uint32_t bits;
+			memcpy( &bits, &f, sizeof( bits ) );
+			sum += bits;
+		}
+		return sum;
+	} );
+
+	ok &= ReportBytePass( L"int32 LE write", runs, values, [&]( )
+	{
+		std::vector< char > out;
+		for( int i = 0; i < values; i++ )
+		{
+			char *seg = LegacyIntToBytes( (int)( i * 2654435761u ) );
+			for( int j = 0; j < 4; j++ )
+				out.push_back( seg[j] );
+			free( seg );
+		}
+		return (uint64_t)ReadLE< uint32_t >( out, out.size( ) - 4 ) + out.size( );
+	}, [&]( )
+	{
+		std::vector< char > out;
+		ByteWriterLE writer( out );
+		for( int i = 0; i < values; i++ )
+			writer.Put< int32_t >( (int32_t)( i * 2654435761u ) );
+		return (uint64_t)ReadLE< uint32_t >( out, out.size( ) - 4 ) + out.size( );
+	} );
+
+	return ok ? 0 : 1;
+}
+
+//Names like the ones in bone and animation lists, a quarter of them with Japanese
+static std::vector< std::string > GenerateBenchmarkNames( int names )
+{
+	static const char *prefixes[] = { "bone_", "anm", "set", "Bip01_", "\xE6\xAD\xA6\xE5\x99\xA8_", "\xE8\x85\x95" };
+	BenchRandom rng( 1 );
+
+	std::vector< std::string > out( names );
+	for( int i = 0; i < names; i++ )
+	{
+		int prefix = rng.Next( 8 );
+		out[i] = prefix < 6 ? prefixes[prefix] : "node";
+		out[i] += std::to_string( rng.Next( 1000 ) );
+	}
+	return out;
+}
+
+static bool ReportUnicodePass( const wchar_t *name, int runs, size_t values, std::function< uint64_t( ) > legacy, std::function< uint64_t( ) > current, std::function< uint64_t( ) > reused )
+{
+	uint64_t legacySum, currentSum, reusedSum;
+	double legacyNs = TimeBytePass( runs, values, legacy, &legacySum );
+	double currentNs = TimeBytePass( runs, values, current, &currentSum );
+	double reusedNs = TimeBytePass( runs, values, reused, &reusedSum );
+
+	LogInfo( ) << name << L": wstring_convert " << legacyNs << L" ns, new " << currentNs << L" ns (" << legacyNs / currentNs << L"x), reused buffer " << reusedNs << L" ns (" << legacyNs / reusedNs << L"x)";
+	if( legacySum != currentSum || legacySum != reusedSum )
+	{
+		LogInfo( ) << L" - results differ!\n";
+		return false;
+	}
+	LogInfo( ) << L"\n";
+	return true;
+}
+
+int RunUnicodeBenchmark( int names, int runs )
+{
+	if( names <= 0 )
+		return 1;
+
+	std::vector< std::string > utf8 = GenerateBenchmarkNames( names );
+	std::vector< std::wstring > wide( names );
+	for( int i = 0; i < names; i++ )
+		wide[i] = UTF8ToWide( utf8[i] );
+
+	LogInfo( ) << L"Unicode benchmark: " << names << L" names, best of " << runs << L" runs, ns per name\n";
+
+	//Sums lengths and units so every conversion has to happen
+	auto sumWide = []( const std::wstring& str )
+	{
+		uint64_t sum = str.size( );
+		for( wchar_t c : str )
+			sum = sum * 31 + (uint32_t)c;
+		return sum;
+	};
+	auto sumUTF8 = []( const std::string& str )
+	{
+		uint64_t sum = str.size( );
+		for( char c : str )
+			sum = sum * 31 + (unsigned char)c;
+		return sum;
+	};
+
+	bool ok = true;
+
+	ok &= ReportUnicodePass( L"UTF-8 to wide", runs, names, [&]( )
+	{
+		uint64_t sum = 0;
+		for( const std::string& str : utf8 )
+		{
+			std::wstring_convert< std::codecvt_utf8< wchar_t > > conv;
+			sum += sumWide( conv.from_bytes( str ) );
+		}
+		return sum;
+	}, [&]( )
+	{
+		uint64_t sum = 0;
+		for( const std::string& str : utf8 )
+			sum += sumWide( UTF8ToWide( str ) );
+		return sum;
+	}, [&]( )
+	{
+		uint64_t sum = 0;
+		std::wstring out;
+		for( const std::string& str : utf8 )
+		{
+			UTF8ToWide( str, out );
+			sum += sumWide( out );
+		}
+		return sum;
+	} );
+
+	ok &= ReportUnicodePass( L"wide to UTF-8", runs, names, [&]( )
+	{
+		uint64_t sum = 0;
+		for( const std::wstring& str : wide )
+		{
+			std::wstring_convert< std::codecvt_utf8< wchar_t > > conv;
+			sum += sumUTF8( conv.to_bytes( str ) );
+		}
+		return sum;
+	}, [&]( )
+	{
+		uint64_t sum = 0;
+		for( const std::wstring& str : wide )
+			sum += sumUTF8( WideToUTF8( str ) );
+		return sum;
+	}, [&]( )
+	{
+		uint64_t sum = 0;
+		std::string out;
+		for( const std::wstring& str : wide )
+		{
+			WideToUTF8( str, out );
+			sum += sumUTF8( out );
+		}
+		return sum;
+	} );
+
+	return ok ? 0 : 1;
+}
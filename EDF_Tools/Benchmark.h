@@ -0,0 +1,39 @@
+#pragma once
+
+//Small LCG, std::rand differs between runtimes
+struct BenchRandom
+{
+	BenchRandom( unsigned int seed ) : state( seed ){};
+
+	int Next( int range )
+	{
+		state = state * 1103515245u + 12345u;
+		return (int)( ( state >> 16 ) % (unsigned int)range );
+	}
+
+	unsigned int state;
+};
+
+//Builds a mission script with the given number of functions and statements per function.
+//Deterministic for a seed, so timings can be compared between builds.
+std::wstring GenerateBenchmarkScript( int functions, int statements, unsigned int seed = 1 );
+
+//Compiles a generated script runs times and prints the timings. Returns 0 on success.
+int RunCompileBenchmark( int functions, int statements, int runs );
+
+//Runs a synthetic BVM loop of the given length through the interpreter and prints instructions per second.
+//Returns 0 if every run produced the expected result.
+int RunVMBenchmark( int iterations, int runs );
+
+//Times the ByteStream readers and writer against the old util.cpp byte helpers on random data.
+//Returns 0 if both gave the same results.
+int RunByteBenchmark( int values, int runs );
+
+//Converts a million or so short UTF-8 names to wide strings and back, timing std::wstring_convert against util.cpp.
+//Returns 0 if both gave the same results.
+int RunUnicodeBenchmark( int names, int runs );
+
+//Generates a corpus for every format, then times write, read and a round trip (the binary read back and written
+//again, which has to match) for each. Results are appended to the JSON history and compared with its last run
+//at the same scale. Returns 0 if every round trip matched.
+int RunFormatBenchmark( int scale, int runs, const std::wstring& historyPath );
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "include/half.hpp"
+
+#if defined( _MSC_VER )
+#include <stdlib.h>
+#endif
+
+//Byte order of a file format, picked at compile time so a read is one load plus a bswap at most
+enum class Endian
+{
+	Little,
+	Big,
+#if defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	Native = Big
+#else
+	Native = Little
+#endif
+};
+
+namespace ByteOrder
+{
+	inline uint8_t Swap( uint8_t value )
+	{
+		return value;
+	}
+
+	inline uint16_t Swap( uint16_t value )
+	{
+#if defined( _MSC_VER )
+		return _byteswap_ushort( value );
+#else
+		return __builtin_bswap16( value );
+#endif
+	}
+
+	inline uint32_t Swap( uint32_t value )
+	{
+#if defined( _MSC_VER )
+		return _byteswap_ulong( value );
+#else
+		return __builtin_bswap32( value );
+#endif
+	}
+
+	inline uint64_t Swap( uint64_t value )
+	{
+#if defined( _MSC_VER )
+		return _byteswap_uint64( value );
+#else
+		return __builtin_bswap64( value );
+#endif
+	}
+
+	//Unsigned integer the same size as T, values are swapped as one of these
+	template< size_t N > struct Bits;
+	template<> struct Bits< 1 > { typedef uint8_t type; };
+	template<> struct Bits< 2 > { typedef uint16_t type; };
+	template<> struct Bits< 4 > { typedef uint32_t type; };
+	template<> struct Bits< 8 > { typedef uint64_t type; };
+
+	//Tag for building a half_float::half from its bits, see the half_caster below
+	struct HalfBits {};
+
+	//memcpy in and out is the portable bit cast, compilers turn it into a plain load
+	template< typename T > inline T FromBits( typename Bits< sizeof( T ) >::type bits )
+	{
+		T value;
+		memcpy( &value, &bits, sizeof( T ) );
+		return value;
+	}
+
+	template<> inline half_float::half FromBits< half_float::half >( uint16_t bits );
+
+	template< Endian E, typename T > inline T Load( const void *src )
+	{
+		typename Bits< sizeof( T ) >::type bits;
+		memcpy( &bits, src, sizeof( T ) );
+		if( E != Endian::Native )
+			bits = Swap( bits );
+
+		return FromBits< T >( bits );
+	}
+
+	template< Endian E, typename T > inline void Store( void *dst, T value )
+	{
+		typename Bits< sizeof( T ) >::type bits;
+		memcpy( &bits, &value, sizeof( T ) );
+		if( E != Endian::Native )
+			bits = Swap( bits );
+
+		memcpy( dst, &bits, sizeof( T ) );
+	}
+}
+
+//half's binary constructor is private, half_caster is the friend the library builds halves from bits with
+namespace half_float
+{
+	namespace detail
+	{
+		template< std::float_round_style R > struct half_caster< half, ByteOrder::HalfBits, R >
+		{
+			static half cast( uint16 bits ) { return half( binary, bits ); }
+		};
+	}
+}
+
+template<> inline half_float::half ByteOrder::FromBits< half_float::half >( uint16_t bits )
+{
+	return half_float::detail::half_caster< half_float::half, ByteOrder::HalfBits >::cast( bits );
+}
+
+//Read only view of bytes that the parsers take, over a vector or a mapped file. It doesn't own them.
+class ByteSpan
+{
+public:
+	ByteSpan( ) : m_data( nullptr ), m_size( 0 ){};
+	ByteSpan( const char *data, size_t size ) : m_data( data ), m_size( size ){};
+	ByteSpan( const std::vector< char >& buffer ) : m_data( buffer.data( ) ), m_size( buffer.size( ) ){};
+
+	const char *data( ) const { return m_data; }
+	size_t size( ) const { return m_size; }
+	bool empty( ) const { return m_size == 0; }
+
+	const char *begin( ) const { return m_data; }
+	const char *end( ) const { return m_data + m_size; }
+	const char& operator[]( size_t i ) const { return m_data[i]; }
+
+	//Bytes from pos to pos + size, throws std::out_of_range if they aren't all inside
+	ByteSpan Sub( size_t pos, size_t size ) const
+	{
+		if( pos > m_size || size > m_size - pos )
+			throw std::out_of_range( "ByteSpan: range past the end of the buffer" );
+		return ByteSpan( m_data + pos, size );
+	}
+
+private:
+	const char *m_data;
+	size_t m_size;
+};
+
+//Bounds checked reads of fixed size values from a byte buffer. Going past the end throws std::out_of_range.
+template< Endian E >
+class ByteReader
+{
+public:
+	ByteReader( const ByteSpan& buffer, size_t pos = 0 ) : m_data( (const unsigned char*)buffer.data( ) ), m_size( buffer.size( ) ), m_pos( pos ){};
+	ByteReader( const void *data, size_t size, size_t pos = 0 ) : m_data( (const unsigned char*)data ), m_size( size ), m_pos( pos ){};
+
+	//Value at an offset, the read position doesn't move
+	template< typename T > T Get( size_t pos ) const
+	{
+		Check( pos, sizeof( T ) );
+		return ByteOrder::Load< E, T >( m_data + pos );
+	}
+
+	//count values starting at an offset
+	template< typename T > void Get( size_t pos, T *out, size_t count ) const
+	{
+		Check( pos, sizeof( T ) * count );
+		for( size_t i = 0; i < count; i++ )
+			out[i] = ByteOrder::Load< E, T >( m_data + pos + i * sizeof( T ) );
+	}
+
+	//Reads into a variable, or every element of an array of them
+	template< typename T > void Get( size_t pos, T& out ) const
+	{
+		out = Get< T >( pos );
+	}
+
+	template< typename T, size_t N > void Get( size_t pos, T ( &out )[N] ) const
+	{
+		Check( pos, sizeof( out ) );
+		for( size_t i = 0; i < N; i++ )
+			Get( pos + i * sizeof( T ), out[i] );
+	}
+
+	//Value at the read position, which then moves past it
+	template< typename T > T Read( )
+	{
+		T value = Get< T >( m_pos );
+		m_pos += sizeof( T );
+		return value;
+	}
+
+	bool CanRead( size_t pos, size_t size ) const
+	{
+		return pos <= m_size && size <= m_size - pos;
+	}
+
+	void Seek( size_t pos ) { m_pos = pos; }
+	void Skip( size_t size ) { m_pos += size; }
+	size_t Tell( ) const { return m_pos; }
+	size_t Size( ) const { return m_size; }
+	const unsigned char *Data( ) const { return m_data; }
+
+private:
+	void Check( size_t pos, size_t size ) const
+	{
+		if( !CanRead( pos, size ) )
+			throw std::out_of_range( "ByteReader: read past the end of the buffer" );
+	}
+
+	const unsigned char *m_data;
+	size_t m_size;
+	size_t m_pos;
+};
+
+//Appends or overwrites fixed size values in a byte vector. Set past the end throws std::out_of_range.
+template< Endian E >
+class ByteWriter
+{
+public:
+	ByteWriter( std::vector< char >& buffer ) : m_buffer( buffer ){};
+
+	//Appends a value
+	template< typename T > void Put( T value )
+	{
+		size_t pos = m_buffer.size( );
+		m_buffer.resize( pos + sizeof( T ) );
+		ByteOrder::Store< E, T >( &m_buffer[pos], value );
+	}
+
+	//Overwrites a value that is already in the buffer, for offsets patched after the data is written
+	template< typename T > void Set( size_t pos, T value )
+	{
+		if( pos > m_buffer.size( ) || sizeof( T ) > m_buffer.size( ) - pos )
+			throw std::out_of_range( "ByteWriter: write past the end of the buffer" );
+		ByteOrder::Store< E, T >( &m_buffer[pos], value );
+	}
+
+	//Overwrites every element of an array
+	template< typename T, size_t N > void Set( size_t pos, const T ( &values )[N] )
+	{
+		if( pos > m_buffer.size( ) || sizeof( values ) > m_buffer.size( ) - pos )
+			throw std::out_of_range( "ByteWriter: write past the end of the buffer" );
+		for( size_t i = 0; i < N; i++ )
+			Set( pos + i * sizeof( T ), values[i] );
+	}
+
+	size_t Size( ) const { return m_buffer.size( ); }
+
+private:
+	std::vector< char >& m_buffer;
+};
+
+typedef ByteReader< Endian::Little > ByteReaderLE;
+typedef ByteReader< Endian::Big > ByteReaderBE;
+typedef ByteWriter< Endian::Little > ByteWriterLE;
+typedef ByteWriter< Endian::Big > ByteWriterBE;
+
+//One off reads for code that doesn't keep a reader around
+template< typename T > inline T ReadLE( const ByteSpan& buffer, size_t pos )
+{
+	return ByteReaderLE( buffer ).Get< T >( pos );
+}
+
+template< typename T > inline T ReadBE( const ByteSpan& buffer, size_t pos )
+{
+	return ByteReaderBE( buffer ).Get< T >( pos );
+}
@@ -2,26 +2,39 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <thread>
 
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "CANM.h"
 #include "include/tinyxml2.h"
 #include "include/half.hpp"
 
-void CANM::Read(const std::wstring& path)
-{
-	std::ifstream file(path + L".canm", std::ios::binary | std::ios::ate | std::ios::in);
+bool CANM::bOptimizeTracks = false;
+float CANM::fTrackTolerance = 0.0f;
+bool CANM::bCollapseConstantTracks = false;
 
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
+// Keyframes are uint16 and assumed to decode as i + v * (k / 65535), only constant track collapsing depends on it
+#define CANM_KEYFRAME_SCALE (1.0f / 65535.0f)
 
-	std::vector<char> buffer(size);
-	if (file.read(buffer.data(), size))
+bool CANM::Read(const std::wstring& path)
+{
+	StageTimer timer("CANM>XML", StatStage::Read);
+	MappedFile file;
+	if (file.Open(path + L".canm"))
 	{
+		ByteSpan buffer = file.Span();
+		timer.AddBytes(buffer.size());
+		timer.Next(StatStage::Parse);
 		// create xml
 		tinyxml2::XMLDocument xml;
 		xml.InsertFirstChild(xml.NewDeclaration());
@@ -30,79 +43,81 @@ void CANM::Read(const std::wstring& path)
 
 		ReadData(buffer, xmlHeader);
 
+		timer.Next(StatStage::Serialize);
 		std::string outfile = WideToUTF8(path) + "_CANM.xml";
-		xml.SaveFile(outfile.c_str());
+		if (xml.SaveFile(outfile.c_str()) != tinyxml2::XML_SUCCESS)
+		{
+			LogError() << L"Can't write " << UTF8ToWide(outfile) << L"\n";
+			return false;
+		}
 		/*
 		tinyxml2::XMLPrinter printer;
 		xml.Accept(&printer);
 		auto xmlString = std::string{ printer.CStr() };
 
-		std::wcout << UTF8ToWide(xmlString) + L"\n";
+		LogInfo() << UTF8ToWide(xmlString) + L"\n";
 		*/
 	}
+	else
+	{
+		LogError() << L"Can't read " << path << L".canm\n";
+		return false;
+	}
 
-	//Clear buffers
-	buffer.clear();
-	file.close();
+	//Unmap the file
+	file.Close();
+	return true;
 }
 
-void CANM::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header)
+void CANM::ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header)
 {
-	int position = 0;
+	ByteReaderLE reader(buffer);
+	m_strings.Reset(buffer);
+
 	unsigned char seg[4];
 	// read header, length is 0x20
-	memcpy(&seg, &buffer[0], 4U);
+	reader.Get(0, seg);
 	//if (seg[0] == 0x43 && seg[1] == 0x41 && seg[2] == 0x4E && seg[3] == 0x4D)	
 	
 	// read AnmData
-	memcpy(&i_AnmDataCount, &buffer[0x8], 4U);
-	memcpy(&i_AnmDataOffset, &buffer[0xC], 4U);
+	reader.Get(0x8, i_AnmDataCount);
+	reader.Get(0xC, i_AnmDataOffset);
 	// read AnmPoint
-	memcpy(&i_AnmPointCount, &buffer[0x10], 4U);
-	memcpy(&i_AnmPointOffset, &buffer[0x14], 4U);
+	reader.Get(0x10, i_AnmPointCount);
+	reader.Get(0x14, i_AnmPointOffset);
 	// read bone
-	memcpy(&i_BoneCount, &buffer[0x18], 4U);
-	memcpy(&i_BoneOffset, &buffer[0x1C], 4U);
+	reader.Get(0x18, i_BoneCount);
+	reader.Get(0x1C, i_BoneOffset);
 
 	// bone data
-	std::wcout << L"Read CANM......\n";
-	std::wcout << L"Read bone list...... ";
+	LogInfo() << L"Read CANM......\n";
+	LogInfo() << L"Read bone list...... ";
 	ReadBoneListData(header, buffer);
-	std::wcout << L"Complete!\n";
+	LogInfo() << L"Complete!\n";
 	// animation key data
 	//ReadAnimationPointData(header, buffer);
-	std::wcout << L"Read animation frame list:\n0     in " + ToString(i_AnmPointCount);
-	std::vector<char> tempBuffer = buffer;
-	v_AnmKey.reserve(i_AnmPointCount);
-	for (int i = 0; i < i_AnmPointCount; i++)
-	{
-		int curpos = i_AnmPointOffset + (i * 0x20);
-
-		//v_AnmKey.push_back(ReadAnimationFrameData(buffer, curpos));
-		v_AnmKey.push_back(ReadAnimationFrameData(&tempBuffer, curpos, 1));
-
-		std::wcout << L"\r" + ToString(i+1);
-		// now not displayed as a percentage
-		//float Progress = i * 100.0f / i_AnmPointCount;
-		//std::wcout << L"\r" + ToString(Progress) + L"\%";
-	}
-	std::wcout << L"\nComplete!\n";
+	LogInfo() << L"Read animation frame list: " + ToString(i_AnmPointCount) + L"...... ";
+	ReadAnimationFrameList(buffer);
+	LogInfo() << L"Complete!\n";
 	// animation data
-	std::wcout << L"Read animation list:\n0     in " + ToString(i_AnmDataCount);
+	LogInfo() << L"Read animation list:\n";
 	ReadAnimationData(header, buffer);
-	std::wcout << L"\nComplete!\n";
-	std::wcout << L"===>CANM parsing completed!\n";
+	LogInfo() << L"\nComplete!\n";
+	LogInfo() << L"===>CANM parsing completed!\n";
 }
 
-void CANM::ReadAnimationData(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CANM::ReadAnimationData(tinyxml2::XMLElement* header, const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmldata = header->InsertNewChildElement("AnmData");
+	ProgressReporter progress(i_AnmDataCount);
 	for (int i = 0; i < i_AnmDataCount; i++)
 	{
 		int curpos = i_AnmDataOffset + (i * 0x1C);
 
 		int value[7];
-		memcpy(&value, &buffer[curpos], 28U);
+		reader.Get(curpos, value);
 		tinyxml2::XMLElement* xmlptr = xmldata->InsertNewChildElement("node");
 
 		xmlptr->SetAttribute("index", i);
@@ -115,14 +130,7 @@ void CANM::ReadAnimationData(tinyxml2::XMLElement* header, const std::vector<cha
 		xmlptr->SetAttribute("int1", value[0]);
 
 		// get string
-		std::wstring wstr;
-		// str
-		if (value[1] > 0)
-			wstr = ReadUnicode(buffer, curpos + value[1]);
-		else
-			wstr = L"";
-		std::string utf8str = WideToUTF8(wstr);
-		xmlptr->SetAttribute("name", utf8str.c_str());
+		xmlptr->SetAttribute("name", value[1] > 0 ? m_strings.Get(curpos + value[1]) : "");
 
 		// i2 is float
 		xmlptr->SetAttribute("time", IntHexAsFloat(value[2]));
@@ -137,7 +145,7 @@ void CANM::ReadAnimationData(tinyxml2::XMLElement* header, const std::vector<cha
 			int datapos = curpos + value[6] + (j * 8);
 
 			short number[4];
-			memcpy(&number, &buffer[datapos], 8U);
+			reader.Get(datapos, number);
 
 			tinyxml2::XMLElement* xmlNode = xmlptr->InsertNewChildElement("value");
 
@@ -145,7 +153,7 @@ void CANM::ReadAnimationData(tinyxml2::XMLElement* header, const std::vector<cha
 			xmlNode->SetAttribute("pos", datapos);
 #endif
 
-			xmlNode->SetAttribute("bone", BoneList[number[0]].c_str());
+			xmlNode->SetAttribute("bone", BoneList[number[0]]);
 			//xmlNode->SetAttribute("kpos", number[1]);
 			//xmlNode->SetAttribute("krot", number[2]);
 			//xmlNode->SetAttribute("ktra", number[3]);
@@ -168,9 +176,9 @@ void CANM::ReadAnimationData(tinyxml2::XMLElement* header, const std::vector<cha
 			else
 				ReadAnimationDataWriteKeyFrame(xmlVis, number[3]);
 		}
-		std::wcout << L"\r" + ToString(i + 1);
+		progress.Update(i + 1);
 	}
-	// end
+	progress.Finish();
 }
 
 void CANM::ReadAnimationDataWriteKeyFrame(tinyxml2::XMLElement* node, int num)
@@ -188,38 +196,37 @@ void CANM::ReadAnimationDataWriteKeyFrame(tinyxml2::XMLElement* node, int num)
 	node->SetAttribute("vy", v_AnmKey[num].vf[4]);
 	node->SetAttribute("vz", v_AnmKey[num].vf[5]);
 	// write keyframe to xml
-	if (v_AnmKey[num].kf.size() > 0)
+	const CANMAnmKeyframe* kf = v_AnmKeyframe.data() + v_AnmKey[num].kfOffset;
+	for (int i = 0; i < v_AnmKey[num].kfCount; i++)
 	{
-		for (int i = 0; i < v_AnmKey[num].kf.size(); i++)
-		{
-			tinyxml2::XMLElement* xmlNode = node->InsertNewChildElement("v");
+		tinyxml2::XMLElement* xmlNode = node->InsertNewChildElement("v");
 
-			xmlNode->SetAttribute("x", v_AnmKey[num].kf[i].vf[0]);
-			xmlNode->SetAttribute("y", v_AnmKey[num].kf[i].vf[1]);
-			xmlNode->SetAttribute("z", v_AnmKey[num].kf[i].vf[2]);
-			// debug mode output half
+		xmlNode->SetAttribute("x", kf[i].vf[0]);
+		xmlNode->SetAttribute("y", kf[i].vf[1]);
+		xmlNode->SetAttribute("z", kf[i].vf[2]);
+		// debug mode output half
 #if defined(DEBUGMODE)
-			//xmlNode->SetAttribute("pos", v_AnmKey[num].pos);
-			half_float::half vf[3];
-			memcpy(&vf, &v_AnmKey[num].kf[i].vf, 6U);
+		half_float::half vf[3];
+		memcpy(&vf, &kf[i].vf, 6U);
 
-			xmlNode->SetAttribute("dx", vf[0]);
-			xmlNode->SetAttribute("dy", vf[1]);
-			xmlNode->SetAttribute("dz", vf[2]);
+		xmlNode->SetAttribute("dx", vf[0]);
+		xmlNode->SetAttribute("dy", vf[1]);
+		xmlNode->SetAttribute("dz", vf[2]);
 #endif
-		}
 	}
 }
 
-void CANM::ReadAnimationPointData(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CANM::ReadAnimationPointData(tinyxml2::XMLElement* header, const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmldata = header->InsertNewChildElement("AnmKey");
 	for (int i = 0; i < i_AnmPointCount; i++)
 	{
 		int curpos = i_AnmPointOffset + (i * 0x20);
 
 		short value[2];
-		memcpy(&value, &buffer[curpos], 4U);
+		reader.Get(curpos, value);
 		tinyxml2::XMLElement* xmlptr = xmldata->InsertNewChildElement("node");
 
 		xmlptr->SetAttribute("index", i);
@@ -232,7 +239,7 @@ void CANM::ReadAnimationPointData(tinyxml2::XMLElement* header, const std::vecto
 
 		// get float
 		float vf[6];
-		memcpy(&vf, &buffer[curpos + 4], 24U);
+		reader.Get(curpos + 4, vf);
 		xmlptr->SetAttribute("ix", vf[0]);
 		xmlptr->SetAttribute("iy", vf[1]);
 		xmlptr->SetAttribute("iz", vf[2]);
@@ -242,7 +249,7 @@ void CANM::ReadAnimationPointData(tinyxml2::XMLElement* header, const std::vecto
 
 		// keyframe offset
 		int offset;
-		memcpy(&offset, &buffer[curpos + 28], 4U);
+		reader.Get(curpos + 28, offset);
 		if (offset > 0)
 		{
 			for (int j = 0; j < value[1]; j++)
@@ -256,14 +263,14 @@ void CANM::ReadAnimationPointData(tinyxml2::XMLElement* header, const std::vecto
 				xmlNode->SetAttribute("pos", datapos);
 
 				short vf[3];
-				memcpy(&vf, &buffer[datapos], 6U);
+				reader.Get(datapos, vf);
 
 				xmlNode->SetAttribute("x", vf[0]);
 				xmlNode->SetAttribute("y", vf[1]);
 				xmlNode->SetAttribute("z", vf[2]);
 #else
 				half_float::half vf[3];
-				memcpy(&vf, &buffer[datapos], 6U);
+				reader.Get(datapos, vf);
 
 				xmlNode->SetAttribute("x", vf[0]);
 				xmlNode->SetAttribute("y", vf[1]);
@@ -276,15 +283,18 @@ void CANM::ReadAnimationPointData(tinyxml2::XMLElement* header, const std::vecto
 	// end
 }
 
-void CANM::ReadBoneListData(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CANM::ReadBoneListData(tinyxml2::XMLElement* header, const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmlbone = header->InsertNewChildElement("BoneList");
+	BoneList.clear();
 	for (int i = 0; i < i_BoneCount; i++)
 	{
 		int curpos = i_BoneOffset + (i * 4);
 
 		int boneofs;
-		memcpy(&boneofs, &buffer[curpos], 4U);
+		reader.Get(curpos, boneofs);
 		tinyxml2::XMLElement* xmlptr = xmlbone->InsertNewChildElement("value");
 
 #if defined(DEBUGMODE)
@@ -293,92 +303,286 @@ void CANM::ReadBoneListData(tinyxml2::XMLElement* header, const std::vector<char
 #endif
 
 		// get string
-		std::wstring wstr;
-		// str
-		if (boneofs > 0)
-			wstr = ReadUnicode(buffer, curpos + boneofs);
-		else
-			wstr = L"";
-		std::string utf8str = WideToUTF8(wstr);
-		xmlptr->SetText(utf8str.c_str());
-		BoneList.push_back(utf8str);
+		const char* bone = boneofs > 0 ? m_strings.Get(curpos + boneofs) : "";
+		xmlptr->SetText(bone);
+		BoneList.push_back(bone);
 	}
 }
 
-CANMAnmKey CANM::ReadAnimationFrameData(const std::vector<char>& buffer, int pos)
+void CANM::ReadAnimationFrameList(const ByteSpan& buffer)
 {
-	CANMAnmKey out;
+	ByteReaderLE reader(buffer);
 
-	memcpy(&out.vi, &buffer[pos], 4U);
-	memcpy(&out.vf, &buffer[pos + 4], 24U);
-	// read keyframe offset
-	int offset;
-	memcpy(&offset, &buffer[pos + 28], 4U);
-	if (offset > 0)
+	v_AnmKey.resize(i_AnmPointCount);
+
+	// first pass: headers only, so every key knows where its keyframes go
+	int kfTotal = 0;
+	for (int i = 0; i < i_AnmPointCount; i++)
 	{
-		for (int j = 0; j < out.vi[1]; j++)
-		{
-			int datapos = pos + offset + (j * 6);
+		int curpos = i_AnmPointOffset + (i * 0x20);
 
-			CANMAnmKeyframe kfout;
-			memcpy(&kfout.vf, &buffer[datapos], 6U);
-			out.kf.push_back(kfout);
-		}
+		short frame;
+		int offset;
+		reader.Get(curpos + 2, frame);
+		reader.Get(curpos + 28, offset);
+
+		v_AnmKey[i].kfOffset = kfTotal;
+		v_AnmKey[i].kfCount = (offset > 0 && frame > 0) ? frame : 0;
+		kfTotal += v_AnmKey[i].kfCount;
 	}
-	// only debug
-	out.pos = pos;
-	return out;
+	v_AnmKeyframe.resize(kfTotal);
+
+	// second pass: decode, every key writes only to its own slot and span
+	int threads_num = std::thread::hardware_concurrency();
+	if (threads_num < 1)
+		threads_num = 1;
+	// small files are not worth starting threads
+	if (i_AnmPointCount < 4096)
+		threads_num = 1;
+
+	int chunk = (i_AnmPointCount + threads_num - 1) / threads_num;
+	auto decode = [&](int start, int end) {
+		for (int i = start; i < end; i++)
+			ReadAnimationFrameData(buffer, i_AnmPointOffset + (i * 0x20), v_AnmKey[i]);
+	};
+
+	if (threads_num == 1)
+	{
+		decode(0, i_AnmPointCount);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(static_cast<size_t>(threads_num));
+	for (int th = 0; th < threads_num; th++)
+	{
+		int start = th * chunk;
+		int end = (std::min)(start + chunk, i_AnmPointCount);
+		if (start >= end)
+			break;
+		threads.emplace_back(decode, start, end);
+	}
+	for (auto& t : threads)
+		t.join();
 }
 
-// faster with the pointer version
-CANMAnmKey CANM::ReadAnimationFrameData(std::vector<char>* buf, int pos, int mask)
+void CANM::ReadAnimationFrameData(const ByteSpan& buffer, int pos, CANMAnmKey& out)
 {
-	CANMAnmKey out;
+	ByteReaderLE reader(buffer);
 
-	memcpy(&out.vi, &buf->data()[pos], 4U);
-	memcpy(&out.vf, &buf->data()[pos + 4], 24U);
+	reader.Get(pos, out.vi);
+	reader.Get(pos + 4, out.vf);
 	// read keyframe offset
 	int offset;
-	memcpy(&offset, &buf->data()[pos + 28], 4U);
-	if (offset > 0)
+	reader.Get(pos + 28, offset);
+	// keyframes are packed 6 bytes each, copy them in one go
+	if (out.kfCount > 0)
+		memcpy(&v_AnmKeyframe[out.kfOffset], &buffer[pos + offset], out.kfCount * 6U);
+	// only debug
+	out.pos = pos;
+}
+
+// Linear interpolation of one keyframe axis at fractional frame t
+static float SampleTrack(const CANMAnmKeyframe* kf, int count, int axis, float t)
+{
+	int k = (int)t;
+	if (k >= count - 1)
+		return kf[count - 1].vf[axis];
+	float f = t - k;
+	return kf[k].vf[axis] + (kf[k + 1].vf[axis] - kf[k].vf[axis]) * f;
+}
+
+void CANM::OptimizeTrack(tinyxml2::XMLElement* data, CANMAnmKey& key, short* svalue, float* fvalue)
+{
+	CANMAnmKeyframe* kf = &v_AnmKeyframe[key.kfOffset];
+	int count = key.kfCount;
+
+	CANMTrackReport report;
+	tinyxml2::XMLElement* boneNode = data->Parent()->ToElement();
+	tinyxml2::XMLElement* anmNode = boneNode->Parent()->ToElement();
+	report.channel = data->Name();
+	report.bone = boneNode->Attribute("bone") ? boneNode->Attribute("bone") : "";
+	report.anm = anmNode->Attribute("name") ? anmNode->Attribute("name") : "";
+	report.framesIn = count;
+	report.framesOut = count;
+	report.maxError = 0.0f;
+
+	// value of one keyframe step on each axis
+	float step[3];
+	for (int c = 0; c < 3; c++)
+		step[c] = fabs(fvalue[c + 3]) * CANM_KEYFRAME_SCALE;
+
+	// constant track: collapse to type 0 with one frame
+	uint16_t qmin[3], qmax[3];
+	for (int c = 0; c < 3; c++)
 	{
-		for (int j = 0; j < out.vi[1]; j++)
+		qmin[c] = qmax[c] = kf[0].vf[c];
+		for (int i = 1; i < count; i++)
 		{
-			int datapos = pos + offset + (j * 6);
+			qmin[c] = (std::min)(qmin[c], kf[i].vf[c]);
+			qmax[c] = (std::max)(qmax[c], kf[i].vf[c]);
+		}
+	}
 
-			CANMAnmKeyframe kfout;
-			memcpy(&kfout.vf, &buf->data()[datapos], 6U);
-			out.kf.push_back(kfout);
+	bool identical = true;
+	float constError = 0.0f;
+	for (int c = 0; c < 3; c++)
+	{
+		identical = identical && qmin[c] == qmax[c];
+		constError = (std::max)(constError, (qmax[c] - qmin[c]) * 0.5f * step[c]);
+	}
+
+	// at tolerance 0 the keyframes have to match exactly, a zero v alone doesn't make a track constant
+	bool constant = fTrackTolerance > 0.0f ? constError <= fTrackTolerance : identical;
+	if (bCollapseConstantTracks && constant)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			float mid = (qmin[c] + qmax[c]) * 0.5f;
+			fvalue[c] += fvalue[c + 3] * mid * CANM_KEYFRAME_SCALE;
+			fvalue[c + 3] = 0.0f;
+		}
+		svalue[0] = 0;
+		svalue[1] = 1;
+
+		v_AnmKeyframe.resize(key.kfOffset);
+		key.kfCount = 0;
+
+		report.framesOut = 1;
+		report.maxError = constError;
+		v_TrackReport.push_back(report);
+		return;
+	}
+
+	// resample to the fewest evenly spaced frames that stay within tolerance,
+	// frames are assumed to be stretched over the whole animation
+	if (fTrackTolerance > 0.0f && count > 2)
+	{
+		// fills resampled with newCount frames and returns the worst error against the original
+		std::vector< CANMAnmKeyframe > resampled;
+		auto resample = [&](int newCount) {
+			resampled.resize(newCount);
+			float toOld = (float)(count - 1) / (newCount - 1);
+			for (int j = 0; j < newCount; j++)
+			{
+				for (int c = 0; c < 3; c++)
+					resampled[j].vf[c] = (uint16_t)(SampleTrack(kf, count, c, j * toOld) + 0.5f);
+			}
+
+			float toNew = (float)(newCount - 1) / (count - 1);
+			float error = 0.0f;
+			for (int i = 0; i < count && error <= fTrackTolerance; i++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					float diff = fabs(SampleTrack(resampled.data(), newCount, c, i * toNew) - kf[i].vf[c]);
+					error = (std::max)(error, diff * step[c]);
+				}
+			}
+			return error;
+		};
+
+		// more frames only ever bring the error down in practice, so search for the fewest that pass
+		int low = 2, high = count - 1, best = 0;
+		while (low <= high)
+		{
+			int middle = (low + high) / 2;
+			if (resample(middle) <= fTrackTolerance)
+			{
+				best = middle;
+				high = middle - 1;
+			}
+			else
+				low = middle + 1;
+		}
+
+		if (best)
+		{
+			float error = resample(best);
+			memcpy(kf, resampled.data(), best * 6U);
+			v_AnmKeyframe.resize(key.kfOffset + best);
+			key.kfCount = best;
+			svalue[1] = best;
+
+			report.framesOut = best;
+			report.maxError = error;
 		}
 	}
-	// only debug
-	out.pos = pos;
-	return out;
+
+	v_TrackReport.push_back(report);
+}
+
+void CANM::WriteOptimizeReport(const std::wstring& path)
+{
+	int framesIn = 0, framesOut = 0, collapsed = 0;
+	float maxError = 0.0f;
+
+	std::ofstream report(ToFilePath(path + L"_canm_opt.csv"), std::ios::out);
+	report << "animation,bone,channel,frames_in,frames_out,max_error\n";
+	for (size_t i = 0; i < v_TrackReport.size(); i++)
+	{
+		const CANMTrackReport& t = v_TrackReport[i];
+		report << t.anm << "," << t.bone << "," << t.channel << ",";
+		report << t.framesIn << "," << t.framesOut << "," << t.maxError << "\n";
+
+		framesIn += t.framesIn;
+		framesOut += t.framesOut;
+		if (t.framesOut == 1)
+			collapsed++;
+		maxError = (std::max)(maxError, t.maxError);
+	}
+	report.close();
+
+	LogInfo() << L"Optimized tracks: " + ToString((int)v_TrackReport.size()) + L", constant: " + ToString(collapsed) + L"\n";
+	LogInfo() << L"Keyframes: " + ToString(framesIn) + L" -> " + ToString(framesOut) + L", max error: " + ToString(maxError) + L"\n";
 }
 
-void CANM::Write(const std::wstring& path)
+bool CANM::Write(const std::wstring& path)
 {
 	std::wstring sourcePath = path + L"_canm.xml";
-	std::wcout << "Will output CANM file.\n";
+	LogInfo() << "Will output CANM file.\n";
 	std::string UTF8Path = WideToUTF8(sourcePath);
 
+	StageTimer timer("XML>CANM", StatStage::Parse);
 	tinyxml2::XMLDocument doc;
-	doc.LoadFile(UTF8Path.c_str());
+	if (doc.LoadFile(UTF8Path.c_str()) != tinyxml2::XML_SUCCESS)
+	{
+		LogError() << L"Can't read " + sourcePath + L"\n";
+		return false;
+	}
 
 	tinyxml2::XMLElement* header = doc.FirstChildElement("CANM");
+	if (!header)
+	{
+		LogError() << L"No CANM element in " + sourcePath + L"\n";
+		return false;
+	}
 
+	timer.Next(StatStage::Build);
 	std::vector< char > bytes;
 	bytes = WriteData(header);
 
 	//Final write.
 	/**/
-	std::ofstream newFile(path + L".CANM", std::ios::binary | std::ios::out | std::ios::ate);
+	timer.Next(StatStage::Write);
+	std::ofstream newFile(ToFilePath(path + L".CANM"), std::ios::binary | std::ios::out | std::ios::ate);
 
 	newFile.write(bytes.data(), bytes.size());
 
 	newFile.close();
+	if (!newFile)
+	{
+		LogError() << L"Can't write " + path + L".CANM\n";
+		return false;
+	}
+	timer.AddBytes(bytes.size());
+	timer.Stop();
+
+	if (bOptimizeTracks)
+		WriteOptimizeReport(path);
 	
-	std::wcout << L"Conversion completed: " + path + L".canm\n";
+	LogInfo() << L"Conversion completed: " + path + L".canm\n";
+	return true;
 }
 
 std::vector<char> CANM::WriteData(tinyxml2::XMLElement* Data)
@@ -416,45 +620,52 @@ std::vector<char> CANM::WriteData(tinyxml2::XMLElement* Data)
 		if (v_AnmPoint[i].haskey)
 		{
 			int offset = v_AnmPoint[i].offset + size_AnmPoint - v_AnmPoint[i].pos;
-			memcpy(&v_AnmPoint[i].bytes[0x1C], &offset, 4U);
+			ByteWriterLE(v_AnmPoint[i].bytes).Set(0x1C, offset);
 		}
 	}
 	*/
 
 	// read animation data
-	std::wcout << L"Read CANM animation list:\n0";
+	LogInfo() << L"Read CANM animation list:\n";
 	entry = Data->FirstChildElement("AnmData");
+	ProgressReporter dataProgress;
 	for (entry2 = entry->FirstChildElement("node"); entry2 != 0; entry2 = entry2->NextSiblingElement("node"))
 	{
 		// bone data is written at the same time
 		//v_AnmData.push_back(WriteAnmData(entry2, &bdbytes));
 		v_AnmData.push_back(WriteAnimationData(entry2, &bdbytes));
-		std::wcout << L"\r" + std::to_wstring(v_AnmData.size());
+		dataProgress.Update(v_AnmData.size());
 	}
-	std::wcout << L" ===> Complete!\n";
+	dataProgress.Finish();
+	LogInfo() << L" ===> Complete!\n";
+	LogInfo() << L"Animation keys: " + ToString((int)v_AnmKey.size()) + L", merged duplicates: " + ToString(i_AnmKeyDupCount);
+	LogInfo() << L" (" + ToString(i_AnmKeyDupSize) + L" bytes saved)\n";
 	// write bone data offset
 	i_AnmDataCount = v_AnmData.size();
 	int size_AnmData = i_AnmDataCount * 0x1C;
 	for (int i = 0; i < i_AnmDataCount; i++)
 	{
 		int offset = v_AnmData[i].offset + size_AnmData - v_AnmData[i].pos;
-		memcpy(&v_AnmData[i].bytes[0x18], &offset, 4U);
+		ByteWriterLE(v_AnmData[i].bytes).Set(0x18, offset);
 	}
 	// write keyframe offset
-	std::wcout << L"Read CANM animation keyframe:\n0";
+	LogInfo() << L"Read CANM animation keyframe:\n";
 	i_AnmPointCount = v_AnmKey.size();
+	ProgressReporter keyProgress(i_AnmPointCount);
 	int size_AnmPoint = i_AnmPointCount * 0x20;
 	for (int i = 0; i < i_AnmPointCount; i++)
 	{
-		if (v_AnmKey[i].kf.size() == 1)
+		if (v_AnmKey[i].kfCount > 0)
 		{
 			int offset = kfbytes.size() + size_AnmPoint - v_AnmKey[i].pos;
-			memcpy(&v_AnmKey[i].bytes[0x1C], &offset, 4U);
-			kfbytes.insert(kfbytes.end(), v_AnmKey[i].kf[0].bytes.begin(), v_AnmKey[i].kf[0].bytes.end());
+			ByteWriterLE(v_AnmKey[i].bytes).Set(0x1C, offset);
+			const char* kf = reinterpret_cast<const char*>(&v_AnmKeyframe[v_AnmKey[i].kfOffset]);
+			kfbytes.insert(kfbytes.end(), kf, kf + (v_AnmKey[i].kfCount * 6));
 		}
-		std::wcout << L"\r" + std::to_wstring(i + 1);
+		keyProgress.Update(i + 1);
 	}
-	std::wcout << L" ===> Complete!\n";
+	keyProgress.Finish();
+	LogInfo() << L" ===> Complete!\n";
 
 	// write bone list
 	i_BoneCount = WBoneList.size();
@@ -469,21 +680,21 @@ std::vector<char> CANM::WriteData(tinyxml2::XMLElement* Data)
 	bytes[5] = 0x02;
 
 	// write animation point data
-	std::wcout << L"Write CANM animation keyframe......";
+	LogInfo() << L"Write CANM animation keyframe......";
 	for (size_t i = 0; i < v_AnmKey.size(); i++)
 	{
 		bytes.insert(bytes.end(), v_AnmKey[i].bytes.begin(), v_AnmKey[i].bytes.end());
-		//std::wcout << L"\r" + std::to_wstring(i + 1);
+		//LogInfo() << L"\r" + std::to_wstring(i + 1);
 	}
-	//std::wcout << L" Complete!\n";
+	//LogInfo() << L" Complete!\n";
 	// write keyframe data
-	//std::wcout << L"Write CANM animation keyframe data......";
+	//LogInfo() << L"Write CANM animation keyframe data......";
 	//float progress = kfbytes.size() / 100.0f;
 	bytes.insert(bytes.end(), kfbytes.begin(), kfbytes.end());
-	std::wcout << L" Complete!\n";
+	LogInfo() << L" Complete!\n";
 	// write animation point header
 	bytes[0x14] = 0x20;
-	memcpy(&bytes[0x10], &i_AnmPointCount, 4U);
+	ByteWriterLE(bytes).Set(0x10, i_AnmPointCount);
 	// 4-byte alignment is required
 	int i_Alignment = bytes.size() % 4;
 	if (i_Alignment > 0)
@@ -494,33 +705,33 @@ std::vector<char> CANM::WriteData(tinyxml2::XMLElement* Data)
 
 	i_AnmDataOffset = bytes.size();
 	// write animation data
-	std::wcout << L"Write CANM animation list......";
+	LogInfo() << L"Write CANM animation list......";
 	for (size_t i = 0; i < v_AnmData.size(); i++)
 	{
 		// need to save this location
 		v_AnmData[i].pos = bytes.size();
 		bytes.insert(bytes.end(), v_AnmData[i].bytes.begin(), v_AnmData[i].bytes.end());
-		//std::wcout << L"\r" + std::to_wstring(i + 1);
+		//LogInfo() << L"\r" + std::to_wstring(i + 1);
 	}
-	std::wcout << L" Complete!\n";
+	LogInfo() << L" Complete!\n";
 	// write bone data
 	bytes.insert(bytes.end(), bdbytes.begin(), bdbytes.end());
 	// write animation data header
-	memcpy(&bytes[0x8], &i_AnmDataCount, 4U);
-	memcpy(&bytes[0xC], &i_AnmDataOffset, 4U);
+	ByteWriterLE(bytes).Set(0x8, i_AnmDataCount);
+	ByteWriterLE(bytes).Set(0xC, i_AnmDataOffset);
 
 	// write bone list
 	i_BoneOffset = bytes.size();
 	bytes.insert(bytes.end(), blbytes.begin(), blbytes.end());
 	// write bone list header
-	memcpy(&bytes[0x18], &i_BoneCount, 4U);
-	memcpy(&bytes[0x1C], &i_BoneOffset, 4U);
+	ByteWriterLE(bytes).Set(0x18, i_BoneCount);
+	ByteWriterLE(bytes).Set(0x1C, i_BoneOffset);
 
 	// write remaining string
 	for (size_t i = 0; i < v_AnmData.size(); i++)
 	{
 		int curpos = bytes.size() - v_AnmData[i].pos;
-		memcpy(&bytes[v_AnmData[i].pos + 4], &curpos, 4U);
+		ByteWriterLE(bytes).Set(v_AnmData[i].pos + 4, curpos);
 		PushWStringToVector(v_AnmData[i].wstr, &bytes);
 	}
 
@@ -581,8 +792,8 @@ CANMAnmPoint CANM::WriteAnmPoint(tinyxml2::XMLElement* data, std::vector< char >
 	}
 
 	out.bytes.resize(0x20, 0);
-	memcpy(&out.bytes[0], &svalue, 4U);
-	memcpy(&out.bytes[4], &fvalue, 24U);
+	ByteWriterLE(out.bytes).Set(0, svalue);
+	ByteWriterLE(out.bytes).Set(4, fvalue);
 
 	return out;
 }
@@ -597,16 +808,16 @@ CANMAnmData CANM::WriteAnmData(tinyxml2::XMLElement* data, std::vector<char>* by
 	out.wstr = UTF8ToWide(data->Attribute("name"));
 	// - 0x00 - : Int32
 	int v1 = data->IntAttribute("int1");
-	memcpy(&out.bytes[0], &v1, 4U);
+	ByteWriterLE(out.bytes).Set(0, v1);
 	// - 0x08 - : Float, animation time.
 	// - 0x0C - : Float. Value = 0x08's value / (0x10's value - 1). 
 	float vf[2];
 	vf[0] = data->FloatAttribute("time");
 	vf[1] = data->FloatAttribute("speed");
-	memcpy(&out.bytes[0x8], &vf, 8U);
+	ByteWriterLE(out.bytes).Set(0x8, vf);
 	// - 0x10 - : Int32, multiplier, but add 1.
 	int v2 = data->IntAttribute("kf");
-	memcpy(&out.bytes[0x10], &v2, 4U);
+	ByteWriterLE(out.bytes).Set(0x10, v2);
 	// write bone data
 	int count = 0;
 	tinyxml2::XMLElement* entry = data->FirstChildElement("value");
@@ -617,7 +828,7 @@ CANMAnmData CANM::WriteAnmData(tinyxml2::XMLElement* data, std::vector<char>* by
 		char buffer[8];
 		for (entry = data->FirstChildElement("value"); entry != 0; entry = entry->NextSiblingElement("value"))
 		{
-			wstr = UTF8ToWide(entry->Attribute("bone"));
+			UTF8ToWide(entry->Attribute("bone"), wstr);
 			// check for duplication
 			bool isExist = false;
 
@@ -649,7 +860,7 @@ CANMAnmData CANM::WriteAnmData(tinyxml2::XMLElement* data, std::vector<char>* by
 				bytes->push_back(buffer[i]);
 		}
 	}
-	memcpy(&out.bytes[0x14], &count, 4U);
+	ByteWriterLE(out.bytes).Set(0x14, count);
 
 	return out;
 }
@@ -662,7 +873,7 @@ std::vector<char> CANM::WriteBoneList(int in)
 	{
 		int pos = i * 4;
 		int offset = out.size() - pos;
-		memcpy(&out[pos], &offset, 4U);
+		ByteWriterLE(out).Set(pos, offset);
 		// write string
 		PushWStringToVector(WBoneList[i], &out);
 	}
@@ -680,16 +891,16 @@ CANMAnmData CANM::WriteAnimationData(tinyxml2::XMLElement* data, std::vector<cha
 	out.wstr = UTF8ToWide(data->Attribute("name"));
 	// - 0x00 - : Int32
 	int v1 = data->IntAttribute("int1");
-	memcpy(&out.bytes[0], &v1, 4U);
+	ByteWriterLE(out.bytes).Set(0, v1);
 	// - 0x08 - : Float, animation time.
 	// - 0x0C - : Float. Value = 0x08's value / (0x10's value - 1). 
 	float vf[2];
 	vf[0] = data->FloatAttribute("time");
 	vf[1] = data->FloatAttribute("speed");
-	memcpy(&out.bytes[0x8], &vf, 8U);
+	ByteWriterLE(out.bytes).Set(0x8, vf);
 	// - 0x10 - : Int32, multiplier, but add 1.
 	int v2 = data->IntAttribute("kf");
-	memcpy(&out.bytes[0x10], &v2, 4U);
+	ByteWriterLE(out.bytes).Set(0x10, v2);
 	// write bone data
 	int count = 0;
 	tinyxml2::XMLElement* entry = data->FirstChildElement("value");
@@ -700,7 +911,7 @@ CANMAnmData CANM::WriteAnimationData(tinyxml2::XMLElement* data, std::vector<cha
 		char buffer[8];
 		for (entry = data->FirstChildElement("value"); entry != 0; entry = entry->NextSiblingElement("value"))
 		{
-			wstr = UTF8ToWide(entry->Attribute("bone"));
+			UTF8ToWide(entry->Attribute("bone"), wstr);
 			// check for duplication
 			bool isExist = false;
 
@@ -732,7 +943,7 @@ CANMAnmData CANM::WriteAnimationData(tinyxml2::XMLElement* data, std::vector<cha
 				bytes->push_back(buffer[i]);
 		}
 	}
-	memcpy(&out.bytes[0x14], &count, 4U);
+	ByteWriterLE(out.bytes).Set(0x14, count);
 
 	return out;
 }
@@ -762,69 +973,82 @@ short CANM::WriteAnimationKeyFrame(tinyxml2::XMLElement* data)
 
 		out.pos = v_AnmKey.size() * 0x20;
 		out.offset = 0;
+		// keyframes are appended to the arena, dropped again if this key is a duplicate
+		out.kfOffset = v_AnmKeyframe.size();
+		out.kfCount = 0;
 		// write keyframe
 		tinyxml2::XMLElement* entry = data->FirstChildElement("v");
 		if (entry != nullptr)
 		{
-			UINT16 vi[3];
-			char buffer[6];
-			short count = 0;
 			CANMAnmKeyframe kfout;
 
 			for (entry = data->FirstChildElement("v"); entry != 0; entry = entry->NextSiblingElement("v"))
 			{
 				// now input int16
-				vi[0] = entry->IntAttribute("x");
-				vi[1] = entry->IntAttribute("y");
-				vi[2] = entry->IntAttribute("z");
-				memcpy(&buffer, &vi, 6U);
-				// end
-				count++;
-				for (int i = 0; i < 6; i++)
-					kfout.bytes.push_back(buffer[i]);
+				kfout.vf[0] = entry->IntAttribute("x");
+				kfout.vf[1] = entry->IntAttribute("y");
+				kfout.vf[2] = entry->IntAttribute("z");
+				v_AnmKeyframe.push_back(kfout);
 			}
+			out.kfCount = v_AnmKeyframe.size() - out.kfOffset;
 
 			svalue[0] = 1;
-			svalue[1] = count;
-			out.kf.push_back(kfout);
+			svalue[1] = out.kfCount;
+
+			if (bOptimizeTracks)
+				OptimizeTrack(data, out, svalue, fvalue);
 		}
 
 		out.bytes.resize(0x20, 0);
-		memcpy(&out.bytes[0], &svalue, 4U);
-		memcpy(&out.bytes[4], &fvalue, 24U);
+		ByteWriterLE(out.bytes).Set(0, svalue);
+		ByteWriterLE(out.bytes).Set(4, fvalue);
 
-		// check for duplication
-		bool isExist = false;
-		for (size_t i = 0; i < v_AnmKey.size(); i++)
+		// check for duplication, only keys with the same hash need a full compare
+		out.hash = HashAnimationKey(out);
+		auto range = m_AnmKeyIndex.equal_range(out.hash);
+		for (auto it = range.first; it != range.second; ++it)
 		{
-			if (out.bytes == v_AnmKey[i].bytes)
+			if (IsSameAnimationKey(out, v_AnmKey[it->second]))
 			{
-				// check subobject, if it exists
-				if (svalue[0] == 1)
-				{
-					if (out.kf[0].bytes == v_AnmKey[i].kf[0].bytes)
-					{
-						isExist = true;
-						return i;
-					}
-					else
-					{
-						break;
-					}
-				}
-				else
-				{
-					isExist = true;
-					return i;
-				}
+				v_AnmKeyframe.resize(out.kfOffset);
+				i_AnmKeyDupCount++;
+				i_AnmKeyDupSize += 0x20 + (out.kfCount * 6);
+				return it->second;
 			}
 		}
 
-		if (!isExist)
+		short index = v_AnmKey.size();
+		v_AnmKey.push_back(out);
+		m_AnmKeyIndex.emplace(out.hash, index);
+		return index;
+	}
+}
+
+uint64_t CANM::HashAnimationKey(const CANMAnmKey& key)
+{
+	// FNV-1a over the key header and its keyframe payload
+	uint64_t hash = 14695981039346656037ULL;
+	auto mix = [&hash](const char* data, size_t size) {
+		for (size_t i = 0; i < size; i++)
 		{
-			short index = v_AnmKey.size();
-			v_AnmKey.push_back(out);
-			return index;
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ULL;
 		}
-	}
+	};
+
+	mix(key.bytes.data(), key.bytes.size());
+	if (key.kfCount > 0)
+		mix(reinterpret_cast<const char*>(&v_AnmKeyframe[key.kfOffset]), key.kfCount * 6U);
+
+	return hash;
+}
+
+bool CANM::IsSameAnimationKey(const CANMAnmKey& a, const CANMAnmKey& b)
+{
+	if (a.bytes != b.bytes || a.kfCount != b.kfCount)
+		return false;
+	if (a.kfCount == 0)
+		return true;
+
+	return memcmp(&v_AnmKeyframe[a.kfOffset], &v_AnmKeyframe[b.kfOffset], a.kfCount * 6U) == 0;
 }
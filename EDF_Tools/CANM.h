@@ -1,21 +1,38 @@
 #pragma once
+#include <unordered_map>
 #include "include/tinyxml2.h"
+#include "StringTable.h"
 
 struct CANMAnmKeyframe
 {
-	UINT16 vf[3];
-	std::vector< char > bytes;
+	uint16_t vf[3];
 };
 
 struct CANMAnmKey
 {
 	short vi[2];
 	float vf[6];
-	std::vector< CANMAnmKeyframe > kf;
+	// keyframes live in CANM::v_AnmKeyframe, this is the span
+	int kfOffset;
+	int kfCount;
 	// when to CANM
 	int pos;
 	int offset;
 	std::vector< char > bytes;
+	// hash of bytes and keyframes, for dedupe
+	uint64_t hash;
+};
+
+// result of the optional track optimisation, one per written track
+struct CANMTrackReport
+{
+	std::string anm;
+	std::string bone;
+	std::string channel;
+	int framesIn;
+	int framesOut;
+	// largest reconstruction error, in value units
+	float maxError;
 };
 
 struct CANMAnmPoint
@@ -37,19 +54,18 @@ struct CANMAnmData
 class CANM
 {
 public:
-	void Read(const std::wstring& path);
-	void ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header);
+	bool Read(const std::wstring& path);
+	void ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header);
 	// old
-	void ReadAnimationPointData(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
+	void ReadAnimationPointData(tinyxml2::XMLElement* header, const ByteSpan& buffer);
 	// now
-	void ReadAnimationData(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
+	void ReadAnimationData(tinyxml2::XMLElement* header, const ByteSpan& buffer);
 	void ReadAnimationDataWriteKeyFrame(tinyxml2::XMLElement* node, int num);
-	void ReadBoneListData(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
-	CANMAnmKey ReadAnimationFrameData(const std::vector<char>& buffer, int pos);
-	// faster with the pointer version
-	CANMAnmKey ReadAnimationFrameData(std::vector<char> *buf, int pos, int mask);
+	void ReadBoneListData(tinyxml2::XMLElement* header, const ByteSpan& buffer);
+	void ReadAnimationFrameList(const ByteSpan& buffer);
+	void ReadAnimationFrameData(const ByteSpan& buffer, int pos, CANMAnmKey& out);
 
-	void Write(const std::wstring& path);
+	bool Write(const std::wstring& path);
 	std::vector< char > WriteData(tinyxml2::XMLElement* Data);
 	CANMAnmPoint WriteAnmPoint(tinyxml2::XMLElement* data, std::vector<char>* bytes);
 	CANMAnmData WriteAnmData(tinyxml2::XMLElement* data, std::vector<char>* bytes);
@@ -57,6 +73,18 @@ public:
 	// new
 	CANMAnmData WriteAnimationData(tinyxml2::XMLElement* data, std::vector<char>* bytes);
 	short WriteAnimationKeyFrame(tinyxml2::XMLElement* data);
+	uint64_t HashAnimationKey(const CANMAnmKey& key);
+	bool IsSameAnimationKey(const CANMAnmKey& a, const CANMAnmKey& b);
+	// optional track optimisation
+	void OptimizeTrack(tinyxml2::XMLElement* data, CANMAnmKey& key, short* svalue, float* fvalue);
+	void WriteOptimizeReport(const std::wstring& path);
+
+	// Collapse constant tracks and drop keyframes before writing
+	static bool bOptimizeTracks;
+	// Allowed reconstruction error, 0 only applies lossless changes
+	static float fTrackTolerance;
+	// Also fold constant tracks into i, relies on the keyframe decode which hasn't been checked against the game
+	static bool bCollapseConstantTracks;
 
 private:
 	int i_AnmDataCount = 0;
@@ -66,10 +94,20 @@ private:
 	int i_BoneCount = 0;
 	int i_BoneOffset = 0;
 
-	std::vector< std::string > BoneList;
+	// names of the file being read, they point into m_strings
+	std::vector< const char* > BoneList;
+	UTF16StringTable m_strings;
 	std::vector< std::wstring > WBoneList;
 
 	std::vector< CANMAnmKey > v_AnmKey;
+	// all keyframes of all keys, contiguous
+	std::vector< CANMAnmKeyframe > v_AnmKeyframe;
+	// written key hash -> indices in v_AnmKey
+	std::unordered_multimap< uint64_t, short > m_AnmKeyIndex;
+	// number of keys that were merged into an existing one
+	int i_AnmKeyDupCount = 0;
+	int i_AnmKeyDupSize = 0;
+	std::vector< CANMTrackReport > v_TrackReport;
 
 	std::vector< CANMAnmPoint > v_AnmPoint;
 	std::vector< CANMAnmData > v_AnmData;
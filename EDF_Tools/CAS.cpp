@@ -2,26 +2,32 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <sstream>
+#include <cmath>
 
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "CANM.h"
 #include "CAS.h"
 #include "include/tinyxml2.h"
 
-void CAS::Read(const std::wstring& path)
+bool CAS::Read(const std::wstring& path)
 {
-	std::ifstream file(path + L".cas", std::ios::binary | std::ios::ate | std::ios::in);
-
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
-
-	std::vector<char> buffer(size);
-	if (file.read(buffer.data(), size))
+	StageTimer timer("CAS>XML", StatStage::Read);
+	MappedFile file;
+	if (file.Open(path + L".cas"))
 	{
+		ByteSpan buffer = file.Span();
+		timer.AddBytes(buffer.size());
+		timer.Next(StatStage::Parse);
 		// create xml
 		tinyxml2::XMLDocument xml;
 		xml.InsertFirstChild(xml.NewDeclaration());
@@ -30,32 +36,46 @@ void CAS::Read(const std::wstring& path)
 
 		ReadData(buffer, xmlHeader);
 		
+		timer.Next(StatStage::Serialize);
 		std::string outfile = WideToUTF8(path) + "_CAS.xml";
-		xml.SaveFile(outfile.c_str());
+		if (xml.SaveFile(outfile.c_str()) != tinyxml2::XML_SUCCESS)
+		{
+			LogError() << L"Can't write " << UTF8ToWide(outfile) << L"\n";
+			return false;
+		}
 		/*
 		tinyxml2::XMLPrinter printer;
 		xml.Accept(&printer);
 		auto xmlString = std::string{ printer.CStr() };
 
-		std::wcout << UTF8ToWide(xmlString) + L"\n";
+		LogInfo() << UTF8ToWide(xmlString) + L"\n";
 		*/
 	}
+	else
+	{
+		LogError() << L"Can't read " << path << L".cas\n";
+		return false;
+	}
 
-	//Clear buffers
-	buffer.clear();
-	file.close();
+	//Unmap the file
+	file.Close();
+	return true;
 }
 
-void CAS::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header)
+void CAS::ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header)
 {
-	int position = 0;
+	ByteReaderLE reader(buffer);
+	m_strings.Reset(buffer);
+	CANMAnimationNames.clear();
+	CASAnimationList.clear();
+
 	unsigned char seg[4];
 	// read header, length is 0x30
-	memcpy(&seg, &buffer[0], 4U);
+	reader.Get(0, seg);
 	//if (seg[0] == 0x43 && seg[1] == 0x41 && seg[2] == 0x53 && seg[3] == 0x00)
 
 	// read version
-	memcpy(&CAS_Version, &buffer[4], 4U);
+	reader.Get(4, CAS_Version);
 	if (CAS_Version == 512)
 	{
 		header->SetAttribute("version", "41");
@@ -68,22 +88,22 @@ void CAS::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header
 	}
 
 	// read canm offset
-	memcpy(&CANM_Offset, &buffer[8], 4U);
+	reader.Get(8, CANM_Offset);
 
 	// read t control
-	memcpy(&i_TControlCount, &buffer[0x0C], 4U);
-	memcpy(&i_TControlOffset, &buffer[0x10], 4U);
+	reader.Get(0x0C, i_TControlCount);
+	reader.Get(0x10, i_TControlOffset);
 	// read v control
-	memcpy(&i_VControlCount, &buffer[0x14], 4U);
-	memcpy(&i_VControlOffset, &buffer[0x18], 4U);
+	reader.Get(0x14, i_VControlCount);
+	reader.Get(0x18, i_VControlOffset);
 	// read animation group
-	memcpy(&i_AnmGroupCount, &buffer[0x1C], 4U);
-	memcpy(&i_AnmGroupOffset, &buffer[0x20], 4U);
+	reader.Get(0x1C, i_AnmGroupCount);
+	reader.Get(0x20, i_AnmGroupOffset);
 	// read bone
-	memcpy(&i_BoneCount, &buffer[0x24], 4U);
-	memcpy(&i_BoneOffset, &buffer[0x28], 4U);
+	reader.Get(0x24, i_BoneCount);
+	reader.Get(0x28, i_BoneOffset);
 	// read unk C
-	memcpy(&i_UnkCOffset, &buffer[0x2C], 4U);
+	reader.Get(0x2C, i_UnkCOffset);
 
 	// output CANM Data
 	tinyxml2::XMLElement* xmlcanm = header->InsertNewChildElement("CanmData");
@@ -93,58 +113,62 @@ void CAS::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header
 	std::unique_ptr< CANM > CANMReader = std::make_unique< CANM >();
 	CANMReader->ReadData(newbuf, xmlcanm);
 	CANMReader.reset();
-	// read CANM animation name list
-	ReadCANMName(header, newbuf);
 	newbuf.clear();
+	// read CANM animation name list
+	ReadCANMName(buffer);
 
 	// t control data
-	std::wcout << L"Read t control list...... ";
+	LogInfo() << L"Read t control list...... ";
 	ReadTControlData(header, buffer);
-	std::wcout << L"Complete!\n";
+	LogInfo() << L"Complete!\n";
 	// v control data
-	std::wcout << L"Read v control list...... ";
+	LogInfo() << L"Read v control list...... ";
 	ReadVControlData(header, buffer);
-	std::wcout << L"Complete!\n";
+	LogInfo() << L"Complete!\n";
 	// animation group data
-	std::wcout << L"Read animation list...... ";
+	LogInfo() << L"Read animation list...... ";
 	ReadAnmGroupData(header, buffer);
-	std::wcout << L"Complete!\n";
+	LogInfo() << L"Complete!\n";
 	// bone data
-	std::wcout << L"Read bone list...... ";
+	LogInfo() << L"Read bone list...... ";
 	ReadBoneListData(header, buffer);
-	std::wcout << L"Complete!\n";
+	LogInfo() << L"Complete!\n";
 	// unk c data
 	tinyxml2::XMLElement* xmlunk = header->InsertNewChildElement("Unknown");
 	if (i_UnkCOffset > 0)
 		ReadAnmGroupNodeDataPtrCommon(buffer, xmlunk, i_UnkCOffset);
 }
 
-void CAS::ReadCANMName(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CAS::ReadCANMName(const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
+	// CANM offsets are from the start of its data
 	int nameCount, nameOffset;
-	memcpy(&nameCount, &buffer[0x8], 4U);
-	memcpy(&nameOffset, &buffer[0xC], 4U);
+	reader.Get(CANM_Offset + 0x8, nameCount);
+	reader.Get(CANM_Offset + 0xC, nameOffset);
 
 	for (int i = 0; i < nameCount; i++)
 	{
-		int curpos = nameOffset + (i * 0x1C);
+		int curpos = CANM_Offset + nameOffset + (i * 0x1C);
 
 		int offset;
-		memcpy(&offset, &buffer[curpos+4], 4U);
-		std::wstring wstr = ReadUnicode(buffer, curpos + offset);
-		CANMAnimationList.push_back(wstr);
+		reader.Get(curpos+4, offset);
+		CANMAnimationNames.push_back(m_strings.Get(curpos + offset));
 	}
 }
 
-void CAS::ReadTControlData(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CAS::ReadTControlData(tinyxml2::XMLElement* header, const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmlTCD = header->InsertNewChildElement("TControl");
 	for (int i = 0; i < i_TControlCount; i++)
 	{
 		int curpos = i_TControlOffset + (i * 0xC);
 
 		int value[3];
-		memcpy(&value, &buffer[curpos], 12U);
+		reader.Get(curpos, value);
 		tinyxml2::XMLElement* xmlptr = xmlTCD->InsertNewChildElement("ptr");
 
 		xmlptr->SetAttribute("index", i);
@@ -153,16 +177,10 @@ void CAS::ReadTControlData(tinyxml2::XMLElement* header, const std::vector<char>
 #endif
 
 		// get string
-		std::wstring wstr;
-		// str
-		if (value[0] > 0)
-			wstr = ReadUnicode(buffer, curpos + value[0]);
-		else
-			wstr = L"";
-		std::string utf8str = WideToUTF8(wstr);
-		xmlptr->SetAttribute("name", utf8str.c_str());
+		const char* name = value[0] > 0 ? m_strings.Get(curpos + value[0]) : "";
+		xmlptr->SetAttribute("name", name);
 		// write name to list
-		CASAnimationList.push_back(wstr);
+		CASAnimationList.push_back(name);
 
 		// read number
 		for (int j = 0; j < value[1]; j++)
@@ -170,28 +188,30 @@ void CAS::ReadTControlData(tinyxml2::XMLElement* header, const std::vector<char>
 			int numpos = curpos + value[2] + (j * 4);
 
 			int number;
-			memcpy(&number, &buffer[numpos], 4U);
+			reader.Get(numpos, number);
 			// now write readable name
 			/*
 			tinyxml2::XMLElement* xmlNode = xmlptr->InsertNewChildElement("value");
 			xmlNode->SetText(number);
 			*/
 			tinyxml2::XMLElement* xmlNode = xmlptr->InsertNewChildElement("anime");
-			xmlNode->SetText( WideToUTF8(CANMAnimationList[number]).c_str() );
+			xmlNode->SetText( CANMAnimationNames[number] );
 		}
 	}
 	// end
 }
 
-void CAS::ReadVControlData(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CAS::ReadVControlData(tinyxml2::XMLElement* header, const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmlun = header->InsertNewChildElement("VControl");
 	for (int i = 0; i < i_VControlCount; i++)
 	{
 		int curpos = i_VControlOffset + (i * 0x14);
 
 		int value[3];
-		memcpy(&value, &buffer[curpos], 12U);
+		reader.Get(curpos, value);
 		tinyxml2::XMLElement* xmlptr = xmlun->InsertNewChildElement("ptr");
 
 		xmlptr->SetAttribute("index", i);
@@ -200,37 +220,33 @@ void CAS::ReadVControlData(tinyxml2::XMLElement* header, const std::vector<char>
 #endif
 
 		// get string
-		std::wstring wstr;
-		// str
-		if (value[0] > 0)
-			wstr = ReadUnicode(buffer, curpos + value[0]);
-		else
-			wstr = L"";
-		std::string utf8str = WideToUTF8(wstr);
-		xmlptr->SetAttribute("name", utf8str.c_str());
+		const char* name = value[0] > 0 ? m_strings.Get(curpos + value[0]) : "";
+		xmlptr->SetAttribute("name", name);
 		//
 		xmlptr->SetAttribute("int1", value[1]);
 		xmlptr->SetAttribute("int2", value[2]);
 
 		float fv;
-		memcpy(&fv, &buffer[curpos + 0xC], 4U);
+		reader.Get(curpos + 0xC, fv);
 		xmlptr->SetAttribute("float3", fv);
 
 		int iv;
-		memcpy(&iv, &buffer[curpos + 0x10], 4U);
+		reader.Get(curpos + 0x10, iv);
 		xmlptr->SetAttribute("int4", iv);
 	}
 }
 
-void CAS::ReadAnmGroupData(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CAS::ReadAnmGroupData(tinyxml2::XMLElement* header, const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmlun = header->InsertNewChildElement("AnmGroup");
 	for (int i = 0; i < i_AnmGroupCount; i++)
 	{
 		int curpos = i_AnmGroupOffset + (i * 0xC);
 
 		int value[3];
-		memcpy(&value, &buffer[curpos], 12U);
+		reader.Get(curpos, value);
 		tinyxml2::XMLElement* xmlptr = xmlun->InsertNewChildElement("ptr");
 
 		xmlptr->SetAttribute("index", i);
@@ -239,14 +255,8 @@ void CAS::ReadAnmGroupData(tinyxml2::XMLElement* header, const std::vector<char>
 #endif
 
 		// get string
-		std::wstring wstr;
-		// str
-		if (value[0] > 0)
-			wstr = ReadUnicode(buffer, curpos + value[0]);
-		else
-			wstr = L"";
-		std::string utf8str = WideToUTF8(wstr);
-		xmlptr->SetAttribute("name", utf8str.c_str());
+		const char* name = value[0] > 0 ? m_strings.Get(curpos + value[0]) : "";
+		xmlptr->SetAttribute("name", name);
 		// get data
 		for (int j = 0; j < value[1]; j++)
 		{
@@ -256,10 +266,12 @@ void CAS::ReadAnmGroupData(tinyxml2::XMLElement* header, const std::vector<char>
 	}
 }
 
-void CAS::ReadAnmGroupNodeData(const std::vector<char>& buffer, int ptrpos, tinyxml2::XMLElement* xmlptr, int index)
+void CAS::ReadAnmGroupNodeData(const ByteSpan& buffer, int ptrpos, tinyxml2::XMLElement* xmlptr, int index)
 {
+	ByteReaderLE reader(buffer);
+
 	int ptrvalue[9];
-	memcpy(&ptrvalue, &buffer[ptrpos], 36U);
+	reader.Get(ptrpos, ptrvalue);
 	tinyxml2::XMLElement* xmlnode = xmlptr->InsertNewChildElement("node");
 
 	xmlnode->SetAttribute("index", index);
@@ -268,13 +280,7 @@ void CAS::ReadAnmGroupNodeData(const std::vector<char>& buffer, int ptrpos, tiny
 #endif
 
 	// i0 is string offset
-	std::wstring wstr;
-	if (ptrvalue[0] > 0)
-		wstr = ReadUnicode(buffer, ptrpos + ptrvalue[0]);
-	else
-		wstr = L"";
-	std::string utf8str = WideToUTF8(wstr);
-	xmlnode->SetAttribute("name", utf8str.c_str());
+	xmlnode->SetAttribute("name", ptrvalue[0] > 0 ? m_strings.Get(ptrpos + ptrvalue[0]) : "");
 	// i1 is data1 offset
 	tinyxml2::XMLElement* xmldata1 = xmlnode->InsertNewChildElement("data1");
 	ReadAnmGroupNodeDataPtr(buffer, xmldata1, ptrpos + ptrvalue[1]);
@@ -311,19 +317,20 @@ void CAS::ReadAnmGroupNodeData(const std::vector<char>& buffer, int ptrpos, tiny
 	{
 		// now write name instead of index
 		//xmlnode->SetAttribute("value", ptrvalue[8]);
-		xmlnode->SetAttribute("value", WideToUTF8( CASAnimationList[ptrvalue[8]]).c_str() );
+		xmlnode->SetAttribute("value", CASAnimationList[ptrvalue[8]] );
 	}
 	else
 	{
-		std::wcout << L"Unknown type at position: " + ToString(ptrpos + 0x1C);
-		std::wcout << L" - Type: " + ToString(ptrvalue[7]) + L"\n";
+		LogWarning() << L"Unknown type at position: " + ToString(ptrpos + 0x1C) << L" - Type: " + ToString(ptrvalue[7]) + L"\n";
 	}
 }
 
-void CAS::ReadAnmGroupNodeDataPtr(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos)
+void CAS::ReadAnmGroupNodeDataPtr(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos)
 {
+	ByteReaderLE reader(buffer);
+
 	int value[8];
-	memcpy(&value, &buffer[pos], 32U);
+	reader.Get(pos, value);
 
 #if defined(DEBUGMODE)
 	xmldata->SetAttribute("debugpos", pos);
@@ -349,8 +356,10 @@ void CAS::ReadAnmGroupNodeDataPtr(const std::vector<char>& buffer, tinyxml2::XML
 		ReadAnmGroupNodeDataPtrCommon(buffer, xmlptr1, pos + value[2]);
 }
 
-void CAS::ReadAnmGroupNodeDataPtrB(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos)
+void CAS::ReadAnmGroupNodeDataPtrB(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos)
 {
+	ByteReaderLE reader(buffer);
+
 	// not using it now
 	/*
 	union test
@@ -360,7 +369,7 @@ void CAS::ReadAnmGroupNodeDataPtrB(const std::vector<char>& buffer, tinyxml2::XM
 	} value[7];
 	*/
 	int value[8];
-	memcpy(&value, &buffer[pos], 32U);
+	reader.Get(pos, value);
 	// simple type check
 	for (int i = 0; i < 8; i++)
 	{
@@ -381,10 +390,12 @@ void CAS::ReadAnmGroupNodeDataPtrB(const std::vector<char>& buffer, tinyxml2::XM
 #endif
 }
 
-void CAS::ReadAnmGroupNodeDataPtrCommon(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos)
+void CAS::ReadAnmGroupNodeDataPtrCommon(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos)
 {
+	ByteReaderLE reader(buffer);
+
 	int value[2];
-	memcpy(&value, &buffer[pos], 8U);
+	reader.Get(pos, value);
 	
 	for (int i = 0; i < value[0]; i++)
 	{
@@ -397,10 +408,10 @@ void CAS::ReadAnmGroupNodeDataPtrCommon(const std::vector<char>& buffer, tinyxml
 	}
 }
 
-void CAS::ReadAnmGroupNodeDataCommon(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos)
+void CAS::ReadAnmGroupNodeDataCommon(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos)
 {
 	std::vector< int > value(i_CasDCCount);
-	memcpy(&value[0], &buffer[pos], i_CasDCCount * 4);
+	ByteReaderLE(buffer).Get(pos, value.data(), value.size());
 	// simple type check
 	for (int i = 0; i < i_CasDCCount; i++)
 	{
@@ -414,7 +425,7 @@ void CAS::ReadAnmGroupNodeDataCommon(const std::vector<char>& buffer, tinyxml2::
 		{
 			float vf = IntHexAsFloat(value[i]);
 			// here need to determine whether to output float
-			if (isnan(vf))
+			if (std::isnan(vf))
 			{
 				datanode = xmldata->InsertNewChildElement("int");
 				datanode->SetText(value[i]);
@@ -428,15 +439,17 @@ void CAS::ReadAnmGroupNodeDataCommon(const std::vector<char>& buffer, tinyxml2::
 	}
 }
 
-void CAS::ReadBoneListData(tinyxml2::XMLElement* header, const std::vector<char>& buffer)
+void CAS::ReadBoneListData(tinyxml2::XMLElement* header, const ByteSpan& buffer)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmlbone = header->InsertNewChildElement("BoneList");
 	for (int i = 0; i < i_BoneCount; i++)
 	{
 		int curpos = i_BoneOffset + (i * 4);
 
 		int boneofs;
-		memcpy(&boneofs, &buffer[curpos], 4U);
+		reader.Get(curpos, boneofs);
 		tinyxml2::XMLElement* xmlptr = xmlbone->InsertNewChildElement("value");
 
 #if defined(DEBUGMODE)
@@ -445,46 +458,59 @@ void CAS::ReadBoneListData(tinyxml2::XMLElement* header, const std::vector<char>
 #endif
 
 		// get string
-		std::wstring wstr;
-		// str
-		if (boneofs > 0)
-			wstr = ReadUnicode(buffer, curpos + boneofs);
-		else
-			wstr = L"";
-		std::string utf8str = WideToUTF8(wstr);
-		xmlptr->SetText(utf8str.c_str());
+		const char* name = boneofs > 0 ? m_strings.Get(curpos + boneofs) : "";
+		xmlptr->SetText(name);
 	}
 }
 
 // to cas
-void CAS::Write(const std::wstring& path)
+bool CAS::Write(const std::wstring& path)
 {
 	std::wstring sourcePath = path + L"_cas.xml";
-	std::wcout << "Will output CAS file.\n";
+	LogInfo() << "Will output CAS file.\n";
 	std::string UTF8Path = WideToUTF8(sourcePath);
 
+	StageTimer timer("XML>CAS", StatStage::Parse);
 	tinyxml2::XMLDocument doc;
-	doc.LoadFile(UTF8Path.c_str());
+	if (doc.LoadFile(UTF8Path.c_str()) != tinyxml2::XML_SUCCESS)
+	{
+		LogError() << L"Can't read " + sourcePath + L"\n";
+		return false;
+	}
 
 	tinyxml2::XMLElement* header = doc.FirstChildElement("CAS");
+	if (!header)
+	{
+		LogError() << L"No CAS element in " + sourcePath + L"\n";
+		return false;
+	}
 
+	timer.Next(StatStage::Build);
 	std::vector< char > bytes;
 	bytes = WriteData(header);
 
 	//Final write.
 	/**/
-	std::ofstream newFile(path + L".cas", std::ios::binary | std::ios::out | std::ios::ate);
+	timer.Next(StatStage::Write);
+	std::ofstream newFile(ToFilePath(path + L".cas"), std::ios::binary | std::ios::out | std::ios::ate);
 
 	newFile.write(bytes.data(), bytes.size());
 
 	newFile.close();
+	if (!newFile)
+	{
+		LogError() << L"Can't write " + path + L".cas\n";
+		return false;
+	}
+	timer.AddBytes(bytes.size());
+	timer.Stop();
 	
-	std::wcout << L"Conversion completed: " + path + L".cas\n";
+	LogInfo() << L"Conversion completed: " + path + L".cas\n";
+	return true;
 }
 
 std::vector<char> CAS::WriteData(tinyxml2::XMLElement* Data)
 {
-	std::vector< char > bytes, aibytes;
 	tinyxml2::XMLElement* entry, * entry2, * entry3;
 
 	// check version
@@ -506,67 +532,83 @@ std::vector<char> CAS::WriteData(tinyxml2::XMLElement* Data)
 	{
 		// read name
 		std::wstring wstr = UTF8ToWide(entry2->Attribute("name"));
+		m_CANMAnimationIndex.emplace(wstr, (int)CANMAnimationList.size());
 		CANMAnimationList.push_back(wstr);
 	}
 
+	// sizing pass, nothing is written until every section offset is known
+	CASLayout layout;
+	int strSize = 0;
+
 	// read TControl data
+	int tcDataSize = 0;
 	entry = Data->FirstChildElement("TControl");
 	for (entry2 = entry->FirstChildElement("ptr"); entry2 != 0; entry2 = entry2->NextSiblingElement("ptr"))
 	{
-		// number is written at the same time
-		v_TControl.push_back(WriteTControlData(entry2, &aibytes));
+		CASTControl tc;
+		tc.wstr = UTF8ToWide(entry2->Attribute("name"));
+		tc.data = entry2;
+		tc.count = 0;
+		for (entry3 = entry2->FirstChildElement(); entry3 != 0; entry3 = entry3->NextSiblingElement())
+			tc.count++;
+
+		m_TControlIndex.emplace(tc.wstr, (int)v_TControl.size());
+		v_TControl.push_back(tc);
+		tcDataSize += tc.count * 4;
+		strSize += UTF16ByteSize(tc.wstr) + 2;
 	}
-	// write number offset
 	i_TControlCount = v_TControl.size();
-	int size_TControl = i_TControlCount * 0xC;
-	for (int i = 0; i < i_TControlCount; i++)
-	{
-		if (v_TControl[i].hasanm)
-		{
-			int offset = v_TControl[i].offset + size_TControl - v_TControl[i].pos;
-			memcpy(&v_TControl[i].bytes[0x8], &offset, 4U);
-		}
-	}
 
 	// read VControl data
 	entry = Data->FirstChildElement("VControl");
 	for (entry2 = entry->FirstChildElement("ptr"); entry2 != 0; entry2 = entry2->NextSiblingElement("ptr"))
 	{
-		v_VControl.push_back(WriteVControlData(entry2));
+		CASVControl vc;
+		vc.wstr = UTF8ToWide(entry2->Attribute("name"));
+		vc.data = entry2;
+		v_VControl.push_back(vc);
+		strSize += UTF16ByteSize(vc.wstr) + 2;
 	}
 	i_VControlCount = v_VControl.size();
 
 	// read bone list data
-	std::string bstr;
 	entry = Data->FirstChildElement("BoneList");
 	for (entry2 = entry->FirstChildElement("value"); entry2 != 0; entry2 = entry2->NextSiblingElement("value"))
 	{
-		bstr = entry2->GetText();
-		WBoneList.push_back(UTF8ToWide(bstr));
+		WBoneList.push_back(UTF8ToWide(entry2->GetText()));
+		strSize += UTF16ByteSize(WBoneList.back()) + 2;
 	}
 	i_BoneCount = WBoneList.size();
-	std::vector< char > blbytes(i_BoneCount * 4);
 
 	// read unknown data
-	entry = Data->FirstChildElement("Unknown");
-	std::vector< char > unkbytes = WriteUnknownData(entry);
+	tinyxml2::XMLElement* unknown = Data->FirstChildElement("Unknown");
 
-	// preread animation group data
-	int pr_anmNum = 0;
-	int pr_anmPtrNum = 0;
+	// read animation group data
+	int setDataSize = 0;
 	entry = Data->FirstChildElement("AnmGroup");
 	for (entry2 = entry->FirstChildElement("ptr"); entry2 != 0; entry2 = entry2->NextSiblingElement("ptr"))
 	{
-		pr_anmNum++;
+		CASAnmGroup group;
+		group.wstr = UTF8ToWide(entry2->Attribute("name"));
+		group.data = entry2;
+		group.first = v_AnmSet.size();
 		for (entry3 = entry2->FirstChildElement("node"); entry3 != 0; entry3 = entry3->NextSiblingElement("node"))
-			pr_anmPtrNum++;
-	}
-	i_AnmGroupCount = pr_anmNum;
-	// read animation group data
-	for (entry2 = entry->FirstChildElement("ptr"); entry2 != 0; entry2 = entry2->NextSiblingElement("ptr"))
-	{
-		v_AnmGroup.push_back(WriteAnimationGroupData(entry2, pr_anmPtrNum));
+		{
+			CASAnmGroup set;
+			set.wstr = UTF8ToWide(entry3->Attribute("name"));
+			set.data = entry3;
+			set.first = setDataSize;
+			setDataSize += SizeAnimationSetData(entry3);
+
+			v_AnmSet.push_back(set);
+			strSize += UTF16ByteSize(set.wstr) + 2;
+		}
+		group.count = v_AnmSet.size() - group.first;
+
+		v_AnmGroup.push_back(group);
+		strSize += UTF16ByteSize(group.wstr) + 2;
 	}
+	i_AnmGroupCount = v_AnmGroup.size();
 
 	// get canm data
 	entry = Data->FirstChildElement("CanmData");
@@ -574,236 +616,241 @@ std::vector<char> CAS::WriteData(tinyxml2::XMLElement* Data)
 	std::vector< char > canmbytes = writer->WriteData(entry);
 	writer.reset();
 
+	// section layout
+	layout.tControl = 0x30;
+	layout.tControlData = layout.tControl + (i_TControlCount * 0xC);
+	layout.vControl = layout.tControlData + tcDataSize;
+	layout.bone = layout.vControl + (i_VControlCount * 0x14);
+	layout.unknown = layout.bone + (i_BoneCount * 4);
+	layout.anmGroup = layout.unknown + SizeUnknownData(unknown);
+	layout.anmSet = layout.anmGroup + (i_AnmGroupCount * 0xC);
+	layout.anmSetData = layout.anmSet + ((int)v_AnmSet.size() * 0x24);
+	// 16-byte alignment is required
+	layout.canm = (layout.anmSetData + setDataSize + 15) & ~15;
+	layout.strings = layout.canm + canmbytes.size();
+	layout.size = layout.strings + strSize;
 
+	// write pass, one buffer of the final size
+	std::vector< char > bytes(layout.size, 0);
 
 	// generate header
-	bytes.resize(0x30, 0);
 	bytes[0] = 0x43;
 	bytes[1] = 0x41;
 	bytes[2] = 0x53;
 	bytes[3] = 0x00;
 	// set version
-	memcpy(&bytes[4], &CAS_Version, 4U);
+	ByteWriterLE(bytes).Set(4, CAS_Version);
+
+	i_TControlOffset = layout.tControl;
+	i_VControlOffset = layout.vControl;
+	i_BoneOffset = layout.bone;
+	i_UnkCOffset = layout.unknown;
+	i_AnmGroupOffset = layout.anmGroup;
+	CANM_Offset = layout.canm;
+	ByteWriterLE(bytes).Set(0x8, CANM_Offset);
+	ByteWriterLE(bytes).Set(0x0C, i_TControlCount);
+	ByteWriterLE(bytes).Set(0x10, i_TControlOffset);
+	ByteWriterLE(bytes).Set(0x14, i_VControlCount);
+	ByteWriterLE(bytes).Set(0x18, i_VControlOffset);
+	ByteWriterLE(bytes).Set(0x1C, i_AnmGroupCount);
+	ByteWriterLE(bytes).Set(0x20, i_AnmGroupOffset);
+	ByteWriterLE(bytes).Set(0x24, i_BoneCount);
+	ByteWriterLE(bytes).Set(0x28, i_BoneOffset);
+	ByteWriterLE(bytes).Set(0x2C, i_UnkCOffset);
 
 	// write TControl data
-	i_TControlOffset = bytes.size();
+	int tcDataPos = layout.tControlData;
 	for (size_t i = 0; i < v_TControl.size(); i++)
 	{
-		// need to save this location
-		v_TControl[i].pos = bytes.size();
-		bytes.insert(bytes.end(), v_TControl[i].bytes.begin(), v_TControl[i].bytes.end());
+		v_TControl[i].pos = layout.tControl + (i * 0xC);
+		WriteTControlData(bytes, v_TControl[i], tcDataPos);
 	}
-	// write number data
-	bytes.insert(bytes.end(), aibytes.begin(), aibytes.end());
-	memcpy(&bytes[0x0C], &i_TControlCount, 4U);
-	memcpy(&bytes[0x10], &i_TControlOffset, 4U);
 
 	// write VControl data
-	i_VControlOffset = bytes.size();
 	for (size_t i = 0; i < v_VControl.size(); i++)
 	{
-		// need to save this location
-		v_VControl[i].pos = bytes.size();
-		bytes.insert(bytes.end(), v_VControl[i].bytes.begin(), v_VControl[i].bytes.end());
+		v_VControl[i].pos = layout.vControl + (i * 0x14);
+		WriteVControlData(bytes, v_VControl[i]);
 	}
-	memcpy(&bytes[0x14], &i_VControlCount, 4U);
-	memcpy(&bytes[0x18], &i_VControlOffset, 4U);
-
-	// write bone list data (all 0)
-	i_BoneOffset = bytes.size();
-	bytes.insert(bytes.end(), blbytes.begin(), blbytes.end());
-	memcpy(&bytes[0x24], &i_BoneCount, 4U);
-	memcpy(&bytes[0x28], &i_BoneOffset, 4U);
+
 	// write unknown data
-	i_UnkCOffset = bytes.size();
-	bytes.insert(bytes.end(), unkbytes.begin(), unkbytes.end());
-	memcpy(&bytes[0x2C], &i_UnkCOffset, 4U);
+	WriteUnknownData(bytes, unknown, layout.unknown);
 
 	// write animation group data
-	i_AnmGroupOffset = bytes.size();
 	for (size_t i = 0; i < v_AnmGroup.size(); i++)
 	{
-		// need to save this location
-		v_AnmGroup[i].pos = bytes.size();
-		bytes.insert(bytes.end(), v_AnmGroup[i].bytes.begin(), v_AnmGroup[i].bytes.end());
+		v_AnmGroup[i].pos = layout.anmGroup + (i * 0xC);
+		int offset = layout.anmSet + (v_AnmGroup[i].first * 0x24) - v_AnmGroup[i].pos;
+		ByteWriterLE(bytes).Set(v_AnmGroup[i].pos + 4, v_AnmGroup[i].count);
+		ByteWriterLE(bytes).Set(v_AnmGroup[i].pos + 8, offset);
 	}
-	memcpy(&bytes[0x1C], &i_AnmGroupCount, 4U);
-	memcpy(&bytes[0x20], &i_AnmGroupOffset, 4U);
 	// write animation set data
 	for (size_t i = 0; i < v_AnmSet.size(); i++)
 	{
-		// need to save this location
-		v_AnmSet[i].pos = bytes.size();
-		bytes.insert(bytes.end(), v_AnmSet[i].bytes.begin(), v_AnmSet[i].bytes.end());
+		v_AnmSet[i].pos = layout.anmSet + (i * 0x24);
+		WriteAnimationSetData(bytes, v_AnmSet[i], layout.anmSetData + v_AnmSet[i].first);
 	}
-	// write animation other data
-	bytes.insert(bytes.end(), v_AnmSetData.begin(), v_AnmSetData.end());
 
-	// 16-byte alignment is required
-	int i_Alignment = bytes.size() % 16;
-	if (i_Alignment > 0)
-	{
-		for (int i = i_Alignment; i < 16; i++)
-			bytes.push_back(0);
-	}
 	// write canm data
-	CANM_Offset = bytes.size();
-	bytes.insert(bytes.end(), canmbytes.begin(), canmbytes.end());
-	memcpy(&bytes[0x8], &CANM_Offset, 4U);
+	if (canmbytes.size() > 0)
+		memcpy(&bytes[layout.canm], canmbytes.data(), canmbytes.size());
 
-	// write TControl string
+	// write strings
+	int strPos = layout.strings;
 	for (size_t i = 0; i < v_TControl.size(); i++)
-	{
-		int curpos = bytes.size() - v_TControl[i].pos;
-		memcpy(&bytes[v_TControl[i].pos], &curpos, 4U);
-		PushWStringToVector(v_TControl[i].wstr, &bytes);
-	}
-	// write VControl string
+		strPos = WriteWString(bytes, v_TControl[i].wstr, strPos, v_TControl[i].pos);
 	for (size_t i = 0; i < v_VControl.size(); i++)
-	{
-		int curpos = bytes.size() - v_VControl[i].pos;
-		memcpy(&bytes[v_VControl[i].pos], &curpos, 4U);
-		PushWStringToVector(v_VControl[i].wstr, &bytes);
-	}
-	// write bone list string
+		strPos = WriteWString(bytes, v_VControl[i].wstr, strPos, v_VControl[i].pos);
 	for (size_t i = 0; i < WBoneList.size(); i++)
-	{
-		int curpos = i_BoneOffset + (i * 4);
-		int strpos = bytes.size() - curpos;
-		memcpy(&bytes[curpos], &strpos, 4U);
-		PushWStringToVector(WBoneList[i], &bytes);
-	}
-	// write animation group string
+		strPos = WriteWString(bytes, WBoneList[i], strPos, layout.bone + (i * 4));
 	for (size_t i = 0; i < v_AnmGroup.size(); i++)
+		strPos = WriteWString(bytes, v_AnmGroup[i].wstr, strPos, v_AnmGroup[i].pos);
+	for (size_t i = 0; i < v_AnmSet.size(); i++)
+		strPos = WriteWString(bytes, v_AnmSet[i].wstr, strPos, v_AnmSet[i].pos);
+
+	return bytes;
+}
+
+int CAS::WriteWString(std::vector<char>& bytes, const std::wstring& wstr, int pos, int ptrPos)
+{
+	// the pointer is relative to its own position
+	int offset = pos - ptrPos;
+	ByteWriterLE(bytes).Set(ptrPos, offset);
+
+	int size = (int)WriteUTF16LE(&bytes[pos], wstr);
+	// zero terminated, buffer is already 0
+	return pos + size + 2;
+}
+
+int CAS::SizeUnknownData(tinyxml2::XMLElement* data)
+{
+	int count = 0;
+	for (tinyxml2::XMLElement* entry = data->FirstChildElement("data"); entry != 0; entry = entry->NextSiblingElement("data"))
+		count++;
+
+	return 8 + (count * i_CasDCCount * 4);
+}
+
+int CAS::SizeMainAnimationDataA(tinyxml2::XMLElement* data)
+{
+	int size = 0x20;
+	tinyxml2::XMLElement* entry = data->FirstChildElement("parametric");
+	if (entry->FirstChildElement())
+		size += SizeUnknownData(entry);
+
+	return size;
+}
+
+int CAS::SizeAnimationSetData(tinyxml2::XMLElement* data)
+{
+	int size = 0;
+	tinyxml2::XMLElement* entry;
+
+	entry = data->FirstChildElement("data1");
+	if (entry->FirstChildElement())
+		size += SizeMainAnimationDataA(entry);
+
+	entry = data->FirstChildElement("data2");
+	if (entry->FirstChildElement())
 	{
-		int curpos = bytes.size() - v_AnmGroup[i].pos;
-		memcpy(&bytes[v_AnmGroup[i].pos], &curpos, 4U);
-		PushWStringToVector(v_AnmGroup[i].wstr, &bytes);
+		for (tinyxml2::XMLElement* entry2 = entry->FirstChildElement("ptr"); entry2 != 0; entry2 = entry2->NextSiblingElement("ptr"))
+		{
+			size += 0x20;
+			tinyxml2::XMLElement* entry3 = entry2->FirstChildElement("parametric");
+			if (entry3->FirstChildElement())
+				size += SizeUnknownData(entry3);
+		}
 	}
-	// write animation set string
-	for (size_t i = 0; i < v_AnmSet.size(); i++)
+
+	const char* parametric[3] = { "parametric1", "parametric2", "parametric3" };
+	for (int i = 0; i < 3; i++)
 	{
-		int curpos = bytes.size() - v_AnmSet[i].pos;
-		memcpy(&bytes[v_AnmSet[i].pos], &curpos, 4U);
-		PushWStringToVector(v_AnmSet[i].wstr, &bytes);
+		entry = data->FirstChildElement(parametric[i]);
+		if (entry->FirstChildElement())
+			size += SizeUnknownData(entry);
 	}
 
-	return bytes;
+	return size;
 }
 
-CASTControl CAS::WriteTControlData(tinyxml2::XMLElement* data, std::vector<char>* bytes)
+void CAS::WriteTControlData(std::vector<char>& bytes, const CASTControl& tc, int& dataPos)
 {
-	CASTControl out;
+	// - 0x04 - : Int32, Number amount.
+	ByteWriterLE(bytes).Set(tc.pos + 4, tc.count);
+	if (tc.count == 0)
+		return;
 
-	out.pos = v_TControl.size() * 0xC;
-	out.offset = bytes->size();
-	out.wstr = UTF8ToWide(data->Attribute("name"));
-	out.hasanm = false;
+	int offset = dataPos - tc.pos;
+	ByteWriterLE(bytes).Set(tc.pos + 8, offset);
 	// write number
-	int count = 0;
-	tinyxml2::XMLElement* entry = data->FirstChildElement();
-	if (entry != nullptr)
+	int number = 0;
+	std::wstring wstr;
+	for (tinyxml2::XMLElement* entry = tc.data->FirstChildElement(); entry != 0; entry = entry->NextSiblingElement())
 	{
-		int number = 0;
-		char buffer[4];
-
-		for (entry = data->FirstChildElement(); entry != 0; entry = entry->NextSiblingElement())
+		std::string nodeType = entry->Name();
+		if (nodeType == "value")
+		{
+			number = entry->IntText();
+		}
+		else if (nodeType == "anime")
 		{
-			std::string nodeType = entry->Name();
-			if (nodeType == "value")
+			UTF8ToWide(entry->GetText(), wstr);
+			auto it = m_CANMAnimationIndex.find(wstr);
+			if (it != m_CANMAnimationIndex.end())
 			{
-				number = entry->IntText();
+				number = it->second;
 			}
-			else if (nodeType == "anime")
+			else
 			{
-				std::wstring wstr = UTF8ToWide(entry->GetText());
-				// check exist
-				bool isExist = false;
-				for (size_t i = 0; i < CANMAnimationList.size(); i++)
-				{
-					if (wstr == CANMAnimationList[i])
-					{
-						isExist = true;
-						number = i;
-						break;
-					}
-				}
 				// If it doesn't exist, it needs to be thrown and set to 0
-				if (!isExist)
-				{
-					std::wcout << L"!!!!!!Non-existent CANM animation: " + wstr + L"\n";
-					number = 0;
-				}
+				LogWarning() << L"!!!!!!Non-existent CANM animation: " + wstr + L"\n";
+				number = 0;
 			}
-			count++;
-
-			memcpy(&buffer, &number, 4U);
-			for (int i = 0; i < 4; i++)
-				bytes->push_back(buffer[i]);
 		}
 
-		out.hasanm = true;
+		ByteWriterLE(bytes).Set(dataPos, number);
+		dataPos += 4;
 	}
-	// - 0x04 - : Int32, Number amount.
-	out.bytes.resize(0xC, 0);
-	memcpy(&out.bytes[4], &count, 4U);
-
-	return out;
 }
 
-CASVControl CAS::WriteVControlData(tinyxml2::XMLElement* data)
+void CAS::WriteVControlData(std::vector<char>& bytes, const CASVControl& vc)
 {
-	CASVControl out;
-
-	out.pos = v_VControl.size() * 0x14;
-	out.wstr = UTF8ToWide(data->Attribute("name"));
-	out.bytes.resize(0x14);
-
 	int ig[2];
-	ig[0] = data->IntAttribute("int1");
-	ig[1] = data->IntAttribute("int2");
-	memcpy(&out.bytes[4], &ig, 8U);
-
-	float fvalue = data->FloatAttribute("float3");
-	memcpy(&out.bytes[0xC], &fvalue, 4U);
+	ig[0] = vc.data->IntAttribute("int1");
+	ig[1] = vc.data->IntAttribute("int2");
+	ByteWriterLE(bytes).Set(vc.pos + 4, ig);
 
-	int ivalue = data->IntAttribute("int4");
-	memcpy(&out.bytes[0x10], &ivalue, 4U);
+	float fvalue = vc.data->FloatAttribute("float3");
+	ByteWriterLE(bytes).Set(vc.pos + 0xC, fvalue);
 
-	return out;
+	int ivalue = vc.data->IntAttribute("int4");
+	ByteWriterLE(bytes).Set(vc.pos + 0x10, ivalue);
 }
 
-std::vector<char> CAS::WriteUnknownData(tinyxml2::XMLElement* data)
+int CAS::WriteUnknownData(std::vector<char>& bytes, tinyxml2::XMLElement* data, int pos)
 {
-	std::vector<char> out(8, 0);
 	// always offset 8
-	out[4] = 8;
+	bytes[pos + 4] = 8;
 	// get count
 	int count = 0;
-	tinyxml2::XMLElement* entry = data->FirstChildElement("data");
-	if (entry != nullptr)
+	int size = i_CasDCCount * 4;
+	for (tinyxml2::XMLElement* entry = data->FirstChildElement("data"); entry != 0; entry = entry->NextSiblingElement("data"))
 	{
-		for (entry = data->FirstChildElement("data"); entry != 0; entry = entry->NextSiblingElement("data"))
-		{
-			std::vector<char> buffer = WriteCASSpecialData(entry, i_CasDCCount);
-			count++;
-
-			out.insert(out.end(), buffer.begin(), buffer.end());
-		}
+		WriteCASSpecialData(bytes, entry, pos + 8 + (count * size), i_CasDCCount);
+		count++;
 	}
-	memcpy(&out[0], &count, 4U);
+	ByteWriterLE(bytes).Set(pos, count);
 
-	return out;
+	return pos + 8 + (count * size);
 }
 
-std::vector<char> CAS::WriteCASSpecialData(tinyxml2::XMLElement* data, int num)
+void CAS::WriteCASSpecialData(std::vector<char>& bytes, tinyxml2::XMLElement* data, int pos, int num)
 {
-	std::vector<char> out;
-
-	char buffer[4];
-	tinyxml2::XMLElement* entry;
+	char buffer[4] = { 0 };
+	int i = 0;
 	std::string nodeType;
-	for (entry = data->FirstChildElement(); entry != 0; entry = entry->NextSiblingElement())
+	// redundant values are dropped, missing ones stay 0
+	for (tinyxml2::XMLElement* entry = data->FirstChildElement(); entry != 0 && i < num; entry = entry->NextSiblingElement(), i++)
 	{
 		nodeType = entry->Name();
 		if (nodeType == "int")
@@ -816,244 +863,142 @@ std::vector<char> CAS::WriteCASSpecialData(tinyxml2::XMLElement* data, int num)
 			float value = entry->FloatText();
 			memcpy(&buffer, &value, 4U);
 		}
-		// push byte
-		for (int i = 0; i < 4; i++)
-			out.push_back(buffer[i]);
+		ByteWriterLE(bytes).Set(pos + (i * 4), buffer);
 	}
-	// expand size, redundant fill 0
-	out.resize(num * 4, 0);
-	return out;
 }
 
-CASAnmGroup CAS::WriteAnimationGroupData(tinyxml2::XMLElement* data, int subnum)
+void CAS::WriteAnimationSetData(std::vector<char>& bytes, const CASAnmGroup& set, int dataPos)
 {
-	CASAnmGroup out;
-	out.wstr = UTF8ToWide(data->Attribute("name"));
-	out.bytes.resize(0xC, 0);
-	// read set
-	int count = 0;
-	int offset = ((i_AnmGroupCount - v_AnmGroup.size()) * 0xC) + (v_AnmSet.size() * 0x24);
-	for (tinyxml2::XMLElement* entry = data->FirstChildElement("node"); entry != 0; entry = entry->NextSiblingElement("node"))
-	{
-		v_AnmSet.push_back(WriteAnimationSetData(entry, subnum));
-		count++;
-	}
-
-	memcpy(&out.bytes[4], &count, 4U);
-	memcpy(&out.bytes[8], &offset, 4U);
-
-	return out;
-}
-
-CASAnmGroup CAS::WriteAnimationSetData(tinyxml2::XMLElement* data, int subnum)
-{
-	CASAnmGroup out;
-	out.wstr = UTF8ToWide(data->Attribute("name"));
-	out.bytes.resize(0x24, 0);
-	// other set
-	int cusofs = (subnum - v_AnmSet.size()) * 0x24;
+	tinyxml2::XMLElement* data = set.data;
 	tinyxml2::XMLElement* entry;
 	// read type
 	int type = data->IntAttribute("type");
-	memcpy(&out.bytes[0x1C], &type, 4U);
+	ByteWriterLE(bytes).Set(set.pos + 0x1C, type);
 	if (type == 0)
 	{
 		float value = data->FloatAttribute("value");
-		memcpy(&out.bytes[0x20], &value, 4U);
+		ByteWriterLE(bytes).Set(set.pos + 0x20, value);
 	}
 	else if (type == 1)
 	{
 		int value = data->IntAttribute("value");
-		memcpy(&out.bytes[0x20], &value, 4U);
+		ByteWriterLE(bytes).Set(set.pos + 0x20, value);
 	}
 	else if (type == 2)
 	{
-		//int value = data->IntAttribute("value");
-		int value;
+		int value = 0;
 		std::wstring tcstr = UTF8ToWide(data->Attribute("value"));
-		// check exist
-		bool isExist = false;
-		for (size_t i = 0; i < v_TControl.size(); i++)
+		auto it = m_TControlIndex.find(tcstr);
+		if (it != m_TControlIndex.end())
 		{
-			if (tcstr == v_TControl[i].wstr)
-			{
-				isExist = true;
-				value = i;
-				break;
-			}
+			value = it->second;
 		}
-		// If it doesn't exist, it needs to be thrown and set to 0
-		if (!isExist)
+		else
 		{
-			std::wcout << L"!!!!!!Non-existent CAS TControl: " + tcstr + L"\n";
-			value = 0;
+			// If it doesn't exist, it needs to be thrown and set to 0
+			LogWarning() << L"!!!!!!Non-existent CAS TControl: " + tcstr + L"\n";
 		}
 
-		memcpy(&out.bytes[0x20], &value, 4U);
+		ByteWriterLE(bytes).Set(set.pos + 0x20, value);
 	}
 	// read data1
 	entry = data->FirstChildElement("data1");
 	if (entry->FirstChildElement())
 	{
-		int value = cusofs + v_AnmSetData.size();
-		memcpy(&out.bytes[4], &value, 4U);
+		int value = dataPos - set.pos;
+		ByteWriterLE(bytes).Set(set.pos + 4, value);
 
-		std::vector<char> buffer = WriteMainAnimationDataA(entry);
-		v_AnmSetData.insert(v_AnmSetData.end(), buffer.begin(), buffer.end());
+		dataPos = WriteMainAnimationDataA(bytes, entry, dataPos);
 	}
 	// read data2
 	entry = data->FirstChildElement("data2");
 	if (entry->FirstChildElement())
 	{
-		int value = cusofs + v_AnmSetData.size();
-		memcpy(&out.bytes[0xC], &value, 4U);
-		// reset value
-		value = 0;
-		std::vector<int> dataPos;
+		int value = dataPos - set.pos;
+		ByteWriterLE(bytes).Set(set.pos + 0xC, value);
+
+		// all ptr blocks first, their parameters follow
+		int ptrPos = dataPos;
+		int count = 0;
 		for (tinyxml2::XMLElement* entry2 = entry->FirstChildElement("ptr"); entry2 != 0; entry2 = entry2->NextSiblingElement("ptr"))
 		{
-			value++;
-			// record location
-			dataPos.push_back(v_AnmSetData.size());
-			// read data
-			std::vector<char> buffer = WriteMainAnimationDataB(entry2);
-			v_AnmSetData.insert(v_AnmSetData.end(), buffer.begin(), buffer.end());
+			dataPos = WriteMainAnimationDataB(bytes, entry2, dataPos);
+			count++;
 		}
-		memcpy(&out.bytes[0x8], &value, 4U);
-		// reset value
-		value = 0;
+		ByteWriterLE(bytes).Set(set.pos + 0x8, count);
+
 		for (tinyxml2::XMLElement* entry2 = entry->FirstChildElement("ptr"); entry2 != 0; entry2 = entry2->NextSiblingElement("ptr"))
 		{
 			tinyxml2::XMLElement* entry3 = entry2->FirstChildElement("parametric");
 			if (entry3->FirstChildElement())
 			{
 				// write parameter offset
-				int curpos = dataPos[value];
-				int offset = v_AnmSetData.size() - curpos;
-				memcpy(&v_AnmSetData[curpos + 8], &offset, 4U);
-				// read parameter data
-				std::vector<char> buffer = WriteUnknownData(entry3);
-				v_AnmSetData.insert(v_AnmSetData.end(), buffer.begin(), buffer.end());
+				int offset = dataPos - ptrPos;
+				ByteWriterLE(bytes).Set(ptrPos + 8, offset);
+				dataPos = WriteUnknownData(bytes, entry3, dataPos);
 			}
-			// finally add "value"
-			value++;
+			ptrPos += 0x20;
 		}
 	}
-	// read parametric1
-	entry = data->FirstChildElement("parametric1");
-	if (entry->FirstChildElement())
+	// read parametric1, 2, 3
+	const char* parametric[3] = { "parametric1", "parametric2", "parametric3" };
+	for (int i = 0; i < 3; i++)
 	{
-		int value = cusofs + v_AnmSetData.size();
-		memcpy(&out.bytes[0x10], &value, 4U);
-
-		std::vector<char> buffer = WriteUnknownData(entry);
-		v_AnmSetData.insert(v_AnmSetData.end(), buffer.begin(), buffer.end());
-	}
-	// read parametric2
-	entry = data->FirstChildElement("parametric2");
-	if (entry->FirstChildElement())
-	{
-		int value = cusofs + v_AnmSetData.size();
-		memcpy(&out.bytes[0x14], &value, 4U);
-
-		std::vector<char> buffer = WriteUnknownData(entry);
-		v_AnmSetData.insert(v_AnmSetData.end(), buffer.begin(), buffer.end());
-	}
-	// read parametric3
-	entry = data->FirstChildElement("parametric3");
-	if (entry->FirstChildElement())
-	{
-		int value = cusofs + v_AnmSetData.size();
-		memcpy(&out.bytes[0x18], &value, 4U);
+		entry = data->FirstChildElement(parametric[i]);
+		if (entry->FirstChildElement())
+		{
+			int value = dataPos - set.pos;
+			ByteWriterLE(bytes).Set(set.pos + 0x10 + (i * 4), value);
 
-		std::vector<char> buffer = WriteUnknownData(entry);
-		v_AnmSetData.insert(v_AnmSetData.end(), buffer.begin(), buffer.end());
+			dataPos = WriteUnknownData(bytes, entry, dataPos);
+		}
 	}
-
-	return out;
 }
 
-std::vector<char> CAS::WriteMainAnimationDataA(tinyxml2::XMLElement* data)
+int CAS::WriteMainAnimationDataA(std::vector<char>& bytes, tinyxml2::XMLElement* data, int pos)
 {
-	std::vector<char> out(0x20, 0);
-	// write unknown
-	int i1 = data->IntAttribute("int1");
-	memcpy(&out[0], &i1, 4U);
-	float f2 = data->FloatAttribute("float2");
-	memcpy(&out[4], &f2, 4U);
-	// check type
-	int type = data->IntAttribute("type");
-	memcpy(&out[0xC], &type, 4U);
-	if (type == 0)
-	{
-		float value = data->FloatAttribute("value");
-		memcpy(&out[0x10], &value, 4U);
-	}
-	else if (type == 1)
-	{
-		int value = data->IntAttribute("value");
-		memcpy(&out[0x10], &value, 4U);
-	}
-	else if (type == 2)
-	{
-		int value = data->IntAttribute("value");
-		memcpy(&out[0x10], &value, 4U);
-	}
-	// write unknown 2
-	int i6 = data->IntAttribute("int6");
-	memcpy(&out[0x14], &i6, 4U);
-	int i7 = data->IntAttribute("int7");
-	memcpy(&out[0x18], &i7, 4U);
-	int i8 = data->IntAttribute("int8");
-	memcpy(&out[0x1C], &i8, 4U);
+	int end = WriteMainAnimationDataB(bytes, data, pos);
 	// read offset data
 	tinyxml2::XMLElement* entry = data->FirstChildElement("parametric");
 	if (entry->FirstChildElement())
 	{
 		int value = 0x20;
-		memcpy(&out[0x8], &value, 4U);
+		ByteWriterLE(bytes).Set(pos + 0x8, value);
 
-		std::vector<char> buffer = WriteUnknownData(entry);
-		out.insert(out.end(), buffer.begin(), buffer.end());
+		end = WriteUnknownData(bytes, entry, end);
 	}
 
-	return out;
+	return end;
 }
 
-std::vector<char> CAS::WriteMainAnimationDataB(tinyxml2::XMLElement* data)
+int CAS::WriteMainAnimationDataB(std::vector<char>& bytes, tinyxml2::XMLElement* data, int pos)
 {
-	std::vector<char> out(0x20, 0);
 	// write unknown
 	int i1 = data->IntAttribute("int1");
-	memcpy(&out[0], &i1, 4U);
+	ByteWriterLE(bytes).Set(pos, i1);
 	float f2 = data->FloatAttribute("float2");
-	memcpy(&out[4], &f2, 4U);
+	ByteWriterLE(bytes).Set(pos + 4, f2);
 	// check type
 	int type = data->IntAttribute("type");
-	memcpy(&out[0xC], &type, 4U);
+	ByteWriterLE(bytes).Set(pos + 0xC, type);
 	if (type == 0)
 	{
 		float value = data->FloatAttribute("value");
-		memcpy(&out[0x10], &value, 4U);
+		ByteWriterLE(bytes).Set(pos + 0x10, value);
 	}
-	else if (type == 1)
-	{
-		int value = data->IntAttribute("value");
-		memcpy(&out[0x10], &value, 4U);
-	}
-	else if (type == 2)
+	else if (type == 1 || type == 2)
 	{
 		int value = data->IntAttribute("value");
-		memcpy(&out[0x10], &value, 4U);
+		ByteWriterLE(bytes).Set(pos + 0x10, value);
 	}
 	// write unknown 2
 	int i6 = data->IntAttribute("int6");
-	memcpy(&out[0x14], &i6, 4U);
+	ByteWriterLE(bytes).Set(pos + 0x14, i6);
 	int i7 = data->IntAttribute("int7");
-	memcpy(&out[0x18], &i7, 4U);
+	ByteWriterLE(bytes).Set(pos + 0x18, i7);
 	int i8 = data->IntAttribute("int8");
-	memcpy(&out[0x1C], &i8, 4U);
+	ByteWriterLE(bytes).Set(pos + 0x1C, i8);
 	// offset data is not read here
 
-	return out;
+	return pos + 0x20;
 }
@@ -1,57 +1,83 @@
 #pragma once
+#include <unordered_map>
 #include "include/tinyxml2.h"
+#include "StringTable.h"
 
 struct CASTControl
 {
 	int pos;
 	std::wstring wstr;
-	int offset;
-	std::vector< char > bytes;
-	bool hasanm;
+	// amount of animation numbers
+	int count;
+	tinyxml2::XMLElement* data;
 };
 
 struct CASVControl
 {
 	int pos;
 	std::wstring wstr;
-	std::vector< char > bytes;
+	tinyxml2::XMLElement* data;
 };
 
 struct CASAnmGroup
 {
 	int pos = 0;
 	std::wstring wstr;
-	std::vector< char > bytes;
+	tinyxml2::XMLElement* data;
+	// group: index of first set, set: offset of its data in the set data section
+	int first = 0;
+	int count = 0;
+};
+
+// Section offsets of a CAS file, all computed before anything is written
+struct CASLayout
+{
+	int tControl;
+	int tControlData;
+	int vControl;
+	int bone;
+	int unknown;
+	int anmGroup;
+	int anmSet;
+	int anmSetData;
+	int canm;
+	int strings;
+	int size;
 };
 
 class CAS
 {
 public:
-	void Read(const std::wstring& path);
-	void ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header);
+	bool Read(const std::wstring& path);
+	void ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header);
 
-	void ReadCANMName(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
-	void ReadTControlData(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
-	void ReadVControlData(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
-	void ReadAnmGroupData(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
-	void ReadAnmGroupNodeData(const std::vector<char>& buffer, int ptrpos, tinyxml2::XMLElement* xmlptr, int index);
-	void ReadAnmGroupNodeDataPtr(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos);
-	void ReadAnmGroupNodeDataPtrB(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos);
-	void ReadAnmGroupNodeDataPtrCommon(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos);
-	void ReadAnmGroupNodeDataCommon(const std::vector<char>& buffer, tinyxml2::XMLElement* xmldata, int pos);
-	void ReadBoneListData(tinyxml2::XMLElement* header, const std::vector<char>& buffer);
+	void ReadCANMName(const ByteSpan& buffer);
+	void ReadTControlData(tinyxml2::XMLElement* header, const ByteSpan& buffer);
+	void ReadVControlData(tinyxml2::XMLElement* header, const ByteSpan& buffer);
+	void ReadAnmGroupData(tinyxml2::XMLElement* header, const ByteSpan& buffer);
+	void ReadAnmGroupNodeData(const ByteSpan& buffer, int ptrpos, tinyxml2::XMLElement* xmlptr, int index);
+	void ReadAnmGroupNodeDataPtr(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos);
+	void ReadAnmGroupNodeDataPtrB(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos);
+	void ReadAnmGroupNodeDataPtrCommon(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos);
+	void ReadAnmGroupNodeDataCommon(const ByteSpan& buffer, tinyxml2::XMLElement* xmldata, int pos);
+	void ReadBoneListData(tinyxml2::XMLElement* header, const ByteSpan& buffer);
 	// to cas
-	void Write(const std::wstring& path);
+	bool Write(const std::wstring& path);
 	std::vector< char > WriteData(tinyxml2::XMLElement* Data);
 
-	CASTControl WriteTControlData(tinyxml2::XMLElement* data, std::vector< char >* bytes);
-	CASVControl WriteVControlData(tinyxml2::XMLElement* data);
-	std::vector< char > WriteUnknownData(tinyxml2::XMLElement* data);
-	std::vector< char > WriteCASSpecialData(tinyxml2::XMLElement* data, int num);
-	CASAnmGroup WriteAnimationGroupData(tinyxml2::XMLElement* data, int subnum);
-	CASAnmGroup WriteAnimationSetData(tinyxml2::XMLElement* data, int subnum);
-	std::vector< char > WriteMainAnimationDataA(tinyxml2::XMLElement* data);
-	std::vector< char > WriteMainAnimationDataB(tinyxml2::XMLElement* data);
+	// sizing pass
+	int SizeUnknownData(tinyxml2::XMLElement* data);
+	int SizeMainAnimationDataA(tinyxml2::XMLElement* data);
+	int SizeAnimationSetData(tinyxml2::XMLElement* data);
+	// write pass, everything goes to its final position in bytes
+	void WriteTControlData(std::vector< char >& bytes, const CASTControl& tc, int& dataPos);
+	void WriteVControlData(std::vector< char >& bytes, const CASVControl& vc);
+	int WriteUnknownData(std::vector< char >& bytes, tinyxml2::XMLElement* data, int pos);
+	void WriteCASSpecialData(std::vector< char >& bytes, tinyxml2::XMLElement* data, int pos, int num);
+	void WriteAnimationSetData(std::vector< char >& bytes, const CASAnmGroup& set, int dataPos);
+	int WriteMainAnimationDataA(std::vector< char >& bytes, tinyxml2::XMLElement* data, int pos);
+	int WriteMainAnimationDataB(std::vector< char >& bytes, tinyxml2::XMLElement* data, int pos);
+	int WriteWString(std::vector< char >& bytes, const std::wstring& wstr, int pos, int ptrPos);
 
 private:
 	int CAS_Version = 0;
@@ -71,13 +97,18 @@ private:
 	std::vector< std::wstring > WBoneList;
 	// List of animation name in CANM
 	std::vector< std::wstring > CANMAnimationList;
-	// List of TControl name in CAS
-	std::vector< std::wstring > CASAnimationList;
+	// Read: CANM animation and TControl names, they point into m_strings
+	std::vector< const char* > CANMAnimationNames;
+	std::vector< const char* > CASAnimationList;
+	UTF16StringTable m_strings;
+
+	// name -> index, first occurrence wins
+	std::unordered_map< std::wstring, int > m_CANMAnimationIndex;
+	std::unordered_map< std::wstring, int > m_TControlIndex;
 
 	std::vector< CASTControl > v_TControl;
 	std::vector< CASVControl > v_VControl;
 	std::vector< CASAnmGroup > v_AnmGroup;
 	std::vector< CASAnmGroup > v_AnmSet;
-	std::vector< char > v_AnmSetData;
 
 };
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "stdafx.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "Stats.h"
+#include "CMPL.h"
+
+//CMPL Tools:
+CMPLHandler::CMPLHandler( std::vector< char > inFile, bool useFakeCompression )
+{
+	data = inFile;
+
+	bUseFakeCompression = useFakeCompression;
+}
+
+//CMPL Decompressor
+std::vector< char > CMPLHandler::Decompress(  )
+{
+	StageTimer timer( "CMPL", StatStage::Decompress );
+	timer.AddBytes( data.size( ) );
+
+	//Check header:
+	if( data[0] != 'C' && data[1] != 'M' && data[2] != 'P' && data[3] != 'L' )
+	{
+		LogError( ) << L"FILE IS NOT CMPL COMPRESSED!\n";
+		return data;
+	}
+	else
+		LogDebug( ) << L"BEGINNING DECOMPRESSION\n";
+
+	//Variables
+	uint8_t bitbuf;
+	uint8_t bitbufcnt;
+
+	std::vector< char > out;
+
+	char mainbuf[4096];
+
+	int bufPos;
+
+	int desiredSize = ReadBE< int32_t >( data, 4 );
+	out.reserve(desiredSize);
+
+	int streamPos = 8;
+
+	//Init buffer:
+	for( int i = 0; i < 4078; ++i )
+		mainbuf[i] = 0;
+	bitbuf = 0;
+	bitbufcnt = 0;
+	bufPos = 4078;
+
+	//Loop
+	while( streamPos < data.size( ) )
+	{
+		//If bitbuf empty
+		if( bitbufcnt == 0 )
+		{
+			//Read and store in buffer
+			bitbuf = data[streamPos];
+			bitbufcnt = 8;
+
+			++streamPos;
+		}
+
+		//if first bit is one, copy byte from input
+		if( bitbuf & 0x1 > 0 )
+		{
+			out.push_back( data[streamPos] );
+			mainbuf[bufPos] = data[streamPos];
+			++bufPos;
+			if( bufPos >= 4096 )
+				bufPos = 0;
+			++streamPos;
+		}
+		else //Copy bytes from buffer
+		{
+			uint8_t chunk[2];
+			chunk[1] = data[streamPos + 1];
+			chunk[0] = data[streamPos];
+
+			streamPos += 2;
+
+			uint16_t val = ( chunk[0] << 8 ) | chunk[1];
+			int copyLen = ( val & 0xf ) + 3;
+			int copyPos = val >> 4;
+
+			for( int i = 0; i < copyLen; ++i )
+			{
+				unsigned char byte = mainbuf[copyPos];
+				out.push_back( byte );
+				mainbuf[bufPos] = byte;
+
+				++bufPos;
+				if( bufPos >= 4096 )
+					bufPos = 0;
+
+				++copyPos;
+				if( copyPos >= 4096 )
+					copyPos = 0;
+			}
+		}
+
+		--bitbufcnt;
+		bitbuf >>= 1;
+	}
+
+	if( out.size( ) == desiredSize )
+	{
+		LogDebug( ) << L"FILE SIZE MATCH! " + ToString( desiredSize ) + L" bytes expected, got " + ToString( (int)out.size( ) ) +  L" DECOMPRESSION SUCCESSFUL!\n";
+	}
+	else
+		LogError( ) << L"FILE SIZE MISMATCH! " + ToString( desiredSize ) + L" bytes expected, got " + ToString( (int)out.size( ) ) + L" DECOMPRESSION FAILED!\n";
+
+	return out;
+}
+
+//CMPL Compresser
+std::vector< char > CMPLHandler::Compress( )
+{
+	StageTimer timer( "CMPL", StatStage::Compress );
+	timer.AddBytes( data.size( ) );
+
+	//Declare output
+	std::vector< char > out;
+
+	//Fill header:
+	out.push_back( 'C' );
+	out.push_back( 'M' );
+	out.push_back( 'P' );
+	out.push_back( 'L' );
+
+	//File size
+	ByteWriterBE( out ).Put< int32_t >( (int32_t)data.size( ) );
+
+	//Begin compression:
+
+	//Use fake compression, faster compile times but extremly ineffecient
+	if( bUseFakeCompression )
+	{
+		LogDebug( ) << L"File using SIMPLE/FAKE Compression.\n";
+
+		//Prepare to format the data into something that the game's CMPL decompressor will read, this data will be trash, not really compressed and is horrible, but just do it anyway.
+		int count = 0;
+		while( count < data.size( ) )
+		{
+			//Push "Copy 8 bits directly" command to reader
+			out.push_back( 0b11111111 );
+
+			for( int i = 0; i < 8; ++i )
+			{
+				if( count >= data.size( ) )
+					break;
+				out.push_back( data[count] );
+				++count;
+			}
+		}
+	}
+	else
+	{
+		//CMPL Compression Algorithm by BlueAmulet
+		//std::vector<uint8_t> out;
+		std::vector<uint8_t> temp;
+		int16_t mainbuf[4096];
+		uint16_t bufPos = 4078;
+		size_t streamPos = 0;
+		uint8_t bits = 0;
+
+		for( size_t i = 0; i < std::size( mainbuf ); i++ )
+		{
+			if( i < bufPos )
+			{
+				mainbuf[i] = 0;
+			}
+			else
+			{
+				// Mark end of buffer as uninitialized
+				mainbuf[i] = -1;
+			}
+		}
+
+		size_t dataSize = data.size( );
+
+		while( streamPos < dataSize )
+		{
+			bits = 0;
+			for( size_t i = 0; i < 8; i++ )
+			{
+				if( streamPos >= dataSize )
+				{
+					break;
+				}
+				size_t bestPos = 0;
+				size_t bestLen = 0;
+				// Try to find match in buffer
+				// TODO: Properly support repeating data
+				for( size_t jo = 0; jo < std::size( mainbuf ); jo++ )
+				{
+					uint16_t j = ( bufPos - jo ) & 0xFFF;
+					if( mainbuf[j] == (int16_t)(uint16_t)data[streamPos] )
+					{
+						size_t matchLen = 0;
+						for( size_t k = 0; k < 18; k++ )
+						{
+							if( ( streamPos + k ) < dataSize && ( ( j + k ) & 0xFFF ) != bufPos && mainbuf[( j + k ) & 0xFFF] == (int16_t)(uint16_t)data[streamPos + k] )
+							{
+								matchLen = k + 1;
+							}
+							else
+							{
+								break;
+							}
+						}
+						if( matchLen > bestLen )
+						{
+							bestLen = matchLen;
+							bestPos = j;
+						}
+					}
+				}
+				// Repeating byte check
+				if( mainbuf[( bufPos - 1 ) & 0xFFF] == (int16_t)(uint16_t)data[streamPos] )
+				{
+					size_t matchLen = 0;
+					for( size_t k = 0; k < 18; k++ )
+					{
+						if( ( streamPos + k ) < dataSize && mainbuf[( bufPos - 1 ) & 0xFFF] == (int16_t)(uint16_t)data[streamPos + k] )
+						{
+							matchLen = k + 1;
+						}
+						else
+						{
+							break;
+						}
+					}
+					if( matchLen > bestLen ) {
+						bestLen = matchLen;
+						bestPos = ( bufPos - 1 ) & 0xFFF;
+					}
+				}
+				// Is copy viable?
+				if( bestLen >= 3 )
+				{
+					// Write copy data
+					uint16_t copyVal = bestLen - 3;
+					copyVal |= bestPos << 4;
+					temp.push_back( copyVal >> 8 );
+					temp.push_back( copyVal & 0xFF );
+					for( size_t j = 0; j < bestLen; j++ ) {
+						mainbuf[bufPos] = data[streamPos];
+						bufPos = ( bufPos + 1 ) & 0xFFF;
+						streamPos++;
+					}
+				}
+				else
+				{
+					// Copy from input
+					temp.push_back( data[streamPos] );
+					mainbuf[bufPos] = data[streamPos];
+					bufPos = ( bufPos + 1 ) & 0xFFF;
+					streamPos++;
+					bits |= 1 << i;
+				}
+			}
+			out.push_back( bits );
+			out.insert( out.end( ), temp.begin( ), temp.end( ) );
+			temp.clear( );
+		}
+	}
+
+	return out;
+}
+
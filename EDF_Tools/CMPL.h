@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+//CMPL Decompressor
+struct CMPLHandler
+{
+	CMPLHandler( std::vector< char > inFile, bool useFakeCompression = false );
+
+	std::vector< char > Decompress( );
+	std::vector< char > Compress( );
+
+	std::vector< char > data;
+
+	//Tool data
+	bool bUseFakeCompression;
+};
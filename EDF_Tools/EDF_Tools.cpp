@@ -4,9 +4,13 @@
 #include "stdafx.h"
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <locale>
 #include <codecvt>
 
@@ -38,14 +42,16 @@ void init_locale(void)
   constexpr char locale_name[] = "";
   setlocale( LC_ALL, locale_name );
   std::locale::global(std::locale(locale_name));
-  std::wcin.imbue(std::locale())
+  std::wcin.imbue(std::locale());
   std::wcout.imbue(std::locale());
 #endif
 }
 
 
 #include "util.h"
+#include "FileIO.h"
 #include "JSONAMLParser.h"
+#include "MissionCommands.h"
 #include "MissionScript.h" //TODO: Implement mission script class that stores and proccess data
 #include "RMPA.h" //TODO: Implement RMPA class that stores and proccess data
 #include "RAB.h" //RAB extractor
@@ -59,16 +65,28 @@ void init_locale(void)
 #include "CAS.h" //CAS parser
 #include "CANM.h" //CANM parser
 
+#include "Benchmark.h" //Compiler benchmark
+#include "VMState.h"
+#include "BVMRunner.h" //BVM profiler
+#include "Batch.h" //Parallel batch conversion
+#include "Server.h" //Conversion server
+#include "Watch.h" //Watch mode
+#include "Stats.h" //Stage timings
+#include "Log.h" //Console output
+
 // In 64-bit, it has errors and does not use it now.
 //#include "ModManager.h"
 
 #define FLAG_VERBOSE 1
 #define FLAG_CREATE_FOLDER 2
+//Part of a run over many files: nothing echoed, outputs named after their input
+#define FLAG_BATCH 4
 
 //Keep this here for now
 //#define TOOL_RABARCHIVER 1
 
-void ProcessFile( const std::wstring& path, int extraFlags )
+//Converts one file by its extension. False if the extension isn't known or the reader reported a failure.
+bool ProcessFile( const std::wstring& path, int extraFlags )
 {
     using namespace std;
 
@@ -93,34 +111,18 @@ void ProcessFile( const std::wstring& path, int extraFlags )
 
 			if( directory.size( ) == 0 )
 			{
-				wchar_t CurDirectory[512];
-				GetCurrentDirectoryW( 512, CurDirectory );
-
-				directory = CurDirectory;
+				directory = GetWorkingDirectory( );
 			}
-			size_t directorySize = directory.size( );
-			directory += L"\\*." + extension;
-
-			struct _wfinddata_t dirFile;
-			long hFile;
-			if( ( hFile = _wfindfirst( directory.c_str(), &dirFile ) ) != -1 )
-			{
-				do
-				{
-					if( !lstrcmpW( dirFile.name, L"." ) ) continue;
-					if( !lstrcmpW( dirFile.name, L".." ) ) continue;
 
-					//wcout << dirFile.name;
-					//wcout << L"\n";
+			//Batch mode, per-record progress would only slow things down
+			ProgressReporter::enabled = false;
 
-					directory = directory.substr( 0, directorySize );
-
-					ProcessFile( directory + L"\\" + dirFile.name, extraFlags | FLAG_CREATE_FOLDER );
-
-				} while( _wfindnext( hFile, &dirFile ) == 0 );
-				_findclose( hFile );
-			}
-			return;
+			BatchSummary summary = RunBatch( ListFiles( directory, extension, false ), [extraFlags]( const std::wstring& file )
+			{
+				return ProcessFile( file, extraFlags | FLAG_CREATE_FOLDER | FLAG_BATCH );
+			} );
+			PrintBatchSummary( summary );
+			return summary.failed == 0;
 		}
 
 		//Convert extension to lowercase for proccessing:
@@ -129,82 +131,79 @@ void ProcessFile( const std::wstring& path, int extraFlags )
 		if( extension == L"rmpa" )
 		{
             unique_ptr<CRMPA> rmpa = make_unique<CRMPA>();
-			rmpa->Read( strn );
+			return rmpa->Read( strn ) > 0;
 		}
 		else if( extension == L"txt" )
 		{
             unique_ptr<CMissionScript> script = make_unique<CMissionScript>();
-			script->Write( strn, extraFlags );
-			script.reset( );
+			return script->Write( strn, extraFlags );
 		}
 		else if( extension == L"bvm" )
 		{
             unique_ptr<CMissionScript> script = make_unique<CMissionScript>();
 			script->LoadLanguage( L"EDF5_2C_MissionCommands.jsonaml", 0 );
 			script->LoadLanguage( L"EDF5_2D_MissionCommands.jsonaml", 1 );
-			script->Read( strn );
-			script.reset( );
+
+			//Scripts in a batch each decompile to their own <name>.txt, so they can run side by side
+			if( extraFlags & FLAG_BATCH )
+			{
+				script->bEchoOutput = false;
+				return script->Read( strn, strn + L".txt" ) > 0;
+			}
+			return script->Read( strn ) > 0;
 		}
 		else if( extension == L"rab" )
 		{
 			std::unique_ptr< RAB > rabReader = std::make_unique< RAB >( );
-			rabReader->Read( strn, false );
-			rabReader.reset( );
+			return rabReader->Read( strn, false );
 		}
 		else if( extension == L"mrab" )
 		{
 			std::unique_ptr< RAB > rabReader = std::make_unique< RAB >( );
-			rabReader->Read( strn, true );
-			rabReader.reset( );
+			return rabReader->Read( strn, true );
 		}
 		else if (extension == L"mdb")
 		{
 			/*
 			wstring scstr;
-			wcout << L"Single Core? (0 is false, 1 is true) : ";
+			LogInfo( ) << L"Single Core? (0 is false, 1 is true) : ";
 			wcin >> scstr;
 			bool onecore = false;
 			if (stoi(scstr) == 1)
 			{
 				onecore = true;
-				wcout << L"\nWill now use a single core to read the file!";
+				LogInfo( ) << L"\nWill now use a single core to read the file!";
 			}
-			wcout << L"\n\n";
+			LogInfo( ) << L"\n\n";
 			*/
 
 			unique_ptr<CMDBtoXML> script = make_unique<CMDBtoXML>();
-			script->Read(strn, true);
-			script.reset();
+			return script->Read(strn, true) > 0;
 		}
 		else if (extension == L"sgo")
 		{
 			std::unique_ptr< SGO > sgoReader = std::make_unique< SGO >();
-			sgoReader->Read(strn);
-			sgoReader.reset();
+			return sgoReader->Read(strn);
 		}
 		else if (extension == L"mab")
 		{
 			std::unique_ptr< MAB > mabReader = std::make_unique< MAB >();
-			mabReader->Read(strn);
-			mabReader.reset();
+			return mabReader->Read(strn);
 		}
 		else if (extension == L"mtab")
 		{
 			std::unique_ptr< MTAB > mtabReader = std::make_unique< MTAB >();
-			mtabReader->Read(strn);
-			mtabReader.reset();
+			return mtabReader->Read(strn);
 		}
 		else if (extension == L"cas")
 		{
 			unique_ptr<CAS> casReader = make_unique<CAS>();
-			casReader->Read(strn);
-			casReader.reset();
+			return casReader->Read(strn);
 		}
 		else if (extension == L"canm")
 		{
 			unique_ptr<CANM> canmReader = make_unique<CANM>();
-			canmReader->Read(strn);
-			canmReader.reset();
+			return canmReader->Read(strn);
 		}
 		else if (extension == L"xml")
 		{
@@ -218,32 +217,34 @@ void ProcessFile( const std::wstring& path, int extraFlags )
 			{
 				// To MDB File, no need for multi-core.
 				unique_ptr< CXMLToMDB > script = make_unique< CXMLToMDB >();
-				script->Write(xmlStrn, false);
-				script.reset();
+				return script->Write(xmlStrn, false);
 			}
 			else if (xmlExtension == L"cas")
 			{
 				unique_ptr< CAS > script = make_unique< CAS >();
-				script->Write(xmlStrn);
-				script.reset();
+				return script->Write(xmlStrn);
 			}
 			else if (xmlExtension == L"canm")
 			{
 				unique_ptr< CANM > script = make_unique< CANM >();
-				script->Write(xmlStrn);
-				script.reset();
+				return script->Write(xmlStrn);
 			}
 			else if (xmlExtension == L"data")
 			{
 				//Data needs a function to judge the header.
-				CheckXMLHeader(xmlStrn);
+				return CheckXMLHeader(xmlStrn);
 			}
+			else
+				return false;
 		}
+		else
+			return false;
 	}
 	else
 	{
 		//Search for valid files:
 	}
+	return false;
 }
 
 //UNDONE: Expression parsing is not within project scope at this time
@@ -409,16 +410,79 @@ std::wstring TestProccess( std::wstring input )
 }
 #endif
 
+//JSON goes here when --stats=<file> was given, otherwise the table is printed
+static std::wstring s_statsPath;
+
+static void ReportStats( )
+{
+	if( s_statsPath.empty( ) )
+	{
+		Stats::PrintTable( );
+		return;
+	}
+
+	std::string json = Stats::ToJSON( );
+	std::ofstream statsFile( ToFilePath( s_statsPath ), std::ios::binary );
+	statsFile.write( json.data( ), json.size( ) );
+}
+
+#if defined( _WIN32 )
 int _tmain( int argc, wchar_t* argv[] )
+#else
+static int wmain( int argc, wchar_t* argv[] )
+#endif
 {
     using namespace std;
 
 	init_locale( );
 	wstring path;
+	//Exit code, 1 when the file given couldn't be converted
+	int result = 0;
+
+	//Registered first so it runs last, after anything the other exit handlers print
+	atexit( Log::Flush );
+
+	//--quiet leaves only warnings and errors, --verbose adds per record detail. Either can go anywhere on the line.
+	for( int i = 1; i < argc; )
+	{
+		if( !wcscmp( argv[i], L"--quiet" ) )
+			Log::level = LogLevel::Warning;
+		else if( !wcscmp( argv[i], L"--verbose" ) )
+			Log::level = LogLevel::Debug;
+		else
+		{
+			++i;
+			continue;
+		}
+
+		for( int j = i; j + 1 < argc; ++j )
+			argv[j] = argv[j + 1];
+		--argc;
+	}
+
+	//--stats anywhere on the line times every stage and reports at exit, --stats=<file> writes it as JSON
+	for( int i = 1; i < argc; )
+	{
+		if( wcsncmp( argv[i], L"--stats", 7 ) || ( argv[i][7] != 0 && argv[i][7] != L'=' ) )
+		{
+			++i;
+			continue;
+		}
+
+		Stats::enabled = true;
+		if( argv[i][7] == L'=' )
+			s_statsPath = argv[i] + 8;
+
+		for( int j = i; j + 1 < argc; ++j )
+			argv[j] = argv[j + 1];
+		--argc;
+	}
+	if( Stats::enabled )
+		atexit( ReportStats );
 
 	if( argc > 1 )
 	{
-		if( !lstrcmpW( argv[1], L"/ARCHIVE" ) && argc > 2 )
+		if( !wcscmp( argv[1], L"/ARCHIVE" ) && argc > 2 )
 		{
 			std::unique_ptr< RAB > rabReader = std::make_unique< RAB >( );
 
@@ -432,20 +496,20 @@ int _tmain( int argc, wchar_t* argv[] )
 
 			if( argc > 3)
 			{
-				if (!lstrcmpW(argv[2], L"-fc")) {
+				if (!wcscmp(argv[2], L"-fc")) {
 					rabReader->bUseFakeCompression = true;
 					fileArgNum++;
 				}
-				else if (!lstrcmpW(argv[2], L"-mt")) {
+				else if (!wcscmp(argv[2], L"-mt")) {
 					rabReader->bIsMultipleThreads = true;
 					fileArgNum++;
 				}
-				else if (!lstrcmpW(argv[2], L"-mc")) {
+				else if (!wcscmp(argv[2], L"-mc")) {
 					// Initialize thread information
 					rabReader->WriteInitMTInfo();
 					fileArgNum++;
 				}
-				else if (!lstrcmpW(argv[2], L"-cmtn")) {
+				else if (!wcscmp(argv[2], L"-cmtn")) {
 					rabReader->bIsMultipleThreads = true;
 					rabReader->bIsMultipleCores = true;
 					rabReader->customizeThreads = 4;
@@ -473,17 +537,336 @@ int _tmain( int argc, wchar_t* argv[] )
 				fileName += L".rab";
 			}
 
-			rabReader->Write( fileName );
+			bool written = rabReader->Write( fileName );
 			rabReader.reset( );
 
-			return 0;
+			return written ? 0 : 1;
+		}
+
+		if( !wcscmp( argv[1], L"/OPTIMIZE" ) && argc > 2 )
+		{
+			//Optimise CANM tracks while converting xml to CANM/CAS: [-tol value] [-collapse] <file>
+			CANM::bOptimizeTracks = true;
+
+			int fileArgNum = 2;
+			while( fileArgNum + 1 < argc )
+			{
+				if( !wcscmp( argv[fileArgNum], L"-tol" ) && fileArgNum + 2 < argc )
+				{
+					float tolerance = -1.0f;
+					try
+					{
+						tolerance = stof( argv[fileArgNum + 1] );
+					}
+					catch( const std::exception& )
+					{
+					}
+
+					//The negated test also turns NaN away
+					if( !( tolerance >= 0.0f ) )
+					{
+						LogError( ) << L"Bad tolerance " << argv[fileArgNum + 1] << L", expected a number of 0 or more\n";
+						return 1;
+					}
+					CANM::fTrackTolerance = tolerance;
+					fileArgNum += 2;
+				}
+				else if( !wcscmp( argv[fileArgNum], L"-collapse" ) )
+				{
+					//Folds constant tracks into their base value, the decode this relies on is unverified
+					CANM::bCollapseConstantTracks = true;
+					fileArgNum++;
+				}
+				else
+					break;
+			}
+
+			LogInfo( ) << L"Parsing file: " << argv[fileArgNum] << L'\n';
+			return ProcessFile( std::wstring( argv[fileArgNum] ), 1 ) ? 0 : 1;
 		}
 
-		wcout << L"Parsing file: " << argv[1] << L'\n';
+		if( !wcscmp( argv[1], L"/DECOMPILE" ) && argc > 2 )
+		{
+			//Decompile every .bvm under a folder, one thread per core unless -t is given
+			int threads = 0;
+			int fileArgNum = 2;
+			if( argc > 4 && !wcscmp( argv[2], L"-t" ) )
+			{
+				threads = stoi( argv[3] );
+				fileArgNum += 2;
+			}
+
+			ProgressReporter::enabled = false;
+
+			std::vector< std::wstring > files = ListFiles( argv[fileArgNum], L"bvm", true );
+			LogInfo( ) << L"Decompiling " << files.size( ) << L" files under " << argv[fileArgNum] << L'\n';
+
+			//The same as /BATCH -e bvm, each script goes to <name>.txt next to it
+			BatchSummary summary = RunBatch( files, []( const std::wstring& file ) { return ProcessFile( file, FLAG_CREATE_FOLDER | FLAG_BATCH ); }, threads );
+			PrintBatchSummary( summary );
 
-		ProcessFile( std::wstring( argv[1] ), 1 );
+			return summary.failed > 0 ? 1 : 0;
+		}
+
+		if( !wcscmp( argv[1], L"/BATCH" ) && argc > 2 )
+		{
+			//Converts every file under a folder on a pool of threads: [-t threads] [-e ext,ext] [-o summary.json] <folder>
+			int threads = 0;
+			std::wstring summaryPath = L"batch_summary.json";
+			std::vector< std::wstring > extensions = { L"sgo", L"mab", L"mtab", L"mdb", L"cas", L"canm", L"rmpa", L"bvm" };
+
+			int fileArgNum = 2;
+			while( fileArgNum + 2 < argc )
+			{
+				if( !wcscmp( argv[fileArgNum], L"-t" ) )
+					threads = stoi( argv[fileArgNum + 1] );
+				else if( !wcscmp( argv[fileArgNum], L"-o" ) )
+					summaryPath = argv[fileArgNum + 1];
+				else if( !wcscmp( argv[fileArgNum], L"-e" ) )
+				{
+					extensions.clear( );
+					wstring list = argv[fileArgNum + 1];
+					while( list.size( ) )
+					{
+						wstring extension = SimpleTokenise( list, L',' );
+						if( extension.size( ) )
+							extensions.push_back( extension );
+					}
+				}
+				else
+					break;
+				fileArgNum += 2;
+			}
+
+			ProgressReporter::enabled = false;
+
+			std::vector< std::wstring > files = FindBatchInputs( argv[fileArgNum], extensions, true );
+			LogInfo( ) << L"Converting " << files.size( ) << L" files under " << argv[fileArgNum] << L'\n';
+
+			BatchSummary summary = RunBatch( files, []( const std::wstring& file ) { return ProcessFile( file, FLAG_CREATE_FOLDER | FLAG_BATCH ); }, threads );
+			PrintBatchSummary( summary );
+
+			std::string json = BatchSummaryToJSON( summary );
+			std::ofstream summaryFile( ToFilePath( summaryPath ), std::ios::binary );
+			summaryFile.write( json.data( ), json.size( ) );
+			LogInfo( ) << L"Summary written to " << summaryPath << L'\n';
+
+			return summary.failed > 0 ? 1 : 0;
+		}
+
+		if( !wcscmp( argv[1], L"/SERVE" ) )
+		{
+			//Stays running and converts what /SEND hands it, with everything already loaded: [-t threads] [-n name]
+			int threads = 0;
+			std::wstring name = SERVER_DEFAULT_NAME;
+
+			for( int i = 2; i + 1 < argc; i += 2 )
+			{
+				if( !wcscmp( argv[i], L"-t" ) )
+					threads = stoi( argv[i + 1] );
+				else if( !wcscmp( argv[i], L"-n" ) )
+					name = argv[i + 1];
+			}
+
+			ProgressReporter::enabled = false;
+
+			//Parse the command tables now rather than on the first script sent
+			CMissionCommandTable::Load( L"EDF5_2C_MissionCommands.jsonaml" );
+			CMissionCommandTable::Load( L"EDF5_2D_MissionCommands.jsonaml" );
+
+			return RunConversionServer( name, []( const std::wstring& file ) { return ProcessFile( file, FLAG_CREATE_FOLDER | FLAG_BATCH ); }, threads );
+		}
+
+		if( !wcscmp( argv[1], L"/SEND" ) && argc > 2 )
+		{
+			//Converts files on a running /SERVE: [-n name] <file> [file...], or [-n name] -stop to shut it down
+			std::wstring name = SERVER_DEFAULT_NAME;
+
+			int fileArgNum = 2;
+			if( fileArgNum + 1 < argc && !wcscmp( argv[fileArgNum], L"-n" ) )
+			{
+				name = argv[fileArgNum + 1];
+				fileArgNum += 2;
+			}
+
+			if( fileArgNum < argc && !wcscmp( argv[fileArgNum], L"-stop" ) )
+			{
+				if( StopConversionServer( name ) )
+					return 0;
+				LogError( ) << L"No server answered as " << name << L"\n";
+				return 1;
+			}
+
+			std::vector< std::wstring > files( argv + fileArgNum, argv + argc );
+			return SendConversionRequests( name, files ) != 0 ? 1 : 0;
+		}
+
+		if( !wcscmp( argv[1], L"/WATCH" ) && argc > 2 )
+		{
+			//Rebuilds sources under a folder as they are saved: [-t threads] [-d debounce ms] [-rab] <folder>
+			//With -rab the archive a rebuilt file is in, <archive>\<folder>\<file>, is re-packed when <archive>.rab or .mrab exists
+			int threads = 0;
+			int debounceMs = WATCH_DEFAULT_DEBOUNCE_MS;
+			bool repack = false;
+
+			int fileArgNum = 2;
+			while( fileArgNum + 1 < argc )
+			{
+				if( !wcscmp( argv[fileArgNum], L"-t" ) && fileArgNum + 2 < argc )
+				{
+					threads = stoi( argv[fileArgNum + 1] );
+					fileArgNum += 2;
+				}
+				else if( !wcscmp( argv[fileArgNum], L"-d" ) && fileArgNum + 2 < argc )
+				{
+					debounceMs = stoi( argv[fileArgNum + 1] );
+					fileArgNum += 2;
+				}
+				else if( !wcscmp( argv[fileArgNum], L"-rab" ) )
+				{
+					repack = true;
+					fileArgNum++;
+				}
+				else
+					break;
+			}
+
+			ProgressReporter::enabled = false;
+
+			//Parse the command tables now rather than on the first script saved
+			CMissionCommandTable::Load( L"EDF5_2C_MissionCommands.jsonaml" );
+			CMissionCommandTable::Load( L"EDF5_2D_MissionCommands.jsonaml" );
+
+			//Each archive keeps what it compressed last time, so a re-pack only compresses the files that changed
+			std::map< std::wstring, RABCompressCache > archiveCaches;
+			WatchRebuilt rebuilt = [&]( const std::vector< std::wstring >& sources )
+			{
+				if( !repack )
+					return;
+
+				std::vector< std::wstring > archives;
+				for( const std::wstring& source : sources )
+				{
+					size_t folderEnd = source.find_last_of( L"\\/" );
+					size_t archiveEnd = ( folderEnd == wstring::npos || folderEnd == 0 ) ? wstring::npos : source.find_last_of( L"\\/", folderEnd - 1 );
+					if( archiveEnd == wstring::npos )
+						continue;
+
+					wstring archive = source.substr( 0, archiveEnd );
+					if( std::find( archives.begin( ), archives.end( ), archive ) == archives.end( ) )
+						archives.push_back( archive );
+				}
+
+				for( const std::wstring& archive : archives )
+				{
+					//A folder that was never packed isn't an archive
+					std::error_code error;
+					wstring rabName = archive + L".rab";
+					if( !std::filesystem::is_regular_file( ToFilePath( rabName ), error ) )
+					{
+						rabName = archive + L".mrab";
+						if( !std::filesystem::is_regular_file( ToFilePath( rabName ), error ) )
+							continue;
+					}
+
+					std::unique_ptr< RAB > rabWriter = std::make_unique< RAB >( );
+					rabWriter->bUseFakeCompression = false;
+					rabWriter->bIsMultipleThreads = false;
+					rabWriter->bIsMultipleCores = false;
+					rabWriter->customizeThreads = 0;
+					rabWriter->mdbFileNum = 0;
+					rabWriter->compressCache = &archiveCaches[archive];
+
+					rabWriter->CreateFromDirectory( archive );
+					if( rabWriter->Write( rabName ) )
+						LogInfo( ) << L"Re-packed " << rabName << L'\n';
+					rabWriter.reset( );
+				}
+			};
+
+			return RunWatch( argv[fileArgNum], []( const std::wstring& file ) { return ProcessFile( file, FLAG_BATCH ); }, rebuilt, threads, debounceMs );
+		}
+
+		if( !wcscmp( argv[1], L"/BENCHCOMPILE" ) )
+		{
+			//Times the mission compiler on a generated script: [functions] [statements per function] [runs]
+			int functions = argc > 2 ? stoi( argv[2] ) : 200;
+			int statements = argc > 3 ? stoi( argv[3] ) : 300;
+			int runs = argc > 4 ? stoi( argv[4] ) : 3;
+
+			return RunCompileBenchmark( functions, statements, runs );
+		}
+
+		if( !wcscmp( argv[1], L"/BENCHVM" ) )
+		{
+			//Times the BVM interpreter on a generated loop: [iterations] [runs]
+			int iterations = argc > 2 ? stoi( argv[2] ) : 10000000;
+			int runs = argc > 3 ? stoi( argv[3] ) : 3;
+
+			return RunVMBenchmark( iterations, runs );
+		}
+
+		if( !wcscmp( argv[1], L"/BENCHBYTES" ) )
+		{
+			//Times ByteReader / ByteWriter against the old byte helpers: [values] [runs]
+			int values = argc > 2 ? stoi( argv[2] ) : 4000000;
+			int runs = argc > 3 ? stoi( argv[3] ) : 5;
+
+			return RunByteBenchmark( values, runs );
+		}
+
+		if( !wcscmp( argv[1], L"/BENCHUTF" ) )
+		{
+			//Times the UTF-8 / wide conversions against std::wstring_convert: [names] [runs]
+			int names = argc > 2 ? stoi( argv[2] ) : 1000000;
+			int runs = argc > 3 ? stoi( argv[3] ) : 5;
+
+			return RunUnicodeBenchmark( names, runs );
+		}
+
+		if( !wcscmp( argv[1], L"/BENCHFORMATS" ) )
+		{
+			//Times read, write and round trip of every format on generated files: [scale] [runs] [history file]
+			int scale = argc > 2 ? stoi( argv[2] ) : 1;
+			int runs = argc > 3 ? stoi( argv[3] ) : 3;
+			std::wstring history = argc > 4 ? argv[4] : L"benchmark_history.json";
+
+			return RunFormatBenchmark( scale, runs, history );
+		}
+
+		if( !wcscmp( argv[1], L"/PROFILEBVM" ) && argc > 2 )
+		{
+			//Runs a .bvm outside the game and writes counts, coverage and folded stacks: <file> [function] [instruction limit]
+			std::wstring function = argc > 3 ? argv[3] : L"";
+			uint64_t limit = argc > 4 ? stoull( argv[4] ) : 10000000;
+
+			return RunBVMProfile( argv[2], function, limit );
+		}
+
+		if( !wcscmp( argv[1], L"/SIMBVM" ) && argc > 2 )
+		{
+			//Runs a .bvm with host calls answered by stubs and writes them to <file>.calls.txt: <file> [stubs file] [function] [instruction limit]
+			std::wstring stubs = argc > 3 ? argv[3] : L"";
+			std::wstring function = argc > 4 ? argv[4] : L"";
+			uint64_t limit = argc > 5 ? stoull( argv[5] ) : 10000000;
+
+			return RunBVMSimulation( argv[2], stubs, function, limit );
+		}
+
+		LogInfo( ) << L"Parsing file: " << argv[1] << L'\n';
+
+		try
+		{
+			if( !ProcessFile( std::wstring( argv[1] ), 1 ) )
+				result = 1;
+		}
+		catch( const std::exception& e )
+		{
+			LogError( ) << L"Failed: " << e.what( ) << L'\n';
+			result = 1;
+		}
 		/*
-		std::wcout << L"Compile (0) or decompile (1)?: ";
+		LogInfo( ) << L"Compile (0) or decompile (1)?: ";
 		std::wcin >> path;
 
 		if( stoi( path ) == 0 )
@@ -508,13 +891,13 @@ int _tmain( int argc, wchar_t* argv[] )
 			CMissionScript *script = new CMissionScript( );
 			script->Read( strn );
 			delete script;
-			std::wcout << "\n";
+			LogInfo( ) << "\n";
 		}
 		*/
 	}
 	else
 	{
-		//wcout << TestProccess( L"2+4-(10-2*(10-5)+5)+(5-2/5)" );
+		//LogInfo( ) << TestProccess( L"2+4-(10-2*(10-5)+5)+(5-2/5)" );
 		//system( "pause" );
 		//return 0;
 
@@ -527,7 +910,7 @@ int _tmain( int argc, wchar_t* argv[] )
 		//ui->GenerateUI( );
 
 		//CJSONAMLParser *parser = new CJSONAMLParser( L"EDF5MissionCommands.jsonaml" );
-		//wcout << parser->SearchTest( );
+		//LogInfo( ) << parser->SearchTest( );
 		//delete parser;
 
 		//return 0;
@@ -545,13 +928,15 @@ int _tmain( int argc, wchar_t* argv[] )
 
 		//return 0;
 
-		wcout << L"Filename:";
+		LogInfo( ) << L"Filename:";
+		Log::Flush( );
 		wcin >> path;
-		wcout << L"\n";
+		LogInfo( ) << L"\n";
 
-		wcout << L"Parsing file...\n";
+		LogInfo( ) << L"Parsing file...\n";
 
-		ProcessFile( path, 1 );
+		if( !ProcessFile( path, 1 ) )
+			result = 1;
 
 		
 		//TEMP CMPL TEST:
@@ -581,10 +966,32 @@ int _tmain( int argc, wchar_t* argv[] )
 		file.close( );
 		*/
 
-		wcout << "\n";
+		LogInfo( ) << "\n";
 	}
-	system( "pause" );
+
+	//Only wait when someone is there to press a key, scripts and pipes carry on
+	Log::Flush( );
+#if defined( _WIN32 )
+	if( _isatty( _fileno( stdin ) ) )
+		system( "pause" );
+#endif
 	
-	return 0;
+	return result;
+}
+
+#if !defined( _WIN32 )
+//Arguments arrive as UTF-8 here, they're widened once so everything past this point matches Windows
+int main( int argc, char* argv[] )
+{
+	std::vector< std::wstring > arguments( argc );
+	std::vector< wchar_t* > argumentPointers( argc + 1, nullptr );
+	for( int i = 0; i < argc; i++ )
+	{
+		arguments[i] = UTF8ToWide( argv[i] );
+		argumentPointers[i] = &arguments[i][0];
+	}
+
+	return wmain( argc, argumentPointers.data( ) );
 }
+#endif
 
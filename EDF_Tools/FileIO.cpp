@@ -0,0 +1,230 @@
+#include "stdafx.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <cwctype>
+#include <fstream>
+#include "util.h"
+#include "FileIO.h"
+
+#if defined( _WIN32 )
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+fs::path ToFilePath( const std::wstring& path )
+{
+#if defined( _WIN32 )
+	return fs::path( path );
+#else
+	//Paths in the game's files and most scripts use Windows separators
+	std::wstring native = path;
+	std::replace( native.begin( ), native.end( ), L'\\', L'/' );
+	return fs::path( WideToUTF8( native ) );
+#endif
+}
+
+static std::wstring FromPath( const fs::path& path )
+{
+#if defined( _WIN32 )
+	return path.wstring( );
+#else
+	return UTF8ToWide( path.string( ) );
+#endif
+}
+
+bool MappedFile::Open( const std::wstring& path )
+{
+	Close( );
+
+#if defined( _WIN32 )
+	HANDLE file = CreateFileW( path.c_str( ), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx( file, &size ) )
+	{
+		CloseHandle( file );
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+
+	if( m_size > 0 )
+	{
+		//The view keeps the mapping and file open, both handles can go
+		HANDLE mapping = CreateFileMappingW( file, NULL, PAGE_READONLY, 0, 0, NULL );
+		if( mapping )
+		{
+			m_data = (const char*)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+			CloseHandle( mapping );
+		}
+	}
+	CloseHandle( file );
+#else
+	int file = open( ToFilePath( path ).c_str( ), O_RDONLY );
+	if( file < 0 )
+		return false;
+
+	struct stat info;
+	if( fstat( file, &info ) != 0 || !S_ISREG( info.st_mode ) )
+	{
+		close( file );
+		return false;
+	}
+	m_size = (size_t)info.st_size;
+
+	if( m_size > 0 )
+	{
+		void *view = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0 );
+		if( view != MAP_FAILED )
+			m_data = (const char*)view;
+	}
+	close( file );
+#endif
+
+	if( m_data )
+	{
+		m_mapped = true;
+	}
+	else if( m_size > 0 )
+	{
+		//Couldn't map it, read it the old way
+		std::ifstream file( ToFilePath( path ), std::ios::binary | std::ios::in );
+		m_copy.resize( m_size );
+		if( !file.read( m_copy.data( ), m_size ) )
+		{
+			m_copy.clear( );
+			m_size = 0;
+			return false;
+		}
+		m_data = m_copy.data( );
+	}
+
+	m_open = true;
+	return true;
+}
+
+void MappedFile::Close( )
+{
+	if( m_mapped )
+	{
+#if defined( _WIN32 )
+		UnmapViewOfFile( m_data );
+#else
+		munmap( (void*)m_data, m_size );
+#endif
+	}
+
+	m_copy.clear( );
+	m_copy.shrink_to_fit( );
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+	m_mapped = false;
+}
+
+//Compares like the Windows directory listing, upper cased
+static bool PathLess( const std::wstring& a, const std::wstring& b )
+{
+	return std::lexicographical_compare( a.begin( ), a.end( ), b.begin( ), b.end( ), []( wchar_t x, wchar_t y )
+	{
+		return std::towupper( x ) < std::towupper( y );
+	} );
+}
+
+static bool HasExtension( const fs::path& path, const std::wstring& extension )
+{
+	if( extension.empty( ) )
+		return true;
+
+	//path::extension keeps the dot
+	std::wstring ext = FromPath( path.extension( ) );
+	return ext.size( ) > 1 && ConvertToLower( ext.substr( 1 ) ) == ConvertToLower( extension );
+}
+
+std::vector< std::wstring > ListFiles( const std::wstring& directory, const std::wstring& extension, bool recursive )
+{
+	std::vector< std::wstring > files;
+	std::error_code error;
+
+	//Unreadable folders are skipped rather than ending the listing
+	if( recursive )
+	{
+		fs::recursive_directory_iterator it( ToFilePath( directory ), fs::directory_options::skip_permission_denied, error ), end;
+		for( ; !error && it != end; it.increment( error ) )
+		{
+			if( it->is_regular_file( error ) && HasExtension( it->path( ), extension ) )
+				files.push_back( FromPath( it->path( ) ) );
+		}
+	}
+	else
+	{
+		fs::directory_iterator it( ToFilePath( directory ), fs::directory_options::skip_permission_denied, error ), end;
+		for( ; !error && it != end; it.increment( error ) )
+		{
+			if( it->is_regular_file( error ) && HasExtension( it->path( ), extension ) )
+				files.push_back( FromPath( it->path( ) ) );
+		}
+	}
+
+	std::sort( files.begin( ), files.end( ), PathLess );
+	return files;
+}
+
+std::vector< std::wstring > ListDirectories( const std::wstring& directory )
+{
+	std::vector< std::wstring > folders;
+	std::error_code error;
+
+	fs::directory_iterator it( ToFilePath( directory ), fs::directory_options::skip_permission_denied, error ), end;
+	for( ; !error && it != end; it.increment( error ) )
+	{
+		if( it->is_directory( error ) )
+			folders.push_back( FromPath( it->path( ) ) );
+	}
+
+	std::sort( folders.begin( ), folders.end( ), PathLess );
+	return folders;
+}
+
+bool IsDirectory( const std::wstring& path )
+{
+	std::error_code error;
+	return fs::is_directory( ToFilePath( path ), error );
+}
+
+uint64_t GetFileLength( const std::wstring& path )
+{
+	std::error_code error;
+	uintmax_t size = fs::file_size( ToFilePath( path ), error );
+	return error ? 0 : (uint64_t)size;
+}
+
+int64_t GetFileWriteTime( const std::wstring& path )
+{
+	std::error_code error;
+	fs::file_time_type time = fs::last_write_time( ToFilePath( path ), error );
+	return error ? 0 : (int64_t)time.time_since_epoch( ).count( );
+}
+
+std::wstring GetFileName( const std::wstring& path )
+{
+	size_t slash = path.find_last_of( L"\\/" );
+	return slash == std::wstring::npos ? path : path.substr( slash + 1 );
+}
+
+std::wstring GetWorkingDirectory( )
+{
+	std::error_code error;
+	return FromPath( fs::current_path( error ) );
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include "ByteStream.h"
+
+//A whole file mapped read only, pages are read in as the parsers touch them instead of copied up front.
+//Empty files, and anything the system won't map, are read into memory instead.
+class MappedFile
+{
+public:
+	MappedFile( ) : m_data( nullptr ), m_size( 0 ), m_open( false ), m_mapped( false ){};
+	~MappedFile( ) { Close( ); }
+
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+
+	//False if the file can't be opened or read
+	bool Open( const std::wstring& path );
+	void Close( );
+
+	bool IsOpen( ) const { return m_open; }
+	size_t Size( ) const { return m_size; }
+	//Valid until Close or destruction
+	ByteSpan Span( ) const { return ByteSpan( m_data, m_size ); }
+
+private:
+	const char *m_data;
+	size_t m_size;
+	bool m_open;
+	bool m_mapped;
+	std::vector< char > m_copy;
+};
+
+//Wide paths are UTF-16 on Windows, elsewhere the system takes UTF-8 and backslashes become slashes.
+//Streams opened through this work everywhere, the std::wstring constructors are an MSVC extension.
+std::filesystem::path ToFilePath( const std::wstring& path );
+
+//Files in a folder with the extension (no dot, any case, "" for every file), subfolders too when recursive.
+//Sorted by name ignoring case like the Windows directory listing, so runs on any system see the same order.
+std::vector< std::wstring > ListFiles( const std::wstring& directory, const std::wstring& extension, bool recursive );
+//Folders directly inside a folder, sorted the same way
+std::vector< std::wstring > ListDirectories( const std::wstring& directory );
+
+//True if the path exists and is a folder
+bool IsDirectory( const std::wstring& path );
+//Size in bytes, 0 if the file can't be read
+uint64_t GetFileLength( const std::wstring& path );
+//Last write time in the file system's own ticks, only good for comparing on the same system. 0 if the file can't be read.
+int64_t GetFileWriteTime( const std::wstring& path );
+//Last part of a path, after the final slash
+std::wstring GetFileName( const std::wstring& path );
+//Folder the tool was started in
+std::wstring GetWorkingDirectory( );
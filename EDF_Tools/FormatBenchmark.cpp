@@ -0,0 +1,1197 @@
+#include "stdafx.h"
+
+#include <iostream>
+#include <fstream>
+#if defined( _WIN32 )
+#include <Windows.h>
+#endif
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <system_error>
+#include "include/tinyxml2.h"
+#include "util.h"
+#include "Log.h"
+#include "FileIO.h"
+#include "SGO.h"
+#include "MAB.h"
+#include "MTAB.h"
+#include "CANM.h"
+#include "CAS.h"
+#include "MDB.h"
+#include "CMPL.h"
+#include "MissionCommands.h"
+#include "MissionScript.h"
+#include "RAB.h"
+#include "Benchmark.h"
+
+//Every corpus is written to the working folder under this prefix, and left there
+#define BENCH_FORMAT_PREFIX L"bench_"
+//Embedded MAB in the SGO corpus, fixed so each keeps its seed at any scale
+#define BENCH_SGO_MABS 4
+
+//Best times of one format over the runs
+struct FormatBenchResult
+{
+	const char *format;
+	uint64_t bytes; //Size of the binary
+	double writeMs;
+	double readMs;
+	double roundTripMs;
+	bool ok; //The binary read back and written again matched
+};
+
+//The three passes of one format. Write returns the size of the binary it made, round trip whether it matched.
+struct FormatBench
+{
+	const char *format;
+	std::function< uint64_t( ) > write;
+	std::function< void( ) > read;
+	std::function< bool( ) > roundTrip;
+};
+
+//Multiples of 1/16 up to 64, exact as floats, halfs and XML text
+static float BenchFloat( BenchRandom& rng )
+{
+	return ( rng.Next( 2048 ) - 1024 ) / 16.0f;
+}
+
+static std::string BenchName( const char *prefix, int i )
+{
+	return prefix + std::to_string( i );
+}
+
+//Names like the ones in the game files, some of them Japanese
+static std::string BenchLabel( BenchRandom& rng )
+{
+	static const char *prefixes[] = { "bone_", "Bip01_", "\xE6\xAD\xA6\xE5\x99\xA8_", "joint", "\xE8\x85\x95" };
+	return prefixes[rng.Next( 5 )] + std::to_string( rng.Next( 200 ) );
+}
+
+static tinyxml2::XMLElement *NewDocument( tinyxml2::XMLDocument& doc, const char *root )
+{
+	doc.Clear( );
+	doc.InsertFirstChild( doc.NewDeclaration( ) );
+	tinyxml2::XMLElement *header = doc.NewElement( root );
+	doc.InsertEndChild( header );
+	return header;
+}
+
+//SGO leaves the MAB corpus points its extras at
+static void GenerateLeafSGO( tinyxml2::XMLElement *subdata, BenchRandom& rng )
+{
+	int nodes = 2 + rng.Next( 5 );
+	for( int i = 0; i < nodes; i++ )
+	{
+		tinyxml2::XMLElement *node;
+		switch( rng.Next( 3 ) )
+		{
+		case 0:
+			node = subdata->InsertNewChildElement( "int" );
+			node->SetText( rng.Next( 10000 ) );
+			break;
+		case 1:
+			node = subdata->InsertNewChildElement( "float" );
+			node->SetText( BenchFloat( rng ) );
+			break;
+		default:
+			node = subdata->InsertNewChildElement( "string" );
+			node->SetText( BenchLabel( rng ).c_str( ) );
+			break;
+		}
+		node->SetAttribute( "name", BenchName( "leaf", i ).c_str( ) );
+	}
+}
+
+static void AddFloatGroup( tinyxml2::XMLElement *ptr, BenchRandom& rng, const char *name )
+{
+	tinyxml2::XMLElement *group = ptr->InsertNewChildElement( "floatgroup" );
+	group->SetAttribute( "name", name );
+	//Few distinct values, so groups are shared like in the game files
+	for( int i = 0; i < 4; i++ )
+		group->InsertNewChildElement( "value" )->SetText( ( rng.Next( 8 ) - 4 ) * 0.5f );
+}
+
+//MAB under main, its SGO extras are Subdata of header named prefix0, prefix1... in the order they are first used,
+//which is the order the reader brings them back in
+static void GenerateMAB( tinyxml2::XMLElement *main, tinyxml2::XMLElement *header, BenchRandom& rng, int bones, int animations, const std::string& prefix )
+{
+	int leaves = 1 + bones / 8;
+	std::vector< int > leafOrder;
+	auto useLeaf = [&]( )
+	{
+		int leaf = rng.Next( leaves );
+		if( std::find( leafOrder.begin( ), leafOrder.end( ), leaf ) == leafOrder.end( ) )
+			leafOrder.push_back( leaf );
+		return prefix + std::to_string( leaf );
+	};
+
+	tinyxml2::XMLElement *xmlBone = main->InsertNewChildElement( "Bone" );
+	for( int i = 0; i < bones; i++ )
+	{
+		tinyxml2::XMLElement *value = xmlBone->InsertNewChildElement( "value" );
+		value->SetAttribute( "ID", i );
+
+		int ptrs = 1 + rng.Next( 3 );
+		for( int j = 0; j < ptrs; j++ )
+		{
+			tinyxml2::XMLElement *ptr = value->InsertNewChildElement( "ptr" );
+			int type = rng.Next( 5 );
+			ptr->SetAttribute( "ExportBone", BenchLabel( rng ).c_str( ) );
+			ptr->SetAttribute( "Parent", BenchLabel( rng ).c_str( ) );
+			ptr->SetAttribute( "Type", type );
+
+			switch( type )
+			{
+			case 0:
+				AddFloatGroup( ptr, rng, "location" );
+				ptr->InsertNewChildElement( "float" )->SetText( BenchFloat( rng ) );
+				ptr->InsertNewChildElement( "int" )->SetText( rng.Next( 100 ) );
+				break;
+			case 1:
+				AddFloatGroup( ptr, rng, "location" );
+				AddFloatGroup( ptr, rng, "scale" );
+				ptr->InsertNewChildElement( "int" )->SetText( rng.Next( 100 ) );
+				break;
+			case 2:
+				AddFloatGroup( ptr, rng, "location" );
+				AddFloatGroup( ptr, rng, "scale" );
+				AddFloatGroup( ptr, rng, "rotation" );
+				break;
+			default:
+				AddFloatGroup( ptr, rng, "location" );
+				ptr->InsertNewChildElement( "float" )->SetText( BenchFloat( rng ) );
+				AddFloatGroup( ptr, rng, "c" );
+				break;
+			}
+
+			ptr->SetAttribute( "unknown", 0 );
+			ptr->SetAttribute( "extra", useLeaf( ).c_str( ) );
+		}
+	}
+
+	tinyxml2::XMLElement *xmlAnime = main->InsertNewChildElement( "Anime" );
+	for( int i = 0; i < animations; i++ )
+	{
+		tinyxml2::XMLElement *value = xmlAnime->InsertNewChildElement( "value" );
+		value->InsertNewChildElement( "name" )->SetText( BenchName( "anime", i ).c_str( ) );
+
+		tinyxml2::XMLElement *ptrA = value->InsertNewChildElement( "ptrA" );
+		int entries = rng.Next( 4 );
+		for( int j = 0; j < entries; j++ )
+		{
+			tinyxml2::XMLElement *entry = ptrA->InsertNewChildElement( "value" );
+			entry->SetAttribute( "name", BenchLabel( rng ).c_str( ) );
+			entry->SetAttribute( "float", BenchFloat( rng ) );
+			entry->SetAttribute( "unk", rng.Next( 4 ) );
+			entry->SetAttribute( "extra", useLeaf( ).c_str( ) );
+		}
+		value->InsertNewChildElement( "ptrB" );
+	}
+
+	for( int leaf : leafOrder )
+	{
+		tinyxml2::XMLElement *subdata = header->InsertNewChildElement( "Subdata" );
+		subdata->SetAttribute( "name", ( prefix + std::to_string( leaf ) ).c_str( ) );
+		subdata->SetAttribute( "header", "SGO" );
+		BenchRandom leafRng( 1000 + leaf );
+		GenerateLeafSGO( subdata, leafRng );
+	}
+}
+
+static void GenerateSGONode( tinyxml2::XMLElement *parent, BenchRandom& rng, int depth, std::vector< int >& mabOrder )
+{
+	int type = rng.Next( depth < 5 ? 12 : 9 );
+	if( type < 3 )
+	{
+		parent->InsertNewChildElement( "int" )->SetText( rng.Next( 100000 ) - 50000 );
+	}
+	else if( type < 6 )
+	{
+		parent->InsertNewChildElement( "float" )->SetText( BenchFloat( rng ) );
+	}
+	else if( type < 8 )
+	{
+		parent->InsertNewChildElement( "string" )->SetText( BenchLabel( rng ).c_str( ) );
+	}
+	else if( type < 9 )
+	{
+		int mab = rng.Next( BENCH_SGO_MABS );
+		if( std::find( mabOrder.begin( ), mabOrder.end( ), mab ) == mabOrder.end( ) )
+			mabOrder.push_back( mab );
+		parent->InsertNewChildElement( "extra" )->SetText( BenchName( "mab", mab ).c_str( ) );
+	}
+	else
+	{
+		tinyxml2::XMLElement *ptr = parent->InsertNewChildElement( "ptr" );
+		int children = 2 + rng.Next( 4 );
+		for( int i = 0; i < children; i++ )
+			GenerateSGONode( ptr, rng, depth + 1, mabOrder );
+	}
+}
+
+//Deep ptr trees with MAB embedded as extras
+static void GenerateSGOCorpus( tinyxml2::XMLDocument& doc, int scale )
+{
+	BenchRandom rng( 1 );
+	tinyxml2::XMLElement *header = NewDocument( doc, "EDFDATA" );
+	tinyxml2::XMLElement *main = header->InsertNewChildElement( "Main" );
+	main->SetAttribute( "header", "SGO" );
+
+	std::vector< int > mabOrder;
+	int nodes = 200 * scale;
+	for( int i = 0; i < nodes; i++ )
+	{
+		GenerateSGONode( main, rng, 0, mabOrder );
+		main->LastChildElement( )->SetAttribute( "name", BenchName( "node", i ).c_str( ) );
+	}
+
+	for( int mab : mabOrder )
+	{
+		tinyxml2::XMLElement *subdata = header->InsertNewChildElement( "Subdata" );
+		subdata->SetAttribute( "name", BenchName( "mab", mab ).c_str( ) );
+		subdata->SetAttribute( "header", "MAB" );
+		BenchRandom mabRng( 100 + mab );
+		GenerateMAB( subdata, header, mabRng, 16 + mab * 8, 8, BenchName( "mab", mab ) + "_leaf" );
+	}
+}
+
+static void GenerateMABCorpus( tinyxml2::XMLDocument& doc, int scale )
+{
+	BenchRandom rng( 2 );
+	tinyxml2::XMLElement *header = NewDocument( doc, "EDFDATA" );
+	tinyxml2::XMLElement *main = header->InsertNewChildElement( "Main" );
+	main->SetAttribute( "header", "MAB" );
+
+	GenerateMAB( main, header, rng, 120 * scale, 40 * scale, "leaf" );
+}
+
+static void GenerateMTABCorpus( tinyxml2::XMLDocument& doc, int scale )
+{
+	BenchRandom rng( 3 );
+	tinyxml2::XMLElement *header = NewDocument( doc, "EDFDATA" );
+	tinyxml2::XMLElement *main = header->InsertNewChildElement( "Main" );
+	main->SetAttribute( "header", "MTAB" );
+	main->SetAttribute( "int1", 1 );
+	main->SetAttribute( "time", 30.0f );
+
+	int materials = 60 * scale;
+	for( int i = 0; i < materials; i++ )
+	{
+		tinyxml2::XMLElement *material = main->InsertNewChildElement( "material" );
+		material->SetAttribute( "name", BenchLabel( rng ).c_str( ) );
+
+		//The writer finds each parameter's nodes by where they start, so none are empty
+		int parameters = 1 + rng.Next( 4 );
+		for( int j = 0; j < parameters; j++ )
+		{
+			tinyxml2::XMLElement *parameter = material->InsertNewChildElement( "parameter" );
+			parameter->SetAttribute( "name", BenchName( "param", rng.Next( 12 ) ).c_str( ) );
+
+			int nodes = 1 + rng.Next( 3 );
+			for( int k = 0; k < nodes; k++ )
+			{
+				tinyxml2::XMLElement *node = parameter->InsertNewChildElement( "node" );
+				node->SetAttribute( "int1", rng.Next( 4 ) );
+				node->SetAttribute( "parameter", rng.Next( 4 ) );
+
+				int ptrs = 1 + rng.Next( 3 );
+				for( int p = 0; p < ptrs; p++ )
+				{
+					tinyxml2::XMLElement *ptr = node->InsertNewChildElement( "ptr" );
+					for( int f = 0; f < 4; f++ )
+					{
+						tinyxml2::XMLElement *key = ptr->InsertNewChildElement( "float" );
+						key->SetAttribute( "timing", (float)( f * 8 ) );
+						key->SetAttribute( "x", BenchFloat( rng ) );
+						key->SetAttribute( "y", BenchFloat( rng ) );
+						key->SetAttribute( "z", BenchFloat( rng ) );
+					}
+				}
+			}
+		}
+	}
+}
+
+//Bone list and animations shared by CANM and CAS, with long keyframe tracks
+static void GenerateCANMData( tinyxml2::XMLElement *header, BenchRandom& rng, int animations, int bones, int maxKeys )
+{
+	tinyxml2::XMLElement *boneList = header->InsertNewChildElement( "BoneList" );
+	for( int i = 0; i < bones; i++ )
+		boneList->InsertNewChildElement( "value" )->SetText( BenchName( "bone", i ).c_str( ) );
+
+	static const char *channels[] = { "position", "rotation", "scaling" };
+
+	tinyxml2::XMLElement *anmData = header->InsertNewChildElement( "AnmData" );
+	for( int i = 0; i < animations; i++ )
+	{
+		tinyxml2::XMLElement *node = anmData->InsertNewChildElement( "node" );
+		node->SetAttribute( "int1", 1 );
+		node->SetAttribute( "name", BenchName( "anm", i ).c_str( ) );
+		node->SetAttribute( "time", (float)( 1 + rng.Next( 64 ) ) );
+		node->SetAttribute( "speed", 0.5f );
+		node->SetAttribute( "kf", 3 );
+
+		int tracks = 1 + rng.Next( bones );
+		for( int j = 0; j < tracks; j++ )
+		{
+			tinyxml2::XMLElement *value = node->InsertNewChildElement( "value" );
+			value->SetAttribute( "bone", BenchName( "bone", rng.Next( bones ) ).c_str( ) );
+
+			for( const char *channel : channels )
+			{
+				tinyxml2::XMLElement *xmlChannel = value->InsertNewChildElement( channel );
+				if( rng.Next( 4 ) == 0 )
+				{
+					xmlChannel->SetAttribute( "type", "null" );
+					continue;
+				}
+
+				int keys = rng.Next( maxKeys );
+				xmlChannel->SetAttribute( "type", keys ? 1 : 0 );
+				xmlChannel->SetAttribute( "frame", keys ? keys : 1 );
+				xmlChannel->SetAttribute( "ix", BenchFloat( rng ) );
+				xmlChannel->SetAttribute( "iy", BenchFloat( rng ) );
+				xmlChannel->SetAttribute( "iz", BenchFloat( rng ) );
+				xmlChannel->SetAttribute( "vx", BenchFloat( rng ) );
+				xmlChannel->SetAttribute( "vy", BenchFloat( rng ) );
+				xmlChannel->SetAttribute( "vz", BenchFloat( rng ) );
+
+				for( int k = 0; k < keys; k++ )
+				{
+					tinyxml2::XMLElement *key = xmlChannel->InsertNewChildElement( "v" );
+					key->SetAttribute( "x", rng.Next( 65536 ) );
+					key->SetAttribute( "y", rng.Next( 65536 ) );
+					key->SetAttribute( "z", rng.Next( 65536 ) );
+				}
+			}
+		}
+	}
+}
+
+static void GenerateCANMCorpus( tinyxml2::XMLDocument& doc, int scale )
+{
+	BenchRandom rng( 4 );
+	tinyxml2::XMLElement *header = NewDocument( doc, "CANM" );
+	GenerateCANMData( header, rng, 60 * scale, 32, 48 );
+}
+
+static void AddCASUnknown( tinyxml2::XMLElement *parent, BenchRandom& rng, int blocks )
+{
+	for( int i = 0; i < blocks; i++ )
+	{
+		tinyxml2::XMLElement *data = parent->InsertNewChildElement( "data" );
+		int values = 5 + rng.Next( 10 );
+		for( int j = 0; j < values; j++ )
+		{
+			if( rng.Next( 2 ) )
+				data->InsertNewChildElement( "int" )->SetText( rng.Next( 100 ) );
+			else
+				data->InsertNewChildElement( "float" )->SetText( BenchFloat( rng ) );
+		}
+	}
+}
+
+static void AddCASPtr( tinyxml2::XMLElement *ptr, BenchRandom& rng )
+{
+	int type = rng.Next( 3 );
+	ptr->SetAttribute( "int1", rng.Next( 10 ) );
+	ptr->SetAttribute( "float2", BenchFloat( rng ) );
+	ptr->SetAttribute( "type", type );
+	if( type == 0 )
+		ptr->SetAttribute( "value", BenchFloat( rng ) );
+	else
+		ptr->SetAttribute( "value", rng.Next( 10 ) );
+	ptr->SetAttribute( "int6", 1 );
+	ptr->SetAttribute( "int7", 2 );
+	ptr->SetAttribute( "int8", 3 );
+	AddCASUnknown( ptr->InsertNewChildElement( "parametric" ), rng, rng.Next( 3 ) );
+}
+
+static void GenerateCASCorpus( tinyxml2::XMLDocument& doc, int scale )
+{
+	BenchRandom rng( 5 );
+	tinyxml2::XMLElement *header = NewDocument( doc, "CAS" );
+	header->SetAttribute( "version", 5 );
+
+	int animations = 40 * scale;
+	GenerateCANMData( header->InsertNewChildElement( "CanmData" ), rng, animations, 16, 16 );
+
+	//References only ever name something that exists, so the reader gives the same names back
+	int tcontrols = 20 * scale;
+	tinyxml2::XMLElement *tcontrol = header->InsertNewChildElement( "TControl" );
+	for( int i = 0; i < tcontrols; i++ )
+	{
+		tinyxml2::XMLElement *ptr = tcontrol->InsertNewChildElement( "ptr" );
+		ptr->SetAttribute( "name", BenchName( "tc", i ).c_str( ) );
+
+		int entries = rng.Next( 5 );
+		for( int j = 0; j < entries; j++ )
+		{
+			if( rng.Next( 2 ) )
+				ptr->InsertNewChildElement( "anime" )->SetText( BenchName( "anm", rng.Next( animations ) ).c_str( ) );
+			else
+				ptr->InsertNewChildElement( "value" )->SetText( rng.Next( 10 ) );
+		}
+	}
+
+	tinyxml2::XMLElement *vcontrol = header->InsertNewChildElement( "VControl" );
+	for( int i = 0; i < 10 * scale; i++ )
+	{
+		tinyxml2::XMLElement *ptr = vcontrol->InsertNewChildElement( "ptr" );
+		ptr->SetAttribute( "name", BenchName( "vc", i ).c_str( ) );
+		ptr->SetAttribute( "int1", rng.Next( 4 ) );
+		ptr->SetAttribute( "int2", rng.Next( 4 ) );
+		ptr->SetAttribute( "float3", BenchFloat( rng ) );
+		ptr->SetAttribute( "int4", rng.Next( 4 ) );
+	}
+
+	static const char *parametrics[] = { "parametric1", "parametric2", "parametric3" };
+
+	tinyxml2::XMLElement *anmGroup = header->InsertNewChildElement( "AnmGroup" );
+	for( int i = 0; i < 12 * scale; i++ )
+	{
+		tinyxml2::XMLElement *ptr = anmGroup->InsertNewChildElement( "ptr" );
+		ptr->SetAttribute( "name", BenchName( "group", i ).c_str( ) );
+
+		int nodes = rng.Next( 5 );
+		for( int j = 0; j < nodes; j++ )
+		{
+			tinyxml2::XMLElement *node = ptr->InsertNewChildElement( "node" );
+			int type = rng.Next( 3 );
+			node->SetAttribute( "name", ( BenchName( "set", i ) + "_" + std::to_string( j ) ).c_str( ) );
+			node->SetAttribute( "type", type );
+			if( type == 0 )
+				node->SetAttribute( "value", BenchFloat( rng ) );
+			else if( type == 1 )
+				node->SetAttribute( "value", rng.Next( 10 ) );
+			else
+				node->SetAttribute( "value", BenchName( "tc", rng.Next( tcontrols ) ).c_str( ) );
+
+			//The reader always brings data1 back, so it is always there
+			AddCASPtr( node->InsertNewChildElement( "data1" ), rng );
+
+			tinyxml2::XMLElement *data2 = node->InsertNewChildElement( "data2" );
+			int ptrs = rng.Next( 4 );
+			for( int k = 0; k < ptrs; k++ )
+				AddCASPtr( data2->InsertNewChildElement( "ptr" ), rng );
+
+			for( const char *parametric : parametrics )
+				AddCASUnknown( node->InsertNewChildElement( parametric ), rng, rng.Next( 3 ) );
+		}
+	}
+
+	tinyxml2::XMLElement *boneList = header->InsertNewChildElement( "BoneList" );
+	for( int i = 0; i < 24; i++ )
+		boneList->InsertNewChildElement( "value" )->SetText( BenchName( "cas_bone", i ).c_str( ) );
+
+	AddCASUnknown( header->InsertNewChildElement( "Unknown" ), rng, 3 );
+}
+
+static void AddMDBVector( tinyxml2::XMLElement *parent, const char *name, float x, float y, float z, float w )
+{
+	tinyxml2::XMLElement *vector = parent->InsertNewChildElement( name );
+	vector->SetAttribute( "x", x );
+	vector->SetAttribute( "y", y );
+	vector->SetAttribute( "z", z );
+	vector->SetAttribute( "w", w );
+}
+
+//Many meshes over every vertex layout type
+static void GenerateMDBCorpus( tinyxml2::XMLDocument& doc, int scale )
+{
+	BenchRandom rng( 6 );
+	tinyxml2::XMLElement *header = NewDocument( doc, "MDB" );
+
+	int objects = 6 * scale;
+	int bones = 32;
+	int materials = 8;
+	int textures = 12;
+
+	//Objects take the first names, the writer uses their ID as the name index
+	tinyxml2::XMLElement *names = header->InsertNewChildElement( "Names" );
+	for( int i = 0; i < objects; i++ )
+		names->InsertNewChildElement( "value" )->SetText( BenchName( "object", i ).c_str( ) );
+	for( int i = 0; i < bones; i++ )
+		names->InsertNewChildElement( "value" )->SetText( BenchName( "bone", i ).c_str( ) );
+	for( int i = 0; i < materials; i++ )
+		names->InsertNewChildElement( "value" )->SetText( BenchName( "material", i ).c_str( ) );
+
+	tinyxml2::XMLElement *xmlTextures = header->InsertNewChildElement( "Textures" );
+	for( int i = 0; i < textures; i++ )
+	{
+		tinyxml2::XMLElement *texture = xmlTextures->InsertNewChildElement( "value" );
+		texture->SetAttribute( "mapping", ( BenchName( "tex", i ) + "_dds" ).c_str( ) );
+		texture->SetAttribute( "filename", ( BenchName( "tex", i ) + ".dds" ).c_str( ) );
+	}
+
+	tinyxml2::XMLElement *boneLists = header->InsertNewChildElement( "BoneLists" );
+	for( int i = 0; i < bones; i++ )
+	{
+		tinyxml2::XMLElement *bone = boneLists->InsertNewChildElement( "Bone" );
+		tinyxml2::XMLElement *name = bone->InsertNewChildElement( "name" );
+		name->SetAttribute( "id", objects + i );
+		name->SetText( BenchName( "bone", i ).c_str( ) );
+
+		bone->InsertNewChildElement( "parent" )->SetAttribute( "value", i - 1 );
+		tinyxml2::XMLElement *ik = bone->InsertNewChildElement( "IK" );
+		ik->SetAttribute( "root", i ? 0 : -1 );
+		ik->SetAttribute( "next", i + 1 < bones ? i + 1 : -1 );
+		ik->SetAttribute( "current", i );
+		bone->InsertNewChildElement( "childrenNum" )->SetAttribute( "value", i + 1 < bones ? 1 : 0 );
+
+		for( int j = 0; j < 2; j++ )
+		{
+			tinyxml2::XMLElement *weight = bone->InsertNewChildElement( "weight" );
+			weight->SetAttribute( "x", rng.Next( 256 ) );
+			weight->SetAttribute( "y", rng.Next( 256 ) );
+			weight->SetAttribute( "z", rng.Next( 256 ) );
+			weight->SetAttribute( "w", rng.Next( 256 ) );
+		}
+		for( int j = 0; j < 4; j++ )
+			AddMDBVector( bone, "mainTM", BenchFloat( rng ), BenchFloat( rng ), BenchFloat( rng ), j == 3 ? 1.0f : 0.0f );
+		for( int j = 0; j < 4; j++ )
+			AddMDBVector( bone, "skinTM", BenchFloat( rng ), BenchFloat( rng ), BenchFloat( rng ), j == 3 ? 1.0f : 0.0f );
+		AddMDBVector( bone, "position", BenchFloat( rng ), BenchFloat( rng ), BenchFloat( rng ), 1.0f );
+		AddMDBVector( bone, "float", BenchFloat( rng ), BenchFloat( rng ), BenchFloat( rng ), 0.0f );
+	}
+
+	struct BenchLayout
+	{
+		const char *name;
+		int type;
+	};
+	static const BenchLayout layouts[] = { { "position", 1 }, { "normal", 4 }, { "tangent", 7 }, { "texcoord", 12 }, { "color", 21 }, { "BLENDINDICES", 21 }, { "BLENDWEIGHT", 7 } };
+
+	tinyxml2::XMLElement *objectLists = header->InsertNewChildElement( "ObjectLists" );
+	for( int i = 0; i < objects; i++ )
+	{
+		tinyxml2::XMLElement *object = objectLists->InsertNewChildElement( "Object" );
+		object->SetAttribute( "ID", i );
+		object->InsertNewChildElement( "name" )->SetText( BenchName( "object", i ).c_str( ) );
+
+		int meshes = 1 + rng.Next( 4 );
+		for( int j = 0; j < meshes; j++ )
+		{
+			tinyxml2::XMLElement *mesh = object->InsertNewChildElement( "Mesh" );
+			mesh->SetAttribute( "MatID", rng.Next( materials ) );
+			mesh->InsertNewChildElement( "raw" )->SetText( "00000000" );
+			mesh->InsertNewChildElement( "raw" )->SetText( "01000000" );
+
+			//Position first, then a run of the others
+			int first = 1 + rng.Next( 3 );
+			int count = 1 + rng.Next( 7 - first );
+			int vertices = 200 + rng.Next( 600 );
+
+			tinyxml2::XMLElement *vertexList = mesh->InsertNewChildElement( "VertexList" );
+			for( int l = -1; l < count; l++ )
+			{
+				const BenchLayout& layout = layouts[l < 0 ? 0 : first + l];
+				tinyxml2::XMLElement *xmlLayout = vertexList->InsertNewChildElement( layout.name );
+				xmlLayout->SetAttribute( "type", layout.type );
+				xmlLayout->SetAttribute( "channel", 0 );
+
+				for( int v = 0; v < vertices; v++ )
+				{
+					tinyxml2::XMLElement *vertex = xmlLayout->InsertNewChildElement( "V" );
+					if( layout.type == 21 )
+					{
+						vertex->SetAttribute( "x", rng.Next( 256 ) );
+						vertex->SetAttribute( "y", rng.Next( 256 ) );
+						vertex->SetAttribute( "z", rng.Next( 256 ) );
+						vertex->SetAttribute( "w", rng.Next( 256 ) );
+					}
+					else
+					{
+						vertex->SetAttribute( "x", BenchFloat( rng ) );
+						vertex->SetAttribute( "y", BenchFloat( rng ) );
+						if( layout.type != 12 )
+							vertex->SetAttribute( "z", BenchFloat( rng ) );
+						if( layout.type == 1 || layout.type == 7 )
+							vertex->SetAttribute( "w", BenchFloat( rng ) );
+					}
+				}
+			}
+
+			tinyxml2::XMLElement *faces = mesh->InsertNewChildElement( "Faces" );
+			for( int f = 0; f < vertices * 3; f++ )
+				faces->InsertNewChildElement( "value" )->SetAttribute( "value", rng.Next( vertices ) );
+		}
+	}
+
+	static const char *textureTypes[] = { "albedo", "normal", "specular" };
+
+	tinyxml2::XMLElement *xmlMaterials = header->InsertNewChildElement( "Materials" );
+	for( int i = 0; i < materials; i++ )
+	{
+		tinyxml2::XMLElement *material = xmlMaterials->InsertNewChildElement( "MaterialNode" );
+		material->InsertNewChildElement( "raw" )->SetText( "00000000" );
+		tinyxml2::XMLElement *name = material->InsertNewChildElement( "MaterialName" );
+		name->SetAttribute( "MatID", objects + bones + i );
+		name->SetText( BenchName( "material", i ).c_str( ) );
+
+		tinyxml2::XMLElement *shader = material->InsertNewChildElement( "Shader" );
+		shader->SetAttribute( "Name", BenchName( "shader", rng.Next( 3 ) ).c_str( ) );
+
+		int parameters = 1 + rng.Next( 4 );
+		for( int j = 0; j < parameters; j++ )
+		{
+			tinyxml2::XMLElement *parameter = shader->InsertNewChildElement( "Parameter" );
+			parameter->SetAttribute( "Name", BenchName( "param", j ).c_str( ) );
+			tinyxml2::XMLElement *color = parameter->InsertNewChildElement( "Color" );
+			color->SetAttribute( "r", rng.Next( 17 ) / 16.0f );
+			color->SetAttribute( "g", rng.Next( 17 ) / 16.0f );
+			color->SetAttribute( "b", rng.Next( 17 ) / 16.0f );
+			color->SetAttribute( "a", 1.0f );
+			parameter->InsertNewChildElement( "raw" )->SetText( "0400000001000000" );
+			parameter->InsertNewChildElement( "raw" )->SetText( "00000000" );
+		}
+
+		int maps = 1 + rng.Next( 3 );
+		for( int j = 0; j < maps; j++ )
+		{
+			int texture = rng.Next( textures );
+			tinyxml2::XMLElement *xmlTexture = shader->InsertNewChildElement( "Texture" );
+			tinyxml2::XMLElement *textureName = xmlTexture->InsertNewChildElement( "Name" );
+			textureName->SetAttribute( "MatID", texture );
+			textureName->SetAttribute( "MIP", 0 );
+			textureName->SetText( ( BenchName( "tex", texture ) + ".dds" ).c_str( ) );
+			xmlTexture->InsertNewChildElement( "Type" )->SetText( textureTypes[j] );
+			xmlTexture->InsertNewChildElement( "raw" )->SetText( "0000000000000000000000000000000000000000" );
+		}
+
+		material->InsertNewChildElement( "raw" )->SetText( "00000000" );
+	}
+}
+
+//Text, structured floats, noise and runs of zeroes, in a spread of sizes
+static std::vector< std::vector< char > > GenerateByteCorpus( int scale, unsigned int seed )
+{
+	static const char *words[] = { "mission", "weapon", "soldier", "EDF", "ant", "\xE6\xAD\xA6\xE5\x99\xA8", "<value>", "0.000000", "\r\n" };
+	BenchRandom rng( seed );
+
+	std::vector< std::vector< char > > files( 12 );
+	for( size_t i = 0; i < files.size( ); i++ )
+	{
+		size_t size = ( (size_t)256 << ( i % 7 ) ) * scale + rng.Next( 256 );
+		std::vector< char >& file = files[i];
+
+		switch( i % 4 )
+		{
+		case 0:
+			while( file.size( ) < size )
+			{
+				const char *word = words[rng.Next( 9 )];
+				file.insert( file.end( ), word, word + strlen( word ) );
+				file.push_back( ' ' );
+			}
+			file.resize( size );
+			break;
+		case 1:
+			while( file.size( ) + 4 <= size )
+			{
+				float f = BenchFloat( rng );
+				file.insert( file.end( ), (char*)&f, (char*)&f + 4 );
+			}
+			file.resize( size );
+			break;
+		case 2:
+			for( size_t j = 0; j < size; j++ )
+				file.push_back( (char)rng.Next( 256 ) );
+			break;
+		default:
+			file.resize( size );
+			for( size_t j = 0; j < size; j += 64 )
+				file[j] = (char)rng.Next( 256 );
+			break;
+		}
+	}
+	return files;
+}
+
+static double MillisecondsSince( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now( ) - start ).count( );
+}
+
+//Best of runs for one pass, with the console muted since the converters log as they go
+template< typename F > static double TimeFormatPass( int runs, F pass )
+{
+	double best = 0.0;
+	for( int run = 0; run < runs; run++ )
+	{
+		LogLevel level = Log::level;
+		Log::level = LogLevel::None;
+		auto start = std::chrono::steady_clock::now( );
+		try
+		{
+			pass( );
+		}
+		catch( ... )
+		{
+			Log::level = level;
+			throw;
+		}
+		double ms = MillisecondsSince( start );
+		Log::level = level;
+
+		if( run == 0 || ms < best )
+			best = ms;
+	}
+	return best;
+}
+
+//Writers and readers that work on an EDFDATA tree in memory
+template< typename T > static FormatBench MakeDataBench( const char *format, tinyxml2::XMLDocument& source, std::shared_ptr< std::vector< char > > binary )
+{
+	auto write = [&source]( )
+	{
+		tinyxml2::XMLElement *header = source.FirstChildElement( "EDFDATA" );
+		std::unique_ptr< T > writer = std::make_unique< T >( );
+		return writer->WriteData( header->FirstChildElement( "Main" ), header );
+	};
+	auto read = [format]( const std::vector< char >& bytes, tinyxml2::XMLDocument& doc )
+	{
+		tinyxml2::XMLElement *header = NewDocument( doc, "EDFDATA" );
+		tinyxml2::XMLElement *main = header->InsertNewChildElement( "Main" );
+		main->SetAttribute( "header", format );
+		std::unique_ptr< T > reader = std::make_unique< T >( );
+		reader->ReadData( bytes, main, header );
+	};
+
+	FormatBench bench;
+	bench.format = format;
+	bench.write = [=]( )
+	{
+		*binary = write( );
+		return (uint64_t)binary->size( );
+	};
+	bench.read = [=]( )
+	{
+		tinyxml2::XMLDocument doc;
+		read( *binary, doc );
+	};
+	bench.roundTrip = [=]( )
+	{
+		tinyxml2::XMLDocument doc;
+		read( *binary, doc );
+		tinyxml2::XMLElement *header = doc.FirstChildElement( "EDFDATA" );
+		std::unique_ptr< T > writer = std::make_unique< T >( );
+		return writer->WriteData( header->FirstChildElement( "Main" ), header ) == *binary;
+	};
+	return bench;
+}
+
+//CAS and CANM, which keep everything under their own root
+template< typename T > static FormatBench MakeRootBench( const char *format, tinyxml2::XMLDocument& source, std::shared_ptr< std::vector< char > > binary )
+{
+	auto read = [format]( const std::vector< char >& bytes, tinyxml2::XMLDocument& doc )
+	{
+		tinyxml2::XMLElement *header = NewDocument( doc, format );
+		std::unique_ptr< T > reader = std::make_unique< T >( );
+		reader->ReadData( bytes, header );
+	};
+
+	FormatBench bench;
+	bench.format = format;
+	bench.write = [=, &source]( )
+	{
+		std::unique_ptr< T > writer = std::make_unique< T >( );
+		*binary = writer->WriteData( source.FirstChildElement( format ) );
+		return (uint64_t)binary->size( );
+	};
+	bench.read = [=]( )
+	{
+		tinyxml2::XMLDocument doc;
+		read( *binary, doc );
+	};
+	bench.roundTrip = [=]( )
+	{
+		tinyxml2::XMLDocument doc;
+		read( *binary, doc );
+		std::unique_ptr< T > writer = std::make_unique< T >( );
+		return writer->WriteData( doc.FirstChildElement( format ) ) == *binary;
+	};
+	return bench;
+}
+
+static bool SameFileContents( const std::wstring& a, const std::wstring& b )
+{
+	MappedFile first, second;
+	if( !first.Open( a ) || !second.Open( b ) )
+		return false;
+	ByteSpan x = first.Span( ), y = second.Span( );
+	return x.size( ) == y.size( ) && std::equal( x.begin( ), x.end( ), y.begin( ) );
+}
+
+static void MoveBenchFile( const std::wstring& from, const std::wstring& to )
+{
+	std::remove( WideToUTF8( to ).c_str( ) );
+	std::rename( WideToUTF8( from ).c_str( ), WideToUTF8( to ).c_str( ) );
+}
+
+//MDB only converts between files. The reader writes _MDB.xml where the writer reads _mdb.xml, the same file on
+//Windows, so every pass works on its own name.
+static FormatBench MakeMDBBench( )
+{
+	std::wstring source = BENCH_FORMAT_PREFIX L"mdb";
+	std::wstring input = source + L"_in";
+	std::wstring output = source + L"_out";
+
+	FormatBench bench;
+	bench.format = "MDB";
+	bench.write = [=]( )
+	{
+		std::unique_ptr< CXMLToMDB > writer = std::make_unique< CXMLToMDB >( );
+		writer->Write( source, false );
+		MoveBenchFile( source + L".mdb", input + L".mdb" );
+		return GetFileLength( input + L".mdb" );
+	};
+	bench.read = [=]( )
+	{
+		std::unique_ptr< CMDBtoXML > reader = std::make_unique< CMDBtoXML >( );
+		reader->Read( input, true );
+	};
+	bench.roundTrip = [=]( )
+	{
+		std::unique_ptr< CMDBtoXML > reader = std::make_unique< CMDBtoXML >( );
+		reader->Read( input, true );
+		MoveBenchFile( input + L"_MDB.xml", output + L"_mdb.xml" );
+		std::unique_ptr< CXMLToMDB > writer = std::make_unique< CXMLToMDB >( );
+		writer->Write( output, false );
+		return SameFileContents( input + L".mdb", output + L".mdb" );
+	};
+	return bench;
+}
+
+//Mission scripts: compile and decompile. The decompiler writes readable pseudocode the compiler can't take back,
+//so the round trip checks both steps give the same bytes a second time.
+static FormatBench MakeBVMBench( int scale )
+{
+	std::wstring source = BENCH_FORMAT_PREFIX L"bvm";
+	std::wstring again = source + L"_again";
+
+	std::wstring text = GenerateBenchmarkScript( 60 * scale, 40 );
+	WriteUTF16File( ( source + L".txt" ).c_str( ), text );
+	WriteUTF16File( ( again + L".txt" ).c_str( ), text );
+
+	FormatBench bench;
+	bench.format = "BVM";
+	bench.write = [=]( )
+	{
+		std::unique_ptr< CMissionScript > script = std::make_unique< CMissionScript >( );
+		script->Write( source, 0 );
+		return GetFileLength( source + L".bvm" );
+	};
+	bench.read = [=]( )
+	{
+		std::unique_ptr< CMissionScript > script = std::make_unique< CMissionScript >( );
+		script->bEchoOutput = false;
+		script->Read( source, source + L"_out.txt" );
+	};
+	bench.roundTrip = [=]( )
+	{
+		for( const std::wstring& path : { source, again } )
+		{
+			std::unique_ptr< CMissionScript > script = std::make_unique< CMissionScript >( );
+			script->Write( path, 0 );
+			script = std::make_unique< CMissionScript >( );
+			script->bEchoOutput = false;
+			script->Read( path, path + L"_out.txt" );
+		}
+		return SameFileContents( source + L".bvm", again + L".bvm" ) && SameFileContents( source + L"_out.txt", again + L"_out.txt" );
+	};
+	return bench;
+}
+
+static FormatBench MakeCMPLBench( int scale )
+{
+	auto files = std::make_shared< std::vector< std::vector< char > > >( GenerateByteCorpus( scale, 7 ) );
+	auto compressed = std::make_shared< std::vector< std::vector< char > > >( files->size( ) );
+
+	FormatBench bench;
+	bench.format = "CMPL";
+	bench.write = [=]( )
+	{
+		uint64_t bytes = 0;
+		for( size_t i = 0; i < files->size( ); i++ )
+		{
+			( *compressed )[i] = CMPLHandler( ( *files )[i] ).Compress( );
+			bytes += ( *compressed )[i].size( );
+		}
+		return bytes;
+	};
+	bench.read = [=]( )
+	{
+		for( size_t i = 0; i < compressed->size( ); i++ )
+			CMPLHandler( ( *compressed )[i] ).Decompress( );
+	};
+	bench.roundTrip = [=]( )
+	{
+		bool ok = true;
+		for( size_t i = 0; i < compressed->size( ); i++ )
+		{
+			std::vector< char > file = CMPLHandler( ( *compressed )[i] ).Decompress( );
+			ok &= file == ( *files )[i] && CMPLHandler( file ).Compress( ) == ( *compressed )[i];
+		}
+		return ok;
+	};
+	return bench;
+}
+
+//The corpus is a folder of folders
+static FormatBench MakeRABBench( int scale )
+{
+	std::wstring source = BENCH_FORMAT_PREFIX L"rab";
+	std::wstring output = source + L"_out";
+
+	std::vector< std::vector< char > > files = GenerateByteCorpus( scale, 8 );
+	auto paths = std::make_shared< std::vector< std::wstring > >( );
+	for( size_t i = 0; i < files.size( ); i++ )
+	{
+		std::wstring folder = L"Folder" + ToString( (int)( i % 3 ) );
+		std::wstring name = folder + L"\\file" + ToString( (int)i ) + L".bin";
+		std::error_code error;
+		std::filesystem::create_directories( ToFilePath( source + L"\\" + folder ), error );
+		std::ofstream file( ToFilePath( source + L"\\" + name ), std::ios::binary | std::ios::out );
+		file.write( files[i].data( ), files[i].size( ) );
+		paths->push_back( name );
+	}
+
+	auto pack = [=]( )
+	{
+		std::unique_ptr< RAB > archive = std::make_unique< RAB >( );
+		archive->bUseFakeCompression = false;
+		archive->bIsMultipleThreads = false;
+		archive->bIsMultipleCores = false;
+		archive->customizeThreads = 0;
+		archive->mdbFileNum = 0;
+		archive->CreateFromDirectory( source );
+		archive->Write( output + L".rab" );
+	};
+
+	FormatBench bench;
+	bench.format = "RAB";
+	bench.write = [=]( )
+	{
+		pack( );
+		return GetFileLength( output + L".rab" );
+	};
+	bench.read = [=]( )
+	{
+		std::unique_ptr< RAB > archive = std::make_unique< RAB >( );
+		archive->Read( output, false );
+	};
+	bench.roundTrip = [=]( )
+	{
+		pack( );
+		std::unique_ptr< RAB > archive = std::make_unique< RAB >( );
+		archive->Read( output, false );
+
+		bool ok = true;
+		for( const std::wstring& path : *paths )
+			ok &= SameFileContents( source + L"\\" + path, output + L"\\" + path );
+		return ok;
+	};
+	return bench;
+}
+
+static FormatBenchResult RunFormatBench( const FormatBench& bench, int runs )
+{
+	FormatBenchResult result;
+	result.format = bench.format;
+	result.bytes = 0;
+	result.writeMs = 0.0;
+	result.readMs = 0.0;
+	result.roundTripMs = 0.0;
+	result.ok = true;
+
+	//A format that throws counts as a failed round trip, the rest still run
+	try
+	{
+		result.writeMs = TimeFormatPass( runs, [&]( ) { result.bytes = bench.write( ); } );
+		result.readMs = TimeFormatPass( runs, bench.read );
+		result.roundTripMs = TimeFormatPass( runs, [&]( ) { result.ok &= bench.roundTrip( ); } );
+	}
+	catch( const std::exception& e )
+	{
+		LogError( ) << L"  " << result.format << L" threw: " << e.what( ) << L"\n";
+		result.ok = false;
+	}
+	return result;
+}
+
+//Each run is one line of the history, so the last one at a scale can be found without a JSON parser
+static std::string FormatResultsToJSON( const std::vector< FormatBenchResult >& results, int scale, int runs )
+{
+	std::string out = "{ \"time\": " + std::to_string( (long long)std::time( nullptr ) );
+	out += ", \"scale\": " + std::to_string( scale );
+	out += ", \"runs\": " + std::to_string( runs );
+	out += ", \"results\": [";
+	for( size_t i = 0; i < results.size( ); i++ )
+	{
+		const FormatBenchResult& result = results[i];
+		out += i ? ", " : " ";
+		out += "{ \"format\": \"" + std::string( result.format ) + "\"";
+		out += ", \"bytes\": " + std::to_string( result.bytes );
+		out += ", \"write_ms\": " + JSONNumber( result.writeMs );
+		out += ", \"read_ms\": " + JSONNumber( result.readMs );
+		out += ", \"roundtrip_ms\": " + JSONNumber( result.roundTripMs );
+		out += ", \"ok\": " + std::string( result.ok ? "true" : "false" ) + " }";
+	}
+	out += " ] }";
+	return out;
+}
+
+//Number after "key": inside [from, to), false if it isn't there
+static bool FindJSONNumber( const std::string& text, size_t from, size_t to, const std::string& key, double *out )
+{
+	size_t pos = text.find( "\"" + key + "\": ", from );
+	if( pos == std::string::npos || pos >= to )
+		return false;
+	*out = atof( text.c_str( ) + pos + key.size( ) + 4 );
+	return true;
+}
+
+//The last run in the history at this scale, empty if there is none
+static std::string FindPreviousRun( const std::string& history, int scale )
+{
+	std::string scaleKey = "\"scale\": " + std::to_string( scale ) + ",";
+	size_t end = history.size( );
+	while( end > 0 )
+	{
+		size_t start = history.rfind( '\n', end - 1 );
+		start = start == std::string::npos ? 0 : start + 1;
+		std::string line = history.substr( start, end - start );
+		if( line.find( "{ \"time\"" ) != std::string::npos && line.find( scaleKey ) != std::string::npos )
+			return line;
+		end = start ? start - 1 : 0;
+	}
+	return "";
+}
+
+//Percent change of one time against the previous run, blank if that run didn't have it
+static std::string FormatChange( const std::string& previous, const char *format, const char *key, double ms )
+{
+	size_t pos = previous.find( "\"format\": \"" + std::string( format ) + "\"" );
+	double before;
+	if( pos == std::string::npos || !FindJSONNumber( previous, pos, previous.find( '}', pos ), key, &before ) || before <= 0.0 )
+		return "";
+
+	char change[32];
+	snprintf( change, sizeof( change ), "%+.1f%%", ( ms / before - 1.0 ) * 100.0 );
+	return change;
+}
+
+static void PrintFormatResults( const std::vector< FormatBenchResult >& results, const std::string& previous )
+{
+	char line[192];
+	snprintf( line, sizeof( line ), "%-6s %10s %10s %10s %10s %10s %10s %8s %8s %8s  %s\n", "Format", "KB", "Write ms", "Read ms", "Trip ms",
+		"Write MB/s", "Read MB/s", "Write", "Read", "Trip", "Round trip" );
+	LogInfo( ) << line;
+
+	for( const FormatBenchResult& result : results )
+	{
+		snprintf( line, sizeof( line ), "%-6s %10.1f %10.3f %10.3f %10.3f %10.2f %10.2f %8s %8s %8s  %s\n", result.format, result.bytes / 1024.0,
+			result.writeMs, result.readMs, result.roundTripMs, MegabytesPerSecond( result.bytes, result.writeMs ), MegabytesPerSecond( result.bytes, result.readMs ),
+			FormatChange( previous, result.format, "write_ms", result.writeMs ).c_str( ), FormatChange( previous, result.format, "read_ms", result.readMs ).c_str( ),
+			FormatChange( previous, result.format, "roundtrip_ms", result.roundTripMs ).c_str( ), result.ok ? "ok" : "MISMATCH" );
+		LogInfo( ) << line;
+	}
+}
+
+//Appends the run to the history array. A file that doesn't look like one is left alone.
+static bool AppendFormatHistory( const std::wstring& path, const std::string& history, const std::string& run )
+{
+	std::string out;
+	size_t first = history.find_first_not_of( " \t\r\n" );
+	size_t last = history.find_last_not_of( " \t\r\n" );
+	if( first == std::string::npos )
+	{
+		out = "[\n" + run + "\n]\n";
+	}
+	else if( history[first] == '[' && history[last] == ']' )
+	{
+		size_t end = history.find_last_not_of( " \t\r\n", last - 1 );
+		out = history.substr( 0, end + 1 ) + ( end == first ? "\n" : ",\n" ) + run + "\n]\n";
+	}
+	else
+	{
+		return false;
+	}
+
+	std::ofstream file( ToFilePath( path ), std::ios::binary | std::ios::out );
+	file.write( out.data( ), out.size( ) );
+	return true;
+}
+
+int RunFormatBenchmark( int scale, int runs, const std::wstring& historyPath )
+{
+	if( scale <= 0 || runs <= 0 )
+		return 1;
+
+	LogInfo( ) << L"Format benchmark: scale " << scale << L", best of " << runs << L" runs\n";
+
+	//Progress counters and the mission compile cache would both skew the timings
+	bool progress = ProgressReporter::enabled;
+	ProgressReporter::enabled = false;
+	bool useCache = CMissionScript::bUseCompileCache;
+	CMissionScript::bUseCompileCache = false;
+
+	std::vector< FormatBench > benches;
+	tinyxml2::XMLDocument sgo, mab, mtab, canm, cas;
+	GenerateSGOCorpus( sgo, scale );
+	GenerateMABCorpus( mab, scale );
+	GenerateMTABCorpus( mtab, scale );
+	GenerateCANMCorpus( canm, scale );
+	GenerateCASCorpus( cas, scale );
+	benches.push_back( MakeDataBench< SGO >( "SGO", sgo, std::make_shared< std::vector< char > >( ) ) );
+	benches.push_back( MakeDataBench< MAB >( "MAB", mab, std::make_shared< std::vector< char > >( ) ) );
+	benches.push_back( MakeDataBench< MTAB >( "MTAB", mtab, std::make_shared< std::vector< char > >( ) ) );
+	benches.push_back( MakeRootBench< CANM >( "CANM", canm, std::make_shared< std::vector< char > >( ) ) );
+	benches.push_back( MakeRootBench< CAS >( "CAS", cas, std::make_shared< std::vector< char > >( ) ) );
+
+	tinyxml2::XMLDocument mdb;
+	GenerateMDBCorpus( mdb, scale );
+	mdb.SaveFile( WideToUTF8( BENCH_FORMAT_PREFIX L"mdb_mdb.xml" ).c_str( ) );
+	mdb.Clear( );
+	benches.push_back( MakeMDBBench( ) );
+
+	benches.push_back( MakeBVMBench( scale ) );
+	benches.push_back( MakeCMPLBench( scale ) );
+	benches.push_back( MakeRABBench( scale ) );
+
+	std::vector< FormatBenchResult > results;
+	bool ok = true;
+	for( const FormatBench& bench : benches )
+	{
+		LogInfo( ) << UTF8ToWide( bench.format ) << L"...\n";
+		results.push_back( RunFormatBench( bench, runs ) );
+		ok &= results.back( ).ok;
+	}
+
+	ProgressReporter::enabled = progress;
+	CMissionScript::bUseCompileCache = useCache;
+
+	MappedFile historyFile;
+	std::string history;
+	if( historyFile.Open( historyPath ) )
+		history.assign( historyFile.Span( ).begin( ), historyFile.Span( ).end( ) );
+	historyFile.Close( );
+
+	PrintFormatResults( results, FindPreviousRun( history, scale ) );
+
+	if( AppendFormatHistory( historyPath, history, FormatResultsToJSON( results, scale, runs ) ) )
+		LogInfo( ) << L"Results added to " << historyPath << L"\n";
+	else
+		LogWarning( ) << historyPath << L" isn't a JSON array, results not saved\n";
+
+	return ok ? 0 : 1;
+}
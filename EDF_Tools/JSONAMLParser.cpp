@@ -5,140 +5,428 @@
 #include <codecvt>
 #include <iostream>
 #include <fstream>
+#include <cwctype>
+#include <mutex>
+#include <unordered_map>
 #include "JSONAMLParser.h"
 #include "util.h"
 
-//Whoo boy, this is a mess. I need to comment this eventually.
+//The grammar is loose: a value is only stored once a ',' (or the closing bracket
+//of an array / subnode) is seen, and keys and values are whatever text lies in
+//between. Parsing is done by range over one normalised buffer, each level scans
+//its own range once and nothing is copied unless the text had to be stitched.
 
-JSONAMLNode::JSONAMLNode( std::wstring node )
+//Arrays smaller than this are scanned, hashing them isn't worth it
+#define JSONAML_INDEX_MIN_NODES 8
+
+static const wchar_t s_arrayText[] = L"ARRAY";
+static const wchar_t s_nodeText[] = L"NODE";
+
+//Value text -> first node with it, for one key
+struct JSONAMLKeyIndex
+{
+	std::unordered_map< std::wstring, JSONAMLNode * > exact;
+	std::unordered_map< std::wstring, JSONAMLNode * > lower;
+};
+
+struct JSONAMLArrIndex
+{
+	std::mutex lock;
+	std::unordered_map< std::wstring, JSONAMLKeyIndex > keys;
+};
+
+//Collects characters like "strn += c", but only keeps a range while they are contiguous
+struct JSONAMLAccum
+{
+	JSONAMLAccum( const wchar_t *text ) : base( text ), start( 0 ), end( 0 ), owned( false ){};
+
+	void Append( size_t i )
+	{
+		if( !owned )
+		{
+			if( start == end )
+			{
+				start = i;
+				end = i + 1;
+				return;
+			}
+			if( end == i )
+			{
+				++end;
+				return;
+			}
+			owned = true;
+			buf.assign( base + start, end - start );
+		}
+		buf.push_back( base[i] );
+	}
+
+	void Clear( )
+	{
+		start = end = 0;
+		owned = false;
+		buf.clear( );
+	}
+
+	size_t Size( ) const { return owned ? buf.size( ) : end - start; }
+
+	const wchar_t *base;
+	size_t start;
+	size_t end;
+	bool owned;
+	std::wstring buf;
+};
+
+static JSONAMLView AccumView( const JSONAMLAccum& acc, std::deque< std::wstring >& ownedText )
+{
+	if( !acc.owned )
+		return JSONAMLView( acc.base + acc.start, acc.end - acc.start );
+
+	ownedText.push_back( acc.buf );
+	return JSONAMLView( ownedText.back( ).data( ), ownedText.back( ).size( ) );
+}
+
+bool JSONAMLView::Equals( const std::wstring& other, bool caseSensitive ) const
+{
+	if( other.size( ) != size )
+		return false;
+
+	if( caseSensitive )
+		return other.compare( 0, size, data, size ) == 0;
+
+	for( size_t i = 0; i < size; ++i )
+	{
+		if( towlower( data[i] ) != towlower( other[i] ) )
+			return false;
+	}
+	return true;
+}
+
+const JSONAMLValue * JSONAMLNode::Find( const std::wstring& key ) const
+{
+	for( size_t i = 0; i < numValues; ++i )
+	{
+		if( values[i].key.Equals( key ) )
+			return &values[i].value;
+	}
+	return nullptr;
+}
+
+std::wstring JSONAMLNode::GetValue( const std::wstring& key ) const
+{
+	const JSONAMLValue *value = Find( key );
+	if( !value )
+		return std::wstring( );
+
+	//Same test as DetermineType( ) == T_STRING, without building a string first
+	const JSONAMLView& val = value->val;
+	if( val.size > 0 && val.data[0] == L'\"' && val.data[val.size - 1] == L'\"' )
+	{
+		if( val.size < 2 )
+			return std::wstring( );
+		return std::wstring( val.data + 1, val.size - 2 );
+	}
+	return val.str( );
+}
+
+JSONAMLValueArr * JSONAMLNode::GetArr( const std::wstring& key ) const
+{
+	const JSONAMLValue *value = Find( key );
+	if( !value || value->subNodeType != 2 )
+		return nullptr;
+	return value->arr;
+}
+
+JSONAMLNode * JSONAMLNode::GetNode( const std::wstring& key ) const
+{
+	const JSONAMLValue *value = Find( key );
+	if( !value || value->subNodeType != 1 )
+		return nullptr;
+	return value->node;
+}
+
+CJSONAMLParser::CJSONAMLParser( const std::wstring& filePath )
+{
+	std::wstring rawString = L"root:" + ReadFile( filePath.c_str() );
+
+	//Drop spaces and tabs outside of quotes and every line break, in one pass.
+	//Quote state counts the quotes after a character, like the old backwards scan.
+	size_t quotesAfter = 0;
+	for( size_t i = 0; i < rawString.size( ); ++i )
+	{
+		if( rawString[i] == L'\"' )
+			++quotesAfter;
+	}
+
+	m_text.reserve( rawString.size( ) );
+	for( size_t i = 0; i < rawString.size( ); ++i )
+	{
+		wchar_t c = rawString[i];
+		if( c == L'\"' )
+			--quotesAfter;
+		else if( ( c == L' ' || c == L'\t' ) && ( quotesAfter & 1 ) == 0 )
+			continue;
+		else if( c == L'\r' || c == L'\n' )
+			continue;
+
+		m_text.push_back( c );
+	}
+
+	int rootIndex = ParseNode( m_text.data( ), m_text.size( ) );
+	ResolveArena( );
+
+	root = &m_nodes[rootIndex];
+}
+
+int CJSONAMLParser::ParseNode( const wchar_t *text, size_t len )
 {
-	int index = 0;
+	size_t scratchBase = m_pairScratch.size( );
+
 	int arrDepth = 0;
 	int context = 0;
-	bool valueIsArray = 0;
+	bool valueIsArray = false;
 	bool isKey = true;
 
-	std::wstring curStrn;
-	std::wstring curKey;
-	std::wstring curValue;
+	JSONAMLAccum curStrn( text );
+	JSONAMLAccum curValue( text );
+	JSONAMLView curKey;
 
-	while( index < node.size( ) )
+	for( size_t index = 0; index < len; ++index )
 	{
-		if( node[index] == ':' && isKey )
+		wchar_t c = text[index];
+
+		if( c == ':' && isKey )
 		{
 			isKey = false;
-			curKey = curStrn;
-			curStrn.clear( );
+			curKey = AccumView( curStrn, m_ownedText );
+			curStrn.Clear( );
 		}
-		else if( node[index] == '[' )
+		else if( c == '[' )
 		{
 			if( !isKey && arrDepth == 0 )
 			{
 				valueIsArray = true;
 			}
-			
+
 			if( arrDepth > 0 )
-				curValue += node[index];
+				curValue.Append( index );
 
 			++arrDepth;
 		}
-		else if( node[index] == ']' && !isKey )
+		else if( c == ']' && !isKey )
 		{
 			--arrDepth;
 
 			if( arrDepth == 0 )
 			{
-				values[curKey] = std::make_unique<JSONAMLValueArr>( curValue );
-				curValue.clear( );
+				JSONAMLView content = AccumView( curValue, m_ownedText );
+
+				JSONAMLValue value = { };
+				value.subNodeType = 2;
+				value.child = ParseArray( content.data, content.size );
+				SetValue( scratchBase, curKey, value );
+
+				curValue.Clear( );
 			}
 			else
-				curValue += node[index];
+				curValue.Append( index );
 		}
-		else if( node[index] == '{' && !isKey && !valueIsArray )
+		else if( c == '{' && !isKey && !valueIsArray )
 		{
 			if( context > 0 )
-				curValue += node[index];
+				curValue.Append( index );
 			++context;
 		}
-		else if( node[index] == '}' && !isKey && !valueIsArray )
+		else if( c == '}' && !isKey && !valueIsArray )
 		{
 			--context;
 			if( context == 0 )
 			{
-				values[curKey] = std::make_unique<JSONAMLValueSubnode>( curValue );
-				curStrn.clear( );
-				curValue.clear( );
+				JSONAMLView content = AccumView( curValue, m_ownedText );
+
+				JSONAMLValue value = { };
+				value.val = JSONAMLView( s_nodeText, 4 );
+				value.subNodeType = 1;
+				value.child = ParseNode( content.data, content.size );
+				SetValue( scratchBase, curKey, value );
+
+				curStrn.Clear( );
+				curValue.Clear( );
 
 				valueIsArray = true; //Ignore existing behavour.
 			}
 			else
-				curValue += node[index];
+				curValue.Append( index );
 		}
-		else if( node[index] == ',' && arrDepth == 0 && context == 0 )
+		else if( c == ',' && arrDepth == 0 && context == 0 )
 		{
 			if( !valueIsArray )
 			{
-				values[curKey] = std::make_unique<JSONAMLValue>( curStrn.c_str( ) );
+				JSONAMLValue value = { };
+				value.val = AccumView( curStrn, m_ownedText );
+				value.subNodeType = 0;
+				SetValue( scratchBase, curKey, value );
 			}
 
 			valueIsArray = false;
 			isKey = true;
-			curStrn.clear( );
+			curStrn.Clear( );
 		}
 		else
 		{
-			if( (arrDepth > 0 || context > 0) && !isKey )
+			if( ( arrDepth > 0 || context > 0 ) && !isKey )
 			{
-				curValue += node[index];
+				curValue.Append( index );
 			}
-			curStrn += node[index];
+			curStrn.Append( index );
 		}
-		++index;
 	}
+
+	JSONAMLNode node = { };
+	node.firstValue = (int)m_pairs.size( );
+	node.numValues = m_pairScratch.size( ) - scratchBase;
+	m_pairs.insert( m_pairs.end( ), m_pairScratch.begin( ) + scratchBase, m_pairScratch.end( ) );
+	m_pairScratch.resize( scratchBase );
+
+	m_nodes.push_back( node );
+	return (int)m_nodes.size( ) - 1;
 }
 
-std::wstring JSONAMLNode::GetValue( const std::wstring& key )
+int CJSONAMLParser::ParseArray( const wchar_t *text, size_t len )
 {
-	if( DetermineType( values[key]->val ) == T_STRING )
+	size_t scratchBase = m_nodeScratch.size( );
+
+	int depth = 0;
+
+	JSONAMLAccum curStrn( text );
+	JSONAMLAccum curValue( text );
+
+	for( size_t index = 0; index < len; ++index )
+	{
+		wchar_t c = text[index];
+
+		if( c == '{' )
+		{
+			if( depth > 0 )
+			{
+				curValue.Append( index );
+			}
+
+			++depth;
+		}
+		else if( c == '}' )
+		{
+			--depth;
+
+			if( depth == 0 )
+			{
+				JSONAMLView content = AccumView( curValue, m_ownedText );
+				int node = ParseNode( content.data, content.size );
+				m_nodeScratch.push_back( node );
+
+				curValue.Clear( );
+				curStrn.Clear( );
+			}
+			else
+				curValue.Append( index );
+		}
+		else
+		{
+			if( depth > 0 )
+			{
+				curValue.Append( index );
+			}
+			curStrn.Append( index );
+		}
+	}
+
+	JSONAMLValueArr arr = { };
+	arr.val = JSONAMLView( s_arrayText, 5 );
+	arr.firstNode = (int)m_arrayNodeIndex.size( );
+	arr.numNodes = m_nodeScratch.size( ) - scratchBase;
+
+	if( curStrn.Size( ) > 0 && arr.numNodes == 0 )
 	{
-		std::wstring returnString;
-		returnString = values[key]->val.substr( 1, values[key]->val.size( ) - 2 );
+		arr.val = AccumView( curStrn, m_ownedText );
+	}
 
-		return returnString;
+	if( arr.numNodes >= JSONAML_INDEX_MIN_NODES )
+		arr.index = std::make_shared< JSONAMLArrIndex >( );
+
+	m_arrayNodeIndex.insert( m_arrayNodeIndex.end( ), m_nodeScratch.begin( ) + scratchBase, m_nodeScratch.end( ) );
+	m_nodeScratch.resize( scratchBase );
+
+	m_arrays.push_back( arr );
+	return (int)m_arrays.size( ) - 1;
+}
+
+void CJSONAMLParser::SetValue( size_t scratchBase, const JSONAMLView& key, const JSONAMLValue& value )
+{
+	//A repeated key overwrites, like assigning into a map
+	for( size_t i = scratchBase; i < m_pairScratch.size( ); ++i )
+	{
+		const JSONAMLView& other = m_pairScratch[i].key;
+		if( other.size == key.size && std::char_traits< wchar_t >::compare( other.data, key.data, key.size ) == 0 )
+		{
+			m_pairScratch[i].value = value;
+			return;
+		}
 	}
-	return values[key]->val;
+
+	JSONAMLPair pair;
+	pair.key = key;
+	pair.value = value;
+	m_pairScratch.push_back( pair );
 }
 
-CJSONAMLParser::CJSONAMLParser( const std::wstring& filePath )
+void CJSONAMLParser::ResolveArena( )
 {
-	std::wstring rawString = L"root:" + ReadFile( filePath.c_str() );
+	//Nothing grows past this point, so indices can turn into pointers
+	m_arrayNodes.resize( m_arrayNodeIndex.size( ) );
+	for( size_t i = 0; i < m_arrayNodeIndex.size( ); ++i )
+		m_arrayNodes[i] = &m_nodes[m_arrayNodeIndex[i]];
 
-	std::wstring proccess = KillWhitespace( rawString );
-	FindAndReplaceAll( proccess, L"\r", L"" );
-	FindAndReplaceAll( proccess, L"\n", L"" );
+	for( size_t i = 0; i < m_pairs.size( ); ++i )
+	{
+		JSONAMLValue& value = m_pairs[i].value;
+		if( value.subNodeType == 1 )
+			value.node = &m_nodes[value.child];
+		else if( value.subNodeType == 2 )
+		{
+			value.arr = &m_arrays[value.child];
+			value.val = value.arr->val;
+		}
+	}
+
+	for( size_t i = 0; i < m_nodes.size( ); ++i )
+		m_nodes[i].values = m_pairs.data( ) + m_nodes[i].firstValue;
 
-	root = std::make_unique< JSONAMLNode >( proccess );
+	for( size_t i = 0; i < m_arrays.size( ); ++i )
+		m_arrays[i].nodes = m_arrayNodes.data( ) + m_arrays[i].firstNode;
 }
 
 JSONAMLValueArr * CJSONAMLParser::GetValueAsArrNode( JSONAMLNode * node, const std::wstring& value )
 {
-	return (JSONAMLValueArr *)( node->values[value].get( ) );
+	return node->GetArr( value );
 }
 
 JSONAMLNode * CJSONAMLParser::FindNode( const std::wstring& key, const std::wstring& value, bool caseSensitive, JSONAMLNode * iroot )
 {
 	if( iroot == NULL )
 	{
-		JSONAMLValueArr * val = (JSONAMLValueArr *)( root->values[L"root"].get( ) );
+		JSONAMLValueArr * val = GetRootArray( );
+		if( !val )
+			return nullptr;
+
 		JSONAMLNode * node = val->LoopUpNode( key, value, caseSensitive );
 
 		if( node )
 			return node;
 		else
 		{
-			for( int i = 0; i < val->nodes.size( ); ++i )
+			for( size_t i = 0; i < val->numNodes; ++i )
 			{
-				JSONAMLNode *node = FindNode( key, value, caseSensitive, val->nodes[i].get( ) );
+				JSONAMLNode *node = FindNode( key, value, caseSensitive, val->nodes[i] );
 				if( node )
 					return node;
 			}
@@ -146,15 +434,44 @@ JSONAMLNode * CJSONAMLParser::FindNode( const std::wstring& key, const std::wstr
 	}
 	else
 	{
-		for( int i = 0; i < iroot->values.size( ); ++i )
+		//Search the arrays and subnodes below this node
+		for( size_t i = 0; i < iroot->numValues; ++i )
 		{
+			const JSONAMLValue& child = iroot->values[i].value;
+			if( child.subNodeType == 2 )
+			{
+				JSONAMLNode *node = child.arr->LoopUpNode( key, value, caseSensitive );
+				if( node )
+					return node;
+
+				for( size_t j = 0; j < child.arr->numNodes; ++j )
+				{
+					node = FindNode( key, value, caseSensitive, child.arr->nodes[j] );
+					if( node )
+						return node;
+				}
+			}
+			else if( child.subNodeType == 1 )
+			{
+				const JSONAMLValue *tested = child.node->Find( key );
+				if( tested && tested->val.Equals( value, caseSensitive ) )
+					return child.node;
 
+				JSONAMLNode *node = FindNode( key, value, caseSensitive, child.node );
+				if( node )
+					return node;
+			}
 		}
 	}
 
 	return nullptr;
 }
 
+JSONAMLValueArr * CJSONAMLParser::GetRootArray( )
+{
+	return root->GetArr( L"root" );
+}
+
 std::wstring CJSONAMLParser::SearchTest( )
 {
 	JSONAMLNode * node = FindNode( L"representations", L"0x2E" );
@@ -163,13 +480,14 @@ std::wstring CJSONAMLParser::SearchTest( )
 	output += node->GetValue(L"name").substr( 1, node->GetValue( L"name" ).size( ) - 2 );
 	output += L"( ";
 
-	int numArgs = GetValueAsArrNode( node, L"arguments" )->nodes.size( );
+	JSONAMLValueArr *args = GetValueAsArrNode( node, L"arguments" );
+	int numArgs = args->numNodes;
 	for( int i = 0; i < numArgs; ++i )
 	{
-		std::wstring temp = GetValueAsArrNode( node, L"arguments" )->nodes[i]->values[L"type"]->val;
+		std::wstring temp = args->nodes[i]->Find( L"type" )->val.str( );
 		temp = temp.substr( 1, temp.size( ) - 2 );
 		output += temp + L" ";
-		temp = GetValueAsArrNode( node, L"arguments" )->nodes[i]->values[L"name"]->val;
+		temp = args->nodes[i]->Find( L"name" )->val.str( );
 		temp = temp.substr( 1, temp.size( ) - 2 );
 		output += temp + L", ";
 	}
@@ -182,85 +500,46 @@ std::wstring CJSONAMLParser::SearchTest( )
 	//return std::wstring( );
 }
 
-JSONAMLValueArr::JSONAMLValueArr( std::wstring parseStrn )
+JSONAMLNode * JSONAMLValueArr::LoopUpNode( const std::wstring& key, const std::wstring& value, bool caseSensitive ) const
 {
-	val = L"ARRAY";
-	subNodeType = 2;
-
-	int index = 0;
-	int depth = 0;
-
-	std::wstring curStrn;
-	std::wstring curKey;
-	std::wstring curValue;
-
-	while( index < parseStrn.size( ) )
+	if( !index )
 	{
-		if( parseStrn[index] == '{' )
-		{
-			if( depth > 0 )
-			{
-				curValue += parseStrn[index];
-			}
-
-			++depth;
-		}
-		else if( parseStrn[index] == '}' )
-		{
-			--depth;
-
-			if( depth == 0 )
-			{
-				nodes.push_back( std::make_unique<JSONAMLNode>( curValue ) );
-				curValue.clear( );
-				curStrn.clear( );
-			}
-			else
-				curValue += parseStrn[index];
-		}
-		else
+		for( size_t i = 0; i < numNodes; ++i )
 		{
-			if( depth > 0 )
-			{
-				curValue += parseStrn[index];
-			}
-			curStrn += parseStrn[index];
+			const JSONAMLValue *tested = nodes[i]->Find( key );
+			if( tested && tested->val.Equals( value, caseSensitive ) )
+				return nodes[i];
 		}
-		++index;
+		return nullptr;
 	}
 
-	if( curStrn.size( ) > 0 && nodes.size() == 0 )
-	{
-		val = curStrn;
-	}
-}
+	std::lock_guard< std::mutex > guard( index->lock );
 
-JSONAMLNode * JSONAMLValueArr::LoopUpNode( const std::wstring& key, const std::wstring& value, bool caseSensitive )
-{
-	for( int i = 0; i < nodes.size( ); ++i )
+	auto it = index->keys.find( key );
+	if( it == index->keys.end( ) )
 	{
-		if( nodes[i]->values[key] )
+		//Built once per key, emplace keeps the first node like the scan does
+		JSONAMLKeyIndex& keyIndex = index->keys[key];
+		for( size_t i = 0; i < numNodes; ++i )
 		{
-			std::wstring compareValue( value.c_str() );
-			std::wstring testedValue( nodes[i]->values[key]->val.c_str() );
-
-			if( !caseSensitive )
+			const JSONAMLValue *tested = nodes[i]->Find( key );
+			if( tested )
 			{
-				compareValue = ConvertToLower( compareValue );
-				testedValue = ConvertToLower( testedValue );
+				std::wstring text = tested->val.str( );
+				keyIndex.lower.emplace( ConvertToLower( text ), nodes[i] );
+				keyIndex.exact.emplace( std::move( text ), nodes[i] );
 			}
-
-			if( testedValue == compareValue )
-				return nodes[i].get( );
 		}
+		it = index->keys.find( key );
 	}
-	return nullptr;
-}
 
-JSONAMLValueSubnode::JSONAMLValueSubnode( std::wstring parseStrn )
-{
-	val = L"NODE";
-	subNodeType = 1;
+	const JSONAMLKeyIndex& keyIndex = it->second;
+	if( caseSensitive )
+	{
+		auto found = keyIndex.exact.find( value );
+		return found != keyIndex.exact.end( ) ? found->second : nullptr;
+	}
 
-	node = std::make_unique<JSONAMLNode>( parseStrn );
+	auto found = keyIndex.lower.find( ConvertToLower( value ) );
+	return found != keyIndex.lower.end( ) ? found->second : nullptr;
 }
@@ -1,45 +1,76 @@
 #pragma once
 
-//Map is implied
-#include <map>
+#include <deque>
+#include <memory>
 
-struct JSONAMLValue
+struct JSONAMLNode;
+struct JSONAMLValueArr;
+struct JSONAMLArrIndex;
+
+//Slice of the parser's text, only valid while the parser lives
+struct JSONAMLView
 {
-	//Todo: More refined system
-	JSONAMLValue( ){};
+	JSONAMLView( ) : data( L"" ), size( 0 ){};
+	JSONAMLView( const wchar_t *text, size_t len ) : data( text ), size( len ){};
 
-	JSONAMLValue( std::wstring value )
-	{
-		val = value.c_str();
-		subNodeType = 0;
-	};
+	std::wstring str( ) const { return std::wstring( data, size ); }
+	bool Equals( const std::wstring& other, bool caseSensitive = true ) const;
 
-	std::wstring val;
-	unsigned char subNodeType;
+	const wchar_t *data;
+	size_t size;
 };
 
-struct JSONAMLNode
+struct JSONAMLValue
 {
-	JSONAMLNode( std::wstring nodeText );
-	std::wstring GetValue( const std::wstring& key );
+	//Raw text, "ARRAY" or "NODE" for containers.
+	JSONAMLView val;
+	//0 = plain value, 1 = subnode, 2 = array
+	unsigned char subNodeType;
+
+	JSONAMLNode *node;
+	JSONAMLValueArr *arr;
 
-	std::map< std::wstring, std::unique_ptr<JSONAMLValue> > values;
+	//Arena index of the node / array, only used while parsing
+	int child;
+};
+
+struct JSONAMLPair
+{
+	JSONAMLView key;
+	JSONAMLValue value;
 };
 
-struct JSONAMLValueArr : public JSONAMLValue
+struct JSONAMLNode
 {
-	JSONAMLValueArr( std::wstring parseStrn );
+	//Null if the key isn't in this node, nothing is inserted
+	const JSONAMLValue *Find( const std::wstring& key ) const;
+	//Value text with the quotes removed from strings, empty if missing
+	std::wstring GetValue( const std::wstring& key ) const;
+	JSONAMLValueArr *GetArr( const std::wstring& key ) const;
+	JSONAMLNode *GetNode( const std::wstring& key ) const;
 
-	JSONAMLNode * LoopUpNode( const std::wstring& key, const std::wstring& value, bool caseSensitive = false );
+	//Pairs in file order, a repeated key keeps its last value
+	JSONAMLPair *values;
+	size_t numValues;
 
-	std::vector< std::unique_ptr<JSONAMLNode> > nodes;
+	int firstValue;
 };
 
-struct JSONAMLValueSubnode : public JSONAMLValue
+struct JSONAMLValueArr
 {
-	JSONAMLValueSubnode( std::wstring parseStrn );
+	//First node whose key has this value. Larger arrays build a hash index per key on first use.
+	JSONAMLNode * LoopUpNode( const std::wstring& key, const std::wstring& value, bool caseSensitive = false ) const;
+
+	//"ARRAY", or the raw text for arrays without nodes
+	JSONAMLView val;
+
+	JSONAMLNode **nodes;
+	size_t numNodes;
 
-	std::unique_ptr<JSONAMLNode> node;
+	int firstNode;
+
+	//Only set for arrays worth indexing
+	std::shared_ptr< JSONAMLArrIndex > index;
 };
 
 class CJSONAMLParser
@@ -52,6 +83,30 @@ public:
 
 	std::wstring SearchTest( );
 
+	//Top level array of the file, or null if the file didn't parse
+	JSONAMLValueArr * GetRootArray( );
+
 protected:
-	std::unique_ptr<JSONAMLNode> root;
-};
\ No newline at end of file
+	//Text is parsed by range, nodes and arrays go to the arena below
+	int ParseNode( const wchar_t *text, size_t len );
+	int ParseArray( const wchar_t *text, size_t len );
+	void SetValue( size_t scratchBase, const JSONAMLView& key, const JSONAMLValue& value );
+	void ResolveArena( );
+
+	JSONAMLNode *root;
+
+	//File text with whitespace and line breaks removed
+	std::wstring m_text;
+	//Pieces that were not contiguous in m_text, deque keeps them in place
+	std::deque< std::wstring > m_ownedText;
+
+	std::vector< JSONAMLNode > m_nodes;
+	std::vector< JSONAMLValueArr > m_arrays;
+	std::vector< JSONAMLPair > m_pairs;
+	std::vector< int > m_arrayNodeIndex;
+	std::vector< JSONAMLNode * > m_arrayNodes;
+
+	//Per level scratch, nested parses push on top and pop back
+	std::vector< JSONAMLPair > m_pairScratch;
+	std::vector< int > m_nodeScratch;
+};
@@ -0,0 +1,96 @@
+#include "stdafx.h"
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <mutex>
+#include <chrono>
+#include "Log.h"
+
+//Info and debug text is held back until this much has built up, or the oldest of it has waited this long
+#define LOG_FLUSH_BYTES 8192
+#define LOG_FLUSH_MS 100
+
+LogLevel Log::level = LogLevel::Info;
+
+static std::mutex s_consoleLock;
+
+struct LogSink
+{
+	LogSink( ) : lastPrint( std::chrono::steady_clock::now( ) ) {};
+
+	//Hands the console every finished line, or everything when partial is set
+	void Print( bool partial )
+	{
+		std::wstring text = stream.str( );
+		//Without a newline rfind gives npos, which wraps to 0
+		size_t end = partial ? text.size( ) : text.rfind( L'\n' ) + 1;
+		lastPrint = std::chrono::steady_clock::now( );
+		if( end == 0 )
+			return;
+
+		{
+			std::lock_guard< std::mutex > lock( s_consoleLock );
+			std::wcout.write( text.data( ), end );
+			std::wcout.flush( );
+		}
+
+		stream.str( text.substr( end ) );
+		stream.seekp( 0, std::ios_base::end );
+	}
+
+	std::wostringstream stream;
+	std::chrono::steady_clock::time_point lastPrint;
+};
+
+//Created on first use, so a thread that never logs costs nothing
+static thread_local LogSink *t_sink = nullptr;
+
+//Prints whatever a thread left behind when it ends
+struct LogSinkOwner
+{
+	~LogSinkOwner( )
+	{
+		if( !t_sink )
+			return;
+		t_sink->Print( true );
+		delete t_sink;
+		t_sink = nullptr;
+	}
+};
+static thread_local LogSinkOwner t_sinkOwner;
+
+static LogSink& Sink( )
+{
+	if( !t_sink )
+	{
+		//Touching the owner makes sure it is constructed, and destroyed, on this thread
+		(void)&t_sinkOwner;
+		t_sink = new LogSink( );
+	}
+	return *t_sink;
+}
+
+std::wostringstream& Log::Stream( )
+{
+	return Sink( ).stream;
+}
+
+void Log::Commit( LogLevel messageLevel )
+{
+	LogSink& sink = Sink( );
+	if( messageLevel >= LogLevel::Warning )
+	{
+		sink.Print( true );
+		return;
+	}
+
+	if( sink.stream.tellp( ) >= LOG_FLUSH_BYTES || std::chrono::steady_clock::now( ) - sink.lastPrint >= std::chrono::milliseconds( LOG_FLUSH_MS ) )
+		sink.Print( false );
+}
+
+void Log::Flush( )
+{
+	if( t_sink )
+		t_sink->Print( true );
+}
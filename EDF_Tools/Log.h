@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+
+enum class LogLevel
+{
+	Debug, //Per record detail, only shown with --verbose
+	Info, //What a conversion is doing
+	Warning,
+	Error,
+	None //Nothing gets through
+};
+
+//All console output goes through here. Each thread builds its text in its own buffer and hands the console whole lines,
+//so threads don't interleave mid line and a batch run isn't held up by a console write per value.
+class Log
+{
+public:
+	//Messages below this are dropped before anything is formatted. --quiet raises it to Warning, --verbose lowers it to Debug.
+	static LogLevel level;
+
+	static bool Enabled( LogLevel messageLevel ) { return messageLevel >= level; }
+
+	//Buffered text of the calling thread, LogLine adds to it
+	static std::wostringstream& Stream( );
+	//Ends a message. Warnings and errors are printed at once, the rest when the buffer fills up or has waited too long.
+	static void Commit( LogLevel messageLevel );
+	//Prints everything the calling thread has buffered, a line it hasn't finished too
+	static void Flush( );
+};
+
+//One message, built with << and committed when the line goes out of scope
+class LogLine
+{
+public:
+	LogLine( LogLevel level ) : m_level( level ), m_enabled( Log::Enabled( level ) ) {};
+	~LogLine( )
+	{
+		if( m_enabled )
+			Log::Commit( m_level );
+	}
+
+	template< typename T > LogLine& operator<<( const T& value )
+	{
+		if( m_enabled )
+			Log::Stream( ) << value;
+		return *this;
+	}
+
+	//std::endl, std::hex and the like
+	LogLine& operator<<( std::wostream& ( *manip )( std::wostream& ) )
+	{
+		if( m_enabled )
+			manip( Log::Stream( ) );
+		return *this;
+	}
+	LogLine& operator<<( std::ios_base& ( *manip )( std::ios_base& ) )
+	{
+		if( m_enabled )
+			manip( Log::Stream( ) );
+		return *this;
+	}
+
+private:
+	LogLevel m_level;
+	bool m_enabled;
+};
+
+inline LogLine LogDebug( ) { return LogLine( LogLevel::Debug ); }
+inline LogLine LogInfo( ) { return LogLine( LogLevel::Info ); }
+inline LogLine LogWarning( ) { return LogLine( LogLevel::Warning ); }
+inline LogLine LogError( ) { return LogLine( LogLevel::Error ); }
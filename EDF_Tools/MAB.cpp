@@ -2,27 +2,32 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <algorithm>
 
 #include "Middleware.h"
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "MAB.h"
 #include "include/tinyxml2.h"
 
 //Read data from MAB
-void MAB::Read(const std::wstring& path)
+bool MAB::Read(const std::wstring& path)
 {
-	std::ifstream file(path + L".mab", std::ios::binary | std::ios::ate | std::ios::in);
-
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
-
-	std::vector<char> buffer(size);
-	if (file.read(buffer.data(), size))
+	StageTimer timer("MAB>XML", StatStage::Read);
+	MappedFile file;
+	if (file.Open(path + L".mab"))
 	{
+		ByteSpan buffer = file.Span();
+		timer.AddBytes(buffer.size());
+		timer.Next(StatStage::Parse);
 		// create xml
 		tinyxml2::XMLDocument xml;
 		xml.InsertFirstChild(xml.NewDeclaration());
@@ -34,40 +39,53 @@ void MAB::Read(const std::wstring& path)
 
 		ReadData(buffer, xmlMain, xmlHeader);
 		
+		timer.Next(StatStage::Serialize);
 		std::string outfile = WideToUTF8(path) + "_DATA.xml";
-		xml.SaveFile(outfile.c_str());
+		if (xml.SaveFile(outfile.c_str()) != tinyxml2::XML_SUCCESS)
+		{
+			LogError() << L"Can't write " << UTF8ToWide(outfile) << L"\n";
+			return false;
+		}
 		/*
 		tinyxml2::XMLPrinter printer;
 		xml.Accept(&printer);
 		auto xmlString = std::string{ printer.CStr() };
 
-		std::wcout << UTF8ToWide(xmlString) + L"\n";
+		LogInfo() << UTF8ToWide(xmlString) + L"\n";
 		*/
 	}
+	else
+	{
+		LogError() << L"Can't read " << path << L".mab\n";
+		return false;
+	}
 
-	//Clear buffers
-	buffer.clear();
-	file.close();
+	//Unmap the file
+	file.Close();
+	return true;
 }
 
-void MAB::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
+void MAB::ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+	m_strings.Reset(buffer);
+
 	int position = 0;
 	unsigned char seg[4];
 	// read header, length is 0x24
-	memcpy(&seg, &buffer[0], 4U);
+	reader.Get(0, seg);
 	//if (seg[0] == 0x4D && seg[1] == 0x41 && seg[2] == 0x42 && seg[3] == 0x00)
 
 	// get count
-	memcpy(&BoneCount, &buffer[0xC], 2U);
-	memcpy(&AnimationCount, &buffer[0xE], 2U);
-	memcpy(&FloatGroupCount, &buffer[0x10], 2U);
-	memcpy(&StringSize, &buffer[0x12], 2U);
+	reader.Get(0xC, BoneCount);
+	reader.Get(0xE, AnimationCount);
+	reader.Get(0x10, FloatGroupCount);
+	reader.Get(0x12, StringSize);
 	// get offset
-	memcpy(&BoneOffset, &buffer[0x14], 4U);
-	memcpy(&AnimationOffset, &buffer[0x18], 4U);
-	memcpy(&FloatGroupOffset, &buffer[0x1C], 4U);
-	memcpy(&StringOffset, &buffer[0x20], 4U);
+	reader.Get(0x14, BoneOffset);
+	reader.Get(0x18, AnimationOffset);
+	reader.Get(0x1C, FloatGroupOffset);
+	reader.Get(0x20, StringOffset);
 
 	// read bone or point
 	tinyxml2::XMLElement* xmlBone = header->InsertNewChildElement("Bone");
@@ -90,14 +108,16 @@ void MAB::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header
 	}
 }
 
-void MAB::ReadBoneData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlBone, tinyxml2::XMLElement* xmlHeader)
+void MAB::ReadBoneData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlBone, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+
 	// get int16
 	short value[2];
-	memcpy(&value, &buffer[curpos], 4U);
+	reader.Get(curpos, value);
 	// get offset
 	int offset;
-	memcpy(&offset, &buffer[curpos + 4], 4U);
+	reader.Get(curpos + 4, offset);
 	// output data
 	tinyxml2::XMLElement* xmlBNode = xmlBone->InsertNewChildElement("value");
 	xmlBNode->SetAttribute("ID", value[0]);
@@ -110,38 +130,26 @@ void MAB::ReadBoneData(const std::vector<char>& buffer, int curpos, tinyxml2::XM
 
 		// get string offset
 		int strofs[2];
-		memcpy(&strofs, &buffer[ptrpos], 8U);
+		reader.Get(ptrpos, strofs);
 		// get string
-		std::wstring wstr;
-		std::string utf8str;
 		// str1
-		if (strofs[0] > 0)
-			wstr = ReadUnicode(buffer, strofs[0]);
-		else
-			wstr = L"";
-		utf8str = WideToUTF8(wstr);
-		xmlBPtr->SetAttribute("ExportBone", utf8str.c_str());
+		xmlBPtr->SetAttribute("ExportBone", strofs[0] > 0 ? m_strings.Get(strofs[0]) : "");
 		// str2
-		if (strofs[1] > 0)
-			wstr = ReadUnicode(buffer, strofs[1]);
-		else
-			wstr = L"";
-		utf8str = WideToUTF8(wstr);
-		xmlBPtr->SetAttribute("Parent", utf8str.c_str());
+		xmlBPtr->SetAttribute("Parent", strofs[1] > 0 ? m_strings.Get(strofs[1]) : "");
 
 		// get type
 		int type;
-		memcpy(&type, &buffer[ptrpos + 8], 4U);
+		reader.Get(ptrpos + 8, type);
 		xmlBPtr->SetAttribute("Type", type);
 
 		ReadBoneTypeData(type, buffer, ptrpos, xmlBPtr);
 
 		// unknown
 		int vi[2];
-		memcpy(&vi, &buffer[ptrpos + 0x18], 8U);
+		reader.Get(ptrpos + 0x18, vi);
 		xmlBPtr->SetAttribute("unknown", vi[0]);
 		if (vi[0] != 0)
-			std::wcout << L"Unknown value at position: " + ToString(ptrpos + 8) + L" - value: " + ToString(vi[0]) + L"\n";
+			LogWarning() << L"Unknown value at position: " + ToString(ptrpos + 8) + L" - value: " + ToString(vi[0]) + L"\n";
 
 		// read extra
 		std::string namestr = "MAB_" + std::to_string(buffer.size()) + "_" + std::to_string(vi[1]);
@@ -151,33 +159,35 @@ void MAB::ReadBoneData(const std::vector<char>& buffer, int curpos, tinyxml2::XM
 	// end
 }
 
-void MAB::ReadBoneTypeData(int type, const std::vector<char>& buffer, int ptrpos, tinyxml2::XMLElement* xmlBPtr)
+void MAB::ReadBoneTypeData(int type, const ByteSpan& buffer, int ptrpos, tinyxml2::XMLElement* xmlBPtr)
 {
+	ByteReaderLE reader(buffer);
+
 	if (type == 0)
 	{
 		tinyxml2::XMLElement* xmlNode;
 
 		// get offset of float group
 		int fofs;
-		memcpy(&fofs, &buffer[ptrpos + 0xC], 4U);
+		reader.Get(ptrpos + 0xC, fofs);
 		// set float group
 		xmlNode = xmlBPtr->InsertNewChildElement("floatgroup");
 		xmlNode->SetAttribute("name", "location");
 		float vf[4];
-		memcpy(&vf, &buffer[fofs], 16U);
+		reader.Get(fofs, vf);
 		Read4FloatData(xmlNode, vf);
 
 		// get float
 		xmlNode = xmlBPtr->InsertNewChildElement("float");
 		xmlNode->SetAttribute("name", "scale");
 		float fvalue;
-		memcpy(&fvalue, &buffer[ptrpos + 0x10], 4U);
+		reader.Get(ptrpos + 0x10, fvalue);
 		xmlNode->SetText(fvalue);
 
 		// get int
 		xmlNode = xmlBPtr->InsertNewChildElement("int");
 		int ivalue;
-		memcpy(&ivalue, &buffer[ptrpos + 0x14], 4U);
+		reader.Get(ptrpos + 0x14, ivalue);
 		xmlNode->SetText(ivalue);
 	}
 	else if (type == 1)
@@ -186,13 +196,13 @@ void MAB::ReadBoneTypeData(int type, const std::vector<char>& buffer, int ptrpos
 
 		// get offset of float group
 		int fofs[2];
-		memcpy(&fofs, &buffer[ptrpos + 0xC], 8U);
+		reader.Get(ptrpos + 0xC, fofs);
 		// set float group
 		for (int j = 0; j < 2; j++)
 		{
 			xmlNode = xmlBPtr->InsertNewChildElement("floatgroup");
 			float vf[4];
-			memcpy(&vf, &buffer[fofs[j]], 16U);
+			reader.Get(fofs[j], vf);
 			// output type help
 			switch (j)
 			{
@@ -212,20 +222,20 @@ void MAB::ReadBoneTypeData(int type, const std::vector<char>& buffer, int ptrpos
 		// get int
 		xmlNode = xmlBPtr->InsertNewChildElement("int");
 		int ivalue;
-		memcpy(&ivalue, &buffer[ptrpos + 0x14], 4U);
+		reader.Get(ptrpos + 0x14, ivalue);
 		xmlNode->SetText(ivalue);
 	}
 	else if (type == 2)
 	{
 		// get offset of float group
 		int fofs[3];
-		memcpy(&fofs, &buffer[ptrpos + 0xC], 12U);
+		reader.Get(ptrpos + 0xC, fofs);
 		// set float group
 		for (int j = 0; j < 3; j++)
 		{
 			tinyxml2::XMLElement* xmlNode = xmlBPtr->InsertNewChildElement("floatgroup");
 			float vf[4];
-			memcpy(&vf, &buffer[fofs[j]], 16U);
+			reader.Get(fofs[j], vf);
 			// output type help
 			switch (j)
 			{
@@ -251,34 +261,33 @@ void MAB::ReadBoneTypeData(int type, const std::vector<char>& buffer, int ptrpos
 
 		// get offset of float group 1
 		int fofs1;
-		memcpy(&fofs1, &buffer[ptrpos + 0xC], 4U);
+		reader.Get(ptrpos + 0xC, fofs1);
 		// set float group
 		xmlNode = xmlBPtr->InsertNewChildElement("floatgroup");
 		xmlNode->SetAttribute("name", "location");
 		float vf1[4];
-		memcpy(&vf1, &buffer[fofs1], 16U);
+		reader.Get(fofs1, vf1);
 		Read4FloatData(xmlNode, vf1);
 
 		// get float
 		xmlNode = xmlBPtr->InsertNewChildElement("float");
 		float fvalue;
-		memcpy(&fvalue, &buffer[ptrpos + 0x10], 4U);
+		reader.Get(ptrpos + 0x10, fvalue);
 		xmlNode->SetText(fvalue);
 
 		// get offset of float group 2
 		int fofs2;
-		memcpy(&fofs2, &buffer[ptrpos + 0x14], 4U);
+		reader.Get(ptrpos + 0x14, fofs2);
 		// set float group
 		xmlNode = xmlBPtr->InsertNewChildElement("floatgroup");
 		xmlNode->SetAttribute("name", "c");
 		float vf2[4];
-		memcpy(&vf2, &buffer[fofs2], 16U);
+		reader.Get(fofs2, vf2);
 		Read4FloatData(xmlNode, vf2);
 	}
 	else
 	{
-		std::wcout << L"Unknown type at position: " + ToString(ptrpos + 8) + L" - ";
-		std::wcout << L"Type: " + ToString(type) + L"\n";
+		LogWarning() << L"Unknown type at position: " + ToString(ptrpos + 8) + L" - " << L"Type: " + ToString(type) + L"\n";
 	}
 }
 
@@ -297,7 +306,7 @@ void MAB::Read4FloatData(tinyxml2::XMLElement* xmlNode, float* vf)
 	*/
 }
 
-void MAB::ReadExtraSGO(std::string& namestr, const std::vector<char>& buffer, int pos, tinyxml2::XMLElement*& xmlHeader)
+void MAB::ReadExtraSGO(std::string& namestr, const ByteSpan& buffer, int pos, tinyxml2::XMLElement*& xmlHeader)
 {
 	// check for duplicate data
 	bool subexist = false;
@@ -321,11 +330,13 @@ void MAB::ReadExtraSGO(std::string& namestr, const std::vector<char>& buffer, in
 	}
 }
 
-void MAB::ReadAnimeData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlAnm, tinyxml2::XMLElement* xmlHeader)
+void MAB::ReadAnimeData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlAnm, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+
 	// get value
 	int value[4];
-	memcpy(&value, &buffer[curpos], 16U);
+	reader.Get(curpos, value);
 	// output data
 	tinyxml2::XMLElement* xmlANode = xmlAnm->InsertNewChildElement("value");
 	//xmlANode->SetAttribute("debugpos", curpos);
@@ -333,11 +344,7 @@ void MAB::ReadAnimeData(const std::vector<char>& buffer, int curpos, tinyxml2::X
 	// value[2] is string
 	tinyxml2::XMLElement* xmlstr = xmlANode->InsertNewChildElement("name");
 	if (value[2] > 0)
-	{
-		std::wstring wstr = ReadUnicode(buffer, value[2]);
-		std::string utf8str = WideToUTF8(wstr);
-		xmlstr->SetText(utf8str.c_str());
-	}
+		xmlstr->SetText(m_strings.Get(value[2]));
 
 	// value[3] is count
 	tinyxml2::XMLElement* xmlANode1 = xmlANode->InsertNewChildElement("ptrA");
@@ -356,62 +363,72 @@ void MAB::ReadAnimeData(const std::vector<char>& buffer, int curpos, tinyxml2::X
 	if (value[1] > 0)
 	{
 		unsigned int check;
-		memcpy(&check, &buffer[value[1]], 4U);
+		reader.Get(value[1], check);
 		if (check != 0xBABABABA)
-			std::wcout << L"Check the pointed data: " + ToString(value[1]) + L"\n";
+			LogWarning() << L"Check the pointed data: " + ToString(value[1]) + L"\n";
 	}
 }
 
-void MAB::ReadAnimeDataA(const std::vector<char>& buffer, int pos, tinyxml2::XMLElement* xmlNode, tinyxml2::XMLElement* xmlHeader)
+void MAB::ReadAnimeDataA(const ByteSpan& buffer, int pos, tinyxml2::XMLElement* xmlNode, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+
 	tinyxml2::XMLElement* xmlptr = xmlNode->InsertNewChildElement("value");
 	//xmlptr->SetAttribute("debugpos", pos);
 
 	// get name
 	int strofs;
-	memcpy(&strofs, &buffer[pos], 4U);
+	reader.Get(pos, strofs);
 
-	std::wstring wstr = ReadUnicode(buffer, strofs);
-	std::string utf8str = WideToUTF8(wstr);
-	xmlptr->SetAttribute("name", utf8str.c_str());
+	xmlptr->SetAttribute("name", m_strings.Get(strofs));
 
 	// set float
 	float vf;
-	memcpy(&vf, &buffer[pos + 4], 4U);
+	reader.Get(pos + 4, vf);
 	xmlptr->SetAttribute("float", vf);
 
 	// set unknown
 	int unk;
-	memcpy(&unk, &buffer[pos + 8], 4U);
+	reader.Get(pos + 8, unk);
 	xmlptr->SetAttribute("unk", unk);
 
 	// get sgo
 	int sgoofs;
-	memcpy(&sgoofs, &buffer[pos + 12], 4U);
+	reader.Get(pos + 12, sgoofs);
 
 	std::string namestr = "MAB_" + std::to_string(buffer.size()) + "_" + std::to_string(sgoofs);
 	xmlptr->SetAttribute("extra", namestr.c_str());
 	ReadExtraSGO(namestr, buffer, sgoofs, xmlHeader);
 }
 
-void MAB::Write(const std::wstring& path, tinyxml2::XMLNode* header)
+bool MAB::Write(const std::wstring& path, tinyxml2::XMLNode* header)
 {
-	std::wcout << "Will output MAB file.\n";
+	LogInfo() << "Will output MAB file.\n";
 
 	tinyxml2::XMLElement* mainData = header->FirstChildElement("Main");
 
+	StageTimer timer("XML>MAB", StatStage::Build);
 	std::vector< char > bytes;
 	bytes = WriteData(mainData, header);
 
 	//Final write.
 	/**/
-	std::ofstream newFile(path + L".mab", std::ios::binary | std::ios::out | std::ios::ate);
+	timer.Next(StatStage::Write);
+	std::ofstream newFile(ToFilePath(path + L".mab"), std::ios::binary | std::ios::out | std::ios::ate);
 
 	newFile.write(bytes.data(), bytes.size());
 
 	newFile.close();
+	if (!newFile)
+	{
+		LogError() << L"Can't write " + path + L".mab\n";
+		return false;
+	}
+	timer.AddBytes(bytes.size());
+	timer.Stop();
 	
-	std::wcout << L"Conversion completed: " + path + L".mab\n";
+	LogInfo() << L"Conversion completed: " + path + L".mab\n";
+	return true;
 }
 
 std::vector<char> MAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNode* header)
@@ -551,15 +568,15 @@ std::vector<char> MAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNo
 	bytes[4] = 0x0F;
 	bytes[8] = 0x03;
 	// count
-	memcpy(&bytes[0xC], &BoneCount, 2U);
-	memcpy(&bytes[0xE], &AnimationCount, 2U);
-	memcpy(&bytes[0x10], &FloatGroupCount, 2U);
-	memcpy(&bytes[0x12], &StringSize, 2U);
+	ByteWriterLE(bytes).Set(0xC, BoneCount);
+	ByteWriterLE(bytes).Set(0xE, AnimationCount);
+	ByteWriterLE(bytes).Set(0x10, FloatGroupCount);
+	ByteWriterLE(bytes).Set(0x12, StringSize);
 	//offset
 	bytes[0x14] = 0x24;
-	memcpy(&bytes[0x18], &AnimationOffset, 4U);
-	memcpy(&bytes[0x1C], &FloatGroupOffset, 4U);
-	memcpy(&bytes[0x20], &StringOffset, 4U);
+	ByteWriterLE(bytes).Set(0x18, AnimationOffset);
+	ByteWriterLE(bytes).Set(0x1C, FloatGroupOffset);
+	ByteWriterLE(bytes).Set(0x20, StringOffset);
 
 	// write bone
 	for (size_t i = 0; i < boneData.size(); i++)
@@ -611,16 +628,16 @@ std::vector<char> MAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNo
 
 	// debug only
 	/*
-	std::wcout << L"BoneCount: " + ToString(BoneCount) + L"\n";
-	std::wcout << L"BonePtrNum: " + ToString(BonePtrNum) + L"\n";
-	std::wcout << L"AnimationCount: " + ToString(AnimationCount) + L"\n";
-	std::wcout << L"animePtrNum: " + ToString(animePtrNum) + L"\n";
+	LogDebug() << L"BoneCount: " + ToString(BoneCount) + L"\n";
+	LogDebug() << L"BonePtrNum: " + ToString(BonePtrNum) + L"\n";
+	LogDebug() << L"AnimationCount: " + ToString(AnimationCount) + L"\n";
+	LogDebug() << L"animePtrNum: " + ToString(animePtrNum) + L"\n";
 
-	std::wcout << L"FloatGroupOffset: " + ToString(FloatGroupOffset) + L"\n";
-	std::wcout << L"FloatGroupCount: " + ToString(FloatGroupCount) + L"\n";
-	std::wcout << L"FloatGroupSize: " + ToString(i_floatSize) + L"\n";
+	LogDebug() << L"FloatGroupOffset: " + ToString(FloatGroupOffset) + L"\n";
+	LogDebug() << L"FloatGroupCount: " + ToString(FloatGroupCount) + L"\n";
+	LogDebug() << L"FloatGroupSize: " + ToString(i_floatSize) + L"\n";
 
-	std::wcout << L"Extra Data End: " + ToString(i_extraPos) + L"\n";
+	LogDebug() << L"Extra Data End: " + ToString(i_extraPos) + L"\n";
 	*/
 	return bytes;
 }
@@ -676,7 +693,7 @@ void MAB::GetMABFloatGroup(tinyxml2::XMLElement* entry3)
 		out.pos = FloatGroupOffset + (FloatGroup.size() * 0x10);
 		// output bytes
 		out.bytes.resize(0x10);
-		memcpy(&out.bytes[0], &out.f, 16U);
+		ByteWriterLE(out.bytes).Set(0, out.f);
 		// check for duplicates
 		bool isExist = false;
 		for (size_t i = 0; i < FloatGroup.size(); i++)
@@ -755,8 +772,8 @@ MABData MAB::GetMABBoneData(tinyxml2::XMLElement* entry2, int ptrpos)
 	}
 	// push bytes
 	out.bytes.resize(0x8);
-	memcpy(&out.bytes[0], &value, 4U);
-	memcpy(&out.bytes[4], &offset, 4U);
+	ByteWriterLE(out.bytes).Set(0, value);
+	ByteWriterLE(out.bytes).Set(4, offset);
 
 	return out;
 }
@@ -774,12 +791,12 @@ MABData MAB::GetMABBonePtrData(tinyxml2::XMLElement* entry3)
 	// 2
 	str = entry3->Attribute("Parent");
 	pos[1] = GetMABStringOffset(str);
-	memcpy(&out.bytes[0], &pos, 8U);
+	ByteWriterLE(out.bytes).Set(0, pos);
 
 	// get type and value
 	int type;
 	type = entry3->IntAttribute("Type");
-	memcpy(&out.bytes[0x8], &type, 4U);
+	ByteWriterLE(out.bytes).Set(0x8, type);
 	// type is not checked now
 	//if (type == 0)
 	int ptr[3];
@@ -792,7 +809,7 @@ MABData MAB::GetMABBonePtrData(tinyxml2::XMLElement* entry3)
 	entry4 = entry4->NextSiblingElement();
 	ptr[2] = GetMABBonePtrValue(entry4);
 
-	memcpy(&out.bytes[0xC], &ptr, 12U);
+	ByteWriterLE(out.bytes).Set(0xC, ptr);
 
 	// get unknown and extra
 	int value[2];
@@ -800,7 +817,7 @@ MABData MAB::GetMABBonePtrData(tinyxml2::XMLElement* entry3)
 	// get extra
 	str = entry3->Attribute("extra");
 	value[1] = GetMABExtraOffset(str);
-	memcpy(&out.bytes[0x18], &value, 8U);
+	ByteWriterLE(out.bytes).Set(0x18, value);
 
 	return out;
 }
@@ -881,7 +898,7 @@ MABData MAB::GetMABAnimeData(tinyxml2::XMLElement* entry2, int ptrpos, int nullp
 
 	// push bytes
 	out.bytes.resize(0x10);
-	memcpy(&out.bytes[0], &offset, 16U);
+	ByteWriterLE(out.bytes).Set(0, offset);
 
 	return out;
 }
@@ -896,11 +913,11 @@ MABData MAB::GetMABAnimePtrData(tinyxml2::XMLElement* entry3, int nullpos)
 	// get string
 	str = entry3->Attribute("name");
 	int pos = GetMABStringOffset(str);
-	memcpy(&out.bytes[0], &pos, 4U);
+	ByteWriterLE(out.bytes).Set(0, pos);
 
 	// get float
 	float vf = entry3->FloatAttribute("float");
-	memcpy(&out.bytes[4], &vf, 4U);
+	ByteWriterLE(out.bytes).Set(4, vf);
 
 	// get unknown and extra
 	int value[2];
@@ -908,7 +925,7 @@ MABData MAB::GetMABAnimePtrData(tinyxml2::XMLElement* entry3, int nullpos)
 	// get extra
 	str = entry3->Attribute("extra");
 	value[1] = GetMABExtraOffset(str);
-	memcpy(&out.bytes[8], &value, 8U);
+	ByteWriterLE(out.bytes).Set(8, value);
 
 	return out;
 }
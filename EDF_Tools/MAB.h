@@ -1,4 +1,5 @@
 #pragma once
+#include "StringTable.h"
 
 struct MABString
 {
@@ -30,16 +31,16 @@ struct MABData
 class MAB
 {
 public:
-	void Read(const std::wstring& path);
-	void ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
-	void ReadBoneData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlBone, tinyxml2::XMLElement* xmlHeader);
-	void ReadBoneTypeData(int type, const std::vector<char>& buffer, int ptrpos, tinyxml2::XMLElement* xmlBPtr);
+	bool Read(const std::wstring& path);
+	void ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
+	void ReadBoneData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlBone, tinyxml2::XMLElement* xmlHeader);
+	void ReadBoneTypeData(int type, const ByteSpan& buffer, int ptrpos, tinyxml2::XMLElement* xmlBPtr);
 	void Read4FloatData(tinyxml2::XMLElement* xmlNode, float* vf);
-	void ReadExtraSGO(std::string& namestr, const std::vector<char>& buffer, int pos, tinyxml2::XMLElement*& xmlHeader);
-	void ReadAnimeData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlAnm, tinyxml2::XMLElement* xmlHeader);
-	void ReadAnimeDataA(const std::vector<char>& buffer, int pos, tinyxml2::XMLElement* xmlNode, tinyxml2::XMLElement* xmlHeader);
+	void ReadExtraSGO(std::string& namestr, const ByteSpan& buffer, int pos, tinyxml2::XMLElement*& xmlHeader);
+	void ReadAnimeData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlAnm, tinyxml2::XMLElement* xmlHeader);
+	void ReadAnimeDataA(const ByteSpan& buffer, int pos, tinyxml2::XMLElement* xmlNode, tinyxml2::XMLElement* xmlHeader);
 
-	void Write(const std::wstring& path, tinyxml2::XMLNode* header);
+	bool Write(const std::wstring& path, tinyxml2::XMLNode* header);
 	std::vector< char > WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNode* header);
 	void GetMABString(std::string namestr);
 	void GetMABExtraDataName(tinyxml2::XMLElement* data);
@@ -73,6 +74,8 @@ private:
 	std::vector< MABFloatGroup > FloatGroup;
 	std::vector< std::string > SubDataGroup;
 	std::vector< MABExtraData > ExtraData;
+	// bone and animation names of the file being read
+	UTF16StringTable m_strings;
 
 	//only wrtie
 	std::vector< MABData > boneData;
@@ -2,12 +2,20 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <sstream>
+#include <stdexcept>
+#include <algorithm>
 
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "MDB.h"
 #include "include/tinyxml2.h"
 #include "include/half.hpp"
@@ -17,28 +25,25 @@
 
 int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 {
-	std::ifstream file(path + L".mdb", std::ios::binary | std::ios::ate | std::ios::in);
-
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
-
-	std::vector<char> buffer(size);
-	if (file.read(buffer.data(), size))
+	StageTimer timer("MDB>XML", StatStage::Read);
+	MappedFile file;
+	if (file.Open(path + L".mdb"))
 	{
-		unsigned char seg[4];
+		ByteSpan buffer = file.Span();
+		timer.AddBytes(buffer.size());
+		timer.Next(StatStage::Parse);
+		ByteReaderLE reader(buffer);
 
 		int position = 0;
 
-		Read4BytesReversed(seg, buffer, position);
-
 		bool validHeader = false;
-		if (seg[0] == 0x4D && seg[1] == 0x44 && seg[2] == 0x42 && seg[3] == 0x30)
+		if (buffer.size() >= 4 && reader.Get<uint32_t>(position) == 0x3042444D) // "MDB0"
 			validHeader = true;
 
 		if (!validHeader)
 		{
-			std::wcout << L"BAD FILE\n";
-			file.close();
+			LogError() << L"BAD FILE\n";
+			file.Close();
 			return -1;
 		}
 
@@ -51,48 +56,38 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 
 		// Name
 		position = 0x8;
-		Read4Bytes(seg, buffer, position);
-		NameTableCount = GetIntFromChunk(seg);
+		NameTableCount = reader.Get<int32_t>(position);
 
 		position = 0x0C;
-		Read4Bytes(seg, buffer, position);
-		NameTableOffset = GetIntFromChunk(seg);
+		NameTableOffset = reader.Get<int32_t>(position);
 
 		// Bone
 		position = 0x10;
-		Read4Bytes(seg, buffer, position);
-		BoneCount = GetIntFromChunk(seg);
+		BoneCount = reader.Get<int32_t>(position);
 
 		position = 0x14;
-		Read4Bytes(seg, buffer, position);
-		BoneOffset = GetIntFromChunk(seg);
+		BoneOffset = reader.Get<int32_t>(position);
 
 		// Object
 		position = 0x18;
-		Read4Bytes(seg, buffer, position);
-		ObjectCount = GetIntFromChunk(seg);
+		ObjectCount = reader.Get<int32_t>(position);
 
 		position = 0x1C;
-		Read4Bytes(seg, buffer, position);
-		ObjectOffset = GetIntFromChunk(seg);
+		ObjectOffset = reader.Get<int32_t>(position);
 
 		// Material
 		position = 0x20;
-		Read4Bytes(seg, buffer, position);
-		MaterialCount = GetIntFromChunk(seg);
+		MaterialCount = reader.Get<int32_t>(position);
 
 		position = 0x24;
-		Read4Bytes(seg, buffer, position);
-		MaterialOffset = GetIntFromChunk(seg);
+		MaterialOffset = reader.Get<int32_t>(position);
 
 		// Object
 		position = 0x28;
-		Read4Bytes(seg, buffer, position);
-		TextureCount = GetIntFromChunk(seg);
+		TextureCount = reader.Get<int32_t>(position);
 
 		position = 0x2C;
-		Read4Bytes(seg, buffer, position);
-		TextureOffset = GetIntFromChunk(seg);
+		TextureOffset = reader.Get<int32_t>(position);
 
 		// Read
 		// name table:
@@ -101,7 +96,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 			tinyxml2::XMLElement* xmlName = xmlHeader->InsertNewChildElement("Names");
 			xmlName->SetAttribute("debug_allcount", NameTableCount);
 
-			std::wcout << L"Getting name list...... ";
+			LogInfo() << L"Getting name list...... ";
 
 			std::string utf8str; 
 			for (int i = 0; i < NameTableCount; i++)
@@ -119,7 +114,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					xmlNameVal->SetAttribute("index", i);
 				}
 			}
-			std::wcout << L"Completed!\n";
+			LogInfo() << L"Completed!\n";
 		}
 		// texture table:
 		if (TextureCount > 0)
@@ -127,7 +122,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 			tinyxml2::XMLElement* xmlTex = xmlHeader->InsertNewChildElement("Textures");
 			xmlTex->SetAttribute("count", TextureCount);
 
-			std::wcout << L"Getting texture list...... ";
+			LogInfo() << L"Getting texture list...... ";
 
 			std::string utf8str;
 			for (int i = 0; i < TextureCount; i++)
@@ -153,7 +148,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 				xmlTexVal->SetAttribute("raw", utf8str.c_str());
 			}
 			//xmlTexVal->InsertNewText(utf8str.c_str());
-			std::wcout << L"Completed!\n";
+			LogInfo() << L"Completed!\n";
 		}
 		// get bone list
 		if (BoneCount > 0)
@@ -161,7 +156,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 			tinyxml2::XMLElement* xmlBoneList = xmlHeader->InsertNewChildElement("BoneLists");
 			xmlBoneList->SetAttribute("count", BoneCount);
 
-			std::wcout << L"Getting bone list...... ";
+			LogInfo() << L"Getting bone list...... ";
 
 			std::string utf8str; 
 			for (int i = 0; i < BoneCount; i++)
@@ -197,7 +192,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					tinyxml2::XMLElement* xmlBNode = xmlBone->InsertNewChildElement("weight");
 					unsigned char seg[4];
 
-					Read4BytesReversed(seg, buffer, tpos);
+					reader.Get(tpos, seg, 4);
 					xmlBNode->SetAttribute("x", seg[0]);
 					xmlBNode->SetAttribute("y", seg[1]);
 					xmlBNode->SetAttribute("z", seg[2]);
@@ -211,7 +206,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					tinyxml2::XMLElement* xmlBNode = xmlBone->InsertNewChildElement("mainTM");
 					float bf[4];
 
-					memcpy(&bf, &buffer[tpos], 16U);
+					reader.Get(tpos, bf, 4);
 					xmlBNode->SetAttribute("x", bf[0]);
 					xmlBNode->SetAttribute("y", bf[1]);
 					xmlBNode->SetAttribute("z", bf[2]);
@@ -225,7 +220,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					tinyxml2::XMLElement* xmlBNode = xmlBone->InsertNewChildElement("skinTM");
 					float bf[4];
 
-					memcpy(&bf, &buffer[tpos], 16U);
+					reader.Get(tpos, bf, 4);
 					xmlBNode->SetAttribute("x", bf[0]);
 					xmlBNode->SetAttribute("y", bf[1]);
 					xmlBNode->SetAttribute("z", bf[2]);
@@ -238,7 +233,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					tinyxml2::XMLElement* xmlBNode = xmlBone->InsertNewChildElement("position");
 					float bf[4];
 
-					memcpy(&bf, &buffer[tpos], 16U);
+					reader.Get(tpos, bf, 4);
 					xmlBNode->SetAttribute("x", bf[0]);
 					xmlBNode->SetAttribute("y", bf[1]);
 					xmlBNode->SetAttribute("z", bf[2]);
@@ -251,7 +246,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					tinyxml2::XMLElement* xmlBNode = xmlBone->InsertNewChildElement("float");
 					float bf[4];
 
-					memcpy(&bf, &buffer[tpos], 16U);
+					reader.Get(tpos, bf, 4);
 					xmlBNode->SetAttribute("x", bf[0]);
 					xmlBNode->SetAttribute("y", bf[1]);
 					xmlBNode->SetAttribute("z", bf[2]);
@@ -262,7 +257,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					xmlBNode->SetAttribute("debugPos", tpos);
 				}
 			}
-			std::wcout << L"Completed!\n\n";
+			LogInfo() << L"Completed!\n\n";
 		}
 		// get object list
 		if (ObjectCount > 0)
@@ -270,7 +265,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 			tinyxml2::XMLElement* xmlObjList = xmlHeader->InsertNewChildElement("ObjectLists");
 			xmlObjList->SetAttribute("count", ObjectCount);
 
-			std::wcout << L"Getting model list:\n";
+			LogInfo() << L"Getting model list:\n";
 
 			std::string utf8str; 
 			for (int i = 0; i < ObjectCount; i++)
@@ -291,7 +286,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 				xmlObjName->SetText(utf8str.c_str());
 
 				xmlObj->SetAttribute("count", objects.back().infoCount);
-				std::wcout << L"Model parsing:" + names[tempint].idname + L"\n";
+				LogInfo() << L"Model parsing:" + names[tempint].idname + L"\n";
 				// get mesh info
 				for (int j = 0; j < objects.back().infoCount; j++)
 				{
@@ -324,8 +319,8 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					tinyxml2::XMLElement* xmlVertexList = xmlMesh->InsertNewChildElement("VertexList");
 					xmlVertexList->SetAttribute("Count", Vnum);
 
-					std::wcout << L"Get count:" + ToString(Vnum) + L"\n";
-					std::wcout << L"Layout count:" + ToString(Layoutnum) + L"\n";
+					LogDebug() << L"Get count:" + ToString(Vnum) + L"\n";
+					LogDebug() << L"Layout count:" + ToString(Layoutnum) + L"\n";
 					int Vsize = objects_info.back().VertexSize;
 					//Read Layout Info
 					for (int k = 0; k < Layoutnum; k++)
@@ -347,9 +342,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					//Read Vertex
 					if (!onecore)
 					{
-						SYSTEM_INFO sysInfo;
-						GetSystemInfo(&sysInfo);
-						int threads_num = sysInfo.dwNumberOfProcessors;
+						int threads_num = (std::max)(1, (int)std::thread::hardware_concurrency());
 						// Read vertices using multiple cores
 						std::vector<std::thread> threads;
 						threads.reserve(static_cast<size_t>(threads_num));
@@ -379,7 +372,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 										xmlVertex->InsertNewChildElement("debug")->SetAttribute("pos", Voffset);
 										mtx.unlock();
 
-										std::wcout << L"vertex type:" + UTF8ToWide(curstr) + L"\n";
+										LogDebug() << L"vertex type:" + UTF8ToWide(curstr) + L"\n";
 										//Read data
 										ReadVertexMT(mtx, Voffset, buffer, Vtype, Vnum, Vsize, xmlVertex);
 										//output result
@@ -388,7 +381,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 								else
 								{
 									threads.emplace_back([th]() {
-										std::wcout << L"no tasks are assigned to thread "+ ToString(th) + L"\n";
+										LogDebug() << L"no tasks are assigned to thread "+ ToString(th) + L"\n";
 										});
 								}
 								// end
@@ -400,7 +393,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 							threads.clear();
 
 							//output result
-							std::wcout << L"parsing complete.\n";
+							LogDebug() << L"parsing complete.\n";
 						}
 					}
 					else
@@ -419,11 +412,11 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 							int Voffset = curpos + objects_info.back().VertexOffset + curoffset;
 							xmlVertex->InsertNewChildElement("debug")->SetAttribute("pos", Voffset);
 
-							std::wcout << L"vertex type:" + UTF8ToWide(curstr) + L", ";
+							LogDebug() << L"vertex type:" + UTF8ToWide(curstr) + L", ";
 							//Read data
 							ReadVertex(Voffset, buffer, Vtype, Vnum, Vsize, xmlVertex);
 							//output result
-							std::wcout << L"parsing complete.\n";
+							LogDebug() << L"parsing complete.\n";
 						}
 					}
 					//Clear temp
@@ -431,8 +424,8 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					
 					//Read faces
 					int iNum = objects_info.back().indicesNum;
-					std::wcout << L"Read faces......\n";
-					std::wcout << L"Get count:" + ToString(iNum) + L"\n";
+					LogDebug() << L"Read faces......\n";
+					LogDebug() << L"Get count:" + ToString(iNum) + L"\n";
 					//Unify with the name in 3dmax
 					tinyxml2::XMLElement* xmlIndices = xmlMesh->InsertNewChildElement("Faces");
 					xmlIndices->SetAttribute("Count", iNum);
@@ -454,17 +447,17 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 							int16 |= seg[i];
 						}
 						*/
-						memcpy(&uint16, &buffer[newcurpos], 2U);
+						uint16 = reader.Get<uint16_t>(newcurpos);
 						//xmlNode->SetAttribute("pos", newcurpos);
 						xmlNode->SetAttribute("value", uint16);
 						//xmlNode->SetText(ReadInt16(buffer, newcurpos));
 					}
-					std::wcout << L"complete.\n";
+					LogDebug() << L"complete.\n";
 				}
 				//mark 3
 			}
 			//mark 2
-			std::wcout << L"Completed!\n\n";
+			LogInfo() << L"Completed!\n\n";
 		}
 		// last get material table:
 		if (MaterialCount > 0)
@@ -472,7 +465,7 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 			tinyxml2::XMLElement* xmlMatHeader = xmlHeader->InsertNewChildElement("Materials");
 			xmlMatHeader->SetAttribute("count", MaterialCount);
 
-			std::wcout << L"Getting material list...... ";
+			LogInfo() << L"Getting material list...... ";
 
 			std::string utf8str;
 			for (int i = 0; i < MaterialCount; i++)
@@ -587,42 +580,53 @@ int CMDBtoXML::Read(const std::wstring& path, bool onecore)
 					xmlMatTexRaw->SetAttribute("inPos", curpos + 0x8);
 				}
 			}
-			std::wcout << L"Completed!\n\n";
+			LogInfo() << L"Completed!\n\n";
 		}
 		// Read End!
 		
 		// Write to file
+		timer.Next(StatStage::Serialize);
 		std::string outfile = WideToUTF8(path) + "_MDB.xml";
-		xml.SaveFile(outfile.c_str());
+		if (xml.SaveFile(outfile.c_str()) != tinyxml2::XML_SUCCESS)
+		{
+			LogError() << L"Can't write " << UTF8ToWide(outfile) << L"\n";
+			return -1;
+		}
 		/*
 		tinyxml2::XMLPrinter printer;
 		xml.Accept(&printer);
 		auto xmlString = std::string{ printer.CStr() };
 
-		std::wcout << UTF8ToWide(xmlString);
+		LogInfo() << UTF8ToWide(xmlString);
 		FindAndReplaceAll(xmlString, "\n", "\r\n");
 		
-		std::ofstream output(path + L"_MDB.xml", std::ios::binary | std::ios::out | std::ios::ate);
+		std::ofstream output(ToFilePath(path + L"_MDB.xml"), std::ios::binary | std::ios::out | std::ios::ate);
 		
 		std::locale utf8_locale(output.getloc(), new std::codecvt_utf8<wchar_t>);
 		output.imbue(utf8_locale);
 		output << xmlString;
 		output.close();
 		*/
-		file.close();
+		file.Close();
+	}
+	else
+	{
+		LogError() << L"Can't read " << path << L".mdb\n";
+		return -1;
 	}
+
+	return 1;
 }
 
-MDBName CMDBtoXML::ReadMDBName(int pos, const std::vector<char>& buffer)
+MDBName CMDBtoXML::ReadMDBName(int pos, const ByteSpan& buffer)
 {
 	MDBName out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	int offset = 0;
 
 	int position = pos;
-	Read4Bytes(seg, buffer, position);
-	offset = GetIntFromChunk(seg);
+	offset = reader.Get<int32_t>(position);
 	if (offset > 0)
 		out.idname = ReadUnicode(buffer, pos + offset);
 	else
@@ -631,246 +635,213 @@ MDBName CMDBtoXML::ReadMDBName(int pos, const std::vector<char>& buffer)
 	return out;
 }
 
-MDBBone CMDBtoXML::ReadBone(int pos, const std::vector<char>& buffer)
+MDBBone CMDBtoXML::ReadBone(int pos, const ByteSpan& buffer)
 {
 	MDBBone out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	int offset = 0;
 	// this is index
 	int position = pos;
-	Read4Bytes(seg, buffer, position);
-	out.index[0] = GetIntFromChunk(seg);
+	out.index[0] = reader.Get<int32_t>(position);
 	// this is parent
 	position = pos + 0x4;
-	Read4Bytes(seg, buffer, position);
-	out.index[1] = GetIntFromChunk(seg);
+	out.index[1] = reader.Get<int32_t>(position);
 
 	position = pos + 0x8;
-	Read4Bytes(seg, buffer, position);
-	out.index[2] = GetIntFromChunk(seg);
+	out.index[2] = reader.Get<int32_t>(position);
 	position = pos + 0x0C;
-	Read4Bytes(seg, buffer, position);
-	out.index[3] = GetIntFromChunk(seg);
+	out.index[3] = reader.Get<int32_t>(position);
 	// this may be index of bone name
 	position = pos + 0x10;
-	Read4Bytes(seg, buffer, position);
-	out.index[4] = GetIntFromChunk(seg);
+	out.index[4] = reader.Get<int32_t>(position);
 
 	// number of bones currently connected to the current bone
 	position = pos + 0x14;
-	Read4Bytes(seg, buffer, position);
-	out.childrenNum = GetIntFromChunk(seg);
+	out.childrenNum = reader.Get<int32_t>(position);
 
 	return out;
 }
 
-MDBMaterial CMDBtoXML::ReadMaterial(int pos, const std::vector<char>& buffer)
+MDBMaterial CMDBtoXML::ReadMaterial(int pos, const ByteSpan& buffer)
 {
 	MDBMaterial out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	int offset = 0;
 
 	int position = pos + 0x4;
-	Read4Bytes(seg, buffer, position);
-	out.matid = GetIntFromChunk(seg);
+	out.matid = reader.Get<int32_t>(position);
 
 	position = pos + 0x8;
-	Read4Bytes(seg, buffer, position);
-	offset = GetIntFromChunk(seg);
+	offset = reader.Get<int32_t>(position);
 	out.shader = ReadUnicode(buffer, pos + offset);
 	// next
 	position = pos + 0x0C;
-	Read4Bytes(seg, buffer, position);
-	out.PtrOffset = GetIntFromChunk(seg);
+	out.PtrOffset = reader.Get<int32_t>(position);
 
 	position = pos + 0x10;
-	Read4Bytes(seg, buffer, position);
-	out.PtrCount = GetIntFromChunk(seg);
+	out.PtrCount = reader.Get<int32_t>(position);
 
 	position = pos + 0x14;
-	Read4Bytes(seg, buffer, position);
-	out.TexOffset = GetIntFromChunk(seg);
+	out.TexOffset = reader.Get<int32_t>(position);
 
 	position = pos + 0x18;
-	Read4Bytes(seg, buffer, position);
-	out.TexCount = GetIntFromChunk(seg);
+	out.TexCount = reader.Get<int32_t>(position);
 
 	return out;
 }
 
-MDBMaterialPtr CMDBtoXML::ReadMaterialPtr(int pos, const std::vector<char>& buffer)
+MDBMaterialPtr CMDBtoXML::ReadMaterialPtr(int pos, const ByteSpan& buffer)
 {
 	MDBMaterialPtr out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	float f;
 	int offset = 0;
 
 	int position = pos;
 	//Read4BytesReversed(seg, buffer, position);
 	//memcpy(&f, &seg, sizeof(f));
-	memcpy(&f, &buffer[position], 4U);
+	f = reader.Get<float>(position);
 	out.r = f;
 
 	position = pos + 0x4;
-	memcpy(&f, &buffer[position], 4U);
+	f = reader.Get<float>(position);
 	out.g = f;
 
 	position = pos + 0x8;
-	memcpy(&f, &buffer[position], 4U);
+	f = reader.Get<float>(position);
 	out.b = f;
 
 	position = pos + 0x0C;
-	memcpy(&f, &buffer[position], 4U);
+	f = reader.Get<float>(position);
 	out.a = f;
 
 	position = pos + 0x18;
-	Read4Bytes(seg, buffer, position);
-	offset = GetIntFromChunk(seg);
+	offset = reader.Get<int32_t>(position);
 	out.ptrname = ReadASCII(buffer, pos + offset);
 
 	return out;
 }
 
-MDBMaterialTex CMDBtoXML::ReadMaterialTex(int pos, const std::vector<char>& buffer)
+MDBMaterialTex CMDBtoXML::ReadMaterialTex(int pos, const ByteSpan& buffer)
 {
 	MDBMaterialTex out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	int offset = 0;
 
 	int position = pos;
-	Read4Bytes(seg, buffer, position);
-	out.texid = GetIntFromChunk(seg);
+	out.texid = reader.Get<int32_t>(position);
 
 	position = pos + 0x4;
-	Read4Bytes(seg, buffer, position);
-	offset = GetIntFromChunk(seg);
+	offset = reader.Get<int32_t>(position);
 	out.textype = ReadASCII(buffer, pos + offset);
 
 	return out;
 }
 
-MDBObject CMDBtoXML::ReadObject(int pos, const std::vector<char>& buffer)
+MDBObject CMDBtoXML::ReadObject(int pos, const ByteSpan& buffer)
 {
 	MDBObject out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	int offset = 0;
 
 	int position = pos;
-	Read4Bytes(seg, buffer, position);
-	out.ID = GetIntFromChunk(seg);
+	out.ID = reader.Get<int32_t>(position);
 
 	position = pos + 0x4;
-	Read4Bytes(seg, buffer, position);
-	out.Nameid = GetIntFromChunk(seg);
+	out.Nameid = reader.Get<int32_t>(position);
 
 	position = pos + 0x8;
-	Read4Bytes(seg, buffer, position);
-	out.infoCount = GetIntFromChunk(seg);
+	out.infoCount = reader.Get<int32_t>(position);
 
 	position = pos + 0x0C;
-	Read4Bytes(seg, buffer, position);
-	out.infoOffset = GetIntFromChunk(seg);
+	out.infoOffset = reader.Get<int32_t>(position);
 
 	return out;
 }
 
-MDBObjectInfo CMDBtoXML::ReadObjectInfo(int pos, const std::vector<char>& buffer)
+MDBObjectInfo CMDBtoXML::ReadObjectInfo(int pos, const ByteSpan& buffer)
 {
 	MDBObjectInfo out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	int offset = 0;
 	short int16;
 
 	int position = pos + 0x4;
-	Read4Bytes(seg, buffer, position);
-	out.matid = GetIntFromChunk(seg);
+	out.matid = reader.Get<int32_t>(position);
 
 	position = pos + 0x0C;
-	Read4Bytes(seg, buffer, position);
-	out.LayoutOffset = GetIntFromChunk(seg);
+	out.LayoutOffset = reader.Get<int32_t>(position);
 
 	position = pos + 0x10;
-	memcpy(&int16, &buffer[position], 2U);
+	int16 = reader.Get<int16_t>(position);
 	out.VertexSize = int16;
 	//out.VertexSize = ReadInt16(buffer, position);
 	position = pos + 0x12;
-	memcpy(&int16, &buffer[position], 2U);
+	int16 = reader.Get<int16_t>(position);
 	out.LayoutCount = int16;
 
 	position = pos + 0x14;
-	Read4Bytes(seg, buffer, position);
-	out.VertexNum = GetIntFromChunk(seg);
+	out.VertexNum = reader.Get<int32_t>(position);
 
 	position = pos + 0x18;
-	Read4Bytes(seg, buffer, position);
-	out.MeshIndex = GetIntFromChunk(seg);
+	out.MeshIndex = reader.Get<int32_t>(position);
 
 	position = pos + 0x1C;
-	Read4Bytes(seg, buffer, position);
-	out.VertexOffset = GetIntFromChunk(seg);
+	out.VertexOffset = reader.Get<int32_t>(position);
 
 	position = pos + 0x20;
-	Read4Bytes(seg, buffer, position);
-	out.indicesNum = GetIntFromChunk(seg);
+	out.indicesNum = reader.Get<int32_t>(position);
 
 	position = pos + 0x24;
-	Read4Bytes(seg, buffer, position);
-	out.indicesOffset = GetIntFromChunk(seg);
+	out.indicesOffset = reader.Get<int32_t>(position);
 
 	return out;
 }
 
-MDBObjectLayout CMDBtoXML::ReadObjectLayout(int pos, const std::vector<char>& buffer)
+MDBObjectLayout CMDBtoXML::ReadObjectLayout(int pos, const ByteSpan& buffer)
 {
 	MDBObjectLayout out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 
 	int position = pos;
-	Read4Bytes(seg, buffer, position);
-	out.type = GetIntFromChunk(seg);
+	out.type = reader.Get<int32_t>(position);
 
 	position = pos + 0x4;
-	Read4Bytes(seg, buffer, position);
-	out.offset = GetIntFromChunk(seg);
+	out.offset = reader.Get<int32_t>(position);
 
 	position = pos + 0x8;
-	Read4Bytes(seg, buffer, position);
-	out.channel = GetIntFromChunk(seg);
+	out.channel = reader.Get<int32_t>(position);
 
 	position = pos + 0x0C;
-	Read4Bytes(seg, buffer, position);
-	int offset = GetIntFromChunk(seg);
+	int offset = reader.Get<int32_t>(position);
 	out.name = ReadASCII(buffer, pos + offset);
 
 	return out;
 }
 
-MDBTexture CMDBtoXML::ReadTexture(int pos, const std::vector<char>& buffer)
+MDBTexture CMDBtoXML::ReadTexture(int pos, const ByteSpan& buffer)
 {
 	MDBTexture out;
 
-	unsigned char seg[4];
+	ByteReaderLE reader(buffer);
 	int offset = 0;
 
 	int position = pos;
-	Read4Bytes(seg, buffer, position);
-	out.ID = GetIntFromChunk(seg);
+	out.ID = reader.Get<int32_t>(position);
 
 	position = pos + 0x4;
-	Read4Bytes(seg, buffer, position);
-	offset = GetIntFromChunk(seg);
+	offset = reader.Get<int32_t>(position);
 	out.mapping = ReadUnicode(buffer, pos + offset);
 
 	position = pos + 0x8;
-	Read4Bytes(seg, buffer, position);
-	offset = GetIntFromChunk(seg);
+	offset = reader.Get<int32_t>(position);
 	out.filename = ReadUnicode(buffer, pos + offset);
 	
 	position = pos + 0xC;
@@ -879,8 +850,10 @@ MDBTexture CMDBtoXML::ReadTexture(int pos, const std::vector<char>& buffer)
 	return out;
 }
 
-void CMDBtoXML::ReadVertex(int pos, const std::vector<char>& buffer, int type, int num, int size, tinyxml2::XMLElement* header)
+void CMDBtoXML::ReadVertex(int pos, const ByteSpan& buffer, int type, int num, int size, tinyxml2::XMLElement* header)
 {
+	ByteReaderLE reader(buffer);
+
 	if (type == 1)
 	{
 		float vf[4];
@@ -889,7 +862,7 @@ void CMDBtoXML::ReadVertex(int pos, const std::vector<char>& buffer, int type, i
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf, &buffer[Vcurpos], 16U);
+			reader.Get(Vcurpos, vf, 4);
 
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
 			xmlVNode->SetAttribute("x", vf[0]);
@@ -906,7 +879,7 @@ void CMDBtoXML::ReadVertex(int pos, const std::vector<char>& buffer, int type, i
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf, &buffer[Vcurpos], 12U);
+			reader.Get(Vcurpos, vf, 3);
 
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
 			xmlVNode->SetAttribute("x", vf[0]);
@@ -922,7 +895,7 @@ void CMDBtoXML::ReadVertex(int pos, const std::vector<char>& buffer, int type, i
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf, &buffer[Vcurpos], 8U);
+			reader.Get(Vcurpos, vf, 4);
 
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
 			xmlVNode->SetAttribute("x", vf[0]);
@@ -939,7 +912,7 @@ void CMDBtoXML::ReadVertex(int pos, const std::vector<char>& buffer, int type, i
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf, &buffer[Vcurpos], 8U);
+			reader.Get(Vcurpos, vf, 2);
 
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
 			xmlVNode->SetAttribute("x", vf[0]);
@@ -954,7 +927,7 @@ void CMDBtoXML::ReadVertex(int pos, const std::vector<char>& buffer, int type, i
 			int Vcurpos = pos + (l * size);
 			//The performance of this function is too poor
 			//Read4BytesReversed(seg, buffer, Vcurpos);
-			memcpy(&seg, &buffer[Vcurpos], 4U);
+			reader.Get(Vcurpos, seg, 4);
 
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
 			xmlVNode->SetAttribute("x", seg[0]);
@@ -971,8 +944,10 @@ void CMDBtoXML::ReadVertex(int pos, const std::vector<char>& buffer, int type, i
 	}
 }
 
-void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const std::vector<char>& buffer, int type, int num, int size, tinyxml2::XMLElement* header)
+void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const ByteSpan& buffer, int type, int num, int size, tinyxml2::XMLElement* header)
 {
+	ByteReaderLE reader(buffer);
+
 	if (type == 1)
 	{
 		struct ModelVertex
@@ -986,7 +961,7 @@ void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const std::vector<char>&
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf[l], &buffer[Vcurpos], 16U);
+			reader.Get(Vcurpos, vf[l].vf, 4);
 
 			//Locking, it seems to become a single core, but does not affect the efficiency?
 			std::lock_guard<std::mutex> lk(mtx);
@@ -1010,7 +985,7 @@ void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const std::vector<char>&
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf[l], &buffer[Vcurpos], 12U);
+			reader.Get(Vcurpos, vf[l].vf, 3);
 
 			std::lock_guard<std::mutex> lk(mtx);
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
@@ -1032,7 +1007,7 @@ void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const std::vector<char>&
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf[l], &buffer[Vcurpos], 8U);
+			reader.Get(Vcurpos, vf[l].vf, 4);
 
 			std::lock_guard<std::mutex> lk(mtx);
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
@@ -1055,7 +1030,7 @@ void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const std::vector<char>&
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf[l], &buffer[Vcurpos], 8U);
+			reader.Get(Vcurpos, vf[l].vf, 2);
 
 			std::lock_guard<std::mutex> lk(mtx);
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
@@ -1076,7 +1051,7 @@ void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const std::vector<char>&
 		{
 			int Vcurpos = pos + (l * size);
 
-			memcpy(&vf[l], &buffer[Vcurpos], 4U);
+			reader.Get(Vcurpos, vf[l].vf, 4);
 
 			std::lock_guard<std::mutex> lk(mtx);
 			tinyxml2::XMLElement* xmlVNode = header->InsertNewChildElement("V");
@@ -1104,16 +1079,27 @@ void CMDBtoXML::ReadVertexMT(std::mutex& mtx, int pos, const std::vector<char>&
 	}
 }
 
-void CXMLToMDB::Write(const std::wstring& path, bool multcore)
+bool CXMLToMDB::Write(const std::wstring& path, bool multcore)
 {
 	std::wstring sourcePath = path + L"_mdb.xml";
 	//std::wstring FileRaw = ReadFile(sourcePath.c_str());
 	std::string UTF8Path = WideToUTF8(sourcePath);
 
+	StageTimer timer("XML>MDB", StatStage::Parse);
 	tinyxml2::XMLDocument doc;
-	doc.LoadFile(UTF8Path.c_str());
+	if (doc.LoadFile(UTF8Path.c_str()) != tinyxml2::XML_SUCCESS)
+	{
+		LogError() << L"Can't read " + sourcePath + L"\n";
+		return false;
+	}
 
+	timer.Next(StatStage::Build);
 	tinyxml2::XMLNode* header = doc.FirstChildElement("MDB");
+	if (!header)
+	{
+		LogError() << L"No MDB element in " + sourcePath + L"\n";
+		return false;
+	}
 	tinyxml2::XMLElement* entry, * entry2;
 
 	// read model name table (if there is)
@@ -1122,11 +1108,11 @@ void CXMLToMDB::Write(const std::wstring& path, bool multcore)
 	if (entry == nullptr)
 	{
 		NoNameTable = true;
-		std::wcout << L"Name table does not exist.\n";
+		LogInfo() << L"Name table does not exist.\n";
 	}
 	else
 	{
-		std::wcout << L"Name table exists.\nLoad name table:\n";
+		LogInfo() << L"Name table exists.\nLoad name table:\n";
 		for (entry2 = entry->FirstChildElement("value"); entry2 != 0; entry2 = entry2->NextSiblingElement("value"))
 		{
 			std::string tempName = entry2->GetText();
@@ -1137,9 +1123,9 @@ void CXMLToMDB::Write(const std::wstring& path, bool multcore)
 
 			NameCount++;
 
-			std::wcout << modelName + L", ";
+			LogDebug() << modelName + L", ";
 		}
-		std::wcout << L"\nLoading completed!\n\n";
+		LogInfo() << L"\nLoading completed!\n\n";
 	}
 	// read texture table (if there is)
 	bool NoTexTable = false;
@@ -1147,72 +1133,66 @@ void CXMLToMDB::Write(const std::wstring& path, bool multcore)
 	if (entry == nullptr)
 	{
 		NoTexTable = true;
-		std::wcout << L"Texture table does not exist.\n";
+		LogInfo() << L"Texture table does not exist.\n";
 	}
 	else
 	{
-		std::wcout << L"Texture table exists. Use texture table...\n";
+		LogInfo() << L"Texture table exists. Use texture table...\n";
 		for (entry2 = entry->FirstChildElement("value"); entry2 != 0; entry2 = entry2->NextSiblingElement("value"))
 		{
 			m_vecTexture.push_back( GetTexture(entry2) );
 		}
-		std::wcout << L"Loading completed!\n\n";
+		LogInfo() << L"Loading completed!\n\n";
 	}
 	// read bone list (it must exist)
 	entry = header->FirstChildElement("BoneLists");
 	if (entry == nullptr)
 	{
-		std::wcout << L"Required \'BoneLists\' do not exist!\n";
-		//terminate program
-		system("pause");
-		exit(0);
+		LogError() << L"Required \'BoneLists\' do not exist!\n";
+		throw std::runtime_error("MDB xml is missing BoneLists");
 	}
 	else
 	{
-		std::wcout << L"Converting BoneLists:\n";
+		LogInfo() << L"Converting BoneLists:\n";
 		for (entry2 = entry->FirstChildElement(); entry2 != 0; entry2 = entry2->NextSiblingElement("Bone"))
 		{
 			m_vecBone.push_back( GetBone(entry2, NoNameTable) );
 		}
-		std::wcout << L"-> bone count: " + ToString(BoneCount) + L"\n\n";
+		LogInfo() << L"-> bone count: " + ToString(BoneCount) + L"\n\n";
 	}
 	// read model list (it must exist)
 	entry = header->FirstChildElement("ObjectLists");
 	if (entry == nullptr)
 	{
-		std::wcout << L"Required \'ObjectLists\' do not exist!\n";
-		//terminate program
-		system("pause");
-		exit(0);
+		LogError() << L"Required \'ObjectLists\' do not exist!\n";
+		throw std::runtime_error("MDB xml is missing ObjectLists");
 	}
 	else
 	{
-		std::wcout << L"Converting objects:\n";
+		LogInfo() << L"Converting objects:\n";
 		for (entry2 = entry->FirstChildElement(); entry2 != 0; entry2 = entry2->NextSiblingElement("Object"))
 		{
-			std::wcout << L"read model:\n";
+			LogDebug() << L"read model:\n";
 			m_vecObject.push_back( GetModel(entry2, NoNameTable, multcore) );
-			std::wcout << L"write model complete!\n\n";
+			LogDebug() << L"write model complete!\n\n";
 		}
-		std::wcout << L"-> object count: " + ToString(ObjectCount) + L"\n\n";
+		LogInfo() << L"-> object count: " + ToString(ObjectCount) + L"\n\n";
 	}
 	// read material list (it must exist)
 	entry = header->FirstChildElement("Materials");
 	if (entry == nullptr)
 	{
-		std::wcout << L"Required \'Materials\' do not exist!\n";
-		//terminate program
-		system("pause");
-		exit(0);
+		LogError() << L"Required \'Materials\' do not exist!\n";
+		throw std::runtime_error("MDB xml is missing Materials");
 	}
 	else
 	{
-		std::wcout << L"Converting Materials:\n";
+		LogInfo() << L"Converting Materials:\n";
 		for (entry2 = entry->FirstChildElement(); entry2 != 0; entry2 = entry2->NextSiblingElement("MaterialNode"))
 		{
 			m_vecMaterial.push_back( GetMaterial(entry2, NoNameTable, NoTexTable) );
 		}
-		std::wcout << L"-> material count: " + ToString(MaterialCount) + L"\n\n";
+		LogInfo() << L"-> material count: " + ToString(MaterialCount) + L"\n\n";
 	}
 
 	//Set to header size.
@@ -1401,16 +1381,25 @@ void CXMLToMDB::Write(const std::wstring& path, bool multcore)
 		}
 	}
 
-	std::wcout << L">> File Size: " + ToString((int)bytes.size()) + L" Bytes!\n";
+	LogInfo() << L">> File Size: " + ToString((int)bytes.size()) + L" Bytes!\n";
 	//Final write.
 	/**/
-	std::ofstream newFile(path + L".mdb", std::ios::binary | std::ios::out | std::ios::ate);
+	timer.Next(StatStage::Write);
+	std::ofstream newFile(ToFilePath(path + L".mdb"), std::ios::binary | std::ios::out | std::ios::ate);
 	
 	newFile.write(bytes.data(), bytes.size());
 	
 	newFile.close();
+	if (!newFile)
+	{
+		LogError() << L"Can't write " + path + L".mdb\n";
+		return false;
+	}
+	timer.AddBytes(bytes.size());
+	timer.Stop();
 	
-	std::wcout << L"Conversion completed: " + sourcePath + L"\n";
+	LogInfo() << L"Conversion completed: " + sourcePath + L"\n";
+	return true;
 }
 
 void CXMLToMDB::AlignFileTo16Bytes(std::vector<char>& bytes)
@@ -1426,14 +1415,7 @@ void CXMLToMDB::AlignFileTo16Bytes(std::vector<char>& bytes)
 
 void CXMLToMDB::Set4BytesInFile(std::vector<char>& bytes, int pos, int value)
 {
-	char* fnofs = IntToBytes(value);
-
-	bytes[pos] = fnofs[0];
-	bytes[pos+1] = fnofs[1];
-	bytes[pos+2] = fnofs[2];
-	bytes[pos+3] = fnofs[3];
-
-	free(fnofs);
+	ByteWriterLE(bytes).Set<int32_t>(pos, value);
 }
 
 void CXMLToMDB::GenerateHeader(std::vector< char >& bytes)
@@ -1483,14 +1465,7 @@ MDBTexture CXMLToMDB::GetTexture(tinyxml2::XMLElement* entry2)
 
 	out.bytes.resize(0x10);
 	// write index
-	char* idBytes = IntToBytes(out.ID);
-
-	out.bytes[0] = idBytes[0];
-	out.bytes[1] = idBytes[1];
-	out.bytes[2] = idBytes[2];
-	out.bytes[3] = idBytes[3];
-
-	free(idBytes);
+	ByteWriterLE(out.bytes).Set<int32_t>(0, out.ID);
 	// write name
 	std::wstring wstr;
 
@@ -1501,7 +1476,7 @@ MDBTexture CXMLToMDB::GetTexture(tinyxml2::XMLElement* entry2)
 	// increment count
 	TextureCount++;
 
-	//std::wcout << mapping + L", " + filename + L"\n";
+	//LogInfo() << mapping + L", " + filename + L"\n";
 	return out;
 }
 
@@ -1547,12 +1522,12 @@ MDBBone CXMLToMDB::GetBone(tinyxml2::XMLElement* entry2, bool NoNameTable)
 	out.index[0] = entry3->IntAttribute("current");
 
 	out.bytes.resize(0xC0);
-	memcpy(&out.bytes[0], &out.index[0], 20U);
+	ByteWriterLE(out.bytes).Set(0, out.index);
 
 	// childrenNum
 	entry3 = entry2->FirstChildElement("childrenNum");
 	out.childrenNum = entry3->IntAttribute("value");
-	memcpy(&out.bytes[0x14], &out.childrenNum, 4U);
+	ByteWriterLE(out.bytes).Set(0x14, out.childrenNum);
 
 	// ubyte 4x2
 	for (int i = 0; i < 2; i++)
@@ -1563,7 +1538,7 @@ MDBBone CXMLToMDB::GetBone(tinyxml2::XMLElement* entry2, bool NoNameTable)
 		out.weight[i][2] = entry3->IntAttribute("z");
 		out.weight[i][3] = entry3->IntAttribute("w");
 	}
-	memcpy(&out.bytes[0x18], &out.weight[0][0], 8U);
+	ByteWriterLE(out.bytes).Set(0x18, out.weight);
 	// matrix1 4x4
 	for (int i = 0; i < 4; i++)
 	{
@@ -1573,7 +1548,7 @@ MDBBone CXMLToMDB::GetBone(tinyxml2::XMLElement* entry2, bool NoNameTable)
 		out.matrix1[i][2] = entry3->FloatAttribute("z");
 		out.matrix1[i][3] = entry3->FloatAttribute("w");
 	}
-	memcpy(&out.bytes[0x20], &out.matrix1[0][0], 64U);
+	ByteWriterLE(out.bytes).Set(0x20, out.matrix1);
 	// matrix2 4x4
 	for (int i = 0; i < 4; i++)
 	{
@@ -1583,7 +1558,7 @@ MDBBone CXMLToMDB::GetBone(tinyxml2::XMLElement* entry2, bool NoNameTable)
 		out.matrix2[i][2] = entry3->FloatAttribute("z");
 		out.matrix2[i][3] = entry3->FloatAttribute("w");
 	}
-	memcpy(&out.bytes[0x60], &out.matrix2[0][0], 64U);
+	ByteWriterLE(out.bytes).Set(0x60, out.matrix2);
 	// fg 2x4
 	for (int i = 0; i < 2; i++)
 	{
@@ -1593,7 +1568,7 @@ MDBBone CXMLToMDB::GetBone(tinyxml2::XMLElement* entry2, bool NoNameTable)
 		out.fg[i][2] = entry3->FloatAttribute("z");
 		out.fg[i][3] = entry3->FloatAttribute("w");
 	}
-	memcpy(&out.bytes[0xA0], &out.fg[0][0], 32U);
+	ByteWriterLE(out.bytes).Set(0xA0, out.fg);
 
 	BoneCount++;
 
@@ -1661,7 +1636,7 @@ MDBMaterial CXMLToMDB::GetMaterial(tinyxml2::XMLElement* entry2, bool NoNameTabl
 		WriteWStringToTemp(wstr);
 		wstr.clear();
 	}
-	memcpy(&out.bytes[4], &out.matid, 4U);
+	ByteWriterLE(out.bytes).Set(4, out.matid);
 	//read shader name
 	//note! it is not stored in the name table!
 	entry3 = entry2->FirstChildElement("Shader");
@@ -1676,7 +1651,7 @@ MDBMaterial CXMLToMDB::GetMaterial(tinyxml2::XMLElement* entry2, bool NoNameTabl
 		m_vecMaterialPtr.push_back(GetMaterialParameter(entry4));
 		out.PtrCount++;
 	}
-	memcpy(&out.bytes[0x10], &out.PtrCount, 4U);
+	ByteWriterLE(out.bytes).Set(0x10, out.PtrCount);
 	// read texture
 	out.TexCount = 0;
 	for (entry4 = entry3->FirstChildElement("Texture"); entry4 != 0; entry4 = entry4->NextSiblingElement("Texture"))
@@ -1684,7 +1659,7 @@ MDBMaterial CXMLToMDB::GetMaterial(tinyxml2::XMLElement* entry2, bool NoNameTabl
 		m_vecMaterialTex.push_back(GetMaterialTexture(entry4, NoTexTable));
 		out.TexCount++;
 	}
-	memcpy(&out.bytes[0x18], &out.TexCount, 4U);
+	ByteWriterLE(out.bytes).Set(0x18, out.TexCount);
 
 	entry3 = entry3->NextSiblingElement("raw");
 	argsStrn = entry3->GetText();
@@ -1728,10 +1703,10 @@ MDBMaterialPtr CXMLToMDB::GetMaterialParameter(tinyxml2::XMLElement* entry4)
 	out.a = entry5->FloatAttribute("a");
 
 	out.bytes.resize(0x20);
-	memcpy(&out.bytes[0], &out.r, 4U);
-	memcpy(&out.bytes[4], &out.g, 4U);
-	memcpy(&out.bytes[8], &out.b, 4U);
-	memcpy(&out.bytes[12], &out.a, 4U);
+	ByteWriterLE(out.bytes).Set(0, out.r);
+	ByteWriterLE(out.bytes).Set(4, out.g);
+	ByteWriterLE(out.bytes).Set(8, out.b);
+	ByteWriterLE(out.bytes).Set(12, out.a);
 
 	entry5 = entry4->FirstChildElement("raw");
 	argsStrn = entry5->GetText();
@@ -1794,7 +1769,7 @@ MDBMaterialTex CXMLToMDB::GetMaterialTexture(tinyxml2::XMLElement* entry4, bool
 
 	out.bytes.resize(0x1C);
 	// write id
-	memcpy(&out.bytes[0], &out.texid, 4U);
+	ByteWriterLE(out.bytes).Set(0, out.texid);
 	
 	entry5 = entry4->FirstChildElement("raw");
 	argsStrn = entry5->GetText();
@@ -1817,12 +1792,7 @@ MDBTexture CXMLToMDB::GetTextureInMaterial(std::wstring wstr1, std::wstring wstr
 
 	out.bytes.resize(0x10);
 	// write index
-	char* idBytes = IntToBytes(out.ID);
-	out.bytes[0] = idBytes[0];
-	out.bytes[1] = idBytes[1];
-	out.bytes[2] = idBytes[2];
-	out.bytes[3] = idBytes[3];
-	free(idBytes);
+	ByteWriterLE(out.bytes).Set<int32_t>(0, out.ID);
 	// increment count
 	TextureCount++;
 
@@ -1871,18 +1841,18 @@ MDBObject CXMLToMDB::GetModel(tinyxml2::XMLElement* entry2, bool NoNameTable, bo
 	// read mesh count
 	for (entry3 = entry2->FirstChildElement("Mesh"); entry3 != 0; entry3 = entry3->NextSiblingElement("Mesh"))
 	{
-		std::wcout << L"read mesh: " + ToString(index[2]) + L"\n";
+		LogDebug() << L"read mesh: " + ToString(index[2]) + L"\n";
 
 		m_vecObjInfo.push_back(GetMeshInModel(entry3, index[2], multcore));
 		index[2] += 1;
 
-		std::wcout << L"write mesh complete!\n";
+		LogDebug() << L"write mesh complete!\n";
 	}
 	out.infoCount = index[2];
 	out.infoOffset = index[3];
 
 	out.bytes.resize(0x10);
-	memcpy(&out.bytes[0], &index, 16U);
+	ByteWriterLE(out.bytes).Set(0, index);
 
 	ObjectCount++;
 
@@ -1918,7 +1888,7 @@ MDBObjectInfo CXMLToMDB::GetMeshInModel(tinyxml2::XMLElement* entry3, int index,
 	out.bytes.resize(0x28);
 	// get material id
 	out.matid = entry3->IntAttribute("MatID");
-	memcpy(&out.bytes[4], &out.matid, 4U);
+	ByteWriterLE(out.bytes).Set(4, out.matid);
 	// read raw
 	entry4 = entry3->FirstChildElement("raw");
 	argsStrn = entry4->GetText();
@@ -1941,20 +1911,20 @@ MDBObjectInfo CXMLToMDB::GetMeshInModel(tinyxml2::XMLElement* entry3, int index,
 	}
 	out.VertexSize = count[0];
 	out.LayoutCount = count[1];
-	memcpy(&out.bytes[0x10], &count, 4U);
+	ByteWriterLE(out.bytes).Set(0x10, count);
 	// get number of vertices
 	int vexNum = 0;
 	entry5 = entry4->FirstChildElement();
 	for (entry6 = entry5->FirstChildElement("V"); entry6 != 0; entry6 = entry6->NextSiblingElement("V"))
 		vexNum++;
 	out.VertexNum = vexNum;
-	memcpy(&out.bytes[0x14], &out.VertexNum, 4U);
+	ByteWriterLE(out.bytes).Set(0x14, out.VertexNum);
 	// write vertex!
 	entry4 = entry3->FirstChildElement("VertexList");
 	m_vecObjVertices.push_back(GetVerticesInModel(objlay, count[0], entry4, vexNum, count[1], multcore));
 	// set index
 	out.MeshIndex = index;
-	memcpy(&out.bytes[0x18], &out.MeshIndex, 4U);
+	ByteWriterLE(out.bytes).Set(0x18, out.MeshIndex);
 	// get number of indices
 	int InxNum = 0;
 	entry4 = entry3->FirstChildElement("Faces");
@@ -1962,7 +1932,7 @@ MDBObjectInfo CXMLToMDB::GetMeshInModel(tinyxml2::XMLElement* entry3, int index,
 		InxNum++;
 	out.indicesNum = InxNum;
 	m_vecObjIndices.push_back(GetIndicesInModel(entry4, InxNum));
-	memcpy(&out.bytes[0x20], &out.indicesNum, 4U);
+	ByteWriterLE(out.bytes).Set(0x20, out.indicesNum);
 
 	objlay.clear();
 
@@ -1982,9 +1952,9 @@ MDBObjectLayout CXMLToMDB::GetLayoutInModel(tinyxml2::XMLElement* entry5, int la
 	out.name = argsStrn;
 
 	out.bytes.resize(0x10);
-	memcpy(&out.bytes[0], &out.type, 4U);
-	memcpy(&out.bytes[4], &out.offset, 4U);
-	memcpy(&out.bytes[8], &out.channel, 4U);
+	ByteWriterLE(out.bytes).Set(0, out.type);
+	ByteWriterLE(out.bytes).Set(4, out.offset);
+	ByteWriterLE(out.bytes).Set(8, out.channel);
 
 	return out;
 }
@@ -2012,9 +1982,9 @@ MDBByte CXMLToMDB::GetVerticesInModel(std::vector<MDBObjectLayout> objlay, int c
 	int offset = objlay[0].offset;
 	int type = objlay[0].type;
 	std::wstring wstr = UTF8ToWide(objlay[0].name);
-	std::wcout << L"read: " + wstr + L", ";
+	LogDebug() << L"read: " + wstr + L", ";
 	GetModelVertex(type, num, entry5, out.bytes, chunksize, offset);
-	std::wcout << L"write complete!\n";
+	LogDebug() << L"write complete!\n";
 	//start looping to get
 	int layoutNum = objlay.size();
 	//Of course, starting from 1
@@ -2024,9 +1994,9 @@ MDBByte CXMLToMDB::GetVerticesInModel(std::vector<MDBObjectLayout> objlay, int c
 		offset = objlay[i].offset;
 		type = objlay[i].type;
 		wstr = UTF8ToWide(objlay[i].name);
-		std::wcout << L"read: " + wstr + L", ";
+		LogDebug() << L"read: " + wstr + L", ";
 		GetModelVertex(type, num, entry5, out.bytes, chunksize, offset);
-		std::wcout << L"write complete!\n";
+		LogDebug() << L"write complete!\n";
 	}
 	//for (entry5 = entry4->FirstChildElement(); entry5 != 0; entry5 = entry5->NextSiblingElement())
 	return out;
@@ -2045,7 +2015,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 		vf[1] = entry6->FloatAttribute("y");
 		vf[2] = entry6->FloatAttribute("z");
 		vf[3] = entry6->FloatAttribute("w");
-		memcpy(&bytes[offset], &vf, 16U);
+		ByteWriterLE(bytes).Set(offset, vf);
 
 		for (int i = 1; i < num; i++)
 		{
@@ -2056,7 +2026,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 			vf[3] = entry6->FloatAttribute("w");
 
 			pos = offset + (i * chunksize);
-			memcpy(&bytes[pos], &vf, 16U);
+			ByteWriterLE(bytes).Set(pos, vf);
 		}
 	}
 	else if (type == 4)
@@ -2066,7 +2036,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 		vf[0] = entry6->FloatAttribute("x");
 		vf[1] = entry6->FloatAttribute("y");
 		vf[2] = entry6->FloatAttribute("z");
-		memcpy(&bytes[offset], &vf, 12U);
+		ByteWriterLE(bytes).Set(offset, vf);
 
 		for (int i = 1; i < num; i++)
 		{
@@ -2076,7 +2046,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 			vf[2] = entry6->FloatAttribute("z");
 
 			pos = offset + (i * chunksize);
-			memcpy(&bytes[pos], &vf, 12U);
+			ByteWriterLE(bytes).Set(pos, vf);
 		}
 	}
 	else if (type == 7)
@@ -2087,7 +2057,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 		vf[1] = entry6->FloatAttribute("y");
 		vf[2] = entry6->FloatAttribute("z");
 		vf[3] = entry6->FloatAttribute("w");
-		memcpy(&bytes[offset], &vf, 8U);
+		ByteWriterLE(bytes).Set(offset, vf);
 
 		for (int i = 1; i < num; i++)
 		{
@@ -2098,7 +2068,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 			vf[3] = entry6->FloatAttribute("w");
 
 			pos = offset + (i * chunksize);
-			memcpy(&bytes[pos], &vf, 8U);
+			ByteWriterLE(bytes).Set(pos, vf);
 		}
 	}
 	else if (type == 12)
@@ -2107,7 +2077,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 
 		vf[0] = entry6->FloatAttribute("x");
 		vf[1] = entry6->FloatAttribute("y");
-		memcpy(&bytes[offset], &vf, 8U);
+		ByteWriterLE(bytes).Set(offset, vf);
 
 		for (int i = 1; i < num; i++)
 		{
@@ -2116,7 +2086,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 			vf[1] = entry6->FloatAttribute("y");
 
 			pos = offset + (i * chunksize);
-			memcpy(&bytes[pos], &vf, 8U);
+			ByteWriterLE(bytes).Set(pos, vf);
 		}
 	}
 	else if (type == 21)
@@ -2127,7 +2097,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 		vf[1] = entry6->IntAttribute("y");
 		vf[2] = entry6->IntAttribute("z");
 		vf[3] = entry6->IntAttribute("w");
-		memcpy(&bytes[offset], &vf, 4U);
+		ByteWriterLE(bytes).Set(offset, vf);
 
 		for (int i = 1; i < num; i++)
 		{
@@ -2138,7 +2108,7 @@ void CXMLToMDB::GetModelVertex(int type, int num, tinyxml2::XMLElement* entry5,
 			vf[3] = entry6->IntAttribute("w");
 
 			pos = offset + (i * chunksize);
-			memcpy(&bytes[pos], &vf, 4U);
+			ByteWriterLE(bytes).Set(pos, vf);
 		}
 	}
 }
@@ -2152,14 +2122,14 @@ MDBByte CXMLToMDB::GetIndicesInModel(tinyxml2::XMLElement* entry4, int size)
 
 	tinyxml2::XMLElement* entry5 = entry4->FirstChildElement("value");
 	value = entry5->IntAttribute("value");
-	memcpy(&out.bytes[0], &value, 2U);
+	ByteWriterLE(out.bytes).Set(0, value);
 	//Here we start at 1 because it is 0 above
 	for (int i = 1; i < size; i++)
 	{
 		entry5 = entry5->NextSiblingElement("value");
 		value = entry5->IntAttribute("value");
 		//The size of each value is 2, so take x2
-		memcpy(&out.bytes[i*2], &value, 2U);
+		ByteWriterLE(out.bytes).Set(i*2, value);
 	}
 
 	return out;
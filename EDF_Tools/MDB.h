@@ -1,6 +1,7 @@
 #pragma once
 #include "include/tinyxml2.h"
 #include <mutex>
+#include "ByteStream.h"
 
 struct MDBName
 {
@@ -121,21 +122,21 @@ class CMDBtoXML
 public:
 	int Read(const std::wstring& path, bool onecore);
 
-	MDBName ReadMDBName(int pos, const std::vector<char>& buffer);
-	MDBTexture ReadTexture(int pos, const std::vector<char>& buffer);
+	MDBName ReadMDBName(int pos, const ByteSpan& buffer);
+	MDBTexture ReadTexture(int pos, const ByteSpan& buffer);
 
-	MDBBone ReadBone(int pos, const std::vector<char>& buffer);
+	MDBBone ReadBone(int pos, const ByteSpan& buffer);
 
-	MDBMaterial ReadMaterial(int pos, const std::vector<char>& buffer);
-	MDBMaterialPtr ReadMaterialPtr(int pos, const std::vector<char>& buffer);
-	MDBMaterialTex ReadMaterialTex(int pos, const std::vector<char>& buffer);
+	MDBMaterial ReadMaterial(int pos, const ByteSpan& buffer);
+	MDBMaterialPtr ReadMaterialPtr(int pos, const ByteSpan& buffer);
+	MDBMaterialTex ReadMaterialTex(int pos, const ByteSpan& buffer);
 
-	MDBObject ReadObject(int pos, const std::vector<char>& buffer);
-	MDBObjectInfo ReadObjectInfo(int pos, const std::vector<char>& buffer);
-	MDBObjectLayout ReadObjectLayout(int pos, const std::vector<char>& buffer);
+	MDBObject ReadObject(int pos, const ByteSpan& buffer);
+	MDBObjectInfo ReadObjectInfo(int pos, const ByteSpan& buffer);
+	MDBObjectLayout ReadObjectLayout(int pos, const ByteSpan& buffer);
 
-	void ReadVertex(int pos, const std::vector<char>& buffer, int type, int num, int size, tinyxml2::XMLElement* header);
-	void ReadVertexMT(std::mutex &mtx, int pos, const std::vector<char>& buffer, int type, int num, int size, tinyxml2::XMLElement* header);
+	void ReadVertex(int pos, const ByteSpan& buffer, int type, int num, int size, tinyxml2::XMLElement* header);
+	void ReadVertexMT(std::mutex &mtx, int pos, const ByteSpan& buffer, int type, int num, int size, tinyxml2::XMLElement* header);
 
 private:
 
@@ -167,7 +168,7 @@ private:
 class CXMLToMDB
 {
 public:
-	void Write(const std::wstring& path, bool multcore);
+	bool Write(const std::wstring& path, bool multcore);
 	void AlignFileTo16Bytes(std::vector<char>& bytes);
 	void Set4BytesInFile(std::vector<char>& bytes, int pos, int value);
 	void GenerateHeader(std::vector< char > &bytes);
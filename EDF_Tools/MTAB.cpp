@@ -2,26 +2,31 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <algorithm>
 
 #include "Middleware.h"
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "MTAB.h"
 #include "include/tinyxml2.h"
 
-void MTAB::Read(const std::wstring& path)
+bool MTAB::Read(const std::wstring& path)
 {
-	std::ifstream file(path + L".mtab", std::ios::binary | std::ios::ate | std::ios::in);
-
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
-
-	std::vector<char> buffer(size);
-	if (file.read(buffer.data(), size))
+	StageTimer timer("MTAB>XML", StatStage::Read);
+	MappedFile file;
+	if (file.Open(path + L".mtab"))
 	{
+		ByteSpan buffer = file.Span();
+		timer.AddBytes(buffer.size());
+		timer.Next(StatStage::Parse);
 		// create xml
 		tinyxml2::XMLDocument xml;
 		xml.InsertFirstChild(xml.NewDeclaration());
@@ -33,44 +38,57 @@ void MTAB::Read(const std::wstring& path)
 
 		ReadData(buffer, xmlMain, xmlHeader);
 
+		timer.Next(StatStage::Serialize);
 		std::string outfile = WideToUTF8(path) + "_DATA.xml";
-		xml.SaveFile(outfile.c_str());
+		if (xml.SaveFile(outfile.c_str()) != tinyxml2::XML_SUCCESS)
+		{
+			LogError() << L"Can't write " << UTF8ToWide(outfile) << L"\n";
+			return false;
+		}
 		/*
 		tinyxml2::XMLPrinter printer;
 		xml.Accept(&printer);
 		auto xmlString = std::string{ printer.CStr() };
 
-		std::wcout << UTF8ToWide(xmlString) + L"\n";
+		LogInfo() << UTF8ToWide(xmlString) + L"\n";
 		*/
 	}
+	else
+	{
+		LogError() << L"Can't read " << path << L".mtab\n";
+		return false;
+	}
 
-	//Clear buffers
-	buffer.clear();
-	file.close();
+	//Unmap the file
+	file.Close();
+	return true;
 }
 
-void MTAB::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
+void MTAB::ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+	m_strings.Reset(buffer);
+
 	int position = 0;
 	unsigned char seg[4];
 	// read header, length is 0x24
-	memcpy(&seg, &buffer[0x10], 4U);
+	reader.Get(0x10, seg);
 	//if (seg[0] == 0x4D && seg[1] == 0x54 && seg[2] == 0x41 && seg[3] == 0x42)
 
 	// get header data
 	int i_hd1;
 	float f_hd2;
-	memcpy(&i_hd1, &buffer[0], 4U);
+	reader.Get(0, i_hd1);
 	header->SetAttribute("int1", i_hd1);
-	memcpy(&f_hd2, &buffer[4], 4U);
+	reader.Get(4, f_hd2);
 	header->SetAttribute("time", f_hd2);
 	// now this value is not needed
 	//memcpy(&i_hd3, &buffer[8], 4U);
 	//header->SetAttribute("int3", i_hd3);
 
 	// get main actions
-	memcpy(&i_MainActionCount, &buffer[0xC], 4U);
-	memcpy(&i_MainActionOffset, &buffer[0x18], 4U);
+	reader.Get(0xC, i_MainActionCount);
+	reader.Get(0x18, i_MainActionOffset);
 
 	// read main action
 	position = i_MainActionOffset;
@@ -83,22 +101,19 @@ void MTAB::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* heade
 	}
 }
 
-void MTAB::ReadMainActionData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader)
+void MTAB::ReadMainActionData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+
 
 #if defined(DEBUGMODE)
 	xmlData->SetAttribute("pos", curpos);
 #endif
 
 	int value[3];
-	memcpy(&value, &buffer[curpos], 12U);
+	reader.Get(curpos, value);
 	// get wide string
-	std::wstring wstr;
-	if (value[1] > 0)
-		wstr = ReadUnicode(buffer, curpos + value[1]);
-	else
-		wstr = L"";
-	xmlData->SetAttribute("name", WideToUTF8(wstr).c_str());
+	xmlData->SetAttribute("name", value[1] > 0 ? m_strings.Get(curpos + value[1]) : "");
 	// get sub action
 	for (int i = 0; i < value[0]; i++)
 	{
@@ -109,15 +124,17 @@ void MTAB::ReadMainActionData(const std::vector<char>& buffer, int curpos, tinyx
 	}
 }
 
-void MTAB::ReadSubActionData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader)
+void MTAB::ReadSubActionData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+
 
 #if defined(DEBUGMODE)
 	xmlData->SetAttribute("pos", curpos);
 #endif
 
 	int value[3];
-	memcpy(&value, &buffer[curpos], 12U);
+	reader.Get(curpos, value);
 	// get string
 	std::string str;
 	if (value[1] > 0)
@@ -135,15 +152,17 @@ void MTAB::ReadSubActionData(const std::vector<char>& buffer, int curpos, tinyxm
 	}
 }
 
-void MTAB::ReadNodeData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader)
+void MTAB::ReadNodeData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader)
 {
+	ByteReaderLE reader(buffer);
+
 
 #if defined(DEBUGMODE)
 	xmlData->SetAttribute("pos", curpos);
 #endif
 
 	int value[5];
-	memcpy(&value, &buffer[curpos], 20U);
+	reader.Get(curpos, value);
 	xmlData->SetAttribute("int1", value[0]);
 	xmlData->SetAttribute("int3", value[2]);
 	xmlData->SetAttribute("parameter", value[3]);
@@ -162,7 +181,7 @@ void MTAB::ReadNodeData(const std::vector<char>& buffer, int curpos, tinyxml2::X
 			xmlNode->SetAttribute("pos", curofs);
 #endif
 			float vf[4];
-			memcpy(&vf, &buffer[curofs], 16U);
+			reader.Get(curofs, vf);
 			xmlNode->SetAttribute("timing", vf[0]);
 			xmlNode->SetAttribute("x", vf[1]);
 			xmlNode->SetAttribute("y", vf[2]);
@@ -171,24 +190,34 @@ void MTAB::ReadNodeData(const std::vector<char>& buffer, int curpos, tinyxml2::X
 	}
 }
 
-void MTAB::Write(const std::wstring& path, tinyxml2::XMLNode* header)
+bool MTAB::Write(const std::wstring& path, tinyxml2::XMLNode* header)
 {
-	std::wcout << "Will output MTAB file.\n";
+	LogInfo() << "Will output MTAB file.\n";
 
 	tinyxml2::XMLElement* mainData = header->FirstChildElement("Main");
 
+	StageTimer timer("XML>MTAB", StatStage::Build);
 	std::vector< char > bytes;
 	bytes = WriteData(mainData, header);
 
 	//Final write.
 	/**/
-	std::ofstream newFile(path + L".mtab", std::ios::binary | std::ios::out | std::ios::ate);
+	timer.Next(StatStage::Write);
+	std::ofstream newFile(ToFilePath(path + L".mtab"), std::ios::binary | std::ios::out | std::ios::ate);
 
 	newFile.write(bytes.data(), bytes.size());
 
 	newFile.close();
+	if (!newFile)
+	{
+		LogError() << L"Can't write " + path + L".mtab\n";
+		return false;
+	}
+	timer.AddBytes(bytes.size());
+	timer.Stop();
 
-	std::wcout << L"Conversion completed: " + path + L".mtab\n";
+	LogInfo() << L"Conversion completed: " + path + L".mtab\n";
+	return true;
 }
 
 std::vector<char> MTAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNode* header)
@@ -220,10 +249,10 @@ std::vector<char> MTAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLN
 	bytes[0x15] = 0x02;
 	bytes[0x18] = 0x1C;
 	// copy remain
-	memcpy(&bytes[0], &headerInt, 4U);
-	memcpy(&bytes[4], &headerTime, 4U);
-	memcpy(&bytes[8], &i_SubActionCount, 4U);
-	memcpy(&bytes[0xC], &i_MainActionCount, 4U);
+	ByteWriterLE(bytes).Set(0, headerInt);
+	ByteWriterLE(bytes).Set(4, headerTime);
+	ByteWriterLE(bytes).Set(8, i_SubActionCount);
+	ByteWriterLE(bytes).Set(0xC, i_MainActionCount);
 
 	// write main action
 	for (size_t i = 0; i < v_MainAction.size(); i++)
@@ -242,7 +271,7 @@ std::vector<char> MTAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLN
 			{
 				int mapos = v_MainAction[j].pos;
 				int safofs = safpos - mapos;
-				memcpy(&bytes[mapos + 8], &safofs, 4U);
+				ByteWriterLE(bytes).Set(mapos + 8, safofs);
 			}
 		}
 
@@ -261,7 +290,7 @@ std::vector<char> MTAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLN
 			{
 				int sapos = v_SubAction[j].pos;
 				int d1_ofs = d1_pos - sapos;
-				memcpy(&bytes[sapos + 8], &d1_ofs, 4U);
+				ByteWriterLE(bytes).Set(sapos + 8, d1_ofs);
 			}
 		}
 
@@ -282,7 +311,7 @@ std::vector<char> MTAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLN
 		// write offset to data
 		int d1_pos = v_Data[i].pos;
 		int d2_ofs = d2_pos - d1_pos;
-		memcpy(&bytes[d1_pos + 0x10], &d2_ofs, 4U);
+		ByteWriterLE(bytes).Set(d1_pos + 0x10, d2_ofs);
 
 		bytes.insert(bytes.end(), v_Data[i].bytes2.begin(), v_Data[i].bytes2.end());
 	}
@@ -298,7 +327,7 @@ std::vector<char> MTAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLN
 			if (v_SubAction[j].str == NameList[i])
 			{
 				int strofs = strpos - v_SubAction[j].pos;
-				memcpy(&bytes[v_SubAction[j].pos + 4], &strofs, 4U);
+				ByteWriterLE(bytes).Set(v_SubAction[j].pos + 4, strofs);
 			}
 		}
 	}
@@ -313,7 +342,7 @@ std::vector<char> MTAB::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLN
 			if (v_MainAction[j].wstr == WNameList[i])
 			{
 				int strofs = strpos - v_MainAction[j].pos;
-				memcpy(&bytes[v_MainAction[j].pos + 4], &strofs, 4U);
+				ByteWriterLE(bytes).Set(v_MainAction[j].pos + 4, strofs);
 			}
 		}
 	}
@@ -354,7 +383,7 @@ MTABMainAction MTAB::WriteMainAction(tinyxml2::XMLElement* data)
 
 	out.bytes.resize(0xC, 0);
 
-	memcpy(&out.bytes[0], &count, 4U);
+	ByteWriterLE(out.bytes).Set(0, count);
 
 	return out;
 }
@@ -392,7 +421,7 @@ MTABMainAction MTAB::WriteSubAction(tinyxml2::XMLElement* data)
 
 	out.bytes.resize(0xC, 0);
 
-	memcpy(&out.bytes[0], &count, 4U);
+	ByteWriterLE(out.bytes).Set(0, count);
 
 	return out;
 }
@@ -432,7 +461,7 @@ MTABData MTAB::WriteDataNode(tinyxml2::XMLElement* data)
 	value[1] = count;
 
 	out.bytes1.resize(0x14, 0);
-	memcpy(&out.bytes1[0], &value, 16U);
+	ByteWriterLE(out.bytes1).Set(0, value);
 
 	return out;
 }
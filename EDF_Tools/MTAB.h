@@ -1,4 +1,5 @@
 #pragma once
+#include "StringTable.h"
 
 struct MTABData
 {
@@ -23,14 +24,14 @@ struct MTABMainAction
 class MTAB
 {
 public:
-	void Read(const std::wstring& path);
-	void ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
-	void ReadMainActionData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader);
-	void ReadSubActionData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader);
-	void ReadNodeData(const std::vector<char>& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader);
+	bool Read(const std::wstring& path);
+	void ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
+	void ReadMainActionData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader);
+	void ReadSubActionData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader);
+	void ReadNodeData(const ByteSpan& buffer, int curpos, tinyxml2::XMLElement* xmlData, tinyxml2::XMLElement* xmlHeader);
 
 	// write
-	void Write(const std::wstring& path, tinyxml2::XMLNode* header);
+	bool Write(const std::wstring& path, tinyxml2::XMLNode* header);
 	std::vector< char > WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNode* header);
 	MTABMainAction WriteMainAction(tinyxml2::XMLElement* data);
 	MTABMainAction WriteSubAction(tinyxml2::XMLElement* data);
@@ -43,6 +44,8 @@ private:
 
 	std::vector< std::string > NameList;
 	std::vector< std::wstring > WNameList;
+	// action names of the file being read
+	UTF16StringTable m_strings;
 
 	std::vector< MTABMainAction > v_MainAction;
 	std::vector< MTABMainAction > v_SubAction;
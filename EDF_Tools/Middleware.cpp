@@ -2,18 +2,22 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 
 #include "Middleware.h"
 #include "util.h"
+#include "Log.h"
+#include "Stats.h"
 #include "SGO.h"
 #include "MAB.h"
 #include "MTAB.h"
 #include "include/tinyxml2.h"
 
-void CheckDataType(const std::vector<char>& buffer, tinyxml2::XMLElement*& xmlHeader, const std::string& str)
+void CheckDataType(const ByteSpan& buffer, tinyxml2::XMLElement*& xmlHeader, const std::string& str)
 {
 	char header[4];
 	header[0] = buffer[0];
@@ -64,36 +68,54 @@ void CheckDataType(const std::vector<char>& buffer, tinyxml2::XMLElement*& xmlHe
 }
 
 // Check the header to determine the output type
-void CheckXMLHeader(const std::wstring& path)
+bool CheckXMLHeader(const std::wstring& path)
 {
 	std::wstring sourcePath = path + L"_data.xml";
 	std::string UTF8Path = WideToUTF8(sourcePath);
 
+	StageTimer timer("XML>DATA", StatStage::Parse);
 	tinyxml2::XMLDocument doc;
-	doc.LoadFile(UTF8Path.c_str());
+	tinyxml2::XMLError loaded = doc.LoadFile(UTF8Path.c_str());
+	timer.Stop();
+	if (loaded != tinyxml2::XML_SUCCESS)
+	{
+		LogError() << L"Can't read " + sourcePath + L"\n";
+		return false;
+	}
 
 	tinyxml2::XMLNode* header = doc.FirstChildElement("EDFDATA");
-	tinyxml2::XMLElement* mainData = header->FirstChildElement("Main");
+	tinyxml2::XMLElement* mainData = header ? header->FirstChildElement("Main") : nullptr;
+	const char* headerAttribute = mainData ? mainData->Attribute("header") : nullptr;
+	if (!headerAttribute)
+	{
+		LogError() << L"No EDFDATA Main header in " + sourcePath + L"\n";
+		return false;
+	}
 
-	std::string headerType = mainData->Attribute("header");
+	std::string headerType = headerAttribute;
+	bool written = false;
 	if (headerType == "SGO")
 	{
 		std::unique_ptr< SGO > writer = std::make_unique< SGO >();
-		writer->Write(path, header);
+		written = writer->Write(path, header);
 		writer.reset();
 	}
 	else if (headerType == "MAB")
 	{
 		std::unique_ptr< MAB > writer = std::make_unique< MAB >();
-		writer->Write(path, header);
+		written = writer->Write(path, header);
 		writer.reset();
 	}
 	else if (headerType == "MTAB")
 	{
 		std::unique_ptr< MTAB > writer = std::make_unique< MTAB >();
-		writer->Write(path, header);
+		written = writer->Write(path, header);
 		writer.reset();
 	}
+	else
+		LogError() << L"Unknown data header " + UTF8ToWide(headerType) + L" in " + sourcePath + L"\n";
+
+	return written;
 }
 
 // Check for the extra file header
@@ -0,0 +1,235 @@
+#include "stdafx.h"
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include "util.h"
+#include "FileIO.h"
+#include "JSONAMLParser.h"
+#include "MissionCommands.h"
+
+#define MISSION_CMD_CACHE_MAGIC 0x444D434D //MCMD
+#define MISSION_CMD_CACHE_VERSION 2
+#define MISSION_CMD_DENSE_LIMIT 0x10000
+
+bool CMissionCommandTable::bUseCache = true;
+
+//Tables are shared by every script in the process, the files don't change mid run
+static std::mutex s_tableLock;
+static std::map< std::wstring, std::shared_ptr< const CMissionCommandTable > > s_tables;
+
+//Same text the decompiler prints for an unknown opcode
+static std::wstring OpcodeToHex( int opcode )
+{
+	std::wstringstream wss;
+	wss << std::hex << opcode;
+	return L"0x" + wss.str( );
+}
+
+std::shared_ptr< const CMissionCommandTable > CMissionCommandTable::Load( const std::wstring& path )
+{
+	std::lock_guard< std::mutex > lock( s_tableLock );
+
+	auto it = s_tables.find( path );
+	if( it != s_tables.end( ) )
+		return it->second;
+
+	std::shared_ptr< CMissionCommandTable > table = std::make_shared< CMissionCommandTable >( );
+
+	//A missing file leaves the table empty, like before
+	int64_t srcTime = GetFileWriteTime( path );
+	if( srcTime != 0 )
+	{
+		uint64_t srcSize = GetFileLength( path );
+		std::wstring cachePath = path + L".cache";
+
+		if( !bUseCache || !table->ReadCache( cachePath, srcSize, srcTime ) )
+		{
+			CJSONAMLParser parser( path );
+			table->Compile( parser );
+
+			if( bUseCache )
+				table->WriteCache( cachePath, srcSize, srcTime );
+		}
+	}
+
+	s_tables[path] = table;
+	return table;
+}
+
+const MissionCommand *CMissionCommandTable::Find( int opcode ) const
+{
+	int index = -1;
+	if( opcode >= 0 && opcode < (int)m_denseIndex.size( ) )
+		index = m_denseIndex[opcode];
+	else if( m_sparseIndex.size( ) > 0 )
+	{
+		auto it = m_sparseIndex.find( opcode );
+		if( it != m_sparseIndex.end( ) )
+			index = it->second;
+	}
+
+	if( index < 0 )
+		return nullptr;
+	return &m_commands[index];
+}
+
+void CMissionCommandTable::Compile( CJSONAMLParser& parser )
+{
+	JSONAMLValueArr *rootArr = parser.GetRootArray( );
+	if( !rootArr )
+		return;
+
+	for( size_t i = 0; i < rootArr->numNodes; ++i )
+	{
+		JSONAMLNode *node = rootArr->nodes[i];
+
+		const JSONAMLValue *rep = node->Find( L"representations" );
+		if( !rep )
+			continue;
+
+		//The decompiler used to match "0x" + lower case hex, only accept that exact form
+		std::wstring key = ConvertToLower( rep->val.str( ) );
+		if( key.size( ) < 3 || key.compare( 0, 2, L"0x" ) != 0 )
+			continue;
+
+		wchar_t *end = nullptr;
+		int opcode = (int)wcstoul( key.c_str( ) + 2, &end, 16 );
+		if( *end != 0 || OpcodeToHex( opcode ) != key )
+			continue;
+
+		MissionCommand command;
+		command.opcode = opcode;
+		command.doesReturn = false;
+		command.name = node->GetValue( L"name" );
+
+		JSONAMLValueArr *args = node->GetArr( L"arguments" );
+		if( args )
+		{
+			for( size_t j = 0; j < args->numNodes; ++j )
+			{
+				command.argTypes.push_back( args->nodes[j]->GetValue( L"type" ) );
+				command.argNames.push_back( args->nodes[j]->GetValue( L"name" ) );
+			}
+		}
+
+		JSONAMLNode *retNode = node->GetNode( L"returnValue" );
+		if( retNode && retNode->numValues > 0 )
+		{
+			command.returnType = retNode->GetValue( L"type" );
+			command.doesReturn = command.returnType != L"void";
+		}
+
+		m_commands.push_back( command );
+	}
+
+	BuildIndex( );
+}
+
+void CMissionCommandTable::BuildIndex( )
+{
+	m_denseIndex.clear( );
+	m_sparseIndex.clear( );
+
+	int maxDense = -1;
+	for( size_t i = 0; i < m_commands.size( ); ++i )
+	{
+		int opcode = m_commands[i].opcode;
+		if( opcode >= 0 && opcode < MISSION_CMD_DENSE_LIMIT && opcode > maxDense )
+			maxDense = opcode;
+	}
+	m_denseIndex.assign( maxDense + 1, -1 );
+
+	//First definition wins, same as the old linear search
+	for( size_t i = 0; i < m_commands.size( ); ++i )
+	{
+		int opcode = m_commands[i].opcode;
+		if( opcode >= 0 && opcode < MISSION_CMD_DENSE_LIMIT )
+		{
+			if( m_denseIndex[opcode] < 0 )
+				m_denseIndex[opcode] = (int)i;
+		}
+		else
+			m_sparseIndex.emplace( opcode, (int)i );
+	}
+}
+
+bool CMissionCommandTable::ReadCache( const std::wstring& path, uint64_t srcSize, int64_t srcTime )
+{
+	std::vector< char > bytes;
+	if( !CacheReadFile( path, bytes ) )
+		return false;
+
+	size_t pos = 0;
+	uint32_t magic, version, count;
+	uint64_t cachedSize, cachedTime;
+	if( !CacheGetInt( bytes, pos, magic ) || magic != MISSION_CMD_CACHE_MAGIC )
+		return false;
+	if( !CacheGetInt( bytes, pos, version ) || version != MISSION_CMD_CACHE_VERSION )
+		return false;
+	if( !CacheGetInt64( bytes, pos, cachedSize ) || cachedSize != srcSize )
+		return false;
+	if( !CacheGetInt64( bytes, pos, cachedTime ) || (int64_t)cachedTime != srcTime )
+		return false;
+	if( !CacheGetInt( bytes, pos, count ) )
+		return false;
+
+	std::vector< MissionCommand > commands;
+	for( uint32_t i = 0; i < count; ++i )
+	{
+		MissionCommand command;
+		uint32_t opcode, flags, argCount;
+		if( !CacheGetInt( bytes, pos, opcode ) || !CacheGetInt( bytes, pos, flags ) )
+			return false;
+		if( !CacheGetWString( bytes, pos, command.name ) || !CacheGetWString( bytes, pos, command.returnType ) )
+			return false;
+		if( !CacheGetInt( bytes, pos, argCount ) )
+			return false;
+
+		command.opcode = (int)opcode;
+		command.doesReturn = ( flags & 1 ) != 0;
+		command.argTypes.resize( argCount );
+		command.argNames.resize( argCount );
+		for( uint32_t j = 0; j < argCount; ++j )
+		{
+			if( !CacheGetWString( bytes, pos, command.argTypes[j] ) || !CacheGetWString( bytes, pos, command.argNames[j] ) )
+				return false;
+		}
+		commands.push_back( command );
+	}
+
+	m_commands.swap( commands );
+	BuildIndex( );
+	return true;
+}
+
+void CMissionCommandTable::WriteCache( const std::wstring& path, uint64_t srcSize, int64_t srcTime ) const
+{
+	std::vector< char > bytes;
+	CachePutInt( bytes, MISSION_CMD_CACHE_MAGIC );
+	CachePutInt( bytes, MISSION_CMD_CACHE_VERSION );
+	CachePutInt64( bytes, srcSize );
+	CachePutInt64( bytes, (uint64_t)srcTime );
+	CachePutInt( bytes, (uint32_t)m_commands.size( ) );
+
+	for( size_t i = 0; i < m_commands.size( ); ++i )
+	{
+		const MissionCommand& command = m_commands[i];
+		CachePutInt( bytes, (uint32_t)command.opcode );
+		CachePutInt( bytes, command.doesReturn ? 1 : 0 );
+		CachePutWString( bytes, command.name );
+		CachePutWString( bytes, command.returnType );
+		CachePutInt( bytes, (uint32_t)command.argTypes.size( ) );
+		for( size_t j = 0; j < command.argTypes.size( ); ++j )
+		{
+			CachePutWString( bytes, command.argTypes[j] );
+			CachePutWString( bytes, command.argNames[j] );
+		}
+	}
+
+	CacheWriteFile( path, bytes );
+}
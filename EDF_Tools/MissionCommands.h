@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+class CJSONAMLParser;
+
+//One command from the 2C / 2D definition files, resolved once at load
+struct MissionCommand
+{
+	int opcode;
+	std::wstring name;
+	std::vector< std::wstring > argTypes;
+	std::vector< std::wstring > argNames;
+	std::wstring returnType;
+	bool doesReturn;
+};
+
+//Opcode -> command table compiled from a JSONAML definition file
+class CMissionCommandTable
+{
+public:
+	//Returns the shared table for a definition file, built on first use.
+	//A binary cache is kept next to the file when bUseCache is set.
+	static std::shared_ptr< const CMissionCommandTable > Load( const std::wstring& path );
+
+	const MissionCommand *Find( int opcode ) const;
+	size_t Size( ) const { return m_commands.size( ); }
+
+	static bool bUseCache;
+
+private:
+	void Compile( CJSONAMLParser& parser );
+	void BuildIndex( );
+
+	bool ReadCache( const std::wstring& path, uint64_t srcSize, int64_t srcTime );
+	void WriteCache( const std::wstring& path, uint64_t srcSize, int64_t srcTime ) const;
+
+	std::vector< MissionCommand > m_commands;
+	//Opcodes below 0x10000 index directly, anything else goes to the map
+	std::vector< int > m_denseIndex;
+	std::unordered_map< int, int > m_sparseIndex;
+};
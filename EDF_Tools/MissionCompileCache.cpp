@@ -0,0 +1,147 @@
+#include "stdafx.h"
+
+#include <vector>
+#include <string>
+#include "util.h"
+#include "MissionCompileCache.h"
+
+#define MISSION_FN_CACHE_MAGIC 0x434E464D //MFNC
+//Bump when the compiler emits different bytes for the same source
+#define MISSION_FN_CACHE_VERSION 4
+
+static uint64_t MissionCacheKey( uint64_t sourceHash, uint64_t symbolHash )
+{
+	return sourceHash ^ ( symbolHash * 1099511628211ULL );
+}
+
+const MissionFnCacheEntry *CMissionCompileCache::Find( uint64_t sourceHash, uint64_t symbolHash ) const
+{
+	auto it = m_entries.find( MissionCacheKey( sourceHash, symbolHash ) );
+	if( it == m_entries.end( ) )
+		return nullptr;
+
+	//Full check, the map key is folded
+	if( it->second.sourceHash != sourceHash || it->second.symbolHash != symbolHash )
+		return nullptr;
+	return &it->second;
+}
+
+void CMissionCompileCache::Add( const MissionFnCacheEntry& entry )
+{
+	m_entries[MissionCacheKey( entry.sourceHash, entry.symbolHash )] = entry;
+}
+
+static void CachePutStrings( std::vector< char >& bytes, const std::vector< std::wstring >& strings )
+{
+	CachePutInt( bytes, (uint32_t)strings.size( ) );
+	for( size_t i = 0; i < strings.size( ); ++i )
+		CachePutWString( bytes, strings[i] );
+}
+
+static void CachePutInts( std::vector< char >& bytes, const std::vector< int >& values )
+{
+	CachePutInt( bytes, (uint32_t)values.size( ) );
+	for( size_t i = 0; i < values.size( ); ++i )
+		CachePutInt( bytes, (uint32_t)values[i] );
+}
+
+static bool CacheGetStrings( const std::vector< char >& bytes, size_t& pos, std::vector< std::wstring >& strings )
+{
+	uint32_t count;
+	if( !CacheGetInt( bytes, pos, count ) || count > bytes.size( ) - pos )
+		return false;
+
+	strings.resize( count );
+	for( uint32_t i = 0; i < count; ++i )
+	{
+		if( !CacheGetWString( bytes, pos, strings[i] ) )
+			return false;
+	}
+	return true;
+}
+
+static bool CacheGetInts( const std::vector< char >& bytes, size_t& pos, std::vector< int >& values )
+{
+	uint32_t count;
+	if( !CacheGetInt( bytes, pos, count ) || count > bytes.size( ) - pos )
+		return false;
+
+	values.resize( count );
+	for( uint32_t i = 0; i < count; ++i )
+	{
+		uint32_t value;
+		if( !CacheGetInt( bytes, pos, value ) )
+			return false;
+		values[i] = (int)value;
+	}
+	return true;
+}
+
+bool CMissionCompileCache::Read( const std::wstring& path )
+{
+	std::vector< char > bytes;
+	if( !CacheReadFile( path, bytes ) )
+		return false;
+
+	size_t pos = 0;
+	uint32_t magic, version, count;
+	if( !CacheGetInt( bytes, pos, magic ) || magic != MISSION_FN_CACHE_MAGIC )
+		return false;
+	if( !CacheGetInt( bytes, pos, version ) || version != MISSION_FN_CACHE_VERSION )
+		return false;
+	if( !CacheGetInt( bytes, pos, count ) )
+		return false;
+
+	std::unordered_map< uint64_t, MissionFnCacheEntry > entries;
+	for( uint32_t i = 0; i < count; ++i )
+	{
+		MissionFnCacheEntry entry;
+		uint32_t numParams;
+		if( !CacheGetInt64( bytes, pos, entry.sourceHash ) || !CacheGetInt64( bytes, pos, entry.symbolHash ) )
+			return false;
+		if( !CacheGetWString( bytes, pos, entry.fnName ) || !CacheGetInt( bytes, pos, numParams ) )
+			return false;
+		if( !CacheGetBytes( bytes, pos, entry.bytes ) || !CacheGetBytes( bytes, pos, entry.fnArgBytes ) )
+			return false;
+		if( !CacheGetInts( bytes, pos, entry.patchBytePos ) || !CacheGetStrings( bytes, pos, entry.patchFuncName ) )
+			return false;
+		if( !CacheGetStrings( bytes, pos, entry.fnNameDebug ) )
+			return false;
+		if( !CacheGetStrings( bytes, pos, entry.strings ) || !CacheGetInts( bytes, pos, entry.stringPos ) )
+			return false;
+		if( entry.patchBytePos.size( ) != entry.patchFuncName.size( ) || entry.strings.size( ) != entry.stringPos.size( ) )
+			return false;
+
+		entry.numParams = (int)numParams;
+		entries[MissionCacheKey( entry.sourceHash, entry.symbolHash )] = entry;
+	}
+
+	m_entries.swap( entries );
+	return true;
+}
+
+void CMissionCompileCache::Write( const std::wstring& path ) const
+{
+	std::vector< char > bytes;
+	CachePutInt( bytes, MISSION_FN_CACHE_MAGIC );
+	CachePutInt( bytes, MISSION_FN_CACHE_VERSION );
+	CachePutInt( bytes, (uint32_t)m_entries.size( ) );
+
+	for( auto it = m_entries.begin( ); it != m_entries.end( ); ++it )
+	{
+		const MissionFnCacheEntry& entry = it->second;
+		CachePutInt64( bytes, entry.sourceHash );
+		CachePutInt64( bytes, entry.symbolHash );
+		CachePutWString( bytes, entry.fnName );
+		CachePutInt( bytes, (uint32_t)entry.numParams );
+		CachePutBytes( bytes, entry.bytes );
+		CachePutBytes( bytes, entry.fnArgBytes );
+		CachePutInts( bytes, entry.patchBytePos );
+		CachePutStrings( bytes, entry.patchFuncName );
+		CachePutStrings( bytes, entry.fnNameDebug );
+		CachePutStrings( bytes, entry.strings );
+		CachePutInts( bytes, entry.stringPos );
+	}
+
+	CacheWriteFile( path, bytes );
+}
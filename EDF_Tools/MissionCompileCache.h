@@ -0,0 +1,40 @@
+#pragma once
+
+#include <unordered_map>
+
+//Compiled bytes of one function, before calls are patched
+struct MissionFnCacheEntry
+{
+	uint64_t sourceHash;
+	uint64_t symbolHash;
+
+	std::wstring fnName;
+	int numParams;
+	std::vector< char > bytes;
+	std::vector< char > fnArgBytes;
+	std::vector< int > patchBytePos;
+	std::vector< std::wstring > patchFuncName;
+	std::vector< std::wstring > fnNameDebug;
+
+	//String literals in the order they were compiled and where their opcodes sit in bytes, relinked on every write
+	std::vector< std::wstring > strings;
+	std::vector< int > stringPos;
+};
+
+//Per function compile results kept next to the mission source.
+//Entries are keyed by the preprocessed function text and the global symbols (variables and function names).
+//String offsets depend on the functions compiled before, the linker patches or recompiles them.
+class CMissionCompileCache
+{
+public:
+	bool Read( const std::wstring& path );
+	void Write( const std::wstring& path ) const;
+
+	const MissionFnCacheEntry *Find( uint64_t sourceHash, uint64_t symbolHash ) const;
+	void Add( const MissionFnCacheEntry& entry );
+
+	size_t Size( ) const { return m_entries.size( ); }
+
+private:
+	std::unordered_map< uint64_t, MissionFnCacheEntry > m_entries;
+};
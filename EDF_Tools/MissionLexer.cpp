@@ -0,0 +1,732 @@
+#include "stdafx.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+#include "util.h"
+#include "MissionLexer.h"
+
+//Longest top level keyword, "initialize", plus a byte order mark
+#define MISSION_KEYWORD_MAX 11
+
+//Function text being collected by ParseMissionProgram.
+//Keeps the start of the text without line breaks, so keywords can be checked without copying the buffer.
+struct MissionSourceBuffer
+{
+	void Add( wchar_t c, size_t pos )
+	{
+		if( text.size( ) == 0 )
+			start = pos;
+		text += c;
+		if( c != L'\n' && head.size( ) <= MISSION_KEYWORD_MAX )
+			head += c;
+	}
+
+	void Clear( )
+	{
+		text.clear( );
+		head.clear( );
+	}
+
+	std::wstring text;
+	std::wstring head;
+	size_t start = 0;
+};
+
+//Words split on any of the delimiters, empty words are skipped like wcstok does
+static std::vector< std::wstring > SplitWords( const std::wstring& text, const wchar_t *delims )
+{
+	std::vector< std::wstring > words;
+
+	size_t pos = text.find_first_not_of( delims );
+	while( pos != std::wstring::npos )
+	{
+		size_t end = text.find_first_of( delims, pos );
+		if( end == std::wstring::npos )
+		{
+			words.push_back( text.substr( pos ) );
+			break;
+		}
+		words.push_back( text.substr( pos, end - pos ) );
+		pos = text.find_first_not_of( delims, end );
+	}
+
+	return words;
+}
+
+CMissionLexer::CMissionLexer( const std::wstring& source, int firstLine ) : m_source( source ), m_pos( 0 ), m_lineStart( 0 ), m_line( firstLine ), m_firstLine( true )
+{
+}
+
+bool CMissionLexer::Next( std::wstring& text, int& line )
+{
+	int column;
+	return Next( text, line, column );
+}
+
+bool CMissionLexer::Next( std::wstring& text, int& line, int& column )
+{
+	while( m_pos < m_source.size( ) )
+	{
+		size_t start = m_pos;
+		int startLine = m_line;
+		int startColumn = (int)( m_pos - m_lineStart ) + 1;
+		bool isInQuote = false;
+		wchar_t lastChar = 0;
+
+		for( ; m_pos < m_source.size( ); ++m_pos )
+		{
+			wchar_t c = m_source[m_pos];
+			if( !isInQuote && ( c == L'\n' || ( c == L';' && !m_firstLine ) ) )
+				break;
+
+			if( c == L'\"' && lastChar != L'\\' )
+				isInQuote = !isInQuote;
+			if( c == L'\n' )
+			{
+				m_line++;
+				m_lineStart = m_pos + 1;
+			}
+
+			lastChar = c;
+		}
+
+		size_t end = m_pos;
+		if( m_pos < m_source.size( ) )
+		{
+			if( m_source[m_pos] == L'\n' )
+			{
+				m_line++;
+				m_lineStart = m_pos + 1;
+			}
+			m_pos++;
+		}
+		m_firstLine = false;
+
+		if( end > start )
+		{
+			text.assign( m_source, start, end - start );
+			line = startLine;
+			column = startColumn;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ParseMissionProgram( const std::wstring& source, const std::vector< std::wstring >& replaceStrings, MissionProgram& program )
+{
+	//Line starts, for positions
+	std::vector< size_t > lineStarts( 1, 0 );
+	for( size_t i = 0; i < source.size( ); ++i )
+	{
+		if( source[i] == L'\n' )
+			lineStarts.push_back( i + 1 );
+	}
+	auto lineAt = [&lineStarts]( size_t pos )
+	{
+		return (int)( std::upper_bound( lineStarts.begin( ), lineStarts.end( ), pos ) - lineStarts.begin( ) );
+	};
+
+	MissionSourceBuffer fnBuffer;
+	int bracketDepth = 0;
+	size_t size = source.size( );
+	for( size_t i = 0; i < size; i++ )
+	{
+		//Ignore certain parts:
+		if( source[i] == L'#' )
+		{
+			while( i < size && source[i] != L'\n' && source[i] != L';' )
+				i++;
+		}
+		//Comments
+		if( i + 1 < size && source[i] == L'/' && source[i + 1] == L'/' )
+		{
+			while( i < size && source[i] != L'\n' )
+				i++;
+		}
+		if( i >= size )
+			break;
+
+		//Test for 'static' variables and 'initialize' blocks:
+		if( source[i] == L' ' )
+		{
+			std::wstring keyword = fnBuffer.head;
+			if( keyword.size( ) > 0 && keyword.front( ) == 0xfeff )
+				keyword.erase( 0, 1 );
+
+			if( keyword == L"static" )
+			{
+				fnBuffer.Clear( );
+
+				//Get static variable string
+				while( i < size && source[i] != L';' && source[i] != L'\n' )
+				{
+					fnBuffer.Add( source[i], i );
+					i++;
+				}
+
+				//Second word is the variable name
+				std::vector< std::wstring > words = SplitWords( fnBuffer.text, L" " );
+				program.statics.push_back( words.size( ) > 1 ? words[1] : std::wstring( ) );
+
+				fnBuffer.Clear( );
+				i++;
+			}
+			else if( keyword == L"initialize" )
+			{
+				fnBuffer.Clear( );
+
+				while( i < size && source[i] != L'}' )
+				{
+					fnBuffer.Add( source[i], i );
+					i++;
+				}
+
+				MissionFnSource init;
+				init.text = fnBuffer.text;
+				init.line = lineAt( fnBuffer.start );
+				program.initialisers.push_back( init );
+
+				fnBuffer.Clear( );
+				i++;
+			}
+
+			if( i >= size )
+				break;
+		}
+
+		//Function ends when the brackets close
+		if( source[i] == L'{' )
+			bracketDepth++;
+		if( source[i] == L'}' )
+		{
+			bracketDepth--;
+			if( bracketDepth == 0 )
+			{
+				fnBuffer.Add( source[i], i );
+
+				MissionFnSource fn;
+				fn.text = fnBuffer.text;
+				fn.line = lineAt( fnBuffer.start );
+
+				//operate on strings using list strings to replace ( #define stuff )
+				for( size_t j = 0; j + 1 < replaceStrings.size( ); j += 2 )
+				{
+					FindAndReplaceAll( fn.text, replaceStrings[j], replaceStrings[j + 1] );
+				}
+
+				program.functions.push_back( fn );
+
+				fnBuffer.Clear( );
+				continue;
+			}
+		}
+
+		fnBuffer.Add( source[i], i );
+	}
+}
+
+MissionFnNode ParseMissionFunction( const std::wstring& source, int firstLine )
+{
+	MissionFnNode fn;
+
+	CMissionLexer lexer( source, firstLine );
+	std::wstring text;
+	int line, column;
+	bool isFirst = true;
+	while( lexer.Next( text, line, column ) )
+	{
+		//Failsafe of sorts, incase trash bytes somehow make it this far.
+		if( isFirst )
+		{
+			isFirst = false;
+			if( text[0] == 0xfeff )
+				continue;
+		}
+
+		if( fn.statements.size( ) == 0 )
+			fn.header = ParseMissionFnHeader( text );
+
+		fn.statements.push_back( ParseMissionStatement( text, line, column ) );
+	}
+
+	return fn;
+}
+
+MissionFnHeader ParseMissionFnHeader( const std::wstring& line )
+{
+	MissionFnHeader header;
+
+	//Return type and name come before the first bracket or comma
+	std::vector< std::wstring > nameParts = SplitWords( line, L"()," );
+	std::vector< std::wstring > words;
+	if( nameParts.size( ) > 0 )
+		words = SplitWords( nameParts[0], L" " );
+
+	if( words.size( ) > 0 )
+		header.returnType = words[0];
+
+	//We will allow a type assumption of void.
+	if( words.size( ) > 1 )
+		header.name = words[1];
+	else
+		header.name = header.returnType;
+
+	//Typed parameters, anything else on the line is skipped
+	std::vector< std::wstring > tokens = SplitWords( line, L"(), " );
+	for( size_t i = 0; i < tokens.size( ); ++i )
+	{
+		if( tokens[i] == L"int" || tokens[i] == L"float" || tokens[i] == L"string" )
+		{
+			if( i + 1 >= tokens.size( ) )
+				break;
+
+			MissionParam param;
+			param.type = tokens[i];
+			param.name = tokens[i + 1];
+			header.params.push_back( param );
+			i++;
+		}
+	}
+
+	return header;
+}
+
+//Syscall spellings, checked in order
+static const struct
+{
+	const wchar_t *names[3];
+	unsigned char shortOpcode;
+	unsigned char longOpcode;
+} s_missionSyscalls[] =
+{
+	{ { L"2C", L"2c", L"syscall0" }, 0x6C, 0xAC },
+	{ { L"2D", L"2d", L"syscall1" }, 0x6D, 0xAD },
+	{ { L"2E", L"2e", L"syscall2" }, 0x6E, 0xAE },
+	{ { L"syscallF", L"syscallf", L"syscall3" }, 0x6F, 0xAF },
+};
+
+static const struct
+{
+	const wchar_t *name;
+	MissionStatementType type;
+} s_missionKeywords[] =
+{
+	{ L"usetemplist", MS_TEMPLIST },
+	{ L"return", MS_RETURN },
+	{ L"if", MS_IF },
+	{ L"}", MS_BLOCKEND },
+	{ L"while", MS_WHILE },
+	{ L"else", MS_ELSE },
+	{ L"hex", MS_HEX },
+	{ L"_JUMPPOS_", MS_JUMPPOS },
+	{ L"_GETPOS_", MS_GETPOS },
+};
+
+//Binary operators, longer spellings first. A higher precedence binds tighter.
+static const struct
+{
+	const wchar_t *op;
+	int precedence;
+} s_missionBinaryOps[] =
+{
+	{ L"||", 1 },
+	{ L"|", 1 },
+	{ L"&&", 2 },
+	{ L"&", 2 },
+	{ L"==", 3 },
+	{ L"!=", 3 },
+	{ L"<=", 4 },
+	{ L">=", 4 },
+	{ L"<", 4 },
+	{ L">", 4 },
+	{ L"+", 5 },
+	{ L"-", 5 },
+	{ L"*", 6 },
+	{ L"/", 6 },
+};
+
+//Characters that end a value or name
+#define MISSION_EXPR_DELIMS L"+-*/<>=!&|(),\""
+
+//Picks the type and syscall opcodes from the callee
+static void SetMissionStatementType( MissionStatement& statement )
+{
+	for( size_t i = 0; i < sizeof( s_missionSyscalls ) / sizeof( s_missionSyscalls[0] ); ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			if( statement.callee == s_missionSyscalls[i].names[j] )
+			{
+				statement.type = MS_SYSCALL;
+				statement.shortOpcode = s_missionSyscalls[i].shortOpcode;
+				statement.longOpcode = s_missionSyscalls[i].longOpcode;
+				return;
+			}
+		}
+	}
+
+	for( size_t i = 0; i < sizeof( s_missionKeywords ) / sizeof( s_missionKeywords[0] ); ++i )
+	{
+		if( statement.callee == s_missionKeywords[i].name )
+		{
+			statement.type = s_missionKeywords[i].type;
+			return;
+		}
+	}
+}
+
+//Bracket matching the one at open, skipping quoted text. Returns end if it isn't closed before end.
+static size_t FindMissionClose( const std::wstring& text, size_t open, size_t end )
+{
+	int depth = 0;
+	bool isInQuote = false;
+	for( size_t i = open; i < end; ++i )
+	{
+		if( text[i] == L'\"' && ( i == 0 || text[i - 1] != L'\\' ) )
+			isInQuote = !isInQuote;
+		if( isInQuote )
+			continue;
+
+		if( text[i] == L'(' )
+			depth++;
+		else if( text[i] == L')' && --depth == 0 )
+			return i;
+	}
+	return end;
+}
+
+//Column of every character KillWhitespace kept, the removed characters are only spaces and tabs
+static std::vector< int > KeptColumns( const std::wstring& text, const std::wstring& kept, int firstColumn )
+{
+	std::vector< int > columns;
+	columns.reserve( kept.size( ) );
+
+	size_t j = 0;
+	for( size_t i = 0; i < kept.size( ); ++i )
+	{
+		while( j < text.size( ) && text[j] != kept[i] )
+			j++;
+		columns.push_back( firstColumn + (int)j );
+		j++;
+	}
+
+	return columns;
+}
+
+//Recursive descent over a statement with its whitespace removed.
+//Only the first error is kept, parsing stops there.
+struct MissionExprParser
+{
+	MissionExprParser( const std::wstring& text, const std::vector< int >& columns, int line, std::wstring& error ) : text( text ), columns( columns ), line( line ), error( error )
+	{
+	}
+
+	//Comma separated expressions in [start, stop). Empty ones are skipped like the old tokeniser did.
+	void ParseList( size_t start, size_t stop, std::vector< MissionExprNode >& nodes )
+	{
+		size_t outerEnd = end;
+		pos = start;
+		end = stop;
+
+		while( pos < end && error.empty( ) )
+		{
+			if( text[pos] == L',' )
+			{
+				pos++;
+				continue;
+			}
+
+			MissionExprNode node;
+			if( !ParseBinary( 1, node ) )
+				break;
+			nodes.push_back( std::move( node ) );
+
+			if( pos < end && text[pos] != L',' )
+				Fail( pos, std::wstring( L"unexpected '" ) + text[pos] + L"'" );
+		}
+
+		end = outerEnd;
+	}
+
+	bool ParseBinary( int minPrecedence, MissionExprNode& node )
+	{
+		if( !ParseUnary( node ) )
+			return false;
+
+		for( ;; )
+		{
+			size_t at = pos;
+			int precedence = 0;
+			const wchar_t *op = MatchBinary( precedence );
+			if( !op || precedence < minPrecedence )
+				return true;
+			pos += wcslen( op );
+
+			MissionExprNode right;
+			if( !ParseBinary( precedence + 1, right ) )
+				return false;
+
+			MissionExprNode binary = MakeNode( ME_BINARY, op, at );
+			binary.children.push_back( std::move( node ) );
+			binary.children.push_back( std::move( right ) );
+			node = std::move( binary );
+		}
+	}
+
+	bool ParseUnary( MissionExprNode& node )
+	{
+		if( pos >= end || ( text[pos] != L'-' && text[pos] != L'!' ) )
+			return ParsePrimary( node );
+
+		size_t at = pos;
+		wchar_t op = text[pos++];
+
+		MissionExprNode operand;
+		if( !ParseUnary( operand ) )
+			return false;
+
+		//Negative numbers stay values
+		if( op == L'-' && operand.kind == ME_VALUE && ( iswdigit( operand.text[0] ) || operand.text[0] == L'.' ) )
+		{
+			node = std::move( operand );
+			node.text.insert( 0, 1, L'-' );
+			node.column = Column( at );
+			return true;
+		}
+
+		node = MakeNode( ME_UNARY, std::wstring( 1, op ), at );
+		node.children.push_back( std::move( operand ) );
+		return true;
+	}
+
+	bool ParsePrimary( MissionExprNode& node )
+	{
+		if( pos >= end )
+			return Fail( pos, L"expected a value" );
+
+		size_t at = pos;
+		if( text[pos] == L'(' )
+		{
+			pos++;
+			if( !ParseBinary( 1, node ) )
+				return false;
+			if( pos >= end || text[pos] != L')' )
+				return Fail( pos, L"expected ')'" );
+			pos++;
+			return true;
+		}
+
+		//Strings keep their quotes and L prefix
+		if( text[pos] == L'\"' || ( text[pos] == L'L' && pos + 1 < end && text[pos + 1] == L'\"' ) )
+		{
+			size_t close = text[pos] == L'L' ? pos + 2 : pos + 1;
+			while( close < end && !( text[close] == L'\"' && text[close - 1] != L'\\' ) )
+				close++;
+			if( close >= end )
+				return Fail( at, L"missing '\"'" );
+
+			node = MakeNode( ME_VALUE, text.substr( at, close + 1 - at ), at );
+			pos = close + 1;
+			return true;
+		}
+
+		size_t wordEnd = std::min( text.find_first_of( MISSION_EXPR_DELIMS, pos ), end );
+		if( wordEnd == pos )
+			return Fail( pos, std::wstring( L"unexpected '" ) + text[pos] + L"'" );
+
+		std::wstring word = text.substr( pos, wordEnd - pos );
+		pos = wordEnd;
+
+		if( pos < end && text[pos] == L'(' )
+		{
+			size_t close = FindMissionClose( text, pos, end );
+			if( close >= end )
+				return Fail( pos, L"expected ')'" );
+
+			node = MakeNode( ME_CALL, word, at );
+			node.args = text.substr( pos + 1, close - pos - 1 );
+			ParseList( pos + 1, close, node.children );
+			pos = close + 1;
+			return error.empty( );
+		}
+
+		std::wstring lower = ConvertToLower( word );
+		bool isValue = iswdigit( word[0] ) || word[0] == L'.' || lower == L"true" || lower == L"false";
+		node = MakeNode( isValue ? ME_VALUE : ME_NAME, word, at );
+		return true;
+	}
+
+	const wchar_t *MatchBinary( int& precedence ) const
+	{
+		for( size_t i = 0; i < sizeof( s_missionBinaryOps ) / sizeof( s_missionBinaryOps[0] ); ++i )
+		{
+			size_t length = wcslen( s_missionBinaryOps[i].op );
+			if( pos + length <= end && text.compare( pos, length, s_missionBinaryOps[i].op ) == 0 )
+			{
+				precedence = s_missionBinaryOps[i].precedence;
+				return s_missionBinaryOps[i].op;
+			}
+		}
+		return nullptr;
+	}
+
+	MissionExprNode MakeNode( MissionExprKind kind, const std::wstring& nodeText, size_t at ) const
+	{
+		MissionExprNode node;
+		node.kind = kind;
+		node.text = nodeText;
+		node.line = line;
+		node.column = Column( at );
+		return node;
+	}
+
+	int Column( size_t at ) const
+	{
+		if( at < columns.size( ) )
+			return columns[at];
+		return columns.size( ) > 0 ? columns.back( ) + 1 : 1;
+	}
+
+	bool Fail( size_t at, const std::wstring& message )
+	{
+		if( error.empty( ) )
+			error = L"column " + ToString( Column( at ) ) + L": " + message;
+		return false;
+	}
+
+	const std::wstring& text;
+	const std::vector< int >& columns;
+	int line;
+	std::wstring& error;
+
+	size_t pos = 0;
+	size_t end = 0;
+};
+
+MissionStatement ParseMissionStatement( const std::wstring& text, int line, int column )
+{
+	MissionStatement statement;
+	statement.type = MS_EXPRESSION;
+	statement.assigns = false;
+	statement.shortOpcode = 0;
+	statement.longOpcode = 0;
+	statement.line = line;
+
+	statement.text = KillWhitespace( text );
+	const std::wstring& strn = statement.text;
+
+	//Split off the top level brackets. The character after a bracket is skipped on purpose, the emitters expect it.
+	std::wstring preBracketString;
+	bool parsingArgStrn = false;
+	int bracketDepth = 0;
+	for( size_t i = 0; i < strn.size( ); i++ )
+	{
+		if( strn[i] == L'(' )
+		{
+			if( bracketDepth == 0 )
+			{
+				preBracketString.assign( strn, 0, i );
+				i++;
+			}
+
+			parsingArgStrn = true;
+			bracketDepth++;
+		}
+		if( strn[i] == L')' )
+		{
+			bracketDepth--;
+			if( bracketDepth <= 0 )
+			{
+				parsingArgStrn = false;
+				i++;
+			}
+		}
+
+		if( parsingArgStrn )
+			statement.args += strn[i];
+	}
+
+	//No brackets?
+	if( preBracketString.size( ) == 0 )
+		preBracketString = strn;
+
+	size_t assignPos = preBracketString.find( L'=' );
+	if( assignPos != std::wstring::npos )
+	{
+		statement.target = preBracketString.substr( 0, assignPos );
+		statement.callee = preBracketString.substr( assignPos + 1 );
+		statement.assigns = true;
+	}
+	else
+		statement.callee = preBracketString;
+
+	SetMissionStatementType( statement );
+
+	//Hex and jump labels aren't expressions
+	if( statement.type == MS_HEX || statement.type == MS_JUMPPOS || statement.type == MS_GETPOS )
+		return statement;
+
+	//Expressions go from the first bracket to its match, not the split above
+	std::vector< int > columns = KeptColumns( text, strn, column );
+	MissionExprParser parser( strn, columns, line, statement.error );
+
+	size_t open = std::wstring::npos;
+	bool isInQuote = false;
+	for( size_t i = 0; i < strn.size( ) && open == std::wstring::npos; ++i )
+	{
+		if( strn[i] == L'\"' && ( i == 0 || strn[i - 1] != L'\\' ) )
+			isInQuote = !isInQuote;
+		else if( strn[i] == L'(' && !isInQuote )
+			open = i;
+	}
+
+	if( open != std::wstring::npos )
+	{
+		size_t close = FindMissionClose( strn, open, strn.size( ) );
+		if( close < strn.size( ) )
+			parser.ParseList( open + 1, close, statement.argNodes );
+		else
+			parser.Fail( open, L"expected ')'" );
+	}
+
+	//The assigned value is everything after the '='
+	if( statement.assigns && statement.type == MS_EXPRESSION )
+		parser.ParseList( assignPos + 1, strn.size( ), statement.valueNodes );
+
+	return statement;
+}
+
+MissionStatement MissionCallStatement( const MissionExprNode& call )
+{
+	MissionStatement statement;
+	statement.type = MS_EXPRESSION;
+	statement.assigns = false;
+	statement.shortOpcode = 0;
+	statement.longOpcode = 0;
+	statement.line = call.line;
+
+	statement.text = call.kind == ME_CALL ? call.text + L"(" + call.args + L")" : call.text;
+	statement.callee = call.text;
+	statement.args = call.args;
+	statement.argNodes = call.children;
+
+	SetMissionStatementType( statement );
+	return statement;
+}
+
+std::wstring MissionFirstLine( const std::wstring& source )
+{
+	size_t start = source.find_first_not_of( L'\n' );
+	if( start == std::wstring::npos )
+		return std::wstring( );
+
+	size_t end = source.find( L'\n', start );
+	if( end == std::wstring::npos )
+		return source.substr( start );
+	return source.substr( start, end - start );
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+//Front end for the mission script compiler.
+//Source is scanned once into functions and statements that keep their line in the preprocessed source.
+//Conditions, assigned values and call arguments are parsed into expression trees with a line and column.
+
+enum MissionStatementType
+{
+	MS_EXPRESSION,
+	MS_SYSCALL,
+	MS_TEMPLIST,
+	MS_RETURN,
+	MS_IF,
+	MS_BLOCKEND,
+	MS_WHILE,
+	MS_ELSE,
+	MS_HEX,
+	MS_JUMPPOS,
+	MS_GETPOS
+};
+
+enum MissionExprKind
+{
+	ME_VALUE,	//Number, string or bool
+	ME_NAME,	//Variable, or anything else without an operator in it
+	ME_CALL,	//Name with bracketed arguments, the arguments are the children
+	ME_UNARY,	//'-' or '!' on the only child
+	ME_BINARY	//Operator on two children
+};
+
+struct MissionExprNode
+{
+	MissionExprKind kind;
+	//Value or name as written, operator for ME_UNARY and ME_BINARY, callee for ME_CALL
+	std::wstring text;
+	//ME_CALL only, the bracketed arguments without the brackets
+	std::wstring args;
+	std::vector< MissionExprNode > children;
+
+	//Position in the preprocessed source
+	int line;
+	int column;
+};
+
+struct MissionStatement
+{
+	MissionStatementType type;
+
+	//Statement with whitespace outside of strings removed
+	std::wstring text;
+	//Text before the top level brackets (and after '='), or the whole statement
+	std::wstring callee;
+	//Text inside the top level brackets
+	std::wstring args;
+	//Left side of the first '='
+	std::wstring target;
+	bool assigns;
+
+	//One and two byte opcodes for MS_SYSCALL
+	unsigned char shortOpcode;
+	unsigned char longOpcode;
+
+	//Top level bracket contents split on commas, the condition of if, while and else
+	std::vector< MissionExprNode > argNodes;
+	//Right side of an expression that assigns
+	std::vector< MissionExprNode > valueNodes;
+	//First syntax error in the expressions, empty if there is none
+	std::wstring error;
+
+	int line;
+};
+
+struct MissionParam
+{
+	std::wstring type;
+	std::wstring name;
+};
+
+struct MissionFnHeader
+{
+	std::wstring returnType;
+	std::wstring name;
+	std::vector< MissionParam > params;
+};
+
+struct MissionFnNode
+{
+	MissionFnHeader header;
+	//Every line, the header included. It compiles to nothing.
+	std::vector< MissionStatement > statements;
+};
+
+//Function or initialize block as cut out of the source
+struct MissionFnSource
+{
+	std::wstring text;
+	int line;
+};
+
+struct MissionProgram
+{
+	std::vector< std::wstring > statics;
+	std::vector< MissionFnSource > initialisers;
+	std::vector< MissionFnSource > functions;
+};
+
+//Splits statements of a function body on line breaks and ';' outside of quotes.
+//The first line only ends at a line break. Empty statements are skipped.
+class CMissionLexer
+{
+public:
+	CMissionLexer( const std::wstring& source, int firstLine = 1 );
+
+	//False once the source is used up
+	bool Next( std::wstring& text, int& line );
+	//Column counts from 1, tabs are one column
+	bool Next( std::wstring& text, int& line, int& column );
+
+private:
+	const std::wstring& m_source;
+	size_t m_pos;
+	size_t m_lineStart;
+	int m_line;
+	bool m_firstLine;
+};
+
+//Splits preprocessed source into statics, initialize blocks and functions. #define pairs are applied to functions.
+void ParseMissionProgram( const std::wstring& source, const std::vector< std::wstring >& replaceStrings, MissionProgram& program );
+
+MissionFnNode ParseMissionFunction( const std::wstring& source, int firstLine );
+MissionFnHeader ParseMissionFnHeader( const std::wstring& line );
+MissionStatement ParseMissionStatement( const std::wstring& text, int line, int column = 1 );
+//Statement for a call or unknown name found inside an expression, as if it were written on its own line
+MissionStatement MissionCallStatement( const MissionExprNode& call );
+
+//First non empty line, no quote handling
+std::wstring MissionFirstLine( const std::wstring& source );
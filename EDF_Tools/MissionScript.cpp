@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <codecvt>
@@ -10,81 +12,126 @@
 
 #include <iostream>
 #include <locale>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <filesystem>
+#include <system_error>
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "JSONAMLParser.h"
+#include "MissionCommands.h"
+#include "MissionLexer.h"
+#include "MissionCompileCache.h"
 #include "MissionScript.h"
 #include "VMState.h"
 
 void CMissionScript::LoadLanguage( std::wstring path, int id )
 {
-	languageFile[id] = std::make_unique<CJSONAMLParser>( path );
+	//Parsed once per process and shared, see CMissionCommandTable::Load
+	languageFile[id] = CMissionCommandTable::Load( path );
 }
 
-int CMissionScript::Read( const std::wstring& path )
+void CMissionScript::ReadCommand( int language, const std::wstring& prefix, int opcode, std::vector< std::wstring >& stack )
 {
-	std::ifstream file( path + L".BVM", std::ios::binary | std::ios::ate);
+	const MissionCommand *command = languageFile[language] ? languageFile[language]->Find( opcode ) : nullptr;
+	if( command )
+	{
+		std::wstring name = command->name;
+		if( name.size( ) == 0 )
+		{
+			std::wstringstream wss;
+			wss << std::hex << opcode;
+			name = prefix + L"( 0x" + wss.str( ) + L", ";
+		}
+		else
+		{
+			name += L"( ";
+		}
+
+		int argC = command->argTypes.size( );
+		for( int i = 0; i < argC; ++i )
+		{
+			if( stack.size( ) == 0 )
+				stack.push_back( L"STACK_SIZE_ERROR" );
+
+			name += stack.back( );
+			stack.pop_back( );
 
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
+			if( !( i == argC - 1 ) )
+				name += L", ";
+		}
 
-	if( size == -1 )
-		return -1;
+		name += L" )";
 
-	std::vector<char> buffer(size);
-	if (file.read(buffer.data(), size))
+		if( !command->doesReturn )
+		{
+			Emit( L"	" + name + L";\r\n" );
+		}
+		else
+		{
+			stack.push_back( name );
+		}
+	}
+	else
 	{
-		unsigned char seg[4];
+		std::wstringstream wss;
+		wss << std::hex << opcode;
+		std::wstring name = prefix + L"( 0x" + wss.str( ) + L" )";
+
+		Emit( L"	" + name + L"\r\n" );
+	}
+}
 
+int CMissionScript::Read( const std::wstring& path, const std::wstring& outPath )
+{
+	StageTimer timer( "BVM>TXT", StatStage::Read );
+	MappedFile file;
+	//The compiler writes .bvm, which is another file where names are case sensitive
+	if( file.Open( path + L".BVM" ) || file.Open( path + L".bvm" ) )
+	{
+		ByteSpan buffer = file.Span( );
+		timer.AddBytes( buffer.size( ) );
+		timer.Next( StatStage::Parse );
 		int position = 0;
 		//position = 0x100;
 
-		Read4BytesReversed( seg, buffer, position );
-
+		//"BVM " in either byte order
 		bool validHeader = false;
-		if( seg[0] == 0x42 && seg[1] == 0x56 && seg[2] == 0x4D && seg[3] == 0x20 )
+		if( buffer.size( ) >= 4 && ( ReadBE< uint32_t >( buffer, position ) == 0x42564D20 || ReadLE< uint32_t >( buffer, position ) == 0x42564D20 ) )
 			validHeader = true;
-		else
-		{
-			Read4Bytes( seg, buffer, position );
-			if( seg[0] == 0x42 && seg[1] == 0x56 && seg[2] == 0x4D && seg[3] == 0x20 )
-				validHeader = true;
-		}
 
 		if( !validHeader )
 		{
-			std::wcout << L"BAD FILE\n";
-			file.close();
+			LogError( ) << L"BAD FILE\n";
+			file.Close();
 			return -1;
 		}
 
-		output = std::wofstream("MISSION_Data.txt", std::ios::binary | std::ios::out | std::ios::ate );
-
-		const unsigned long MaxCode = 0x10ffff;
-		const std::codecvt_mode Mode = std::generate_header;
-		std::locale utf16_locale(output.getloc(), new std::codecvt_utf16<wchar_t, MaxCode, Mode>);
-		output.imbue(utf16_locale);
+		m_output.clear( );
 
 		//Get string array position
 		position = 0x38;
-		Read4Bytes( seg, buffer, position );
-		m_iStringBufferOfs = GetIntFromChunk( seg );
+		m_iStringBufferOfs = ReadLE< int32_t >( buffer, position );
 
 		//Read variable names
 		//Get variable name count
 		position = 0x18;
-		Read4Bytes( seg, buffer, position );
-		int count = GetIntFromChunk(seg);
+		int count = ReadLE< int32_t >( buffer, position );
 		//Get offset to variable name table
 		position = 0x1c;
-		Read4Bytes( seg, buffer, position );
-		position = GetIntFromChunk(seg);
+		position = ReadLE< int32_t >( buffer, position );
 
 		//Read
 		for( int i = 0; i < count; i++ )
 		{
 			//Read offset
-			Read4Bytes( seg, buffer, position );
-			int pos = GetIntFromChunk( seg );
+			int pos = ReadLE< int32_t >( buffer, position );
 
 			m_vecVarNames.push_back( ReadUnicode( buffer, pos ) );
 
@@ -94,18 +141,16 @@ int CMissionScript::Read( const std::wstring& path )
 		//Todo: Get better data from this.
 		//Count of array 2
 		position = 0x20;
-		Read4Bytes( seg, buffer, position );
-		count = GetIntFromChunk( seg );
+		count = ReadLE< int32_t >( buffer, position );
 
 		position = 0x30;
-		Read4Bytes( seg, buffer, position );
-		int unknownChunkStart = GetIntFromChunk( seg );
+		int unknownChunkStart = ReadLE< int32_t >( buffer, position );
 
         //Determine initial values of all static variables
 		//Big thanks to Souzooka for designing this system.
         std::wstring variable_data;
         VMState runtime_state = VMState(m_vecVarNames);
-        runtime_state.interpret((unsigned char*)&(buffer.data()[unknownChunkStart]));
+        runtime_state.interpret((unsigned char*)&(buffer.data()[unknownChunkStart]), buffer.size() - unknownChunkStart);
         runtime_state.printstatics(variable_data);
 
 		//Reformat string to more ideal state:
@@ -113,45 +158,36 @@ int CMissionScript::Read( const std::wstring& path )
 
 		//Get function data offset
 		position = 0x34;
-		Read4Bytes( seg, buffer, position );
-		int functionDataOffset = GetIntFromChunk( seg );
+		int functionDataOffset = ReadLE< int32_t >( buffer, position );
 		//functionDataOffset = buffer[functionDataOffset];
 
 		//position of Function Array
 		position = 0x24;
-		Read4Bytes( seg, buffer, position );
-		position = GetIntFromChunk( seg );
+		position = ReadLE< int32_t >( buffer, position );
 
 
 		m_iFunctionDataOfs = functionDataOffset;
-		Read4Bytes( seg, buffer, position );
-		m_iFunctionDataOfs += GetIntFromChunk( seg );
+		m_iFunctionDataOfs += ReadLE< int32_t >( buffer, position );
 
 		//Read strings from array 2
 		//position += 4;
 		for( int i = 0; i < count; i++ )
 		{
 			//Read offset
-			Read4Bytes( seg, buffer, position );
-			int pos = GetIntFromChunk( seg );
+			int pos = ReadLE< int32_t >( buffer, position );
 
 			pos += functionDataOffset;
 
 			pos++;
-			Read4Bytes( seg, buffer, pos );
-
-			seg[0] = 0xff;
-			seg[1] = 0xff;
-
-			int num2 = GetIntFromChunk( seg );
+			//Backwards 16 bit jump to the function body
+			int num2 = (int)( 0xFFFF0000 | ReadLE< uint16_t >( buffer, pos ) );
 
 			m_vecFuncOffsets.push_back( (pos + num2) - 1 );
 
 			//Read name:
 			position += 4;
 
-			Read4Bytes( seg, buffer, position );
-			pos = GetIntFromChunk( seg );
+			pos = ReadLE< int32_t >( buffer, position );
 
 			MissionFunction *func = new MissionFunction( );
 			func->fnName = ReadUnicode( buffer, pos );
@@ -170,10 +206,10 @@ int CMissionScript::Read( const std::wstring& path )
 			position += 4;
 		}
 
-		std::wcout << L"Dumping data...\n";
+		if( bEchoOutput )
+			LogInfo( ) << L"Dumping data...\n";
 
-        output << variable_data + L"\r\n";
-        std::wcout << variable_data + L"\r\n";
+        Emit( variable_data + L"\r\n" );
 
 		//Loop through every function:
 		for( int funcID = 0; funcID < m_vecFunctions.size(); funcID++ )
@@ -197,8 +233,7 @@ int CMissionScript::Read( const std::wstring& path )
 
 			strn += L" )\r\n{\r\n";
 
-			output << strn;
-			std::wcout << strn;
+			Emit( strn );
 
 			//Read bytes.
 			position = m_vecFuncOffsets[funcID];
@@ -211,17 +246,32 @@ int CMissionScript::Read( const std::wstring& path )
 			//Formating lol
 			strn = L"}\r\n";
 
-			output << strn;
-			std::wcout << strn;
+			Emit( strn );
+		}
+		timer.Next( StatStage::Write );
+		if( !WriteUTF16File( outPath.c_str( ), m_output ) )
+		{
+			LogError( ) << L"Can't write " << outPath << L"\n";
+			file.Close();
+			return -1;
 		}
-		output.close();
+		timer.AddBytes( m_output.size( ) * 2 );
 	}
+	else
+		return -1;
 
-	file.close();
+	file.Close();
 	return 1;
 }
 
-void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int numArgs, int nextFunctionStart )
+void CMissionScript::Emit( const std::wstring& text )
+{
+	m_output += text;
+	if( bEchoOutput )
+		LogInfo( ) << text;
+}
+
+void CMissionScript::ReadFn( int position, const ByteSpan& buffer, int numArgs, int nextFunctionStart )
 {
 	int ofs = 0;
 	int numLocalVars = 0;
@@ -239,7 +289,9 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 
 	//Define the stack.
 	std::vector< std::wstring > stack;
-	unsigned char seg[4] = { 0, 0, 0, 0 };
+	ByteReaderLE reader( buffer );
+	//Operand of the current instruction, zero extended
+	uint32_t operand = 0;
 
 	//Track number of "variables"
 	int numVar = 0;
@@ -247,12 +299,6 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 	bool isInIf = false;
 	int ifEnd = 0;
 
-	//Clear seg
-	seg[0] = 0;
-	seg[1] = 0;
-	seg[2] = 0;
-	seg[3] = 0;
-
 	//Initialise stack with function arguements:
 	//for( int i = 0; i < numArgs; i++ )
 	//{
@@ -264,8 +310,7 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 	{
 		if( ofs == ifEnd && isInIf )
 		{
-			std::wcout << L"	}\r\n";
-			output << L"	}\r\n";
+			Emit( L"	}\r\n" );
 
 			isInIf = false;
 		}
@@ -286,12 +331,9 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 		{
 			std::wstring strn = L"	";
 
-			seg[0] = 0xff;
-			seg[1] = 0xff;
-			seg[2] = 0xff;
-			seg[3] = buffer[ofs + 1];
+			operand = 0xFFFFFF00 | reader.Get< uint8_t >( ofs + 1 );
 
-			int num = GetIntFromChunk( seg );
+			int num = (int)operand;
 
 			num = ofs + num;
 
@@ -330,14 +372,13 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			}
 			if( !found )
 			{
-				strn = L"Jump( " + std::to_wstring( (uint64_t)GetIntFromChunk( seg ) ) + L" )";
+				strn = L"Jump( " + std::to_wstring( (uint64_t)(int)operand ) + L" )";
 			}
 			if( !ret )
 			{
 				strn += L"\r\n";
 
-				std::wcout << L"	" + strn;
-				output << L"	" + strn;
+				Emit( L"	" + strn );
 			}
 			else
 			{
@@ -351,12 +392,9 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 		{
 			std::wstring strn =	L"	";
 			
-			seg[0] = 0xff;
-			seg[1] = 0xff;
-			seg[2] = buffer[ofs +2];
-			seg[3] = buffer[ofs +1];
+			operand = 0xFFFF0000 | reader.Get< uint16_t >( ofs + 1 );
 
-			int num = GetIntFromChunk( seg );
+			int num = (int)operand;
 
 			num = ofs + num;
 
@@ -395,14 +433,13 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			}
 			if( !found )
 			{
-				strn = L"Jump( " + std::to_wstring( (uint64_t)GetIntFromChunk( seg ) ) + L" )";
+				strn = L"Jump( " + std::to_wstring( (uint64_t)(int)operand ) + L" )";
 			}
 			if( !ret )
 			{
 				strn += L"\r\n";
 
-				std::wcout << L"	" + strn;
-				output <<  L"	" + strn;
+				Emit( L"	" + strn );
 			}
 			else
 			{
@@ -424,18 +461,16 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			break;
 		};
 
-		//Clear seg
-		seg[0] = 0;
-		seg[1] = 0;
-		seg[2] = 0;
-		seg[3] = 0;
-
 		//Read based on size:
-		for( int i = 0; i < size; i++ )
-		{
-			ofs++;
-			seg[3-i] = buffer[ofs];
-		}
+		if( size == 1 )
+			operand = reader.Get< uint8_t >( ofs + 1 );
+		else if( size == 2 )
+			operand = reader.Get< uint16_t >( ofs + 1 );
+		else if( size == 4 )
+			operand = reader.Get< uint32_t >( ofs + 1 );
+		else
+			operand = 0;
+		ofs += size;
 
 		//Handle the operator byte.
 		switch( operationByte )
@@ -478,8 +513,7 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			stack.pop_back();
 			stack.push_back( result );
 
-			std::wcout << L"	" + result + L"\r\n";
-			output << L"	" + result + L"\r\n";
+			Emit( L"	" + result + L"\r\n" );
 		}
 		break;
 
@@ -490,7 +524,7 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 
 		case 0x03: //Duplicate stack x times
 		{
-			int num = GetIntFromChunk( seg );
+			int num = (int)operand;
 			if( stack.size() > 0 )
 			{
 				std::wstring strn = stack.back();
@@ -618,14 +652,14 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 
 		case 0x14: //Get from BVM RAS
 		{
-			int num = GetIntFromChunk( seg );
+			int num = (int)operand;
 			if( num < m_vecVarNames.size() )
 			{
 				stack.push_back( m_vecVarNames[num ] );
 			}
 			else
 			{
-				std::wstring strn = L"RAS[ " + ToString(GetIntFromChunk( seg )) + L" ]";
+				std::wstring strn = L"RAS[ " + ToString((int)operand) + L" ]";
 				stack.push_back( strn );
 			}
 		}
@@ -639,19 +673,11 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			}
 			else if( byte == 0xD5 ) //Override for float. Probably not exatcly needed, but every instance of D5 I have sene has been a float.
 			{
-				//Float is actualy the wrong way around!
-				char reversedSeg[4];
-				reversedSeg[0] = seg[3];
-				reversedSeg[1] = seg[2];
-				reversedSeg[2] = seg[1];
-				reversedSeg[3] = seg[0];
-
-				float f;
-				memcpy(&f, &reversedSeg, sizeof(f));
+				float f = reader.Get< float >( ofs - 3 );
 				stack.push_back( std::to_wstring( (long double)f ) );
 			}
 			else
-				stack.push_back( std::to_wstring( (uint64_t)GetIntFromChunk( seg ) ) );
+				stack.push_back( std::to_wstring( (uint64_t)(int)operand ) );
 		}
 		break;
 
@@ -662,24 +688,22 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 				std::wstring strn = stack.back();
 				std::wstring out = L"	";
 				stack.pop_back();
-				int num = GetIntFromChunk( seg );
+				int num = (int)operand;
 				if( num < m_vecVarNames.size() )
 				{
 					out += m_vecVarNames[num] + L" = " + strn + L"\r\n";
-					std::wcout << out;
-					output << out;
+					Emit( out );
 				}
 				else
 				{
 					out += L"RAS[ " + ToString( num ) + L" ] = " + strn + L"\r\n";
-					std::wcout << out;
-					output << out;
+					Emit( out );
 				}
 			}
 		}
 		case 0x17: //Retrieve value from BVM RAS and push it to BVM stack, relative index
 		{
-			int varNumber = GetIntFromChunk( seg );
+			int varNumber = (int)operand;
 			if( varNumber <= numArgs )
 				stack.push_back( L"arg" + ToString( varNumber - 1 ) );
 			else
@@ -689,21 +713,19 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 
 		case 0x18: //Push stored relative BVM RAS index + next <size bytes> to stack
 		{
-			stack.push_back( L"localVar." + ToString( GetIntFromChunk( seg ) - 1 ) );
+			stack.push_back( L"localVar." + ToString( (int)operand - 1 ) );
 		}
 		break;
 
 		case 0x1B: //Increment index that BVM RAS is accessed by the next <size> bytes
 		{
-			std::wcout << L"	relIndex += " + ToString( GetIntFromChunk( seg ) ) + L"\r\n";
-			output << L"	relIndex += " + ToString( GetIntFromChunk( seg ) ) + L"\r\n";
+			Emit( L"	relIndex += " + ToString( (int)operand ) + L"\r\n" );
 		}
 		break;
 
 		case 0x1C: //Decrement index that BVM RAS is accessed by the next <size> bytes
 		{
-			std::wcout << L"	relIndex -= " + ToString( GetIntFromChunk( seg ) ) + L"\r\n";
-			output << L"	relIndex -= " + ToString( GetIntFromChunk( seg ) ) + L"\r\n";
+			Emit( L"	relIndex -= " + ToString( (int)operand ) + L"\r\n" );
 		}
 		break;
 
@@ -737,7 +759,7 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 
 		case 0x1a: //String
 		{
-			int strTableOffset = GetIntFromChunk( seg );
+			int strTableOffset = (int)operand;
 			std::wstring strn = ReadUnicode( buffer, m_iStringBufferOfs + strTableOffset );
 			stack.push_back( L"\"" + strn + L"\"" );
 		}
@@ -873,10 +895,9 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			stack.pop_back();
 
 			isInIf = true;
-			ifEnd = GetIntFromChunk( seg ) + ofs - size;
+			ifEnd = (int)operand + ofs - size;
 
-			std::wcout << str;
-			output << str;
+			Emit( str );
 		}
 		break;
 
@@ -890,10 +911,9 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			stack.pop_back( );
 
 			isInIf = true;
-			ifEnd = GetIntFromChunk( seg ) + ofs - size;
+			ifEnd = (int)operand + ofs - size;
 
-			std::wcout << str;
-			output << str;
+			Emit( str );
 		}
 		break;
 
@@ -901,24 +921,21 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 		{
 			std::wstring str = L"}\r\n";
 
-			for( int i = 0; i < 4 - size; i++ )
-			{
-				seg[i] = 0xff;
-			}
+			//Always a backwards jump, fill the bytes above the operand
+			if( size < 4 )
+				operand |= 0xFFFFFFFF << ( size * 8 );
 
-			int num = GetIntFromChunk( seg );
+			int num = (int)operand;
 
 			if( (ofs-size) + num == (position - 4) )
 			{
 				std::wstring str = L"	return;\r\n";
 
-				std::wcout << str;
-				output << str;
+				Emit( str );
 				break;
 			}
 
-			std::wcout << str;
-			output << str;
+			Emit( str );
 		}
 		break;
 		case 0x32: //Gutted print function:
@@ -927,7 +944,9 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 				stack.push_back( L"STACK_EMPTY" );
 
 			std::wstring strn = L"Debug: " + stack.back();
-			std::wcout << strn; stack.pop_back();
+			if( bEchoOutput )
+				LogInfo( ) << strn;
+			stack.pop_back();
 		}
 		break;
 
@@ -973,166 +992,34 @@ void CMissionScript::ReadFn( int position, const std::vector<char>& buffer, int
 			}
 
 			//stack.pop_back();
-			std::wcout << strn;
-			output << strn;
+			Emit( strn );
 		}
 		break;
 
 			case 0x2c://Exectute:
 			{
-				//output << L"	0x2C\r\n";
-				//std::wcout << L"	0x2C\r\n";
-
-				std::wstringstream wss;
-				wss << std::hex << GetIntFromChunk( seg );
-				std::wstring compare(L"0x" + wss.str( ));
-
-				JSONAMLNode *node = languageFile[0]->FindNode( L"representations", compare );
-				if( node )
-				{
-					std::wstring name = node->GetValue( L"name" );
-					if( name.size( ) == 0 )
-					{
-						name = L"2C( " + compare + L", ";
-					}
-					else
-					{
-						name += L"( ";
-					}
-
-					JSONAMLValueArr *args = languageFile[0]->GetValueAsArrNode( node, L"arguments" );
-
-					int argC = 0;
-					if( args )
-						argC = args->nodes.size( );
-
-					if( argC > 0 )
-					{
-						for( int i = 0; i < argC; ++i )
-						{
-							if( stack.size( ) == 0 )
-								stack.push_back( L"STACK_SIZE_ERROR" );
-
-							name += stack.back( );
-							stack.pop_back( );
-
-							if( !( i == argC - 1 ) )
-								name += L", ";
-						}
-					}
-					else if( name.size() == 0 )
-					{
-						name.pop_back( );
-						name.pop_back( );
-					}
-
-					name += L" )";
-
-					JSONAMLValueSubnode *retVals = (JSONAMLValueSubnode *)( node->values[L"returnValue"].get( ) );
-
-					if( !retVals || retVals->node->values.size() == 0 || retVals->node->GetValue( L"type" ) == L"void" )
-					{
-						std::wcout << L"	" + name + L";\r\n";
-						output << L"	" + name + L";\r\n";
-					}
-					else
-					{
-						stack.push_back( name );
-					}
-				}
-				else
-				{
-					std::wstring name = L"2C( 0x" + wss.str( ) + L" )";
-
-					std::wcout << L"	" + name + L"\r\n";
-					output << L"	" + name + L"\r\n";
-				}
+				ReadCommand( 0, L"2C", (int)operand, stack );
 			}
 			break;
 			case 0x2D:
 			{
-				std::wstringstream wss;
-				wss << std::hex << GetIntFromChunk( seg );
-				std::wstring compare( L"0x" + wss.str( ) );
-
-				JSONAMLNode *node = languageFile[1]->FindNode( L"representations", compare );
-				if( node )
-				{
-					std::wstring name = node->GetValue( L"name" );
-					if( name.size( ) == 0 )
-					{
-						name = L"2D( " + compare + L", ";
-					}
-					else
-					{
-						name += L"( ";
-					}
-
-					JSONAMLValueArr *args = languageFile[1]->GetValueAsArrNode( node, L"arguments" );
-
-					int argC = 0;
-					if( args )
-						argC = args->nodes.size( );
-
-					if( argC > 0 )
-					{
-						for( int i = 0; i < argC; ++i )
-						{
-							if( stack.size( ) == 0 )
-								stack.push_back( L"STACK_SIZE_ERROR" );
-
-							name += stack.back( );
-							stack.pop_back( );
-
-							if( !( i == argC - 1 ) )
-								name += L", ";
-						}
-					}
-					else if( name.size( ) == 0 )
-					{
-						name.pop_back( );
-						name.pop_back( );
-					}
-
-					name += L" )";
-
-					JSONAMLValueSubnode *retVals = (JSONAMLValueSubnode *)( node->values[L"returnValue"].get( ) );
-
-					if( !retVals || retVals->node->values.size( ) == 0 || retVals->node->GetValue( L"type" ) == L"void" )
-					{
-						std::wcout << L"	" + name + L";\r\n";
-						output << L"	" + name + L";\r\n";
-					}
-					else
-					{
-						stack.push_back( name );
-					}
-				}
-				else
-				{
-					std::wstring name = L"2D( 0x" + wss.str( ) + L" )";
-
-					std::wcout << L"	" + name + L"\r\n";
-					output << L"	" + name + L"\r\n";
-				}
+				ReadCommand( 1, L"2D", (int)operand, stack );
 			}
 			break;
 			case 0x2E:
 			{
-				output << L"	0x2E\r\n";
-				std::wcout << L"	0x2E\r\n";
+				Emit( L"	0x2E\r\n" );
 			}
 			break;
 			case 0x2F:
 			{
-				output << L"	0x2F\r\n";
-				std::wcout << L"	0x2F\r\n";
+				Emit( L"	0x2F\r\n" );
 			}
 			break;
 
 			case 0x30: //Exit?
 				//stack.clear();
-				//std::wcout << L"EXIT\r\n";
+				//LogInfo( ) << L"EXIT\r\n";
 				//output << L"EXIT\r\n";
 			break;
 		}
@@ -1179,8 +1066,8 @@ BVMHeader::~BVMHeader()
 
 std::vector< char > BVMHeader::GenerateBytes()
 {
-	char *seg;
 	std::vector< char > bytes;
+	ByteWriterLE writer( bytes );
 
 	//"BVM ".
 	PushStringToVectorNoEnd( headerString, &bytes );
@@ -1208,36 +1095,16 @@ std::vector< char > BVMHeader::GenerateBytes()
 	bytes.push_back( 0x0 );
 
 	//Num vars
-	seg = IntToBytes( varArrSize );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( varArrSize );
 
 	//Offset to vars
-	seg = IntToBytes( varArrPtr );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( varArrPtr );
 
 	//Num functions
-	seg = IntToBytes( fnArrSize );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( fnArrSize );
 
 	//Offset to functions
-	seg = IntToBytes( fnArrPtr );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( fnArrPtr );
 
 	//Unknown 2
 	for( int i = 0; i < 8; i++ )
@@ -1247,32 +1114,17 @@ std::vector< char > BVMHeader::GenerateBytes()
 
 	//Pointer to initialization values, 0x30
 	//This is necessary, it is unable to 0
-	seg = IntToBytes( fnArrPtr + (fnArrSize*16) );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( fnArrPtr + (fnArrSize*16) );
 
 	//Pointer to functions , 0x34
-	seg = IntToBytes( fnArrPtr + (fnArrSize*16) + sizeOfVarInitialisers ); //TODO: Make this more valid lol
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( fnArrPtr + (fnArrSize*16) + sizeOfVarInitialisers ); //TODO: Make this more valid lol
 
 	//Pointer to stringtable
-	seg = IntToBytes( strnPtr );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( strnPtr );
 
 	//Pointer to name of initialize the global variable string, only one string
 	//Use this to check the location, 0x3C
-	//std::wcout << std::hex << int(bytes.size());
+	//LogInfo() << std::hex << int(bytes.size());
 	for (int i = 0; i < 4; i++)
 	{
 		bytes.push_back(0x00);
@@ -1285,12 +1137,7 @@ std::vector< char > BVMHeader::GenerateBytes()
 	}
 
 	//Pointer to end of 4-byte aligned valid data, 0x44
-	seg = IntToBytes( 0 );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( 0 );
 
 	//padding
 	for( int i = 0; i < 4; i++ )
@@ -1312,7 +1159,7 @@ std::vector< char > BVMHeader::GenerateBytes()
 //Handle preproccessor information
 void CMissionScript::Preproccesser( std::wstring missionSourceRaw, std::wstring &missionSourceProccessed )
 {
-	std::wcout << L"Running preproccessor...\n";
+	LogInfo( ) << L"Running preproccessor...\n";
 
 	//Handle preproccessor stuff
 	std::wstring preProccesserBuffer;
@@ -1340,7 +1187,7 @@ void CMissionScript::Preproccesser( std::wstring missionSourceRaw, std::wstring
 				//Include
 				if( preproccessorInstructionType == 1 )
 				{
-					std::wcout << preProccesserBuffer + L"\n";
+					LogInfo( ) << preProccesserBuffer + L"\n";
 					std::wstring includeFile = ReadFile( preProccesserBuffer.c_str( ) );
 					FindAndReplaceAll( includeFile, L"\r\n", L"\n" );
 					std::wstring includeFileProccessed = includeFile;
@@ -1367,7 +1214,7 @@ void CMissionScript::Preproccesser( std::wstring missionSourceRaw, std::wstring
 					if( preProccesserBuffer == L"include" )
 					{
 						preproccessorInstructionType = 1;
-						std::wcout << L"Including file: ";
+						LogInfo( ) << L"Including file: ";
 					}
 				}
 
@@ -1382,41 +1229,97 @@ void CMissionScript::Preproccesser( std::wstring missionSourceRaw, std::wstring
 	}
 }
 
+bool CMissionScript::bUseCompileCache = true;
+int CMissionScript::iCompileThreads = 0;
+
+int CMissionScript::AddMissionString( const std::wstring& strn )
+{
+	auto it = m_missionStrnOfs.find( strn );
+	if( it != m_missionStrnOfs.end( ) )
+		return it->second;
+
+	//Offsets are in bytes, each string is zero terminated
+	int ofs = m_iMissionStrnSize;
+	m_iMissionStrnSize += UTF16ByteSize( strn );
+	m_iMissionStrnSize += 2; //0 terminator size
+
+	m_vecMissionStrns.push_back( strn );
+	m_missionStrnOfs[strn] = ofs;
+	return ofs;
+}
+
+int CMissionScript::FindMissionString( const std::wstring& strn ) const
+{
+	auto it = m_missionStrnOfs.find( strn );
+	return it != m_missionStrnOfs.end( ) ? it->second : -1;
+}
+
+const std::vector< int > *CMissionScript::FindVar( const std::wstring& name ) const
+{
+	auto it = m_varIndex.find( name );
+	return it != m_varIndex.end( ) ? &it->second : nullptr;
+}
+
+int CMissionScript::CountFunctions( const std::wstring& name ) const
+{
+	auto it = m_fnNameCount.find( name );
+	return it != m_fnNameCount.end( ) ? it->second : 0;
+}
+
+void CMissionScript::BuildSymbolTables( )
+{
+	m_varIndex.clear( );
+	for( int i = 0; i < m_vecVarNames.size( ); i++ )
+		m_varIndex[m_vecVarNames[i]].push_back( i );
+
+	m_fnNameCount.clear( );
+	m_fnIndex.clear( );
+	for( int i = 0; i < m_vecFunctions.size( ); i++ )
+	{
+		m_fnNameCount[m_vecFunctions[i]->fnName]++;
+		//Calls link to the first function with the name
+		m_fnIndex.insert( std::make_pair( m_vecFunctions[i]->fnName, i ) );
+	}
+}
+
+uint64_t CMissionScript::HashSymbols( )
+{
+	const std::wstring separator( 1, L'\0' );
+
+	uint64_t hash = HashWString( L"vars" );
+	for( size_t i = 0; i < m_vecVarNames.size( ); i++ )
+		hash = HashWString( separator, HashWString( m_vecVarNames[i], hash ) );
+
+	hash = HashWString( L"functions", hash );
+	for( size_t i = 0; i < m_vecFunctions.size( ); i++ )
+		hash = HashWString( separator, HashWString( m_vecFunctions[i]->fnName, hash ) );
+
+	return hash;
+}
+
 #define FLAG_VERBOSE 1
 #define FLAG_CREATE_FOLDER 2
 
 //Write a BVM file
-void CMissionScript::Write( const std::wstring& path, int flags )
+bool CMissionScript::Write( const std::wstring& path, int flags )
 {
-	//Output file
-	std::ofstream newMission;
-	if( flags & FLAG_CREATE_FOLDER )
+	//Checked before the output is opened, so a missing source doesn't empty an existing .bvm
+	std::error_code sourceError;
+	if( !std::filesystem::is_regular_file( ToFilePath( path + L".txt" ), sourceError ) )
 	{
-		std::wstring folderName;
-		std::wstring oldFolder;
-		const size_t last_slash_idx = path.rfind( L'\\' );
-		if( std::string::npos != last_slash_idx )
-		{
-			folderName = path.substr( last_slash_idx + 1, path.size( ) - last_slash_idx );
-			oldFolder = path.substr( 0, last_slash_idx );
-		}
-
-		CreateDirectoryExW( oldFolder.c_str(), path.c_str(), NULL );
-
-		newMission = std::ofstream( path + L"\\" + L"Mission" + L".bvm", std::ios::binary | std::ios::out | std::ios::ate );
+		LogError( ) << L"Can't read " << path << L".txt\n";
+		return false;
 	}
-	else
-		newMission = std::ofstream( path + L".bvm", std::ios::binary | std::ios::out | std::ios::ate );
-
-	//newMission.close( );
-	//return;
 
 	//Read input file and prepare function compilation
+	StageTimer timer( "TXT>BVM", StatStage::Read );
 	std::wstring sourcePath = path + L".txt";
 	std::wstring missionSourceRaw = ReadFile( sourcePath.c_str() );
+	timer.AddBytes( missionSourceRaw.size( ) * 2 );
+	timer.Next( StatStage::Parse );
 
 	//Verbose
-	std::wcout << L"Compiling file: " + sourcePath + L"\n";
+	LogInfo( ) << L"Compiling file: " + sourcePath + L"\n";
 
 	FindAndReplaceAll( missionSourceRaw, L"\r\n", L"\n" );
 
@@ -1425,103 +1328,17 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	Preproccesser( missionSourceRaw, missionSourceProccessed );
 
 	//Parse source file into functions
-	std::wstring fnBuffer;
-	int bracketDepth = 0;
-	for( int i = 0; i < missionSourceProccessed.size( ); i++ )
-	{
-		//Ignore certain parts:
-		if( missionSourceProccessed[i] == L'#' )
-		{
-			while( missionSourceProccessed[i] != L'\n' && missionSourceProccessed[i] != L';' )
-			{
-				i++;
-			}
-		}
-		//Comments
-		if( missionSourceProccessed[i] == L'/' && missionSourceProccessed[i+1] == L'/' )
-		{
-			while( missionSourceProccessed[i] != L'\n' )
-			{
-				i++;
-			}
-		}
-
-		//Test for 'static' variables:
-		if( missionSourceProccessed[i] == L' ' )
-		{
-			std::wstring varBuf = fnBuffer;
-			FindAndReplaceAll( varBuf, L"\n", L"" );
-			if( varBuf.front( ) == 0xfeff )
-				varBuf.erase( 0, 1 );
-			if( varBuf == L"static" )
-			{
-				fnBuffer.clear( );
-
-				//Get static variable string
-				while( missionSourceProccessed[i] != L';' && missionSourceProccessed[i] != L'\n' )
-				{
-					fnBuffer += missionSourceProccessed[i];
-					i++;
-				}
-
-				//Parse "static variable"
-				wchar_t *token = wcstok( &fnBuffer[0], L" " );
-
-				//var name
-				token = wcstok( NULL, L" " );
-				m_vecVarNames.push_back( token );
-
-				fnBuffer.clear( );
-				i++;
-			}
-
-			if (varBuf == L"initialize")
-			{
-				fnBuffer.clear();
-
-				//Get static variable string
-				while (missionSourceProccessed[i] != L'}')
-				{
-					fnBuffer += missionSourceProccessed[i];
-					i++;
-				}
-
-				m_Initialisers.push_back(new MissionFunction(fnBuffer, this));
+	MissionProgram program;
+	ParseMissionProgram( missionSourceProccessed, m_vecReplaceStrings, program );
 
-				fnBuffer.clear();
-				i++;
-			}
-
-			varBuf.clear( );
-		}
-
-		//Parse function and push to array
-		if( missionSourceProccessed[i] == L'{' )
-			bracketDepth++;
-		if( missionSourceProccessed[i] == L'}' )
-		{
-			bracketDepth--;
-			if( bracketDepth == 0 )
-			{
-				fnBuffer += missionSourceProccessed[i];
-
-				//operate on strings using list strings to replace ( #define stuff )
-				for( int j = 0; j < m_vecReplaceStrings.size( ); j += 2 )
-				{
-					FindAndReplaceAll( fnBuffer, m_vecReplaceStrings[j], m_vecReplaceStrings[j+1] );
-				}
-
-				m_vecFunctions.push_back( new MissionFunction( fnBuffer, this ) );
-
-				fnBuffer.clear( );
-				continue;
-			}
-		}
-
-		fnBuffer += missionSourceProccessed[i];
-	}
+	m_vecVarNames.insert( m_vecVarNames.end( ), program.statics.begin( ), program.statics.end( ) );
+	for( size_t i = 0; i < program.initialisers.size( ); i++ )
+		m_Initialisers.push_back( new MissionFunction( program.initialisers[i].text, this, program.initialisers[i].line ) );
+	for( size_t i = 0; i < program.functions.size( ); i++ )
+		m_vecFunctions.push_back( new MissionFunction( program.functions[i].text, this, program.functions[i].line ) );
 
 	//Init header
+	timer.Next( StatStage::Build );
 	header = new BVMHeader( );
 
 	header->varArrSize = m_vecVarNames.size();
@@ -1532,6 +1349,7 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	{
 		m_vecFunctions[i]->GetName();
 	}
+	BuildSymbolTables( );
 
 	//Parse and generate initialiser bytes
 	std::vector< char > InitBytes;
@@ -1566,17 +1384,144 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	
 	m_iFunctionDataOfs = startOfFnData;
 
-	//Compile functions
-	for( int i = 0; i < m_vecFunctions.size( ); i++ )
+	//Compile functions, unchanged ones come from the cache.
+	//Functions only read the symbol tables, so they are compiled on a pool with string offsets left open.
+	std::wstring cachePath = sourcePath + L".cache";
+	CMissionCompileCache oldCache, newCache;
+	if( bUseCompileCache )
+		oldCache.Read( cachePath );
+
+	int numFunctions = m_vecFunctions.size( );
+	uint64_t symbolHash = HashSymbols( );
+	std::vector< uint64_t > sourceHashes( numFunctions );
+	std::vector< std::exception_ptr > errors( numFunctions );
+	std::vector< char > cached( numFunctions, 0 );
+
+	int threads = iCompileThreads;
+	if( threads <= 0 )
+		threads = std::thread::hardware_concurrency( );
+	if( threads <= 0 )
+		threads = 1;
+	if( threads > numFunctions )
+		threads = numFunctions;
+
+	std::atomic< int > next( 0 );
+	auto compileWorker = [&]( )
+	{
+		for( int i = next++; i < numFunctions; i = next++ )
+		{
+			MissionFunction *fn = m_vecFunctions[i];
+			try
+			{
+				sourceHashes[i] = HashWString( fn->sourceCode );
+
+				const MissionFnCacheEntry *entry = bUseCompileCache ? oldCache.Find( sourceHashes[i], symbolHash ) : nullptr;
+				if( entry )
+				{
+					fn->ApplyCacheEntry( *entry );
+					fn->compileLog = L"Cached function: " + fn->fnName + L"\n";
+					cached[i] = 1;
+				}
+				else
+				{
+					fn->deferStrings = true;
+					fn->Compile( );
+				}
+			}
+			catch( ... )
+			{
+				errors[i] = std::current_exception( );
+			}
+		}
+	};
+
+	std::vector< std::thread > pool;
+	for( int i = 1; i < threads; ++i )
+		pool.push_back( std::thread( compileWorker ) );
+	compileWorker( );
+	for( size_t i = 0; i < pool.size( ); ++i )
+		pool[i].join( );
+
+	//Log in source order, stopping where a serial compile would have thrown
+	int numFailed = 0;
+	for( int i = 0; i < numFunctions; i++ )
+	{
+		LogInfo( ) << m_vecFunctions[i]->compileLog;
+		if( errors[i] )
+			std::rethrow_exception( errors[i] );
+		if( m_vecFunctions[i]->hasErrors )
+			numFailed++;
+	}
+
+	//Nothing is written, the old .bvm and cache stay as they were
+	if( numFailed > 0 )
+	{
+		LogError( ) << L"Compilation failed: " << sourcePath << L", " << numFailed << L" function(s) with errors\n";
+		delete header;
+		return false;
+	}
+
+	//Link strings in function order, which keeps the table and offsets as a one by one compile made them.
+	//A literal whose offset needs a different sized opcode moves every jump after it, so that function is compiled again.
+	std::vector< int > relink;
+	m_iNumCachedFunctions = 0;
+	for( int i = 0; i < numFunctions; i++ )
+	{
+		MissionFunction *fn = m_vecFunctions[i];
+		bool patched = true;
+		for( size_t j = 0; j < fn->stringRefs.size( ); j++ )
+		{
+			if( !fn->PatchString( fn->stringRefPos[j], AddMissionString( fn->stringRefs[j] ) ) )
+				patched = false;
+		}
+
+		if( !patched )
+			relink.push_back( i );
+		else if( cached[i] )
+			m_iNumCachedFunctions++;
+	}
+
+	next = 0;
+	auto relinkWorker = [&]( )
+	{
+		for( int i = next++; i < (int)relink.size( ); i = next++ )
+		{
+			MissionFunction *fn = m_vecFunctions[relink[i]];
+			MissionFunction compiled( fn->sourceCode, this, fn->sourceLine );
+			compiled.Compile( );
+			*fn = compiled;
+		}
+	};
+
+	pool.clear( );
+	for( int i = 1; i < threads && i < (int)relink.size( ); ++i )
+		pool.push_back( std::thread( relinkWorker ) );
+	relinkWorker( );
+	for( size_t i = 0; i < pool.size( ); ++i )
+		pool[i].join( );
+
+	for( int i = 0; i < numFunctions; i++ )
 	{
-		m_vecFunctions[i]->Compile();
+		MissionFunction *fn = m_vecFunctions[i];
+		//A function with errors is compiled again next time, so its errors are reported again
+		if( bUseCompileCache && !fn->hasErrors )
+		{
+			MissionFnCacheEntry newEntry;
+			newEntry.sourceHash = sourceHashes[i];
+			newEntry.symbolHash = symbolHash;
+			fn->FillCacheEntry( newEntry );
+			newCache.Add( newEntry );
+		}
 
 		m_vecFuncOffsets.push_back(startOfFnData + (Fnbytes.size() + 4));
 
 		//Add to fnBytes list
-		Fnbytes.insert(Fnbytes.end(), m_vecFunctions[i]->bytes.begin(), m_vecFunctions[i]->bytes.end());
+		Fnbytes.insert(Fnbytes.end(), fn->bytes.begin(), fn->bytes.end());
 	}
 
+	if( bUseCompileCache )
+		newCache.Write( cachePath );
+
 	//Patch instructions:
 	std::vector< char > fnPatchBytes;
 	for( int i = 0; i < m_vecFunctions.size( ); i++ )
@@ -1586,24 +1531,17 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 			int ofs = (m_vecFuncOffsets[i] - startOfFnData) + m_vecFunctions[i]->patchBytePos[j];
 			int start = ofs - 4;
 
-			int fnOfs;
-
-			for (int fnID = 0; fnID < m_vecFunctions.size(); fnID++)
-			{
-				if (m_vecFunctions[i]->patchFuncName[j] == m_vecFunctions[fnID]->fnName)
-				{
-					fnOfs = (m_vecFuncOffsets[fnID] - startOfFnData) - start;
-					break;
-				}
-			}
+			//A call nothing can be linked to would jump to an arbitrary offset, stop like a compile error does
+			auto fnID = m_fnIndex.find(m_vecFunctions[i]->patchFuncName[j]);
+			if (fnID == m_fnIndex.end())
+				throw std::runtime_error(WideToUTF8(L"Undefined function " + m_vecFunctions[i]->patchFuncName[j] + L" called from " + m_vecFunctions[i]->fnName));
 
-			char* seg = IntToBytes(fnOfs);
+			int fnOfs = (m_vecFuncOffsets[fnID->second] - startOfFnData) - start;
 
-			Fnbytes[start + 1] = seg[0];
-			Fnbytes[start + 2] = seg[1];
+			ByteWriterLE(Fnbytes).Set<int16_t>(start + 1, (int16_t)fnOfs);
 			if (fnOfs > 32767)
 			{
-				std::wcout << "\noverly large location:" + fnOfs;
+				LogWarning( ) << "\noverly large location:" << fnOfs;
 				//It doesn't make sense to support it now
 				/*
 				Fnbytes[start + 3] = seg[2];
@@ -1611,8 +1549,6 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 				Fnbytes[start + 0] = 0xE9;
 				*/
 			}
-
-			free(seg);
 		}
 	}
 
@@ -1623,8 +1559,7 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	int sizeofstringarray = 0;
 	for( int i = 0; i < m_vecMissionStrns.size( ); i++ )
 	{
-		int numChars = m_vecMissionStrns[i].size( );
-		sizeofstringarray += ( sizeof( wchar_t )*numChars );
+		sizeofstringarray += UTF16ByteSize( m_vecMissionStrns[i] );
 		sizeofstringarray += 2; //Zero terminator size
 	}
 
@@ -1632,8 +1567,7 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	int sizeofvarstrarray = 0;
 	for( int i = 0; i < m_vecVarNames.size( ); i++ )
 	{
-		int numChars = m_vecVarNames[i].size( );
-		sizeofvarstrarray += ( sizeof( wchar_t )*numChars );
+		sizeofvarstrarray += UTF16ByteSize( m_vecVarNames[i] );
 		sizeofvarstrarray += 2; //Zero terminator size
 	}
 	int startOfFunctionStrings = startOfStrings + sizeofstringarray + sizeofvarstrarray;
@@ -1647,12 +1581,10 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	for( int i = 0; i < m_vecFunctions.size( ); i++ )
 	{
 		//offset -= 1;
-		char* seg = IntToBytes(offset + 4);
-		fnPointerBytes.push_back(0xA9);
-		fnPointerBytes.push_back(seg[0]);
-		fnPointerBytes.push_back(seg[1]);
-		fnPointerBytes.push_back(0x30);
-		free(seg);
+		ByteWriterLE writer(fnPointerBytes);
+		writer.Put<uint8_t>(0xA9);
+		writer.Put<int16_t>((int16_t)(offset + 4));
+		writer.Put<uint8_t>(0x30);
 
 		int fnSize = m_vecFunctions[i]->bytes.size();
 		offset -= 4;
@@ -1671,7 +1603,7 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 		fnDataBytes.insert(fnDataBytes.end(), dataBytes.begin(), dataBytes.end());
 
 		offset += m_vecFunctions[i]->bytes.size();
-		strOfs += (sizeof(wchar_t) * m_vecFunctions[i]->fnName.size()) + 2;
+		strOfs += UTF16ByteSize(m_vecFunctions[i]->fnName) + 2;
 	}
 
 	//Start filling out our bytes by generating the header
@@ -1681,15 +1613,9 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	offset = 0;
 	for( int i = 0; i < m_vecVarNames.size( ); i++ )
 	{
-		char *seg = IntToBytes( startOfStrings + sizeofstringarray + offset );
-		bytes.push_back( seg[0] );
-		bytes.push_back( seg[1] );
-		bytes.push_back( seg[2] );
-		bytes.push_back( seg[3] );
-		free( seg );
+		ByteWriterLE( bytes ).Put< int32_t >( startOfStrings + sizeofstringarray + offset );
 
-		int numChars = m_vecVarNames[i].size( );
-		offset += ( sizeof( wchar_t )*numChars );
+		offset += UTF16ByteSize( m_vecVarNames[i] );
 		offset += 2; //Zero terminator size
 	}
 
@@ -1739,7 +1665,8 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 		PushWStringToVector(m_vecFunctions[i]->fnName, &bytes);
 	}
 
-	//Push fn Args
+	//Push fn Args, a call to a missing function still writes but fails the compile
+	bool linked = true;
 	for (int i = 0; i < m_vecFunctions.size(); i++)
 	{
 		int argsnum = m_vecFunctions[i]->fnArgBytes.size();
@@ -1754,14 +1681,9 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 			// +7 here because the position obtained is already 1 larger than it should be
 			int start = (i - InitFnsize) * 16 + fnDataBytesOffset + 7;
 			// only debug
-			//std::wcout << int(start);
-			//std::wcout << "\n";
-			char* seg = IntToBytes((bytes.size() - argsnum));
-			bytes[start + 0] = seg[0];
-			bytes[start + 1] = seg[1];
-			bytes[start + 2] = seg[2];
-			bytes[start + 3] = seg[3];
-			free(seg);
+			//LogInfo() << int(start);
+			//LogInfo( ) << "\n";
+			ByteWriterLE(bytes).Set<int32_t>(start, (int32_t)(bytes.size() - argsnum));
 		}
 		// Also check that the calling function exists.
 		int fnnum = m_vecFunctions[i]->fnNameDebug.size();
@@ -1769,17 +1691,12 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 		{
 			for (int j = 0; j < fnnum; j++)
 			{
-				bool fnExist = false;
-				for (int k = 0; k < m_vecFunctions.size(); k++)
-				{
-					if (m_vecFunctions[i]->fnNameDebug[j] == m_vecFunctions[k]->fnName)
-						fnExist = true;
-				}
+				bool fnExist = CountFunctions(m_vecFunctions[i]->fnNameDebug[j]) > 0;
 
 				if (!fnExist)
 				{
-					std::wcout << L"\nCritical error:\n";
-					std::wcout << m_vecFunctions[i]->fnNameDebug[j] + L" - that does not exist.\n\n";
+					LogError( ) << L"\nCritical error:\n" << m_vecFunctions[i]->fnNameDebug[j] + L" - that does not exist.\n\n";
+					linked = false;
 				}
 			}
 		}
@@ -1809,12 +1726,7 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 
 	//Push init String
 	int initpos = header->EOFpos.back() - 16;
-	char* initseg = IntToBytes(bytes.size());
-	bytes[initpos + 0] = initseg[0];
-	bytes[initpos + 1] = initseg[1];
-	bytes[initpos + 2] = initseg[2];
-	bytes[initpos + 3] = initseg[3];
-	free(initseg);
+	ByteWriterLE(bytes).Set<int32_t>(initpos, (int32_t)bytes.size());
 
 	for (int i = 0; i < m_Initialisers.size(); i++)
 	{
@@ -1824,7 +1736,7 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 	if (!hasInitFn)
 	{
 		PushWStringToVector(L"Mission", &bytes);
-		std::wcout << L"No global variables are initialized, the output defaults.\n";
+		LogInfo( ) << L"No global variables are initialized, the output defaults.\n";
 	}
 
 	//Functions
@@ -1841,12 +1753,7 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 			bytes.push_back(0xBA);
 			if (bytes.size() % 4 == 0 && eoaPosSet == false)
 			{
-				char* eofseg = IntToBytes(bytes.size());
-				bytes[eod + 0] = eofseg[0];
-				bytes[eod + 1] = eofseg[1];
-				bytes[eod + 2] = eofseg[2];
-				bytes[eod + 3] = eofseg[3];
-				free(eofseg);
+				ByteWriterLE(bytes).Set<int32_t>(eod, (int32_t)bytes.size());
 
 				eoaPosSet = true;
 			}
@@ -1856,99 +1763,61 @@ void CMissionScript::Write( const std::wstring& path, int flags )
 
 	//write EOF
 	int eof = header->EOFpos.back();
-	char* eofseg = IntToBytes(bytes.size());
-	bytes[eof + 0] = eofseg[0];
-	bytes[eof + 1] = eofseg[1];
-	bytes[eof + 2] = eofseg[2];
-	bytes[eof + 3] = eofseg[3];
+	ByteWriterLE(bytes).Set<int32_t>(eof, (int32_t)bytes.size());
 	if (eoaPosSet == false)
+		ByteWriterLE(bytes).Set<int32_t>(eod, (int32_t)bytes.size());
+	
+	//Final write. The output is opened last so a failed compile leaves the old file alone.
+	timer.Next( StatStage::Write );
+	std::ofstream newMission;
+	if( flags & FLAG_CREATE_FOLDER )
 	{
-		bytes[eod + 0] = eofseg[0];
-		bytes[eod + 1] = eofseg[1];
-		bytes[eod + 2] = eofseg[2];
-		bytes[eod + 3] = eofseg[3];
+		//Already there is fine, a failure shows up when the file won't open
+		std::error_code error;
+		std::filesystem::create_directory( ToFilePath( path ), error );
+
+		newMission = std::ofstream( ToFilePath( path + L"\\" + L"Mission" + L".bvm" ), std::ios::binary | std::ios::out | std::ios::ate );
 	}
-	free(eofseg);
-	
-	//Final write.
+	else
+		newMission = std::ofstream( ToFilePath( path + L".bvm" ), std::ios::binary | std::ios::out | std::ios::ate );
+
 	newMission.write(bytes.data(), bytes.size());
 
 	newMission.close();
+	timer.AddBytes( bytes.size( ) );
+	timer.Stop( );
+	delete header;
 
-	std::wcout << L"Compilation completed: " + sourcePath + L"\n";
+	if( !newMission )
+	{
+		LogError( ) << L"Can't write " << path << L".bvm\n";
+		return false;
+	}
 
-	delete header;
+	LogInfo( ) << L"Compilation completed: " + sourcePath + L"\n";
+	return linked;
 }
 
-MissionFunction::MissionFunction( std::wstring srcCode, CMissionScript *script )
+MissionFunction::MissionFunction( std::wstring srcCode, CMissionScript *script, int line )
 {
 	sourceCode = srcCode;
+	sourceLine = line;
 	myScript = script;
 }
 
-void MissionFunction::CompileLine(std::wstring fnStrn)
+void MissionFunction::CompileStatement(const MissionStatement& statement)
 {
-	std::wstring argsStrn;
-	bool parsingArgStrn = false;
-	int bracketDepth = 0;
-
-	std::wstring preBracketString;
+	std::wstring argsStrn = statement.args;
+	std::wstring preBracketString = statement.callee;
 
-	//Kill whitespace in main string.
-	fnStrn = KillWhitespace(fnStrn);
-
-	//Begin parsing string.
-	for (int i = 0; i < fnStrn.size(); i++)
-	{
-		//Control chars
-		if (fnStrn[i] == L'(')
-		{
-			if (bracketDepth == 0)
-			{
-				preBracketString = fnStrn.c_str();
-				preBracketString.erase(i, preBracketString.size() - i);
-				i++;
-			}
-
-			parsingArgStrn = true;
-			bracketDepth++;
-		}
-		if (fnStrn[i] == L')')
-		{
-			bracketDepth--;
-			if (bracketDepth <= 0)
-			{
-				parsingArgStrn = false;
-				i++;
-			}
-		}
-
-		if (parsingArgStrn)
-		{
-			argsStrn += fnStrn[i];
-		}
-	}
-
-	//No brackets?
-	if (preBracketString.size() == 0)
-		preBracketString = fnStrn;
-
-	//Scan string for variable operators
-	bool lineSetsVariable = false;
+	bool lineSetsVariable = statement.assigns;
 	bool lineSetsLocalVariable = false;
-	std::wstring strVarName;
-	for (int pos = 0; pos < preBracketString.size(); pos++)
-	{
-		if (preBracketString[pos] == L'=')
-		{
-			//Get left side:
-			strVarName = preBracketString.c_str();
-			strVarName.erase(pos, strVarName.size() - pos);
-			preBracketString.erase(0, pos + 1);
+	const std::wstring& strVarName = statement.target;
 
-			lineSetsVariable = true;
-			break;
-		}
+	if (statement.error.size() > 0)
+	{
+		compileLog += L"Bad expression on line " + ToString(statement.line) + L", " + statement.error + L": " + statement.text + L"\n";
+		hasErrors = true;
 	}
 
 	//Todo: Handle variables correctly.
@@ -1971,16 +1840,13 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 		{
 			bool isDefinedGlobalVar = false;
 
-			for (int i = 0; i < myScript->GetNumVars(); i++)
+			const std::vector< int > *globalVar = myScript->FindVar(strVarName);
+			if (globalVar)
 			{
-				if (myScript->GetVarName(i) == strVarName)
-				{
-					bytes.push_back(0x55);
-					bytes.push_back(i);
+				bytes.push_back(0x55);
+				bytes.push_back(globalVar->front());
 
-					isDefinedGlobalVar = true;
-					break;
-				}
+				isDefinedGlobalVar = true;
 			}
 			if (!isDefinedGlobalVar)
 			{
@@ -1999,16 +1865,17 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 		//bytes.push_back( 0x00 );
 	}
 
-	//Check functions
-	for (int j = 0; j < myScript->GetNumFunctions(); j++)
+	//Check functions, a name defined twice is called twice. A call that is assigned is compiled with the value.
+	int numLocalCalls = (lineSetsVariable && statement.type == MS_EXPRESSION) ? 0 : myScript->CountFunctions(preBracketString);
+	for (int j = 0; j < numLocalCalls; j++)
 	{
-		if (preBracketString == myScript->GetFnName(j)) //If I am trying to call a function I have stored locally:
+		//If I am trying to call a function I have stored locally:
 		{
 			//Create string backup
 			std::wstring strnBak = preBracketString.c_str();
 
 			//Handle the rest of the function
-			CompileArgs(argsStrn);
+			CompileArgs(statement.argNodes);
 
 			//Register area for patching
 			patchBytePos.push_back(bytes.size());
@@ -2024,19 +1891,21 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 	}
 
 	//Get function name:
-	if (preBracketString == L"2C" || preBracketString == L"2c" || preBracketString == L"syscall0") //2C
+	if (statement.type == MS_SYSCALL) //2C, 2D, 2E, 2F
 	{
-		//Get arguement 1 (Type of 2C command)
-		std::wstring arg = SimpleTokenise(argsStrn, L',');
+		//Get arguement 1 (Type of command)
+		std::wstring arg;
+		if (statement.argNodes.size() > 0)
+			arg = statement.argNodes[0].text;
 
 		int parseNum = (int)wcstol(arg.c_str(), NULL, 0);
-		char* fnTypeBytes = IntToBytes(parseNum);
 
-		if (parseNum == 2)
+		if (statement.shortOpcode == 0x6C && parseNum == 2)
 		{
-			std::wstring temparg = argsStrn;
-			std::wstring fnToken = SimpleTokenise(temparg, L',');
-			if (fnToken.front() == L'\"' && fnToken.back() == L'\"')
+			std::wstring fnToken;
+			if (statement.argNodes.size() > 1)
+				fnToken = statement.argNodes[1].text;
+			if (fnToken.size() > 1 && fnToken.front() == L'\"' && fnToken.back() == L'\"')
 			{
 				fnToken.erase(0, 1);
 				fnToken.pop_back();
@@ -2044,109 +1913,31 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 			}
 			else
 			{
-				std::wcout << L"Wrong parameter: " + fnStrn + L"\n";
+				compileLog += L"Wrong parameter on line " + ToString(statement.line) + L": " + statement.text + L"\n";
 			}
 		}
 
 		//Handle the rest of the function
-		CompileArgs(argsStrn);
-
-		//Compress bytes
-		if (parseNum > 0xff)
-		{
-			bytes.push_back(0xAC);
-			bytes.push_back(fnTypeBytes[0]);
-			bytes.push_back(fnTypeBytes[1]);
-		}
-		else
-		{
-			bytes.push_back(0x6C);
-			bytes.push_back(fnTypeBytes[0]);
-		}
-		free(fnTypeBytes);
-		
-	}
-	else if (preBracketString == L"2D" || preBracketString == L"2d" || preBracketString == L"syscall1") //2D
-	{
-		//Get arguement 1 (Type of 2D command)
-		std::wstring arg = SimpleTokenise(argsStrn, L',');
-
-		int parseNum = (int)wcstol(arg.c_str(), NULL, 0);
-		char* fnTypeBytes = IntToBytes(parseNum);
-
-		//Handle the rest of the function
-		CompileArgs(argsStrn);
-
-		//Compress bytes
-		if (parseNum > 0xff)
-		{
-			bytes.push_back(0xAD);
-			bytes.push_back(fnTypeBytes[0]);
-			bytes.push_back(fnTypeBytes[1]);
-		}
-		else
-		{
-			bytes.push_back(0x6D);
-			bytes.push_back(fnTypeBytes[0]);
-		}
-		free(fnTypeBytes);
-	}
-	else if (preBracketString == L"2E" || preBracketString == L"2e" || preBracketString == L"syscall2") //2E
-	{
-		//Get arguement 1 (Type of 2E command)
-		std::wstring arg = SimpleTokenise(argsStrn, L',');
-
-		int parseNum = (int)wcstol(arg.c_str(), NULL, 0);
-		char* fnTypeBytes = IntToBytes(parseNum);
-
-		//Handle the rest of the function
-		CompileArgs(argsStrn);
+		CompileArgs(statement.argNodes, 1);
 
 		//Compress bytes
 		if (parseNum > 0xff)
 		{
-			bytes.push_back(0xAE);
-			bytes.push_back(fnTypeBytes[0]);
-			bytes.push_back(fnTypeBytes[1]);
+			bytes.push_back(statement.longOpcode);
+			ByteWriterLE(bytes).Put<int16_t>((int16_t)parseNum);
 		}
 		else
 		{
-			bytes.push_back(0x6E);
-			bytes.push_back(fnTypeBytes[0]);
+			bytes.push_back(statement.shortOpcode);
+			bytes.push_back((char)parseNum);
 		}
-		free(fnTypeBytes);
 	}
-	else if (preBracketString == L"syscallF" || preBracketString == L"syscallf" || preBracketString == L"syscall3") //2F
-	{
-		//Get arguement 1 (Type of 2F command)
-		std::wstring arg = SimpleTokenise(argsStrn, L',');
-
-		int parseNum = (int)wcstol(arg.c_str(), NULL, 0);
-		char* fnTypeBytes = IntToBytes(parseNum);
-
-		//Handle the rest of the function
-		CompileArgs(argsStrn);
-
-		//Compress bytes
-		if (parseNum > 0xff)
-		{
-			bytes.push_back(0xAF);
-			bytes.push_back(fnTypeBytes[0]);
-			bytes.push_back(fnTypeBytes[1]);
-		}
-		else
-		{
-			bytes.push_back(0x6F);
-			bytes.push_back(fnTypeBytes[0]);
-		}
-		free(fnTypeBytes);
-	}
-	else if (preBracketString == L"usetemplist") //temp list
+	else if (statement.type == MS_TEMPLIST) //temp list
 	{
 		// use a temp list to solve hex() does not have variables
-		CompileArgs(argsStrn);
+		CompileArgs(statement.argNodes);
 	}
-	else if (preBracketString == L"return") //Return
+	else if (statement.type == MS_RETURN) //Return
 	{
 		if (bytes.size() < 127)
 		{
@@ -2157,19 +1948,14 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 		{
 			bytes.push_back(0xA8);
 
-			char* ofsBytes = IntToBytes((-bytes.size()) + 1);
-
-			bytes.push_back(ofsBytes[0]);
-			bytes.push_back(ofsBytes[1]);
-
-			free(ofsBytes);
+			ByteWriterLE(bytes).Put<int16_t>((int16_t)((-bytes.size()) + 1));
 		}
 	}
-	else if (preBracketString == L"if") //conditional
+	else if (statement.type == MS_IF) //conditional
 	{
 		ifArgs.push_back(argsStrn.c_str());
 
-		CompileExpression(argsStrn);
+		CompileArgs(statement.argNodes);
 
 		bytes.push_back(0xA6); //Jump if stack == 0
 		//Placeholder
@@ -2178,29 +1964,19 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 		bytes.push_back(0x00);
 		patchConditionalPos.push_back(bytes.size());
 	}
-	else if (preBracketString == L"}") //Patch conditional
+	else if (statement.type == MS_BLOCKEND) //Patch conditional
 	{
 		if (whileStartPos.size() > 0)
 		{
 			// Jump back to conditions.
 			int ofs = whileStartPos.back() - bytes.size();
-			char* ofsBytes = IntToBytes(ofs);
-
 			bytes.push_back(0xA8);
-			bytes.push_back(ofsBytes[0]);
-			bytes.push_back(ofsBytes[1]);
-
-			free(ofsBytes);
+			ByteWriterLE(bytes).Put<int16_t>((int16_t)ofs);
 			whileStartPos.pop_back();
 
 			// Jump out of loop if false
 			ofs = whileConditionalPos.back();
-			char* ofsseg = IntToBytes(bytes.size() - ofs);
-
-			bytes[ofs+1] = ofsseg[0];
-			bytes[ofs+2] = ofsseg[1];
-
-			free(ofsseg);
+			ByteWriterLE(bytes).Set<int16_t>(ofs + 1, (int16_t)(bytes.size() - ofs));
 			whileConditionalPos.pop_back();
 		}
 
@@ -2213,18 +1989,8 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 			//Its hex should be: A8 0300
 			if (elseConditionalPos.size() > 0 && int(bytes[start - 3]) == -88 && int(bytes[start - 2]) == 3 && int(bytes[start - 1]) == 0)
 			{
-				char* seg = IntToBytes((bytes.size() - start) + 3);
 				//If true, skip the content of else
-				/*
-				bytes[start - 4] = seg[0];
-				bytes[start - 3] = seg[1];
-				bytes[start - 2] = seg[2];
-				bytes[start - 1] = seg[3];
-				*/
-				bytes[start - 2] = seg[0];
-				bytes[start - 1] = seg[1];
-
-				free(seg);
+				ByteWriterLE(bytes).Set<int16_t>(start - 2, (int16_t)((bytes.size() - start) + 3));
 
 				elseConditionalPos.pop_back();
 			}
@@ -2239,22 +2005,17 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 				//Its hex should be: A6 0000
 				if (int(bytes[start - 3]) == -90 && int(bytes[start - 2]) == 0 && int(bytes[start - 1]) == 0)
 				{
-					char* seg = IntToBytes((bytes.size() - start) + 3);
-
-					bytes[start - 2] = seg[0];
-					bytes[start - 1] = seg[1];
-
-					free(seg);
+					ByteWriterLE(bytes).Set<int16_t>(start - 2, (int16_t)((bytes.size() - start) + 3));
 				}
 				//only debug display
 				/*
 				else
 				{
-					std::wcout << int(bytes[start - 5]);
-					std::wcout << int(bytes[start - 4]);
-					std::wcout << int(bytes[start - 3]);
-					std::wcout << int(bytes[start - 2]);
-					std::wcout << int(bytes[start - 1]);
+					LogInfo() << int(bytes[start - 5]);
+					LogInfo() << int(bytes[start - 4]);
+					LogInfo() << int(bytes[start - 3]);
+					LogInfo() << int(bytes[start - 2]);
+					LogInfo() << int(bytes[start - 1]);
 					//system("pause");
 					//exit(0);
 				}*/
@@ -2263,10 +2024,10 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 			patchConditionalPos.pop_back();
 		}
 	}
-	else if( preBracketString == L"while" ) //while loop
+	else if( statement.type == MS_WHILE ) //while loop
 	{
 		whileStartPos.push_back( bytes.size( ) );
-		CompileExpression( argsStrn );
+		CompileArgs( statement.argNodes );
 
 		whileConditionalPos.push_back(bytes.size());
 		bytes.push_back( 0xA6 ); //Jump if stack == 0
@@ -2275,16 +2036,16 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 		bytes.push_back( 0x00 );
 		bytes.push_back( 0x00 );
 	}
-	else if (preBracketString == L"else") //else
+	else if (statement.type == MS_ELSE) //else
 	{
 		//elseConditionalPos is necessary
 		//it needs to be used to judge "else" instead of "if"
 		elseConditionalPos.push_back(bytes.size());
 		patchConditionalPos.push_back(bytes.size());
 
-		CompileExpression(argsStrn);
+		CompileArgs(statement.argNodes);
 	}
-	else if( preBracketString == L"hex" ) //Raw hex code
+	else if( statement.type == MS_HEX ) //Raw hex code
 	{
 		//Align to 2-byte chunks
 		if( argsStrn.length( ) % 2 > 0 )
@@ -2300,7 +2061,7 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 			bytes.push_back( byte );
 		}
 	}
-	else if (preBracketString == L"_JUMPPOS_") // custom jump
+	else if (statement.type == MS_JUMPPOS) // custom jump
 	{
 		// structure:
 		// _JUMPPOS_(pos name, type, extra offset);
@@ -2337,10 +2098,7 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 					if (str_LjumpPos[i] == str_RjumpPos.back())
 					{
 						int ofs = i_LjumpPos[i];
-						char* ofsseg = IntToBytes(ofs - i_RjumpPos.back() + i_RjumpOffset.back());
-						bytes.push_back(ofsseg[0]);
-						bytes.push_back(ofsseg[1]);
-						free(ofsseg);
+						ByteWriterLE(bytes).Put<int16_t>((int16_t)(ofs - i_RjumpPos.back() + i_RjumpOffset.back()));
 
 						succeed = true;
 						str_RjumpPos.pop_back();
@@ -2359,7 +2117,7 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 			}
 		}
 	}
-	else if (preBracketString == L"_GETPOS_") // custom jump
+	else if (statement.type == MS_GETPOS) // custom jump
 	{
 		// structure:
 		// _GETPOS_(pos name);
@@ -2377,10 +2135,7 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 					if (str_RjumpPos[i] == argsStrn)
 					{
 						int ofs = i_RjumpPos[i];
-						char* ofsseg = IntToBytes(bytes.size() - ofs + i_RjumpOffset[i]);
-						bytes[ofs + 1] = ofsseg[0];
-						bytes[ofs + 2] = ofsseg[1];
-						free(ofsseg);
+						ByteWriterLE(bytes).Set<int16_t>(ofs + 1, (int16_t)(bytes.size() - ofs + i_RjumpOffset[i]));
 					}
 				}
 			}
@@ -2391,8 +2146,7 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 	{
 		if( lineSetsVariable )
 		{
-			//look for control symbols:
-			CompileExpression( preBracketString );
+			CompileArgs( statement.valueNodes );
 		}
 	}
 
@@ -2402,654 +2156,141 @@ void MissionFunction::CompileLine(std::wstring fnStrn)
 	}
 }
 
-void MissionFunction::CompileExpression( std::wstring argsStrn )
+//Operator index for add, sub, mul and div, -1 for the rest
+static int MissionArithmeticOp( const std::wstring& op )
 {
-	//Parse string, scaning for specific expressions
-	std::wstring token, expr;
-	expr = argsStrn.c_str( );
-
-	bool handledExpr = false;
-
-	//delete ;
-	if( expr[expr.size( )] == L';' )
-	{
-		expr.pop_back( );
-	}
-
-	//If I am a string, just ignore it.
-	if( !( DetermineType( argsStrn ) == T_STRING ) )
-	{
-		// OK! Here is the main problem child.
-		// We need to handle conditionals elsewhere, perhaps? That said, they do "operate" two values together into a single value. But it is hard to really handle 1 + 2 > 5 * 3, as it will become 0 * 3...
-		// CompileArgs can convert any value into its bvm equivalent, so we should exploit that here.
-		// 
-		// 
-		// BVM bytes required:
-		// 0x4 (0x44): BVM add, extra param determines type ( 0 = int + int, 1 = int + float, 2 = float + int, 3 = float + float )
-		// 0x5 (0x45): BVM sub, extra param determines type ( 0 = int - int, 1 = int - float, 2 = float - int, 3 = float - float )
-		// 0x6 (0x46): BVM mul, extra param determines type ( 0 = int * int, 1 = int * float, 2 = float * int, 3 = float * float )
-		// 0x7 (0x47): BVM div, extra param determines type ( 0 = int / int, 1 = int / float, 2 = float / int, 3 = float / float )
-		// 
-		// Solution 1:
-		// Tokenise, extracting the two halfs of the current step
-		// Feed data into stack, 'next' first, then 'part'.
-		// Determine value types of both "next" and "Part"
-		// Take control value and fill in the blanks.
-		// Problems: "Wrong way around"
-		// Will likely need to do this in reverse.
-		//
-		//
-		//
-		// Solution 2:
-		// iterate from string len to 0:
-		// if char at index = control symbol.
-		//
-		// if we dont have a control symbol yet:
-		// chop off end of string, store it as 'part', store control symbol.
-		// Determine value type of part. Store result.
-		// Feed part to CompileArgs
-		//
-		// Otherwise:
-		// chop off end of string, store it as 'next', store control symbol to temp value.
-		// Determine value type of next. Store result.
-		// Feed next to CompileArgs
-		// Generate arithematic control bytes and feed to BVM.
-		// Swap part with next. Swap stored control symbol with next.
-
-		// When we reach 0, do pretty much the same thing, just with the remainder of the string as the next.
-		// Should have handled it then.
-
-		//IMPLEMENTATION:
-
-		//Local storage
-		wchar_t ctrl = NULL;
-		wchar_t delim[4] = { L'+', L'-', L'*', L'/' };
-		int lastnumber = 0;
-
-		std::wstring next, part, last;
-		
-		ValueType lastType;
-
-		//Must get the length of the first value read forward.
-		part = expr;
-		for (int i = part.size() - 1; i > 0; --i)
-		{
-			for (int delim_index = 0; delim_index < 4; ++delim_index)
-			{
-				if (part[i] == delim[delim_index]) //if char at index = control symbol.
-				{
-					part.erase(i, part.size() - i);
-				}
-			}
-		}
-
-		//Read the string forward, prevent reverse output.
-		//i should be 1, as 0 may cause negative numbers to be recognized as -
-		for (int i = 1; i < expr.size(); ++i)
-		{
-			for (int delim_index = 0; delim_index < 4; ++delim_index)
-			{
-				if (expr[i] == delim[delim_index]) //if char at index = control symbol.
-				{
-					if (ctrl == NULL) //if we dont have a control symbol yet:
-					{
-						//Store control symbol. Chop off end of string, store it as 'part'.
-						ctrl = expr[i];
-
-						//Determine value type of part. Store result.
-						//Is actually the first value
-						lastType = DetermineType(part);
-
-						//TODO: Determine variable types appropriately.
-						if (lastType == T_INVALID)
-							lastType = T_INT;
-
-						//Feed part to CompileArgs
-						CompileValue(part);
-
-						//For testing output order
-						//bytes.push_back(0xF1);
-
-						//Because the previous pointer is needed, it is stored.
-						lastnumber = i;
-					}
-					else //Otherwise:
-					{
-						//Store control symbol to temp buffer.
-						char newctrl = expr[i];
-
-						//Chop off the tail and head, keep the required string, store it as 'next'.
-						//Current pointer is next position, so use previous pointer.
-						next = expr.c_str();
-						next.erase(i, expr.size() - i);
-						next.erase(0, lastnumber + 1);
-
-						//Determine value type of next. Store result.
-						ValueType curType = DetermineType(next);
-
-						//TODO: Determine variable types appropriately.
-						if (curType == T_INVALID)
-							curType = T_INT;
-
-						//Feed next to CompileArgs
-						CompileValue(next);
-
-						//Generate arithematic control bytes and feed to BVM.
-
-						char subByte;
-
-						//Eh, probably a better way of doing this.
-						if (lastType == T_INT && curType == T_INT)
-							subByte = 0; //Int + Int
-						else if (lastType == T_INT && curType == T_FLOAT)
-							subByte = 1; //Int + Float
-						else if (lastType == T_FLOAT && curType == T_INT)
-							subByte = 2; //Float + Int
-						else if (lastType == T_FLOAT && curType == T_FLOAT)
-							subByte = 3; //Float + Float
-
-						//Can safely assume > 0 is a float.
-						if (subByte > 0)
-							lastType = T_FLOAT;
-
-						char mainByte;
-
-						//Convert char to appropriate byte
-						switch (ctrl)
-						{
-						case '+':
-							mainByte = 0x04;
-							break;
-						case '-':
-							mainByte = 0x05;
-							break;
-						case '*':
-							mainByte = 0x06;
-							break;
-						case '/':
-							mainByte = 0x07;
-							break;
-						}
-
-						//Push to compiled code
-						bytes.push_back(mainByte);
-						bytes.push_back(subByte);
-
-						//Store control symbol.
-						ctrl = newctrl;
-						//Because the previous pointer is needed, it is stored.
-						lastnumber = i;
-					}
-				}
-			}
-		}
-
-		//iterate from string len to 0. Not using it now.
-		/*
-			for (int i = expr.size() - 1; i > 0; --i)
-			{
-				for (int delim_index = 0; delim_index < 4; ++delim_index)
-				{
-					if (expr[i] == delim[delim_index]) //if char at index = control symbol.
-					{
-						if (ctrl == NULL) //if we dont have a control symbol yet:
-						{
-							//Store control symbol. Chop off end of string, store it as 'part'.
-							ctrl = expr[i];
-
-							part = expr.c_str();
-							expr.erase(i, expr.size() - i);
-							part.erase(0, i + 1);
-
-							//Determine value type of part. Store result.
-							lastType = DetermineType(part);
-
-							//TODO: Determine variable types appropriately.
-							if (lastType == T_INVALID)
-								lastType = T_INT;
-
-							//Feed part to CompileArgs
-							CompileValue(part);
-						}
-						else //Otherwise:
-						{
-							//Store control symbol to temp buffer.
-							char newctrl = expr[i];
-
-							//Chop off end of string, store it as 'next'.
-							next = expr.c_str();
-							expr.erase(i, expr.size() - i);
-							next.erase(0, i + 1);
-
-							//Determine value type of next. Store result.
-							ValueType curType = DetermineType(next);
-
-							//TODO: Determine variable types appropriately.
-							if (curType == T_INVALID)
-								curType = T_INT;
-
-							//Feed next to CompileArgs
-							CompileValue(next);
-
-							//Generate arithematic control bytes and feed to BVM.
-
-							char subByte;
-
-							//Eh, probably a better way of doing this.
-							if (lastType == T_INT && curType == T_INT)
-								subByte = 0; //Int + Int
-							else if (lastType == T_INT && curType == T_FLOAT)
-								subByte = 1; //Int + Float
-							else if (lastType == T_FLOAT && curType == T_INT)
-								subByte = 2; //Float + Int
-							else if (lastType == T_FLOAT && curType == T_FLOAT)
-								subByte = 3; //Float + Float
-
-							//Can safely assume > 0 is a float.
-							if (subByte > 0)
-								lastType = T_FLOAT;
-
-							char mainByte;
-
-							//Convert char to appropriate byte
-							switch (ctrl)
-							{
-							case '+':
-								mainByte = 0x04;
-								break;
-							case '-':
-								mainByte = 0x05;
-								break;
-							case '*':
-								mainByte = 0x06;
-								break;
-							case '/':
-								mainByte = 0x07;
-								break;
-							}
-
-							//Push to compiled code
-							bytes.push_back(mainByte);
-							bytes.push_back(subByte);
-
-							//Store control symbol.
-							ctrl = newctrl;
-						}
-					}
-				}
-			}
-		*/
-
-		//When we reach 0, do pretty much the same thing, just with the remainder of the string as the next.
-		if( ctrl != NULL )
-		{
-			//Chop off unwanted strings
-			last = expr.c_str();
-			last.erase(0, lastnumber + 1);
-			//Determine value type of next. Store result.
-			ValueType curType = DetermineType(last);
-
-			//TODO: Determine variable types appropriately.
-			if( curType == T_INVALID )
-				curType = T_INT;
-
-			//Feed next to CompileArgs
-			CompileValue(last);
-
-			//Generate arithematic control bytes and feed to BVM.
-
-			char subByte;
-
-			//Eh, probably a better way of doing this.
-			if( lastType == T_INT && curType == T_INT )
-				subByte = 0; //Int + Int
-			else if( lastType == T_INT && curType == T_FLOAT )
-				subByte = 1; //Int + Float
-			else if( lastType == T_FLOAT && curType == T_INT)
-				subByte = 2; //Float + Int
-			else if( lastType == T_FLOAT && curType == T_FLOAT)
-				subByte = 3; //Float + Float
-
-			char mainByte;
-			//Used to distinguish who is the last output.
-			switch(ctrl)
-			{
-			case '+':
-			mainByte = 0x44;
-			break;
-			case '-':
-			mainByte = 0x45;
-			break;
-			case '*':
-			mainByte = 0x46;
-			break;
-			case '/':
-			mainByte = 0x47;
-			break;
-			}
-
-			bytes.push_back( mainByte );
-			bytes.push_back( subByte );
-
-			handledExpr = true;
-		}
-
-		//Greater than
-		token = SimpleTokenise( expr, L'>' );
-		if( expr.size( ) > 0 )
-		{
-			if( expr.front( ) == L'=' )
-			{
-				expr.erase( 0, 1 );
-
-				if( token.find( L"2C" ) != std::string::npos || token.find( L"2D" ) != std::string::npos )
-					CompileLine( token );
-				else
-					CompileArgs( token );
-
-				if( expr.find( L"2C" ) != std::string::npos || expr.find( L"2D" ) != std::string::npos )
-					CompileLine( expr );
-				else
-					CompileArgs( expr );
-
-				bytes.push_back( 0x24 );
-				bytes.push_back( 0x00 );
-				handledExpr = true;
-			}
-			else
-			{
-				if( token.find( L"2C" ) != std::string::npos || token.find( L"2D" ) != std::string::npos )
-					CompileLine( token );
-				else
-					CompileArgs( token );
-
-				if( expr.find( L"2C" ) != std::string::npos || expr.find( L"2D" ) != std::string::npos )
-					CompileLine( expr );
-				else
-					CompileArgs( expr );
-
-				bytes.push_back( 0x25 );
-				bytes.push_back( 0x00 );
-				handledExpr = true;
-			}
-		}
-
-		expr = argsStrn.c_str( );
-		//Less than
-		token = SimpleTokenise( expr, L'<' );
-		if( expr.size( ) > 0 )
-		{
-			if( expr.front( ) == L'=' )
-			{
-				expr.erase( 0, 1 );
-
-				if( token.find( L"2C" ) != std::string::npos || token.find( L"2D" ) != std::string::npos )
-					CompileLine( token );
-				else
-					CompileArgs( token );
-
-				if( expr.find( L"2C" ) != std::string::npos || expr.find( L"2D" ) != std::string::npos )
-					CompileLine( expr );
-				else
-					CompileArgs( expr );
-
-				bytes.push_back( 0x21 );
-				bytes.push_back( 0x00 );
-				handledExpr = true;
-			}
-			else
-			{
-				if( token.find( L"2C" ) != std::string::npos || token.find( L"2D" ) != std::string::npos )
-					CompileLine( token );
-				else
-					CompileArgs( token );
-
-				if( expr.find( L"2C" ) != std::string::npos || expr.find( L"2D" ) != std::string::npos )
-					CompileLine( expr );
-				else
-					CompileArgs( expr );
+	static const wchar_t *ops[4] = { L"+", L"-", L"*", L"/" };
+	for( int i = 0; i < 4; ++i )
+	{
+		if( op == ops[i] )
+			return i;
+	}
+	return -1;
+}
 
-				bytes.push_back( 0x20 );
-				bytes.push_back( 0x00 );
-				handledExpr = true;
-			}
-		}
+//Type a value is added as. Variables aren't typed yet, so only float literals are floats.
+static ValueType MissionExprType( const MissionExprNode& expr )
+{
+	if( expr.kind == ME_VALUE || expr.kind == ME_NAME )
+		return DetermineType( expr.text ) == T_FLOAT ? T_FLOAT : T_INT;
 
-		expr = argsStrn.c_str( );
-		//Equal to:
-		token = SimpleTokenise( expr, L'=' );
-		if( expr.size( ) > 0 )
-		{
-			if( expr.front( ) == L'=' )
-			{
-				expr.erase( 0, 1 );
+	if( expr.kind == ME_BINARY && MissionArithmeticOp( expr.text ) >= 0 )
+	{
+		if( MissionExprType( expr.children[0] ) == T_FLOAT || MissionExprType( expr.children[1] ) == T_FLOAT )
+			return T_FLOAT;
+	}
+	else if( expr.kind == ME_UNARY && expr.text == L"-" )
+		return MissionExprType( expr.children[0] );
 
-				if( token.find( L"2C" ) != std::string::npos || token.find( L"2D" ) != std::string::npos )
-					CompileLine( token );
-				else
-					CompileArgs( token );
+	return T_INT;
+}
 
-				if( expr.find( L"2C" ) != std::string::npos || expr.find( L"2D" ) != std::string::npos )
-					CompileLine( expr );
-				else
-					CompileArgs( expr );
+static const struct
+{
+	const wchar_t *op;
+	char opcode;
+} s_missionCompareOps[] =
+{
+	{ L"<", 0x20 },
+	{ L"<=", 0x21 },
+	{ L"==", 0x22 },
+	{ L"!=", 0x23 },
+	{ L">=", 0x24 },
+	{ L">", 0x25 },
+};
 
-				bytes.push_back( 0x22 );
-				bytes.push_back( 0x00 );
-				handledExpr = true;
-			}
-		}
+//Operands are pushed first, then the operator works on the top of the stack
+void MissionFunction::CompileExpression( const MissionExprNode& expr, bool inArithmetic )
+{
+	if( expr.kind == ME_UNARY )
+	{
+		CompileExpression( expr.children[0] );
 
-		expr = argsStrn.c_str( );
-		//Not
-		token = SimpleTokenise( expr, L'!' );
-		if( expr.size( ) > 0 )
+		if( expr.text == L"!" )
 		{
-			if( token.find( L"2C" ) != std::string::npos || token.find( L"2D" ) != std::string::npos )
-				CompileLine( token );
-			else
-				CompileArgs( token );
-
-			if( expr.front( ) == L'=' ) // Not equal to:
-			{
-				expr.erase( 0, 1 );
-
-				if( expr.find( L"2C" ) != std::string::npos || expr.find( L"2D" ) != std::string::npos )
-					CompileLine( expr );
-				else
-					CompileArgs( expr );
-
-				bytes.push_back( 0x23 );
-				bytes.push_back( 0x00 );
-				handledExpr = true;
-			}
-			else //Raw Not:
-			{
-				handledExpr = true;
-				bytes.push_back( 0x11 );
-			}
+			//0x11 is a bitwise not, a logical not compares with 0
+			bytes.push_back( 0x15 );
+			bytes.push_back( 0x22 );
+			bytes.push_back( 0x00 );
 		}
-
-		expr = argsStrn.c_str( );
-		//And
-		token = SimpleTokenise( expr, L'&' );
-		if( expr.size( ) > 0 )
+		else
 		{
-			if( token.find( L"2C" ) != std::string::npos || token.find( L"2D" ) != std::string::npos )
-				CompileLine( token );
-			else
-				CompileArgs( token );
-
-			if( expr.back( ) == L'&' ) //Logical and
-			{
-				expr.erase( 0, 1 );
-
-				if( expr.find( L"2C" ) != std::string::npos || expr.find( L"2D" ) != std::string::npos )
-					CompileLine( expr );
-				else
-					CompileArgs( expr );
-
-				bytes.push_back( 0x0E );
-				handledExpr = true;
-			}
-			else //Raw And:
-			{
-				handledExpr = true;
-				bytes.push_back( 0x0E );
-			}
+			//Negate, the extra param is 0 for int and 1 for float
+			bytes.push_back( 0x49 );
+			bytes.push_back( MissionExprType( expr.children[0] ) == T_FLOAT ? 1 : 0 );
 		}
-
-		expr = argsStrn.c_str();
+		return;
 	}
 
-	//OLD CODE: DISABLED.
-#if 0
-	//+
-	//++, search for ++thing or thing++
-	if( ( expr[0] == L'+' && expr[1] == L'+' ) || expr[expr.size( )] == L'+' && expr[expr.size( ) - 1] == L'+' )
+	if( expr.kind == ME_BINARY )
 	{
+		int arithmetic = MissionArithmeticOp( expr.text );
+		CompileExpression( expr.children[0], arithmetic >= 0 );
+		CompileExpression( expr.children[1], arithmetic >= 0 );
 
-
-		//0x0A
-	}
-	else
-	{
-		expr = argsStrn.c_str( );
-		token = SimpleTokenise( expr, L'+' );
-		if( expr.size( ) > 0 )
+		if( arithmetic >= 0 )
 		{
-			if( IsValidInt( token ) && IsValidInt( expr ) )
-			{
-				CompileArgs( ToString( stoi( token ) + stoi( expr ) ) );
-			}
-			else
-			{
-				bool handledVar;
-				//Then check if its a global var
-				for( int i = 0; i < myScript->GetNumVars( ); i++ )
-				{
-					if( myScript->GetVarName( i ) == token )
-					{
-						//bytes.push_back( 0x55 );
-						//bytes.push_back( i );
-						bytes.push_back( 0x54 );
-						bytes.push_back( i );
+			// 0x4 (0x44): BVM add, extra param determines type ( 0 = int + int, 1 = int + float, 2 = float + int, 3 = float + float )
+			// 0x5 (0x45): BVM sub, 0x6 (0x46): BVM mul, 0x7 (0x47): BVM div, same extra param
+			char subByte = 0;
+			if( MissionExprType( expr.children[0] ) == T_FLOAT )
+				subByte += 2;
+			if( MissionExprType( expr.children[1] ) == T_FLOAT )
+				subByte += 1;
 
-						handledVar = true;
-					}
-				}
-
-				if( handledVar )
-				{
-					bytes.push_back( 0x55 );
-					bytes.push_back( stoi( expr ) );
-					bytes.push_back( 0x4 );
-					bytes.push_back( 0x0 );
-				}
-			}
+			//The operation that finishes a sum uses the 0x4x form
+			bytes.push_back( ( inArithmetic ? 0x04 : 0x44 ) + arithmetic );
+			bytes.push_back( subByte );
 		}
-	}
-
-	//-
-	//--, search for ++thing or thing++
-	if( ( expr[0] == L'-' && expr[1] == L'-' ) || expr[expr.size( )] == L'-' && expr[expr.size( ) - 1] == L'-' )
-	{
-
-
-		//0x0A
-	}
-	else
-	{
-		expr = argsStrn.c_str( );
-		token = SimpleTokenise( expr, L'-' );
-		if( expr.size( ) > 0 )
+		else if( expr.text == L"&&" || expr.text == L"&" )
+			bytes.push_back( 0x0E );
+		else if( expr.text == L"||" || expr.text == L"|" )
+			bytes.push_back( 0x0F );
+		else
 		{
-			if( IsValidInt( token ) && IsValidInt( expr ) )
+			for( size_t i = 0; i < sizeof( s_missionCompareOps ) / sizeof( s_missionCompareOps[0] ); ++i )
 			{
-				CompileArgs( ToString( stoi( token ) + stoi( expr ) ) );
-			}
-			else
-			{
-				bool handledVar;
-				//Then check if its a global var
-				for( int i = 0; i < myScript->GetNumVars( ); i++ )
+				if( expr.text == s_missionCompareOps[i].op )
 				{
-					if( myScript->GetVarName( i ) == token )
-					{
-						//bytes.push_back( 0x55 );
-						//bytes.push_back( i );
-						bytes.push_back( 0x54 );
-						bytes.push_back( i );
-
-						handledVar = true;
-					}
-				}
-
-				if( handledVar )
-				{
-					bytes.push_back( 0x55 );
-					bytes.push_back( stoi( expr ) );
-					bytes.push_back( 0x5 );
-					bytes.push_back( 0x0 );
+					bytes.push_back( s_missionCompareOps[i].opcode );
+					bytes.push_back( 0x00 );
 				}
 			}
 		}
+		return;
 	}
-#endif
 
-	if( !handledExpr )
+	//Values and variables are pushed
+	if( expr.kind != ME_CALL )
 	{
-		if( argsStrn.size( ) > 0 )
+		bool handledVar = DetermineType( expr.text ) != T_INVALID || myScript->FindVar( expr.text );
+		for( size_t i = 0; !handledVar && i < m_vecLocalVars.size( ); i++ )
 		{
-			ValueType type = DetermineType( argsStrn );
-			if( type != T_INVALID )
-			{
-				CompileValue( argsStrn );
-			}
-			else
-			{
-				//Check local and global variables for a match:
-
-				bool handledVar = false;
-				for( int i = 0; i < m_vecLocalVars.size( ); i++ )
-				{
-					if( argsStrn == m_vecLocalVars[i] )
-					{
-						handledVar = true;
-					}
-				}
+			if( expr.text == m_vecLocalVars[i] )
+				handledVar = true;
+		}
 
-				//Then check if its a global var
-				for( int i = 0; i < myScript->GetNumVars( ); i++ )
-				{
-					if( myScript->GetVarName( i ) == argsStrn )
-					{
-						handledVar = true;
-					}
-				}
+		if( handledVar )
+		{
+			CompileValue( expr.text );
+			return;
+		}
 
-				if( handledVar )
-				{
-					CompileValue( argsStrn );
-				}
-				else
-				{
-					CompileLine(argsStrn);
-				}
-			}
+		if( myScript->CountFunctions( expr.text ) == 0 )
+		{
+			compileLog += L"Unknown name on line " + ToString( expr.line ) + L", column " + ToString( expr.column ) + L": " + expr.text + L"\n";
+			hasErrors = true;
 		}
 	}
+
+	//Calls compile like a line of their own
+	CompileStatement( MissionCallStatement( expr ) );
 }
 
-void MissionFunction::CompileArgs( std::wstring argsStrn )
+void MissionFunction::CompileArgs( const std::vector< MissionExprNode >& args, size_t first )
 {
-	while( argsStrn.size( ) > 0 )
-	{
-		std::wstring arg;
-		arg = SimpleTokenise( argsStrn, L',' );
-
-		CompileExpression( arg );
-	}
+	for( size_t i = first; i < args.size( ); i++ )
+		CompileExpression( args[i] );
 }
 
 //Compiles a single value to its BVM equivalent
@@ -3069,17 +2310,15 @@ void MissionFunction::CompileValue( std::wstring argsStrn )
 	}
 
 	//Then check if its a global var
-	for( int i = 0; i < myScript->GetNumVars( ); i++ )
+	const std::vector< int > *globalVar = myScript->FindVar( argsStrn );
+	for( size_t i = 0; globalVar && i < globalVar->size( ); i++ )
 	{
-		if( myScript->GetVarName( i ) == argsStrn )
-		{
-			//bytes.push_back( 0x55 );
-			//bytes.push_back( i );
-			bytes.push_back( 0x54 );
-			bytes.push_back( i );
+		//bytes.push_back( 0x55 );
+		//bytes.push_back( i );
+		bytes.push_back( 0x54 );
+		bytes.push_back( ( *globalVar )[i] );
 
-			handledVar = true;
-		}
+		handledVar = true;
 	}
 
 	if( handledVar )
@@ -3094,45 +2333,34 @@ void MissionFunction::CompileValue( std::wstring argsStrn )
 		argsStrn.erase( argsStrn.begin( ) );
 
 		//Check string array:
-		bool found = false;
-		int ofs = 0;
-		for( int strID = 0; strID < myScript->m_vecMissionStrns.size( ); strID++ )
-		{
-			if( myScript->m_vecMissionStrns[strID] == argsStrn )
-			{
-				found = true;
-				break;
-			}
-			ofs += sizeof( wchar_t )*myScript->m_vecMissionStrns[strID].size( );
-			ofs += 2; //0 terminator size
-		}
-		if( !found )
-		{
-			myScript->m_vecMissionStrns.push_back( argsStrn );
-		}
+		int ofs = deferStrings ? -1 : myScript->FindMissionString( argsStrn );
+		stringRefs.push_back( argsStrn );
+		stringRefPos.push_back( bytes.size( ) );
 
 		//Run a few tests and optimise bytes.
-		if( ofs == 0 )
+		if( ofs < 0 )
+		{
+			//Not linked yet, Write fills in the offset
+			bytes.push_back( 0x9a );
+			bytes.push_back( 0x00 );
+			bytes.push_back( 0x00 );
+		}
+		else if( ofs == 0 )
 		{
 			bytes.push_back( 0x1a );
 		}
 		else
 		{
-			char *ofsBytes = IntToBytes( ofs );
-
-			if( ofsBytes[1] == 0x00 && ofsBytes[2] == 0x00 && ofsBytes[3] == 0x00 ) //Probably a better way of checking this lol
+			if( (uint32_t)ofs <= 0xFF )
 			{
 				bytes.push_back( 0x5a );
-				bytes.push_back( ofsBytes[0] );
+				bytes.push_back( (char)ofs );
 			}
 			else
 			{
 				bytes.push_back( 0x9a );
-				bytes.push_back( ofsBytes[0] );
-				bytes.push_back( ofsBytes[1] );
+				ByteWriterLE( bytes ).Put< int16_t >( (int16_t)ofs );
 			}
-
-			free( ofsBytes );
 		}
 	}
 	else if( argsStrn.back( ) == L'f' ) //Float
@@ -3152,11 +2380,8 @@ void MissionFunction::CompileValue( std::wstring argsStrn )
 		int num = stoi( argsStrn );
 		if( num > 127 || num < -127 )
 		{
-			char *ofsBytes = IntToBytes( num );
 			bytes.push_back( 0x95 );
-			bytes.push_back( ofsBytes[0] );
-			bytes.push_back( ofsBytes[1] );
-			free( ofsBytes );
+			ByteWriterLE( bytes ).Put< int16_t >( (int16_t)num );
 		}
 		else
 		{
@@ -3178,155 +2403,42 @@ void MissionFunction::CompileValue( std::wstring argsStrn )
 	}
 }
 
-//I dont like the name.
-std::wstring TokeniseStringIgnoreQuotes( std::wstring &input, std::wstring tokens )
-{
-	bool bIsInQuote = false;
-	wchar_t lastChar = 0;
-
-	//Iterate over every character in the string.
-	for( int pos = 0; pos < input.size( ); ++pos )
-	{
-		//Determine if this character is valid for splitting:
-		if( !bIsInQuote )
-		{
-			//Iterate through every token character
-			for( int i = 0; i < tokens.size(); ++i )
-			{
-				if( input[pos] == tokens[i] )
-				{
-					//Get left side:
-					std::wstring out = input.c_str( );
-					out.erase( pos, out.size( ) - pos );
-					input.erase( 0, pos + 1 );
-
-					//if( out.size() > 0 || input.size() == 0 )
-					return out;
-				}
-			}
-		}
-
-		if( input[pos] == L'\"' && lastChar != '\\' )
-		{
-			bIsInQuote = !bIsInQuote;
-		}
-
-		lastChar = input[pos];
-	}
-
-	std::wstring out = input.c_str( );
-	input.clear( );
-	return out;
-}
-
 void MissionFunction::Compile( )
 {
-	std::wstring source = sourceCode;
-
-	//Tokenise:
-	std::wstring token;
-	token = TokeniseStringIgnoreQuotes( source, L"\n" );
-
-	std::vector< std::wstring > lines;
-	//Collect all tokens
-	while( source.size() > 0 || token.size() > 0 )
-	{
-		if( token.size() > 0 )
-		lines.push_back( token );
+	MissionFnNode fn = ParseMissionFunction( sourceCode, sourceLine );
 
-		//FIXME: Problematic. Will probably need to create a custom tokenisation proccess here.
-		token = TokeniseStringIgnoreQuotes( source, L"\n;" );
-	}
-
-	//Failsafe of sorts, incase trash bytes somehow make it this far.
-	if( lines[0][0] == 0xfeff )
-	{
-		lines.erase( lines.begin() );
-	}
-
-	//Further split string:
-	wchar_t* token2;
-	std::wstring parser;
-	std::wstring lineZeroBackup = &lines[0][0];
-	token2 = wcstok( &lines[0][0], L"()," );
-
-	//Assume First string is function name for now.
-	//Scan string to split it into function name and type
-	//int fnRetType = 0; 0 = Void, only void for now
-	token2 = wcstok( token2, L" " );
-	parser = token2;
-
-	int fnRetType = 0;
-
-	//Check return types:
-	if (parser == L"void")
-		fnRetType = 0;
-
-	token2 = wcstok( NULL, L"(), " );
-
-	//We will allow a type assumption of void.
-	if( token2 == NULL )
-		fnName = parser;
-	else
-		fnName = token2;
+	fnName = fn.header.name;
 
 	//Verbose
-	std::wcout << L"Compiling function: " + fnName;
+	compileLog += L"Compiling function: " + fnName;
 
 	m_iNumLocalVars = 0;
 	m_iNumLocalVars2 = 0;
 
 	//Get fn args.
-	token2 = wcstok(&lineZeroBackup[0], L"(), ");
-	while (token2)
+	for( size_t i = 0; i < fn.header.params.size( ); i++ )
 	{
-		std::wstring argParser = token2;
-		if (argParser == L"int")
-		{
-			token2 = wcstok(NULL, L"(), ");
-			if (token2)
-			{
-				//Has int arguement
-				m_iNumLocalVars++;
-				m_iNumLocalVars2++;
-				m_vecLocalVars.push_back(token2);
-				fnArgBytes.push_back(0x01);
-			}
-		}
-		else if (argParser == L"float")
-		{
-			token2 = wcstok(NULL, L"(), ");
-			if (token2)
-			{
-				//Has float arguement
-				m_iNumLocalVars++;
-				m_iNumLocalVars2++;
-				m_vecLocalVars.push_back(token2);
-				fnArgBytes.push_back(0x02);
-			}
-		}
-		else if (argParser == L"string")
-		{
-			token2 = wcstok(NULL, L"(), ");
-			if (token2)
-			{
-				//Has string arguement (Todo, actualy parse this correctly?)
-				m_iNumLocalVars++;
-				m_iNumLocalVars2++;
-				m_vecLocalVars.push_back(token2);
-				fnArgBytes.push_back(0x03);
-			}
-		}
-		token2 = wcstok(NULL, L"(), ");
+		const MissionParam& param = fn.header.params[i];
+
+		m_iNumLocalVars++;
+		m_iNumLocalVars2++;
+		m_vecLocalVars.push_back( param.name );
+
+		if( param.type == L"int" )
+			fnArgBytes.push_back( 0x01 );
+		else if( param.type == L"float" )
+			fnArgBytes.push_back( 0x02 );
+		else //string (Todo, actualy parse this correctly?)
+			fnArgBytes.push_back( 0x03 );
 	}
 
 	if (fnArgBytes.size() != NULL)
 	{
-		std::wcout << " has ";
-		std::wcout << m_iNumLocalVars2;
-		std::wcout << " parameter(s)";
+		compileLog += L" has ";
+		compileLog += ToString(m_iNumLocalVars2);
+		compileLog += L" parameter(s)";
 	}
-	std::wcout << L"\n";
+	compileLog += L"\n";
 
 	//Prepare function return bytes
 	//Return function
@@ -3349,10 +2461,10 @@ void MissionFunction::Compile( )
 	}
 
 	//Parse every line
-	for (int i = 0; i < lines.size(); i++)
+	for (size_t i = 0; i < fn.statements.size(); i++)
 	{
-		//Attempt rewrite code
-		CompileLine(lines[i]);
+		m_iCurrentLine = fn.statements[i].line;
+		CompileStatement(fn.statements[i]);
 	}
 
 	//Conditional jump to return.
@@ -3366,12 +2478,7 @@ void MissionFunction::Compile( )
 	{
 		bytes.push_back(0xA8);
 
-		char* ofsBytes = IntToBytes((-bytes.size()) + 1);
-
-		bytes.push_back(ofsBytes[0]);
-		bytes.push_back(ofsBytes[1]);
-
-		free(ofsBytes);
+		ByteWriterLE(bytes).Put<int16_t>((int16_t)((-bytes.size()) + 1));
 	}
 
 	bytes[2] = m_iNumLocalVars + 1;
@@ -3380,124 +2487,40 @@ void MissionFunction::Compile( )
 
 void MissionFunction::CompileInit()
 {
-	std::wstring source = sourceCode;
+	MissionFnNode fn = ParseMissionFunction(sourceCode, sourceLine);
 
-	//Tokenise:
-	std::wstring token;
-	token = TokeniseStringIgnoreQuotes(source, L"\n");
-
-	std::vector< std::wstring > lines;
-	//Collect all tokens
-	while (source.size() > 0 || token.size() > 0)
-	{
-		if (token.size() > 0)
-			lines.push_back(token);
+	initName = fn.header.name;
 
-		token = TokeniseStringIgnoreQuotes(source, L"\n;");
-	}
-	//Failsafe of sorts, incase trash bytes somehow make it this far.
-	if (lines[0][0] == 0xfeff)
-	{
-		lines.erase(lines.begin());
-	}
-	//Further split string:
-	wchar_t* token2;
-	std::wstring parser;
-	std::wstring lineZeroBackup = &lines[0][0];
-	token2 = wcstok(&lines[0][0], L"(),");
-
-	//Assume First string is function name for now.
-	//Scan string to split it into function name and type
-	int fnRetType = 0; //0 = Void, only void for now
-	token2 = wcstok(token2, L" ");
-	parser = token2;
-
-	token2 = wcstok(NULL, L"(), ");
-
-	//We will allow a type assumption of void.
-	if (token2 == NULL)
-		initName = parser;
-	else
-		initName = token2;
-
-	std::wcout << L"Initialize Global Variables:\n=========>" + initName;
+	LogInfo( ) << L"Initialize Global Variables:\n=========>" + initName;
 
 	m_iNumGlobalVars = 0;
 
-	//Clear args.
-	token2 = wcstok(&lineZeroBackup[0], L"(), ");
-	while (token2)
-	{
-		std::wstring argParser = token2;
-		token2 = wcstok(NULL, L"(), ");
-	}
-
 	//Parse every line
-	for (int i = 0; i < lines.size(); i++)
+	for (size_t i = 0; i < fn.statements.size(); i++)
 	{
-		//Attempt rewrite code
-		CompileInitLine(lines[i]);
+		m_iCurrentLine = fn.statements[i].line;
+		CompileInitLine(fn.statements[i]);
 	}
 
-	std::wcout << " has ";
-	std::wcout << m_iNumGlobalVars;
-	std::wcout << " value";
-	std::wcout << L"\n";
+	LogInfo( ) << " has " << m_iNumGlobalVars << " value" << L"\n";
 
 	bytes.push_back(0x30);
 }
 
-void MissionFunction::CompileInitLine(std::wstring fnStrn)
+void MissionFunction::CompileInitLine(const MissionStatement& statement)
 {
-	std::wstring argsStrn;
-	bool parsingArgStrn = false;
-	int bracketDepth = 0;
-
-	std::wstring preBracketString;
-
-	//Kill whitespace in main string.
-	fnStrn = KillWhitespace(fnStrn);
-
-	//Begin parsing string.
-	for (int i = 0; i < fnStrn.size(); i++)
-	{
-		//Control chars
-		if (fnStrn[i] == L'(')
-		{
-			if (bracketDepth == 0)
-			{
-				preBracketString = fnStrn.c_str();
-				preBracketString.erase(i, preBracketString.size() - i);
-				i++;
-			}
-
-			parsingArgStrn = true;
-			bracketDepth++;
-		}
-		if (fnStrn[i] == L')')
-		{
-			bracketDepth--;
-			if (bracketDepth <= 0)
-			{
-				parsingArgStrn = false;
-				i++;
-			}
-		}
+	std::wstring argsStrn = statement.args;
 
-		if (parsingArgStrn)
-		{
-			argsStrn += fnStrn[i];
-		}
-	}
-
-	//No brackets?
-	if (preBracketString.size() == 0)
-		preBracketString = fnStrn;
+	//Initialisers don't assign, put the '=' back
+	std::wstring preBracketString = statement.callee;
+	if (statement.assigns)
+		preBracketString = statement.target + L"=" + statement.callee;
 
 	//Get function name:
-	for (int i = 0; i < myScript->GetNumVars(); i++)
+	const std::vector< int > *globalVar = myScript->FindVar(preBracketString);
+	for (size_t var = 0; globalVar && var < globalVar->size(); var++)
 	{
-		if (preBracketString == myScript->GetVarName(i))
+		int i = (*globalVar)[var];
 		{
 			while (argsStrn.size() > 0)
 			{
@@ -3553,11 +2576,8 @@ void MissionFunction::CompileInitValue(std::wstring argsStrn)
 		int num = stoi(argsStrn);
 		if (num > 127 || num < -127)
 		{
-			char* ofsBytes = IntToBytes(num);
 			bytes.push_back(0x95);
-			bytes.push_back(ofsBytes[0]);
-			bytes.push_back(ofsBytes[1]);
-			free(ofsBytes);
+			ByteWriterLE(bytes).Put<int16_t>((int16_t)num);
 		}
 		else
 		{
@@ -3585,42 +2605,73 @@ void MissionFunction::Decompile( )
 //Todo: Clean this up a bit
 void MissionFunction::GetName( )
 {
-	std::wstring source = sourceCode.c_str( );
-
-	//Tokenise:
-	wchar_t* token;
-	token = wcstok( &source[0], L"\n" );
-
-	std::vector< std::wstring > lines;
-	//Collect all tokens
-	while( token )
+	//Same line and failsafe as Compile, other functions link against this before it is compiled
+	CMissionLexer lexer( sourceCode, sourceLine );
+	std::wstring text;
+	int line;
+	bool isFirst = true;
+	while( lexer.Next( text, line ) )
 	{
-		lines.push_back( token );
-		token = wcstok( NULL, L"\n;" );
-	}
-
-	//Further split string:
-	wchar_t* token2;
-	std::wstring parser;
-	token2 = wcstok( &lines[0][0], L"()," );
+		if( isFirst )
+		{
+			isFirst = false;
+			if( text[0] == 0xfeff )
+				continue;
+		}
 
-	//Assume First string is function name for now.
-	//Scan string to split it into function name and type
-	token2 = wcstok( token2, L" " );
-	parser = token2;
+		fnName = ParseMissionFnHeader( text ).name;
+		return;
+	}
+}
 
-	int fnRetType = 0;
-	//Check return types:
-	if( parser == L"void" )
-		fnRetType = 0;
+void MissionFunction::ApplyCacheEntry( const MissionFnCacheEntry& entry )
+{
+	fnName = entry.fnName;
+	m_iNumLocalVars2 = entry.numParams;
+	bytes = entry.bytes;
+	fnArgBytes = entry.fnArgBytes;
+	patchBytePos = entry.patchBytePos;
+	patchFuncName = entry.patchFuncName;
+	fnNameDebug = entry.fnNameDebug;
+	stringRefs = entry.strings;
+	stringRefPos = entry.stringPos;
+}
 
-	token2 = wcstok( NULL, L" " );
+void MissionFunction::FillCacheEntry( MissionFnCacheEntry& entry ) const
+{
+	entry.fnName = fnName;
+	entry.numParams = m_iNumLocalVars2;
+	entry.bytes = bytes;
+	entry.fnArgBytes = fnArgBytes;
+	entry.patchBytePos = patchBytePos;
+	entry.patchFuncName = patchFuncName;
+	entry.fnNameDebug = fnNameDebug;
+	entry.strings = stringRefs;
+	entry.stringPos = stringRefPos;
+}
 
-	//We will allow a type assumption of void.
-	if( token2 == NULL )
-		fnName = parser;
-	else
-		fnName = token2;
+bool MissionFunction::PatchString( int pos, int ofs )
+{
+	//Same size rules as CompileValue. Positions from a damaged cache fail here and get recompiled.
+	if( pos < 0 || pos >= (int)bytes.size( ) )
+		return false;
+	unsigned char opcode = bytes[pos];
+	if( ofs == 0 )
+		return opcode == 0x1a;
+
+	if( ofs < 0x100 )
+	{
+		if( opcode != 0x5a || pos + 1 >= (int)bytes.size( ) )
+			return false;
+		bytes[pos + 1] = ofs;
+		return true;
+	}
+
+	if( opcode != 0x9a || pos + 2 >= (int)bytes.size( ) )
+		return false;
+	bytes[pos + 1] = ofs & 0xFF;
+	bytes[pos + 2] = ( ofs >> 8 ) & 0xFF;
+	return true;
 }
 
 std::vector< char > MissionFunction::GenerateFnDataBytes( int ofsToName, int fnPointerSize, int fnNum, int offset )
@@ -3631,23 +2682,13 @@ std::vector< char > MissionFunction::GenerateFnDataBytes( int ofsToName, int fnP
 	//Todo: Calculate this correctly
 	pos -= myScript->GetFnDataOfs();
 
-	char *ofsBytes = IntToBytes( pos );
+	ByteWriterLE writer( bytes );
 
 	//Offset 1
-	bytes.push_back( ofsBytes[0] );
-	bytes.push_back( ofsBytes[1] );
-	bytes.push_back( ofsBytes[2] );
-	bytes.push_back( ofsBytes[3] );
-
-	free( ofsBytes );
+	writer.Put< int32_t >( pos );
 
 	//Offset to function name string
-	char *seg = IntToBytes( ofsToName );
-	for( int i = 0; i < 4; i++ )
-	{
-		bytes.push_back( seg[i] );
-	}
-	free( seg );
+	writer.Put< int32_t >( ofsToName );
 
 	//Offset 3
 	bytes.push_back( 0x00 );
@@ -3658,12 +2699,7 @@ std::vector< char > MissionFunction::GenerateFnDataBytes( int ofsToName, int fnP
 	//Data, count Args
 	if (m_iNumLocalVars2)
 	{
-		char* segFn = IntToBytes(m_iNumLocalVars2);
-		bytes.push_back(segFn[0]);
-		bytes.push_back(segFn[1]);
-		bytes.push_back(segFn[2]);
-		bytes.push_back(segFn[3]);
-		free(segFn);
+		writer.Put<int32_t>(m_iNumLocalVars2);
 	}
 	else
 	{
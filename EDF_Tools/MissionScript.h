@@ -1,7 +1,13 @@
 #pragma once
 
+#include <unordered_map>
+#include "ByteStream.h"
+
 //Forward declare this
 class CMissionScript;
+struct MissionStatement;
+struct MissionExprNode;
+struct MissionFnCacheEntry;
 
 //Function data map.
 struct CMissionFnData
@@ -12,8 +18,8 @@ struct CMissionFnData
 //Structure for a single mission function
 struct MissionFunction
 {
-	MissionFunction::MissionFunction(){	};
-	MissionFunction::MissionFunction( std::wstring srcCode, CMissionScript *script );
+	MissionFunction(){	};
+	MissionFunction( std::wstring srcCode, CMissionScript *script, int line = 1 );
 
 	std::wstring fnName;
 	std::wstring initName;
@@ -22,23 +28,33 @@ struct MissionFunction
 
 	//Compiler fns
 	void Compile();
-	void CompileLine( std::wstring fnStrn );
-	void CompileArgs( std::wstring argsStrn );
+	void CompileStatement( const MissionStatement& statement );
+	//Compiles the arguments from first on, each pushes one value
+	void CompileArgs( const std::vector< MissionExprNode >& args, size_t first = 0 );
 	void CompileValue( std::wstring argsStrn );
-	void CompileExpression( std::wstring argsStrn );
+	//inArithmetic is set for the operands of add, sub, mul and div
+	void CompileExpression( const MissionExprNode& expr, bool inArithmetic = false );
 
 	void CompileInit();
-	void CompileInitLine(std::wstring argsStrn);
+	void CompileInitLine(const MissionStatement& statement);
 	void CompileInitValue(std::wstring argsStrn);
 
 	//Decompiler fns
 	void Decompile( );
 
 	void GetName( );
+	//Takes the compile results from the cache, strings are linked afterwards like a fresh compile
+	void ApplyCacheEntry( const MissionFnCacheEntry& entry );
+	void FillCacheEntry( MissionFnCacheEntry& entry ) const;
+	//Writes the final offset into the string literal at pos, false if it needs a different sized opcode
+	bool PatchString( int pos, int ofs );
 	std::vector< char > GenerateFnDataBytes( int ofsToNameint, int fnPointerSize, int fnNum, int offset );
 
 	//Used for compiler
 	std::wstring sourceCode;
+	//Line of the source in the preprocessed file, and of the statement being compiled
+	int sourceLine = 1;
+	int m_iCurrentLine = 0;
 	std::vector< char > bytes;
 	std::vector< char > bytes2;
 
@@ -62,6 +78,17 @@ struct MissionFunction
 	//Function name debug.
 	std::vector<std::wstring> fnNameDebug;
 
+	//String literals in compile order and the position of their opcode in bytes
+	std::vector< std::wstring > stringRefs;
+	std::vector< int > stringRefPos;
+	//Leave string offsets to the linker, functions are compiled before the string table exists
+	bool deferStrings = false;
+
+	//Console output of Compile, printed in function order once every function is done
+	std::wstring compileLog;
+	//Set when compileLog holds an error, the bytes can't be written
+	bool hasErrors = false;
+
 	//jump function
 	//request
 	std::vector< std::wstring > str_RjumpPos;
@@ -77,8 +104,8 @@ struct MissionFunction
 //Structure for the BVM header
 struct BVMHeader
 {
-	BVMHeader::BVMHeader();
-	BVMHeader::~BVMHeader();
+	BVMHeader();
+	~BVMHeader();
 
 	std::vector< char > GenerateBytes();
 
@@ -103,8 +130,15 @@ class CMissionScript
 public:
 	//Decompiler
 	void LoadLanguage( std::wstring path, int id );
-	int Read( const std::wstring& path );
-	void ReadFn( int position, const std::vector<char>& buffer, int numArgs, int nextFunctionStart );
+	int Read( const std::wstring& path, const std::wstring& outPath = L"MISSION_Data.txt" );
+	void ReadFn( int position, const ByteSpan& buffer, int numArgs, int nextFunctionStart );
+	//2C / 2D command lookup, prefix is printed for unknown commands
+	void ReadCommand( int language, const std::wstring& prefix, int opcode, std::vector< std::wstring >& stack );
+	//Appends decompiled text to the output, and the console when echoing
+	void Emit( const std::wstring& text );
+
+	//Print the decompiled script to the console as well, off for batch runs
+	bool bEchoOutput = true;
 
 	std::vector< int > m_vecFuncOffsets;
 	std::vector< std::wstring > m_vecMissionStrns;
@@ -112,7 +146,7 @@ public:
 	void Preproccesser( std::wstring missionSourceRaw, std::wstring & missionSourceProccessed );
 
 	//Compiler
-	void Write( const std::wstring& path, int flags );
+	bool Write( const std::wstring& path, int flags );
 
 	int GetNumFunctions( ) { return m_vecFunctions.size( ); }
 	int GetFnDataOfs( ) { return m_iFunctionDataOfs;  }
@@ -121,20 +155,53 @@ public:
 	int GetNumVars( ) { return m_vecVarNames.size( ); }
 	std::wstring GetVarName( int index )	{ return m_vecVarNames[index]; }
 
+	//Global variable indices for a name, every one of them if it is declared twice. Null if unknown.
+	const std::vector< int > *FindVar( const std::wstring& name ) const;
+	//Number of functions with this name, a local call is emitted once for each
+	int CountFunctions( const std::wstring& name ) const;
+
+	//Adds a string literal if it is new, returns its byte offset in the string table
+	int AddMissionString( const std::wstring& strn );
+	//Byte offset of a string literal, -1 if it was never added
+	int FindMissionString( const std::wstring& strn ) const;
+
+	//Functions the last Write took from the compile cache
+	int GetNumCachedFunctions( ) { return m_iNumCachedFunctions; }
+
+	//Keep compiled functions in <source>.txt.cache and reuse them when nothing they depend on changed
+	static bool bUseCompileCache;
+	//Threads used to compile functions, 0 for one per core
+	static int iCompileThreads;
+
 private:
 	int m_iStringBufferOfs;
 	int m_iFunctionDataOfs;
-	std::wofstream output;
+	//Decompiled text, written out in one go at the end of Read
+	std::wstring m_output;
 
 	std::vector< std::wstring > m_vecVarNames;
 
 	std::vector< std::wstring > m_vecReplaceStrings;
 
+	//Hash of everything a function's bytes depend on besides its own text
+	uint64_t HashSymbols( );
+	int m_iNumCachedFunctions = 0;
+
+	//Name lookups for the compiler, built once the function names are known
+	void BuildSymbolTables( );
+	std::unordered_map< std::wstring, std::vector< int > > m_varIndex;
+	std::unordered_map< std::wstring, int > m_fnNameCount;
+	std::unordered_map< std::wstring, int > m_fnIndex;
+
+	//String literal offsets, and the size of m_vecMissionStrns in bytes
+	std::unordered_map< std::wstring, int > m_missionStrnOfs;
+	int m_iMissionStrnSize = 0;
+
 	//Compilation stuff
 	BVMHeader *header;
 	std::vector< MissionFunction* > m_Initialisers;
 	std::vector< MissionFunction * > m_vecFunctions;
 
 	//Decompilation stuff:
-	std::unique_ptr<CJSONAMLParser> languageFile[2];
-};
\ No newline at end of file
+	std::shared_ptr<const CMissionCommandTable> languageFile[2];
+};
@@ -2,15 +2,131 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <ctime>
+#endif
 #include <string>
 #include <vector>
+#include <map>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "RAB.h"
 
 //#define RABREADER_DEBUG
 
-void RAB::Read( const std::wstring& path, bool isMRAB )
+//FILETIME ticks between 1601 and the Unix epoch
+#define RAB_FILETIME_UNIX_EPOCH 116444736000000000ULL
+
+//Last write time of a file as a FILETIME, 0 if it can't be read
+static uint64_t GetRABFileTime( const std::wstring& path )
+{
+#if defined( _WIN32 )
+	FILETIME ft = { 0, 0 };
+
+	//A tad hacky.
+	HANDLE fHandle = CreateFileW( (LPCWSTR)path.c_str( ),
+		FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL );
+	if( fHandle == INVALID_HANDLE_VALUE )
+		return 0;
+
+	GetFileTime( fHandle, (LPFILETIME)NULL, (LPFILETIME)NULL, &ft );
+	CloseHandle( fHandle );
+
+	return ( (uint64_t)ft.dwHighDateTime << 32 ) | ft.dwLowDateTime;
+#else
+	struct stat info;
+	if( stat( ToFilePath( path ).c_str( ), &info ) != 0 )
+		return 0;
+
+	return (uint64_t)( (int64_t)info.st_mtim.tv_sec * 10000000 + info.st_mtim.tv_nsec / 100 ) + RAB_FILETIME_UNIX_EPOCH;
+#endif
+}
+
+//Gives an extracted file the time stored in the archive
+static void SetRABFileTime( const std::wstring& path, uint64_t fileTime )
+{
+#if defined( _WIN32 )
+	FILETIME ft;
+	ft.dwLowDateTime = (DWORD)fileTime;
+	ft.dwHighDateTime = (DWORD)( fileTime >> 32 );
+
+	HANDLE fHandle = CreateFileW( (LPCWSTR)path.c_str( ),
+		FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL );
+	if( fHandle == INVALID_HANDLE_VALUE )
+		return;
+
+	SetFileTime( fHandle, (LPFILETIME)NULL, (LPFILETIME)NULL, &ft );
+	CloseHandle( fHandle );
+#else
+	int64_t ticks = (int64_t)( fileTime - RAB_FILETIME_UNIX_EPOCH );
+	struct timespec times[2];
+	times[0].tv_sec = 0;
+	times[0].tv_nsec = UTIME_OMIT;
+	times[1].tv_sec = (time_t)( ticks / 10000000 );
+	times[1].tv_nsec = (long)( ticks % 10000000 ) * 100;
+	if( times[1].tv_nsec < 0 )
+	{
+		times[1].tv_sec--;
+		times[1].tv_nsec += 1000000000;
+	}
+	utimensat( AT_FDCWD, ToFilePath( path ).c_str( ), times, 0 );
+#endif
+}
+
+//Hour:minute day/month/year in UTC, for the debug listing
+static std::wstring RABFileTimeString( uint64_t fileTime )
+{
+	int hour, minute, day, month, year;
+#if defined( _WIN32 )
+	FILETIME ft;
+	ft.dwLowDateTime = (DWORD)fileTime;
+	ft.dwHighDateTime = (DWORD)( fileTime >> 32 );
+
+	SYSTEMTIME st;
+	FileTimeToSystemTime( &ft, &st );
+	hour = st.wHour;
+	minute = st.wMinute;
+	day = st.wDay;
+	month = st.wMonth;
+	year = st.wYear;
+#else
+	time_t seconds = (time_t)( ( (int64_t)fileTime - (int64_t)RAB_FILETIME_UNIX_EPOCH ) / 10000000 );
+	struct tm st = { };
+	gmtime_r( &seconds, &st );
+	hour = st.tm_hour;
+	minute = st.tm_min;
+	day = st.tm_mday;
+	month = st.tm_mon + 1;
+	year = st.tm_year + 1900;
+#endif
+
+	std::wstring fileTimeString;
+
+	fileTimeString += ToString( hour ) + L":" + ToString( minute ) + L" ";
+	fileTimeString += ToString( day ) + L"/";
+	fileTimeString += ToString( month ) + L"/";
+	fileTimeString += ToString( year );
+
+	return fileTimeString;
+}
+
+bool RAB::Read( const std::wstring& path, bool isMRAB )
 {
 	std::wstring ext;
 	if( isMRAB )
@@ -18,17 +134,15 @@ void RAB::Read( const std::wstring& path, bool isMRAB )
 	else
 		ext = L".rab";
 
-	std::ifstream file( path + ext, std::ios::binary | std::ios::ate );
-
-	std::streamsize size = file.tellg( );
-	file.seekg( 0, std::ios::beg );
-
-	if( size == -1 )
-		return;
-
-	std::vector<char> buffer( size );
-	if( file.read( buffer.data( ), size ) )
+	StageTimer timer( "RAB>FILES", StatStage::Read );
+	MappedFile file;
+	//False once any file fails to extract, the rest are still tried
+	bool extracted = true;
+	if( file.Open( path + ext ) )
 	{
+		ByteSpan buffer = file.Span( );
+		timer.AddBytes( buffer.size( ) );
+		timer.Next( StatStage::Parse );
 #ifndef RABREADER_DEBUG
 		//Create folder
 
@@ -43,62 +157,46 @@ void RAB::Read( const std::wstring& path, bool isMRAB )
 
 		if( directory.size( ) == 0 )
 		{
-			wchar_t CurDirectory[512];
-			GetCurrentDirectoryW( 512, CurDirectory );
-
-			directory = CurDirectory;
-		}
-
-		std::wstring myFolderName;
-		std::wstring oldFolder;
-		last_slash_idx = directory.rfind( L'\\' );
-		if( std::string::npos != last_slash_idx )
-		{
-			myFolderName = directory.substr( last_slash_idx + 1, directory.size( ) - last_slash_idx );
-			oldFolder = directory.substr( 0, last_slash_idx );
+			directory = GetWorkingDirectory( );
 		}
 
-		CreateDirectoryExW( (oldFolder).c_str( ), path.c_str( ), NULL );
+		//Already there is fine, files that can't be written are reported as they're extracted
+		std::error_code error;
+		std::filesystem::create_directory( ToFilePath( path ), error );
 #endif
 
 		//Begin read
 		unsigned char seg[4];
 		int position;
 
-		Read4Bytes( seg, buffer, 0x8 );
 
-		dataStartOfs = GetIntFromChunk( seg );
-		std::wcout << L"Data starting at " + ToString( dataStartOfs ) + L"\n";
+		dataStartOfs = ReadLE< int32_t >( buffer, 0x8 );
+		LogDebug( ) << L"Data starting at " + ToString( dataStartOfs ) + L"\n";
 
-		Read4Bytes( seg, buffer, 0x14 );
-		numFiles = GetIntFromChunk( seg );
-		std::wcout << L"Number of archived files: " + ToString( numFiles ) + L"\n";
+		numFiles = ReadLE< int32_t >( buffer, 0x14 );
+		LogDebug( ) << L"Number of archived files: " + ToString( numFiles ) + L"\n";
 
-		Read4Bytes( seg, buffer, 0x1c );
-		fileTreeStructPos = GetIntFromChunk( seg );
-		std::wcout << L"File Tree Struct position: " + ToString( fileTreeStructPos ) + L"\n";
+		fileTreeStructPos = ReadLE< int32_t >( buffer, 0x1c );
+		LogDebug( ) << L"File Tree Struct position: " + ToString( fileTreeStructPos ) + L"\n";
 
-		Read4Bytes( seg, buffer, 0x20 );
-		numFolders = GetIntFromChunk( seg );
-		std::wcout << L"Number of archived Folders: " + ToString( numFolders ) + L"\n";
+		numFolders = ReadLE< int32_t >( buffer, 0x20 );
+		LogDebug( ) << L"Number of archived Folders: " + ToString( numFolders ) + L"\n";
 
-		Read4Bytes( seg, buffer, 0x24 );
-		nameTablePos = GetIntFromChunk( seg );
-		std::wcout << L"Name Table position: " + ToString( nameTablePos ) + L"\n";
+		nameTablePos = ReadLE< int32_t >( buffer, 0x24 );
+		LogDebug( ) << L"Name Table position: " + ToString( nameTablePos ) + L"\n";
 
 		//Read folders:
 		position = nameTablePos;
 
 		for( int i = 0; i < numFolders; ++i )
 		{
-			Read4Bytes( seg, buffer, position );
-			folders.push_back( ReadUnicode( buffer, position + GetIntFromChunk( seg ) ) );
-			std::wcout << L"FOLDER " + ToString( i ) + L":" + folders.back() + L"\n";
+			folders.push_back( ReadUnicode( buffer, position + ReadLE< int32_t >( buffer, position ) ) );
+			LogDebug( ) << L"FOLDER " + ToString( i ) + L":" + folders.back() + L"\n";
 
 #ifndef RABREADER_DEBUG
 			//Create folder:
 			std::wstring newFolderPath = path + L"\\" + folders.back( ).c_str( );
-			CreateDirectoryExW( ( oldFolder ).c_str( ), newFolderPath.c_str(), NULL );
+			std::filesystem::create_directories( ToFilePath( newFolderPath ), error );
 #endif
 
 			position += 4;
@@ -108,79 +206,49 @@ void RAB::Read( const std::wstring& path, bool isMRAB )
 		position = 0x28;
 		for( int i = 0; i < numFiles; ++i )
 		{
-			std::wcout << L"\n";
-			std::wcout << L"FILE: ";
-			Read4Bytes( seg, buffer, position );
-			std::wstring fileName = ReadUnicode( buffer, position + GetIntFromChunk( seg ) );
-			std::wcout << fileName + L"\n";
+			std::wstring fileName = ReadUnicode( buffer, position + ReadLE< int32_t >( buffer, position ) );
+			LogInfo( ) << L"\nFILE: " << fileName << L"\n";
 
 			position += 0x4;
 
-			Read4Bytes( seg, buffer, position );
-			int fileSize = GetIntFromChunk( seg );
-			std::wcout << L"--FILE SIZE: " + ToString( fileSize ) + L"\n";
+			int fileSize = ReadLE< int32_t >( buffer, position );
+			LogDebug( ) << L"--FILE SIZE: " + ToString( fileSize ) + L"\n";
 
 			position += 0x4;
 
-			Read4Bytes( seg, buffer, position );
 
-			std::wstring folderName = folders.at( GetIntFromChunk( seg ) );
+			std::wstring folderName = folders.at( ReadLE< int32_t >( buffer, position ) );
 
-			std::wcout << L"--PARENT NAME: " + folderName + L"\n";
+			LogDebug( ) << L"--PARENT NAME: " + folderName + L"\n";
 
 			position += 0x4;
 
 			position += 0x4;
 
-			unsigned char data[8];
-
-			Read4BytesReversed( seg, buffer, position );
-			data[0] = seg[0];
-			data[1] = seg[1];
-			data[2] = seg[2];
-			data[3] = seg[3];
+			uint64_t fileTime = ReadLE< uint32_t >( buffer, position );
 
 			position += 0x4;
-			Read4BytesReversed( seg, buffer, position );
-
-			data[4] = seg[0];
-			data[5] = seg[1];
-			data[6] = seg[2];
-			data[7] = seg[3];
-
-			FILETIME ft;
-			memcpy( &ft, data, sizeof( FILETIME ) );
-
-			SYSTEMTIME st;
-
-			FileTimeToSystemTime( &ft, &st );
-
-			std::wstring fileTimeString;
-
-			fileTimeString += ToString( st.wHour ) + L":" + ToString( st.wMinute ) + L" ";
-			fileTimeString += ToString( st.wDay ) + L"/";
-			fileTimeString += ToString( st.wMonth ) + L"/";
-			fileTimeString += ToString( st.wYear );
+			fileTime |= (uint64_t)ReadLE< uint32_t >( buffer, position ) << 32;
 
-			std::wcout << L"--FILE TIME: " + fileTimeString + L"\n";
+			if( Log::Enabled( LogLevel::Debug ) )
+				LogDebug( ) << L"--FILE TIME: " + RABFileTimeString( fileTime ) + L"\n";
 			position += 0x4;
 
-			Read4Bytes( seg, buffer, position );
-			int fileStart = GetIntFromChunk( seg );
-			std::wcout << L"--CONTENT START POS: " + ToString( fileStart ) + L"\n";
+			int fileStart = ReadLE< int32_t >( buffer, position );
+			LogDebug( ) << L"--CONTENT START POS: " + ToString( fileStart ) + L"\n";
 
 			position += 0x4;
 
 			//Unknown block:
-			std::wcout << L"--UNKNOWN BLOCK: ";
-			Read4BytesReversed( seg, buffer, position );
-			for( int j = 0; j < 4; ++j )
+			ByteReaderLE( buffer ).Get( position, seg, 4 );
+			if( Log::Enabled( LogLevel::Debug ) )
 			{
-				std::wcout << L"0x";
-				std::wcout << std::hex << seg[j];
-				std::wcout << L" ";
+				LogLine line = LogDebug( );
+				line << L"--UNKNOWN BLOCK: ";
+				for( int j = 0; j < 4; ++j )
+					line << L"0x" << std::hex << seg[j] << std::dec << L" ";
+				line << L"\n";
 			}
-			std::wcout << L"\n";
 
 			position += 0x4;
 
@@ -191,6 +259,7 @@ void RAB::Read( const std::wstring& path, bool isMRAB )
 			std::vector< char > tempFile(buffer.begin() + fileStart, buffer.begin() + fileStart + fileSize);
 
 			bool shouldDecompress = true;
+			bool written;
 
 			if( shouldDecompress )
 			{
@@ -200,34 +269,41 @@ void RAB::Read( const std::wstring& path, bool isMRAB )
 				tempFile.clear( );
 
 				//Output
-				std::ofstream file = std::ofstream( correctedPath, std::ios::binary | std::ios::out | std::ios::ate );
+				std::ofstream file = std::ofstream( ToFilePath( correctedPath ), std::ios::binary | std::ios::out | std::ios::ate );
 				file.write(decompressedFile.data(), decompressedFile.size());
 				file.close( );
+				written = !file.fail( );
 
 				decompressedFile.clear( );
 			}
 			else
 			{
 				//Output
-				std::ofstream file = std::ofstream( correctedPath, std::ios::binary | std::ios::out | std::ios::ate );
+				std::ofstream file = std::ofstream( ToFilePath( correctedPath ), std::ios::binary | std::ios::out | std::ios::ate );
 				file.write(tempFile.data(), tempFile.size());
 				file.close( );
+				written = !file.fail( );
 			}
 
-			//A tad hacky.
-			HANDLE fHandle = CreateFileW( (LPCWSTR)correctedPath.c_str( ),
-				FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
-				NULL, OPEN_EXISTING,
-				FILE_ATTRIBUTE_NORMAL, NULL );
+			if( !written )
+			{
+				LogError( ) << L"Can't write " << correctedPath << L"\n";
+				extracted = false;
+				continue;
+			}
 
 			//Set the filetime on the file
-			SetFileTime( fHandle, (LPFILETIME)NULL, (LPFILETIME)NULL, &ft );
-
-			//Close our handle.
-			CloseHandle( fHandle );
+			SetRABFileTime( correctedPath, fileTime );
 #endif
 		}
 	}
+	else
+	{
+		LogError( ) << L"Can't read " << path << ext << L"\n";
+		return false;
+	}
+
+	return extracted;
 }
 
 void RAB::CreateFromDirectory( const std::wstring& path )
@@ -235,34 +311,24 @@ void RAB::CreateFromDirectory( const std::wstring& path )
 	largestFileSize = 0;
 
 	//Scan folders in directory:
-
-	WIN32_FIND_DATA fileData;
-	HANDLE hFind = FindFirstFile( (path + L"\\*" ).c_str( ), &fileData );
-	if( hFind == INVALID_HANDLE_VALUE )
+	if( !IsDirectory( path ) )
 	{
-		std::wcout << "BAD PATH IN RAB WRITE!\n";
+		LogError( ) << "BAD PATH IN RAB WRITE!\n";
 		return;
 	}
 
-	do
+	for( const std::wstring& folder : ListDirectories( path ) )
 	{
-		if( fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+		std::wstring folderName = GetFileName( folder );
+
+		//Todo: More methods of doing this.
+		//Exclude certain files.
+		if( wcscmp( folderName.c_str( ), L"Excluded" ) && wcscmp( folderName.c_str( ), L"Exclude" ) )
 		{
-			//Check if it is a control path:
-			if( std::wcscmp( fileData.cFileName, L"." ) && std::wcscmp( fileData.cFileName, L".." ) )
-			{
-				//Todo: More methods of doing this.
-				//Exclude certain files.
-				if( lstrcmpW( fileData.cFileName, L"Excluded" ) && lstrcmpW( fileData.cFileName, L"Exclude" ) )
-				{
-					folders.push_back(fileData.cFileName);
-					AddFilesInDirectory(path + L"\\" + fileData.cFileName);
-				}
-			}
+			folders.push_back( folderName );
+			AddFilesInDirectory( path + L"\\" + folderName );
 		}
-	} while( FindNextFile( hFind, &fileData ) != 0 );
-
-	FindClose( hFind );
+	}
 }
 
 #ifdef MULTITHREAD
@@ -273,7 +339,7 @@ void RAB::CreateFromDirectory( const std::wstring& path )
 
 void MultithreadCompressFile( RABFile *file )
 {
-	std::wcout << L"Compressing file: " + file->fileName + L"\n";
+	LogInfo( ) << L"Compressing file: " + file->fileName + L"\n";
 
 	CMPLHandler compresser = CMPLHandler( file->data );
 	compresser.bUseFakeCompression = false;
@@ -288,15 +354,12 @@ void MultithreadCompressFile( RABFile *file )
 
 void RAB::AddFilesInDirectory( const std::wstring& path )
 {
-	std::wcout << L"Writing path " + path + L"!\n";
+	LogInfo( ) << L"Writing path " + path + L"!\n";
 
 	//Scan files in directory:
-
-	WIN32_FIND_DATA fileData;
-	HANDLE hFind = FindFirstFile( ( path + L"\\*" ).c_str( ), &fileData );
-	if( hFind == INVALID_HANDLE_VALUE )
+	if( !IsDirectory( path ) )
 	{
-		std::wcout << "BAD PATH IN RAB WRITE!\n";
+		LogError( ) << "BAD PATH IN RAB WRITE!\n";
 		return;
 	}
 
@@ -304,48 +367,43 @@ void RAB::AddFilesInDirectory( const std::wstring& path )
 	std::vector< std::thread > threads;
 #endif
 
-	do
+	for( const std::wstring& filePath : ListFiles( path, L"", false ) )
 	{
-		if( !(fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) )
-		{
-			std::wstring fileName = fileData.cFileName;
-			std::wcout << L"FILE:" + fileName + L"\n";
+		std::wstring fileName = GetFileName( filePath );
+		LogInfo( ) << L"FILE:" + fileName + L"\n";
 
-			AddFile( path + L"\\" + fileName );
+		AddFile( path + L"\\" + fileName );
 
-			size_t lastindex = fileName.find_last_of(L'.');
-			if (lastindex != std::wstring::npos)
-			{
-				std::wstring extension = fileName.substr(lastindex + 1, extension.size() - lastindex);
-				extension = ConvertToLower(extension);
-				if (extension == L"mdb") {
-					mdbFileNum++;
-				}
+		size_t lastindex = fileName.find_last_of(L'.');
+		if (lastindex != std::wstring::npos)
+		{
+			std::wstring extension = fileName.substr(lastindex + 1, extension.size() - lastindex);
+			extension = ConvertToLower(extension);
+			if (extension == L"mdb") {
+				mdbFileNum++;
 			}
+		}
 
 #ifdef MULTITHREAD
-			if( threads.size( ) < MAX_MULTITHREADED_FILES - 1 )
-			{
-				threads.push_back( std::thread( MultithreadCompressFile, files.back( ).get( ) ) );
-			}
-			else
-			{
-				threads.push_back( std::thread( MultithreadCompressFile, files.back( ).get( ) ) );
+		if( threads.size( ) < MAX_MULTITHREADED_FILES - 1 )
+		{
+			threads.push_back( std::thread( MultithreadCompressFile, files.back( ).get( ) ) );
+		}
+		else
+		{
+			threads.push_back( std::thread( MultithreadCompressFile, files.back( ).get( ) ) );
 
-				std::wcout << L"Ran Max Allowed threads. Waiting for completion\n";
+			LogInfo( ) << L"Ran Max Allowed threads. Waiting for completion\n";
 
-				for( int i = 0; i < threads.size( ); ++i )
-				{
-					threads[i].join( );
+			for( int i = 0; i < threads.size( ); ++i )
+			{
+				threads[i].join( );
 
-					std::wcout << L"Completed All Threads. Continuing\n";
-				}
+				LogInfo( ) << L"Completed All Threads. Continuing\n";
 			}
-#endif
 		}
-	} while( FindNextFile( hFind, &fileData ) != 0 );
-
-	FindClose( hFind );
+#endif
+	}
 }
 
 void RAB::AddFile( std::wstring filePath )
@@ -367,7 +425,7 @@ void RAB::AddFile( std::wstring filePath )
 		directory = directory.substr( last_slash_idx + 1, directory.size( ) - last_slash_idx );
 	}
 
-	//std::wcout << L"DGB:" + file + L"\n";
+	//LogInfo( ) << L"DGB:" + file + L"\n";
 
 	int folderID = -1;
 	for( int i = 0; i < folders.size( ); ++i )
@@ -399,8 +457,10 @@ bool CompRabFolders( const std::unique_ptr<RABFile> &a, const std::unique_ptr<RA
 	return a->folderID > b->folderID;
 }
 
-void RAB::Write( const std::wstring& rabName )
+bool RAB::Write( const std::wstring& rabName )
 {
+	StageTimer timer( "FILES>RAB", StatStage::Build );
+
 	//Sort inputs:
 	std::sort( files.begin( ), files.end( ), CompRabFolders );
 
@@ -409,13 +469,11 @@ void RAB::Write( const std::wstring& rabName )
 		files[i]->fileID = i;
 	}
 
-	//Misc variables
-	char *seg;
-
 	//Generate data:
 	std::vector< char > data;
+	ByteWriterLE writer( data );
 
-	std::wcout << L"Beggining RAB Archiving.\n";
+	LogInfo( ) << L"Beggining RAB Archiving.\n";
 
 	//Generate header:
 
@@ -448,16 +506,10 @@ void RAB::Write( const std::wstring& rabName )
 	data.push_back( 0x00 );
 
 	//0x10: Largest uncompressed file size
-	seg = IntToBytes( largestFileSize );
-	for( int i = 0; i < 4; ++i )
-		data.push_back( seg[i] );
-	free( seg );
+	writer.Put< int32_t >( largestFileSize );
 
 	//0x14: Number of files:
-	seg = IntToBytes( numFiles );
-	for( int i = 0; i < 4; ++i )
-		data.push_back( seg[i] );
-	free( seg );
+	writer.Put< int32_t >( numFiles );
 
 	//0x18: Offset to beginning of file info table, always 0x28
 	data.push_back( 0x28 );
@@ -474,10 +526,7 @@ void RAB::Write( const std::wstring& rabName )
 
 	//0x20 Number of Folders:
 	numFolders = folders.size( );
-	seg = IntToBytes( numFolders );
-	for( int i = 0; i < 4; ++i )
-		data.push_back( seg[i] );
-	free( seg );
+	writer.Put< int32_t >( numFolders );
 
 	//0x24 Offset to beginning of folder name table
 	const int folderNameTableStartOffs = 0x24;
@@ -509,47 +558,22 @@ void RAB::Write( const std::wstring& rabName )
 
 		fileCompressedSizePos.push_back( data.size( ) );
 
-		seg = IntToBytes( files[i]->fileSize );
-		for( int j = 0; j < 4; ++j )
-			data.push_back( seg[j] );
-		free( seg );
+		writer.Put< int32_t >( files[i]->fileSize );
 		
 		//0x8 Folder index.
-		seg = IntToBytes( files[i]->folderID );
-		for( int j = 0; j < 4; ++j )
-			data.push_back( seg[j] );
-		free( seg );
+		writer.Put< int32_t >( files[i]->folderID );
 
 		//0xc HD Texture?
 		int isHD = 0;
 		if( folders[files[i]->folderID] == L"HD-TEXTURE" )
 			isHD = 1;
 
-		seg = IntToBytes( isHD );
-		for( int j = 0; j < 4; ++j )
-			data.push_back( seg[j] );
-		free( seg );
+		writer.Put< int32_t >( isHD );
 
 		//0x10 File time
 
-		unsigned char datetime[8];
-
-		memcpy( datetime, &files[i]->fileTime, sizeof( FILETIME ) );
-
-		for( int j = 0; j < 8; ++j )
-			data.push_back( datetime[j] );
-
-		/*
-		seg = IntToBytes( files[i]->fileTime.dwLowDateTime, false );
-		for( int j = 0; j < 4; ++j )
-			data.push_back( seg[j] );
-		free( seg );
-
-		seg = IntToBytes( files[i]->fileTime.dwHighDateTime, false );
-		for( int j = 0; j < 4; ++j )
-			data.push_back( seg[j] );
-		free( seg );
-		*/
+		writer.Put< uint32_t >( (uint32_t)files[i]->fileTime );
+		writer.Put< uint32_t >( (uint32_t)( files[i]->fileTime >> 32 ) );
 
 		//0x18 file content offs
 		fileOffsPos.push_back( data.size( ) );
@@ -591,10 +615,7 @@ void RAB::Write( const std::wstring& rabName )
 		data.push_back( 0x00 );
 
 		//0x4 File index.
-		seg = IntToBytes( sortedFiles[i]->fileID );
-		for( int j = 0; j < 4; ++j )
-			data.push_back( seg[j] );
-		free( seg );
+		writer.Put< int32_t >( sortedFiles[i]->fileID );
 	}
 
 	//Folder name table:
@@ -613,34 +634,22 @@ void RAB::Write( const std::wstring& rabName )
 	}
 
 	//Correct file name table offs
-	seg = IntToBytes( fileNameTablePos );
-	for( int i = 0; i < 4; ++i )
-		data[fileNameTableStartOffs + i] = seg[i];
-	free( seg );
+	writer.Set< int32_t >( fileNameTableStartOffs, fileNameTablePos );
 
 	//Correct folder table offs
-	seg = IntToBytes( folderTablePos );
-	for( int i = 0; i < 4; ++i )
-		data[folderNameTableStartOffs + i] = seg[i];
-	free( seg );
+	writer.Set< int32_t >( folderNameTableStartOffs, folderTablePos );
 
 	//Strings:
 	//Files
 	for( int i = 0; i < files.size( ); ++i )
 	{
-		seg = IntToBytes( data.size( ) - fileNameStringPos[i] );
-		for( int j = 0; j < 4; ++j )
-			data[fileNameStringPos[i] + j] = seg[j];
-		free( seg );
+		writer.Set< int32_t >( fileNameStringPos[i], (int32_t)( data.size( ) - fileNameStringPos[i] ) );
 
 		for( int s = 0; s < sortedFiles.size(); ++s )
 		{
 			if( files[i]->fileName == sortedFiles[s]->fileName )
 			{
-				seg = IntToBytes( data.size( ) - fileNameTableStringPos[s] );
-				for( int j = 0; j < 4; ++j )
-					data[fileNameTableStringPos[s] + j] = seg[j];
-				free( seg );
+				writer.Set< int32_t >( fileNameTableStringPos[s], (int32_t)( data.size( ) - fileNameTableStringPos[s] ) );
 
 				break;
 			}
@@ -654,26 +663,21 @@ void RAB::Write( const std::wstring& rabName )
 	//Folders
 	for( int i = 0; i < folders.size( ); ++i )
 	{
-		seg = IntToBytes( data.size() - folderNameStringPos[i] );
-		for( int j = 0; j < 4; ++j )
-			data[folderNameStringPos[i] + j] = seg[j];
-		free( seg );
+		writer.Set< int32_t >( folderNameStringPos[i], (int32_t)( data.size() - folderNameStringPos[i] ) );
 
 		PushWStringToVector( folders[i], &data );
 	}
 
-	std::wcout << L"RAB Archive data complete, now archiving files...\n";
+	LogInfo( ) << L"RAB Archive data complete, now archiving files...\n";
 
 	//Correct archive data offs
-	seg = IntToBytes( data.size( ) );
-	for( int i = 0; i < 4; ++i )
-		data[archiveStartDataOffs + i] = seg[i];
-	free( seg );
+	writer.Set< int32_t >( archiveStartDataOffs, (int32_t)( data.size( ) ) );
 
 	//File contents:
 	int largestCompressedFile = 0;
 	if (bIsMultipleThreads)
 	{
+#if defined( _WIN32 )
 		CRITICAL_SECTION *CriticalSection = new CRITICAL_SECTION;
 		InitializeCriticalSectionAndSpinCount(CriticalSection, 0x00000400);
 
@@ -734,8 +738,7 @@ void RAB::Write( const std::wstring& rabName )
 				}
 				else {
 					DWORD errorCode = GetLastError();
-					std::wcout << errorCode;
-					std::wcout << L"\n";
+					LogError( ) << errorCode << L"\n";
 					system("pause");
 				}
 				v_MTFile[i].size = 0;
@@ -764,8 +767,7 @@ void RAB::Write( const std::wstring& rabName )
 				}
 				else {
 					DWORD errorCode = GetLastError();
-					std::wcout << errorCode;
-					std::wcout << L"\n";
+					LogError( ) << errorCode << L"\n";
 					system("pause");
 				}
 				v_MTFile[i].isActive = 0;
@@ -793,7 +795,7 @@ void RAB::Write( const std::wstring& rabName )
 				ResumeThread(v_MTFile[i].hnd);
 			}
 		}
-		std::wcout << L"Set the number of threads active: " + std::to_wstring(activeThreadsNum) + L"\n\n";
+		LogInfo() << L"Set the number of threads active: " + std::to_wstring(activeThreadsNum) + L"\n\n";
 		// end
 
 		DWORD result = WaitForMultipleObjects(handleNum, v_handle, TRUE, INFINITE);
@@ -827,35 +829,101 @@ void RAB::Write( const std::wstring& rabName )
 			}
 			delete[] v_MTFile;
 		}
+#else
+		//No Win32 threads here, a pool takes the next file until none are left
+		size_t activeThreadsNum = customizeThreads > 0 ? (size_t)customizeThreads : (std::max)(1u, std::thread::hardware_concurrency());
+		activeThreadsNum = (std::max)((size_t)1, (std::min)(activeThreadsNum, files.size()));
+		LogInfo() << L"Set the number of threads active: " + std::to_wstring(activeThreadsNum) + L"\n\n";
+
+		std::vector< std::vector< char > > compressedFiles(files.size());
+		std::atomic< size_t > nextFile(0);
+		std::vector< std::thread > threads;
+		for (size_t t = 0; t < activeThreadsNum; ++t)
+		{
+			threads.emplace_back([&]()
+			{
+				for (size_t i = nextFile++; i < files.size(); i = nextFile++)
+				{
+					LogInfo( ) << L"Compressing file: " + files[i]->fileName + L"\n";
+
+					CMPLHandler compresser = CMPLHandler(files[i]->data);
+					compresser.bUseFakeCompression = false;
+
+					compressedFiles[i] = compresser.Compress();
+					compresser.data.clear();
+
+					LogInfo( ) << L"File compression completed: " + files[i]->fileName + L"\n";
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		for (size_t i = 0; i < files.size(); ++i) {
+			if (largestCompressedFile < compressedFiles[i].size())
+				largestCompressedFile = compressedFiles[i].size();
+
+			writer.Set<int32_t>(fileOffsPos[i], (int32_t)(data.size()));
+			writer.Set<int32_t>(fileCompressedSizePos[i], (int32_t)(compressedFiles[i].size()));
+
+			data.insert(data.end(), compressedFiles[i].begin(), compressedFiles[i].end());
+			compressedFiles[i].clear();
+		}
+#endif
 	}
 	else {
+		//Only what this archive still holds is kept for next time
+		RABCompressCache keptCache;
+
 		for (int i = 0; i < files.size(); ++i)
 		{
-			seg = IntToBytes(data.size());
-			for (int j = 0; j < 4; ++j)
-				data[fileOffsPos[i] + j] = seg[j];
-			free(seg);
+			writer.Set<int32_t>(fileOffsPos[i], (int32_t)(data.size()));
 			bool shouldCompress = true;
 			if (shouldCompress)
 			{
-				std::wcout << L"Compressing file: " + files[i]->fileName + L"\n";
+				std::wstring cacheKey = (files[i]->folderID >= 0 ? folders[files[i]->folderID] : L"") + L"\\" + files[i]->fileName;
+				const RABCompressedFile *cached = nullptr;
+				if (compressCache)
+				{
+					auto entry = compressCache->find(cacheKey);
+					if (entry != compressCache->end() && entry->second.fileSize == files[i]->fileSize && entry->second.fakeCompression == bUseFakeCompression
+						&& entry->second.fileTime == files[i]->fileTime)
+						cached = &entry->second;
+				}
 
-				CMPLHandler compresser = CMPLHandler(files[i]->data);
-				compresser.bUseFakeCompression = bUseFakeCompression;
+				std::vector< char > compressedFile;
+				if (cached)
+				{
+					LogDebug( ) << L"Unchanged file: " + files[i]->fileName + L"\n";
+					compressedFile = cached->data;
+				}
+				else
+				{
+					LogInfo( ) << L"Compressing file: " + files[i]->fileName + L"\n";
+
+					CMPLHandler compresser = CMPLHandler(files[i]->data);
+					compresser.bUseFakeCompression = bUseFakeCompression;
 
-				std::vector< char > compressedFile = compresser.Compress();
+					compressedFile = compresser.Compress();
+					compresser.data.clear();
+				}
+
+				if (compressCache)
+				{
+					RABCompressedFile& kept = keptCache[cacheKey];
+					kept.fileSize = files[i]->fileSize;
+					kept.fileTime = files[i]->fileTime;
+					kept.fakeCompression = bUseFakeCompression;
+					kept.data = compressedFile;
+				}
 
 				if (largestCompressedFile < compressedFile.size())
 					largestCompressedFile = compressedFile.size();
 
-				seg = IntToBytes(compressedFile.size());
-				for (int j = 0; j < 4; ++j)
-					data[fileCompressedSizePos[i] + j] = seg[j];
-				free(seg);
+				writer.Set<int32_t>(fileCompressedSizePos[i], (int32_t)(compressedFile.size()));
 
 				data.insert(data.end(), compressedFile.begin(), compressedFile.end());
 				compressedFile.clear();
-				compresser.data.clear();
 			}
 			else
 			{
@@ -865,20 +933,24 @@ void RAB::Write( const std::wstring& rabName )
 				data.insert(data.end(), files[i]->data.begin(), files[i]->data.end());
 			}
 
-			std::wcout << L"File: " + files[i]->fileName + L" Archived\n";
+			LogInfo( ) << L"File: " + files[i]->fileName + L" Archived\n";
 		}
+
+		if (compressCache)
+			compressCache->swap(keptCache);
 	}
 
 	//Update "largest compressed file" int:
-	seg = IntToBytes( largestCompressedFile );
-	for( int i = 0; i < 4; ++i )
-		data[largestCompressedFileSizeOffs + i] = seg[i];
-	free( seg );
+	writer.Set< int32_t >( largestCompressedFileSizeOffs, largestCompressedFile );
 
 	//Write RAB
-	std::ofstream file = std::ofstream( rabName, std::ios::binary | std::ios::out | std::ios::ate );
+	timer.Next( StatStage::Write );
+	std::ofstream file = std::ofstream( ToFilePath( rabName ), std::ios::binary | std::ios::out | std::ios::ate );
 	file.write(data.data(), data.size());
 	file.close( );
+	bool written = !file.fail( );
+	timer.AddBytes( data.size( ) );
+	timer.Stop( );
 
 	data.clear( );
 
@@ -896,9 +968,17 @@ void RAB::Write( const std::wstring& rabName )
 	fileOffsPos.clear( );
 	data.clear( );
 
-	std::wcout << L"RAB Archive operation completed!\n";
+	if( !written )
+	{
+		LogError( ) << L"Can't write " << rabName << L"\n";
+		return false;
+	}
+
+	LogInfo( ) << L"RAB Archive operation completed!\n";
+	return true;
 }
 
+#if defined( _WIN32 )
 // Helper function to count set bits in the processor mask.
 DWORD RAB::CountSetBits(ULONG_PTR bitMask)
 {
@@ -915,9 +995,11 @@ DWORD RAB::CountSetBits(ULONG_PTR bitMask)
 
 	return bitSetCount;
 }
+#endif
 
 void RAB::WriteInitMTInfo()
 {
+#if defined( _WIN32 )
 	PSYSTEM_LOGICAL_PROCESSOR_INFORMATION pCPUInfo = 0;
 	DWORD lCPUInfo = 0;
 	GetLogicalProcessorInformation(pCPUInfo, &lCPUInfo);
@@ -997,13 +1079,23 @@ void RAB::WriteInitMTInfo()
 
 		free(pCPUInfo);
 	}
+#else
+	//No core and thread split here, a thread per logical processor up to the same 16
+	unsigned int threads = std::thread::hardware_concurrency();
+	if (threads > 1) {
+		bIsMultipleThreads = true;
+		customizeThreads = (std::min)(threads, 16u);
+	}
+#endif
 }
 
+#if defined( _WIN32 )
+
 DWORD WINAPI RABWriteMTCompress(LPVOID lpParam)
 {
 	RABMTParameter* InPtr = (RABMTParameter*)lpParam;
 	EnterCriticalSection(InPtr->cs);
-	std::wcout << L"Compressing file: " + InPtr->fileName + L"\n";
+	LogInfo( ) << L"Compressing file: " + InPtr->fileName + L"\n";
 	LeaveCriticalSection(InPtr->cs);
 
 	CMPLHandler compresser = CMPLHandler(InPtr->data);
@@ -1014,7 +1106,7 @@ DWORD WINAPI RABWriteMTCompress(LPVOID lpParam)
 	compresser.data.clear();
 
 	EnterCriticalSection(InPtr->cs);
-	std::wcout << L"File compression completed: " + InPtr->fileName + L"\n";
+	LogInfo( ) << L"File compression completed: " + InPtr->fileName + L"\n";
 	for (size_t i = 0; i < InPtr->taskNum; ++i) {
 		if (InPtr->task[i].isActive == 0) {
 			InPtr->task[i].isActive = 1;
@@ -1038,7 +1130,7 @@ DWORD WINAPI RABWriteMTCompress2(LPVOID lpParam)
 	SetThreadAffinityMask(GetCurrentThread(), AffinityMask);
 
 	EnterCriticalSection(InPtr->cs);
-	std::wcout << L"Compressing file: " + InPtr->fileName + L"\n";
+	LogInfo( ) << L"Compressing file: " + InPtr->fileName + L"\n";
 	LeaveCriticalSection(InPtr->cs);
 
 	CMPLHandler compresser = CMPLHandler(InPtr->data);
@@ -1050,7 +1142,7 @@ DWORD WINAPI RABWriteMTCompress2(LPVOID lpParam)
 
 	RABFileList* pFile = 0;
 	EnterCriticalSection(InPtr->cs);
-	std::wcout << L"File compression completed: " + InPtr->fileName + L"\n";
+	LogInfo( ) << L"File compression completed: " + InPtr->fileName + L"\n";
 	pFile = InPtr->pList->next;
 	if (pFile) {
 		InPtr->pList->next = pFile->next;
@@ -1070,7 +1162,7 @@ RABFileList* __fastcall RABWriteMTCompressNext(RABFileList* File, LPCRITICAL_SEC
 	File->next = 0;
 
 	EnterCriticalSection(cs);
-	std::wcout << L"Compressing file: " + File->fileName + L"\n";
+	LogInfo( ) << L"Compressing file: " + File->fileName + L"\n";
 	LeaveCriticalSection(cs);
 
 	CMPLHandler compresser = CMPLHandler(File->data);
@@ -1082,7 +1174,7 @@ RABFileList* __fastcall RABWriteMTCompressNext(RABFileList* File, LPCRITICAL_SEC
 
 	RABFileList* pFile = 0;
 	EnterCriticalSection(cs);
-	std::wcout << L"File compression completed: " + File->fileName + L"\n";
+	LogInfo( ) << L"File compression completed: " + File->fileName + L"\n";
 	pFile = File->pList->next;
 	if (pFile) {
 		File->pList->next = pFile->next;
@@ -1092,310 +1184,26 @@ RABFileList* __fastcall RABWriteMTCompressNext(RABFileList* File, LPCRITICAL_SEC
 	delete File;
 	return pFile;
 }
+#endif
 
 RABFile::RABFile( std::wstring name, int fID, const std::wstring& fullPath )
 {
 	fileName = name;
 	folderID = fID;
 	fileID = 0;
+	fileSize = 0;
+	fileTime = 0;
 
-	std::ifstream file( fullPath, std::ios::binary | std::ios::ate );
-
-	std::streamsize size = file.tellg( );
-	file.seekg( 0, std::ios::beg );
-
-	if( size == -1 )
+	MappedFile file;
+	if( !file.Open( fullPath ) )
 		return;
 
-	std::vector<char> buffer( size );
-	if( file.read( buffer.data( ), size ) )
-	{
-	}
-
-	file.close( );
-
+	//The archive keeps its own copy, it is compressed in place later
+	ByteSpan buffer = file.Span( );
 	fileSize = buffer.size( );
-	data = buffer;
-
-	//A tad hacky.
-	HANDLE fHandle = CreateFileW( (LPCWSTR)fullPath.c_str( ),
-		FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
-		NULL, OPEN_EXISTING,
-		FILE_ATTRIBUTE_NORMAL, NULL );
-
-	//Set the filetime on the file
-	GetFileTime( fHandle, (LPFILETIME)NULL, (LPFILETIME)NULL, &fileTime );
-
-	//Close our handle.
-	CloseHandle( fHandle );
-}
-
-//CMPL Tools:
-CMPLHandler::CMPLHandler( std::vector< char > inFile, bool useFakeCompression )
-{
-	data = inFile;
-
-	bUseFakeCompression = useFakeCompression;
-}
-
-//CMPL Decompressor
-std::vector< char > CMPLHandler::Decompress(  )
-{
-	//Check header:
-	if( data[0] != 'C' && data[1] != 'M' && data[2] != 'P' && data[3] != 'L' )
-	{
-		std::wcout << L"FILE IS NOT CMPL COMPRESSED!\n";
-		return data;
-	}
-	else
-		std::wcout << L"BEGINNING DECOMPRESSION\n";
-
-	//Variables
-	uint8_t bitbuf;
-	uint8_t bitbufcnt;
-
-	std::vector< char > out;
-
-	char mainbuf[4096];
-
-	int bufPos;
-
-	unsigned char seg[4];
-	Read4BytesReversed( seg, data, 4 );
-	int desiredSize = GetIntFromChunk( seg );
-	out.reserve(desiredSize);
-
-	int streamPos = 8;
-
-	//Init buffer:
-	for( int i = 0; i < 4078; ++i )
-		mainbuf[i] = 0;
-	bitbuf = 0;
-	bitbufcnt = 0;
-	bufPos = 4078;
-
-	//Loop
-	while( streamPos < data.size( ) )
-	{
-		//If bitbuf empty
-		if( bitbufcnt == 0 )
-		{
-			//Read and store in buffer
-			bitbuf = data[streamPos];
-			bitbufcnt = 8;
-
-			++streamPos;
-		}
-
-		//if first bit is one, copy byte from input
-		if( bitbuf & 0x1 > 0 )
-		{
-			out.push_back( data[streamPos] );
-			mainbuf[bufPos] = data[streamPos];
-			++bufPos;
-			if( bufPos >= 4096 )
-				bufPos = 0;
-			++streamPos;
-		}
-		else //Copy bytes from buffer
-		{
-			uint8_t chunk[2];
-			chunk[1] = data[streamPos + 1];
-			chunk[0] = data[streamPos];
-
-			streamPos += 2;
-
-			uint16_t val = ( chunk[0] << 8 ) | chunk[1];
-			int copyLen = ( val & 0xf ) + 3;
-			int copyPos = val >> 4;
-
-			for( int i = 0; i < copyLen; ++i )
-			{
-				unsigned char byte = mainbuf[copyPos];
-				out.push_back( byte );
-				mainbuf[bufPos] = byte;
-
-				++bufPos;
-				if( bufPos >= 4096 )
-					bufPos = 0;
+	data.assign( buffer.begin( ), buffer.end( ) );
 
-				++copyPos;
-				if( copyPos >= 4096 )
-					copyPos = 0;
-			}
-		}
-
-		--bitbufcnt;
-		bitbuf >>= 1;
-	}
-
-	if( out.size( ) == desiredSize )
-	{
-		std::wcout << L"FILE SIZE MATCH! " + ToString( desiredSize ) + L" bytes expected, got " + ToString( (int)out.size( ) ) +  L" DECOMPRESSION SUCCESSFUL!\n";
-	}
-	else
-		std::wcout << L"FILE SIZE MISMATCH! " + ToString( desiredSize ) + L" bytes expected, got " + ToString( (int)out.size( ) ) + L" DECOMPRESSION FAILED!\n";
-
-	return out;
-}
-
-//CMPL Compresser
-std::vector< char > CMPLHandler::Compress( )
-{
-	//Declare output
-	std::vector< char > out;
-
-	//Fill header:
-	out.push_back( 'C' );
-	out.push_back( 'M' );
-	out.push_back( 'P' );
-	out.push_back( 'L' );
-
-	//File size
-	char *sizeBytes = IntToBytes( data.size( ), false );
-
-	out.push_back( sizeBytes[0] );
-	out.push_back( sizeBytes[1] );
-	out.push_back( sizeBytes[2] );
-	out.push_back( sizeBytes[3] );
-
-	free( sizeBytes );
-
-	//Begin compression:
-
-	//Use fake compression, faster compile times but extremly ineffecient
-	if( bUseFakeCompression )
-	{
-		std::wcout << L"File using SIMPLE/FAKE Compression.\n";
-
-		//Prepare to format the data into something that the game's CMPL decompressor will read, this data will be trash, not really compressed and is horrible, but just do it anyway.
-		int count = 0;
-		while( count < data.size( ) )
-		{
-			//Push "Copy 8 bits directly" command to reader
-			out.push_back( 0b11111111 );
-
-			for( int i = 0; i < 8; ++i )
-			{
-				if( count >= data.size( ) )
-					break;
-				out.push_back( data[count] );
-				++count;
-			}
-		}
-	}
-	else
-	{
-		//CMPL Compression Algorithm by BlueAmulet
-		//std::vector<uint8_t> out;
-		std::vector<uint8_t> temp;
-		int16_t mainbuf[4096];
-		uint16_t bufPos = 4078;
-		size_t streamPos = 0;
-		uint8_t bits = 0;
-
-		for( size_t i = 0; i < _countof( mainbuf ); i++ )
-		{
-			if( i < bufPos )
-			{
-				mainbuf[i] = 0;
-			}
-			else
-			{
-				// Mark end of buffer as uninitialized
-				mainbuf[i] = -1;
-			}
-		}
+	file.Close( );
 
-		size_t dataSize = data.size( );
-
-		while( streamPos < dataSize )
-		{
-			bits = 0;
-			for( size_t i = 0; i < 8; i++ )
-			{
-				if( streamPos >= dataSize )
-				{
-					break;
-				}
-				size_t bestPos = 0;
-				size_t bestLen = 0;
-				// Try to find match in buffer
-				// TODO: Properly support repeating data
-				for( size_t jo = 0; jo < _countof( mainbuf ); jo++ )
-				{
-					uint16_t j = ( bufPos - jo ) & 0xFFF;
-					if( mainbuf[j] == (int16_t)(uint16_t)data[streamPos] )
-					{
-						size_t matchLen = 0;
-						for( size_t k = 0; k < 18; k++ )
-						{
-							if( ( streamPos + k ) < dataSize && ( ( j + k ) & 0xFFF ) != bufPos && mainbuf[( j + k ) & 0xFFF] == (int16_t)(uint16_t)data[streamPos + k] )
-							{
-								matchLen = k + 1;
-							}
-							else
-							{
-								break;
-							}
-						}
-						if( matchLen > bestLen )
-						{
-							bestLen = matchLen;
-							bestPos = j;
-						}
-					}
-				}
-				// Repeating byte check
-				if( mainbuf[( bufPos - 1 ) & 0xFFF] == (int16_t)(uint16_t)data[streamPos] )
-				{
-					size_t matchLen = 0;
-					for( size_t k = 0; k < 18; k++ )
-					{
-						if( ( streamPos + k ) < dataSize && mainbuf[( bufPos - 1 ) & 0xFFF] == (int16_t)(uint16_t)data[streamPos + k] )
-						{
-							matchLen = k + 1;
-						}
-						else
-						{
-							break;
-						}
-					}
-					if( matchLen > bestLen ) {
-						bestLen = matchLen;
-						bestPos = ( bufPos - 1 ) & 0xFFF;
-					}
-				}
-				// Is copy viable?
-				if( bestLen >= 3 )
-				{
-					// Write copy data
-					uint16_t copyVal = bestLen - 3;
-					copyVal |= bestPos << 4;
-					temp.push_back( copyVal >> 8 );
-					temp.push_back( copyVal & 0xFF );
-					for( size_t j = 0; j < bestLen; j++ ) {
-						mainbuf[bufPos] = data[streamPos];
-						bufPos = ( bufPos + 1 ) & 0xFFF;
-						streamPos++;
-					}
-				}
-				else
-				{
-					// Copy from input
-					temp.push_back( data[streamPos] );
-					mainbuf[bufPos] = data[streamPos];
-					bufPos = ( bufPos + 1 ) & 0xFFF;
-					streamPos++;
-					bits |= 1 << i;
-				}
-			}
-			out.push_back( bits );
-			out.insert( out.end( ), temp.begin( ), temp.end( ) );
-			temp.clear( );
-		}
-	}
-
-	return out;
+	fileTime = GetRABFileTime( fullPath );
 }
-
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "CMPL.h"
+
+#if defined( _WIN32 )
 // Need to be a multiple of 32 bytes
 struct RABMTFile
 {
@@ -35,15 +43,17 @@ struct RABMTParameter
 DWORD WINAPI RABWriteMTCompress(LPVOID lpParam);
 DWORD WINAPI RABWriteMTCompress2(LPVOID lpParam);
 RABFileList* __fastcall RABWriteMTCompressNext(RABFileList* File, LPCRITICAL_SECTION cs);
+#endif
 
 struct RABFile
 {
-	RABFile::RABFile( std::wstring name, int fID, const std::wstring& fullPath );
+	RABFile( std::wstring name, int fID, const std::wstring& fullPath );
 	//void LoadData( std::string path );
 
 	std::wstring fileName;
 	int fileSize;
-	FILETIME fileTime;
+	//Last write time as the archive stores it, a Windows FILETIME (100 ns ticks since 1601)
+	uint64_t fileTime;
 	int fileStart;
 
 	int fileID;
@@ -52,33 +62,33 @@ struct RABFile
 	std::vector< char > data;
 };
 
-//CMPL Decompressor
-struct CMPLHandler
+//A file as it was last compressed into an archive
+struct RABCompressedFile
 {
-	CMPLHandler( std::vector< char > inFile, bool useFakeCompression = false );
-
-	std::vector< char > Decompress( );
-	std::vector< char > Compress( );
-
+	int fileSize;
+	uint64_t fileTime;
+	bool fakeCompression;
 	std::vector< char > data;
-
-	//Tool data
-	bool bUseFakeCompression;
 };
 
+//Kept between writes of the same archive, keyed by folder and file name, so writing it again only compresses what changed
+typedef std::map< std::wstring, RABCompressedFile > RABCompressCache;
+
 struct RAB
 {
 public:
 	//Read
-	void Read( const std::wstring& path, bool isMRAB );
+	bool Read( const std::wstring& path, bool isMRAB );
 
 	//Write
 	void CreateFromDirectory( const std::wstring& path );
 
 	void AddFilesInDirectory( const std::wstring& path );
 	void AddFile( std::wstring filePath );
-	void Write( const std::wstring& rabName );
+	bool Write( const std::wstring& rabName );
+#if defined( _WIN32 )
 	DWORD CountSetBits(ULONG_PTR bitMask);
+#endif
 	void WriteInitMTInfo();
 
 	//Tool properties.
@@ -86,6 +96,8 @@ public:
 	bool bIsMultipleThreads;
 	bool bIsMultipleCores;
 	int customizeThreads;
+	//Used and refreshed by single threaded writes when set
+	RABCompressCache *compressCache = nullptr;
 	//Stored Data
 	int numFiles;
 	int numFolders;
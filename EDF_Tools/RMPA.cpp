@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <locale>
@@ -12,35 +14,34 @@
 #include <locale>
 #include <locale.h>
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "RMPA.h"
 
 #define TYPE_HEADER_SIZE 0x20
 
 int CRMPA::Read( const std::wstring& path )
 {
-	std::ifstream file( path + L".RMPA", std::ios::binary | std::ios::ate);
-
-	std::streamsize size = file.tellg();
-	file.seekg(0, std::ios::beg);
-
-	std::vector<char> buffer(size);
-	if( file.read(buffer.data(), size) )
+	StageTimer timer( "RMPA", StatStage::Read );
+	MappedFile file;
+	if( file.Open( path + L".RMPA" ) )
 	{
-		unsigned char seg[4];
-
+		ByteSpan buffer = file.Span( );
+		timer.AddBytes( buffer.size( ) );
+		timer.Next( StatStage::Parse );
 		int position = 0;
 		//position = 0x100;
 
-		Read4BytesReversed( seg, buffer, position );
-
 		bool validHeader = false;
-		if( seg[0] == 0x00 && seg[1] == 0x50 && seg[2] == 0x4D && seg[3] == 0x52 )
+		if( buffer.size( ) >= 4 && ReadBE< uint32_t >( buffer, position ) == 0x00504D52 ) //"\0PMR"
 			validHeader = true;
 
 		if( !validHeader )
 		{
-			std::wcout << L"BAD FILE\n";
-			file.close();
+			LogError( ) << L"BAD FILE\n";
+			file.Close();
 			return -1;
 		}
 
@@ -55,88 +56,76 @@ int CRMPA::Read( const std::wstring& path )
 
 		//0x8: Bool denoting if RMPA has route data
 		position = 0x8;
-		Read4BytesReversed( seg, buffer, position );
-		hasRoutes = GetIntFromChunk( seg );
-		std::wcout << L"Has Routes: " + ToString( hasRoutes ) + L"\n";
+		hasRoutes = ReadBE< int32_t >( buffer, position );
+		LogInfo( ) << L"Has Routes: " + ToString( hasRoutes ) + L"\n";
 
 		position = 0xc;
-		Read4BytesReversed( seg, buffer, position );
-		routePos = GetIntFromChunk( seg );
+		routePos = ReadBE< int32_t >( buffer, position );
 
 		//0x10: Bool denoting if RMPA has shape data
 		position = 0x10;
-		Read4BytesReversed( seg, buffer, position );
-		hasShapes = GetIntFromChunk( seg );
-		std::wcout << L"Has Shapes: " + ToString( hasShapes ) + L"\n";
+		hasShapes = ReadBE< int32_t >( buffer, position );
+		LogInfo( ) << L"Has Shapes: " + ToString( hasShapes ) + L"\n";
 
 		position = 0x14;
-		Read4BytesReversed( seg, buffer, position );
-		shapePos = GetIntFromChunk( seg );
+		shapePos = ReadBE< int32_t >( buffer, position );
 
 		//0x18: Bool denoting if RMPA has camera data
 		position = 0x18;
-		Read4BytesReversed( seg, buffer, position );
-		hasCamData = GetIntFromChunk( seg );
-		std::wcout << L"Has Camera Data: " + ToString( hasCamData ) + L"\n";
+		hasCamData = ReadBE< int32_t >( buffer, position );
+		LogInfo( ) << L"Has Camera Data: " + ToString( hasCamData ) + L"\n";
 
 		position = 0x1C;
-		Read4BytesReversed( seg, buffer, position );
-		camPos = GetIntFromChunk( seg );
+		camPos = ReadBE< int32_t >( buffer, position );
 
 		//0x18: Bool denoting if RMPA has spawnpoint data
 		position = 0x20;
-		Read4BytesReversed( seg, buffer, position );
-		hasSpawnpoints = GetIntFromChunk( seg );
-		std::wcout << L"Has Spawnpoint Data: " + ToString( hasSpawnpoints ) + L"\n";
+		hasSpawnpoints = ReadBE< int32_t >( buffer, position );
+		LogInfo( ) << L"Has Spawnpoint Data: " + ToString( hasSpawnpoints ) + L"\n";
 
 		position = 0x24;
-		Read4BytesReversed( seg, buffer, position );
-		spawnPos = GetIntFromChunk( seg );
+		spawnPos = ReadBE< int32_t >( buffer, position );
 
 		//Read spawnpoints:
 		//ReadSpawnpoints( buffer );
 
 		ReadRoutes( buffer );
-
-		//Lets do something with our data:
-		std::wstring input;
-		std::wcin >> input;
 	}
+	else
+	{
+		LogError( ) << L"Can't read " << path << L".RMPA\n";
+		return -1;
+	}
+
+	return 1;
 }
 
-void CRMPA::ReadRoutes( const std::vector<char>& buffer )
+void CRMPA::ReadRoutes( const ByteSpan& buffer )
 {
-	unsigned char seg[4];
-
 	int position = routePos;
-	Read4BytesReversed( seg, buffer, position );
-	int numSubheaders = GetIntFromChunk( seg );
-	std::wcout << L"Enumerators: " + ToString( numSubheaders ) + L"\n";
+	int numSubheaders = ReadBE< int32_t >( buffer, position );
+	LogDebug( ) << L"Enumerators: " + ToString( numSubheaders ) + L"\n";
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int ofs = GetIntFromChunk( seg );
-	std::wcout << L"Enumerators 1 pos: " + ToString( ofs ) + L"\n";
+	int ofs = ReadBE< int32_t >( buffer, position );
+	LogDebug( ) << L"Enumerators 1 pos: " + ToString( ofs ) + L"\n";
 
 	//Subheader
 	for( int i = 0; i < numSubheaders; i++ )
 	{
-		std::wcout << L"Enumerator " + ToString( i ) + L":\n";
+		LogDebug( ) << L"Enumerator " + ToString( i ) + L":\n";
 
 		position = spawnPos + ofs + 0x8;
-		Read4BytesReversed( seg, buffer, position );
-		int endOfs = GetIntFromChunk( seg );
-		std::wcout << L"Enumerator ends at: " + ToString( endOfs ) + L"\n";
+		int endOfs = ReadBE< int32_t >( buffer, position );
+		LogDebug( ) << L"Enumerator ends at: " + ToString( endOfs ) + L"\n";
 
 		position = spawnPos + ofs + 0x18;
-		Read4BytesReversed( seg, buffer, position );
-		int dataCount = GetIntFromChunk( seg );
-		std::wcout << L"Number of data in Enumerator " + ToString( i ) + L": " + ToString( dataCount ) + L"\n";
+		int dataCount = ReadBE< int32_t >( buffer, position );
+		LogDebug( ) << L"Number of data in Enumerator " + ToString( i ) + L": " + ToString( dataCount ) + L"\n";
 
 		position = spawnPos + ofs + 0x1C;
-		Read4BytesReversed( seg, buffer, position );
-		int num = GetIntFromChunk( seg );
-		std::wcout << L"Data should begin at: " + ToString( num ) + L"\n";
+		int num = ReadBE< int32_t >( buffer, position );
+		LogDebug( ) << L"Data should begin at: " + ToString( num ) + L"\n";
 
 		int clusterPos = spawnPos + ofs + num;
 
@@ -145,12 +134,15 @@ void CRMPA::ReadRoutes( const std::vector<char>& buffer )
 		{
 			routes.push_back( ReadRoute( clusterPos, buffer ) );
 
-			std::wcout << L"Route: Name:" + routes.back( ).name + L" ";
-			std::wcout << L"position in route:" + ToString( routes.back( ).number ) + L" ";
-			std::wcout << L"ID:" + ToString( routes.back( ).ID ) + L" ";
-			//std::wcout << L"Position: " + ToString( spawnPoints.back( ).x ) + L" " + ToString( spawnPoints.back( ).y ) + L" " + ToString( spawnPoints.back( ).z ) + L" ";
-			//std::wcout << L"Angles: " + ToString( spawnPoints.back( ).pitch ) + L" " + ToString( spawnPoints.back( ).yaw ) + L" " + ToString( spawnPoints.back( ).roll ) + L" ";
-			//std::wcout << L"\n";
+			if( Log::Enabled( LogLevel::Debug ) )
+			{
+				LogDebug( ) << L"Route: Name:" + routes.back( ).name + L" ";
+				LogDebug( ) << L"position in route:" + ToString( routes.back( ).number ) + L" ";
+				LogDebug( ) << L"ID:" + ToString( routes.back( ).ID ) + L" ";
+			}
+			//LogDebug( ) << L"Position: " + ToString( spawnPoints.back( ).x ) + L" " + ToString( spawnPoints.back( ).y ) + L" " + ToString( spawnPoints.back( ).z ) + L" ";
+			//LogDebug( ) << L"Angles: " + ToString( spawnPoints.back( ).pitch ) + L" " + ToString( spawnPoints.back( ).yaw ) + L" " + ToString( spawnPoints.back( ).roll ) + L" ";
+			//LogDebug( ) << L"\n";
 
 			clusterPos += 0x3C;
 		}
@@ -159,39 +151,32 @@ void CRMPA::ReadRoutes( const std::vector<char>& buffer )
 	}
 }
 
-void CRMPA::ReadSpawnpoints( const std::vector<char>& buffer )
+void CRMPA::ReadSpawnpoints( const ByteSpan& buffer )
 {
-	unsigned char seg[4];
-
 	int position = spawnPos;
-	Read4BytesReversed( seg, buffer, position );
-	int numSubheaders = GetIntFromChunk( seg );
-	std::wcout << L"Enumerators: " + ToString( numSubheaders ) + L"\n";
+	int numSubheaders = ReadBE< int32_t >( buffer, position );
+	LogDebug( ) << L"Enumerators: " + ToString( numSubheaders ) + L"\n";
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int ofs = GetIntFromChunk( seg );
-	std::wcout << L"Enumerators 1 pos: " + ToString( ofs ) + L"\n";
+	int ofs = ReadBE< int32_t >( buffer, position );
+	LogDebug( ) << L"Enumerators 1 pos: " + ToString( ofs ) + L"\n";
 
 	//Subheader
 	for( int i = 0; i < numSubheaders; i++ )
 	{
-		std::wcout << L"Enumerator " + ToString( i ) + L":\n";
+		LogDebug( ) << L"Enumerator " + ToString( i ) + L":\n";
 
 		position = spawnPos + ofs + 0x8;
-		Read4BytesReversed( seg, buffer, position );
-		int endOfs = GetIntFromChunk( seg );
-		std::wcout << L"Enumerator ends at: " + ToString( endOfs ) + L"\n";
+		int endOfs = ReadBE< int32_t >( buffer, position );
+		LogDebug( ) << L"Enumerator ends at: " + ToString( endOfs ) + L"\n";
 
 		position = spawnPos + ofs + 0x18;
-		Read4BytesReversed( seg, buffer, position );
-		int dataCount = GetIntFromChunk( seg );
-		std::wcout << L"Number of data in Enumerator " + ToString( i ) + L": " + ToString( dataCount ) + L"\n";
+		int dataCount = ReadBE< int32_t >( buffer, position );
+		LogDebug( ) << L"Number of data in Enumerator " + ToString( i ) + L": " + ToString( dataCount ) + L"\n";
 
 		position = spawnPos + ofs + 0x1C;
-		Read4BytesReversed( seg, buffer, position );
-		int num = GetIntFromChunk( seg );
-		std::wcout << L"Data should begin at: " + ToString( num ) + L"\n";
+		int num = ReadBE< int32_t >( buffer, position );
+		LogDebug( ) << L"Data should begin at: " + ToString( num ) + L"\n";
 
 		int clusterPos = spawnPos + ofs + num;
 
@@ -200,12 +185,15 @@ void CRMPA::ReadSpawnpoints( const std::vector<char>& buffer )
 		{
 			spawnPoints.push_back( ReadSpawnpoint( clusterPos, buffer ) );
 
-			//std::wcout << spawnPoints.back( ).
-			std::wcout << L"Spawnpoint: Name:" + spawnPoints.back( ).name + L" ";
-			std::wcout << L"ID?:" + ToString( spawnPoints.back( ).num ) + L" ";
-			std::wcout << L"Position: " + ToString( spawnPoints.back( ).x ) + L" " + ToString( spawnPoints.back( ).y ) + L" " + ToString( spawnPoints.back( ).z ) + L" ";
-			std::wcout << L"Angles: " + ToString( spawnPoints.back( ).pitch ) + L" " + ToString( spawnPoints.back( ).yaw ) + L" " + ToString( spawnPoints.back( ).roll ) + L" ";
-			std::wcout << L"\n";
+			//LogDebug( ) << spawnPoints.back( ).
+			if( Log::Enabled( LogLevel::Debug ) )
+			{
+				LogDebug( ) << L"Spawnpoint: Name:" + spawnPoints.back( ).name + L" ";
+				LogDebug( ) << L"ID?:" + ToString( spawnPoints.back( ).num ) + L" ";
+				LogDebug( ) << L"Position: " + ToString( spawnPoints.back( ).x ) + L" " + ToString( spawnPoints.back( ).y ) + L" " + ToString( spawnPoints.back( ).z ) + L" ";
+				LogDebug( ) << L"Angles: " + ToString( spawnPoints.back( ).pitch ) + L" " + ToString( spawnPoints.back( ).yaw ) + L" " + ToString( spawnPoints.back( ).roll ) + L" ";
+				LogDebug( ) << L"\n";
+			}
 
 			clusterPos += 0x40;
 		}
@@ -214,76 +202,56 @@ void CRMPA::ReadSpawnpoints( const std::vector<char>& buffer )
 	}
 }
 
-RMPASpawnPoint CRMPA::ReadSpawnpoint( int pos, const std::vector<char>& buffer )
+RMPASpawnPoint CRMPA::ReadSpawnpoint( int pos, const ByteSpan& buffer )
 {
-	unsigned char seg[] = { 0x0, 0x0, 0x0, 0x0 };
-
 	int position = pos;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown1 = GetIntFromChunk( seg );
+	int unknown1 = ReadBE< int32_t >( buffer, position );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown2 = GetIntFromChunk( seg );
+	int unknown2 = ReadBE< int32_t >( buffer, position );
 
 	//0x8 data
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int id = GetIntFromChunk( seg );
+	int id = ReadBE< int32_t >( buffer, position );
 
 	float vecPos[3];
 	for( int i = 0; i < 3; i++ ) //+0xC
 	{
 		position += 4;
-		Read4Bytes( seg, buffer, position );
-
-		float f;
-		memcpy( &f, &seg, sizeof( f ) );
-		vecPos[i] = f;
+		vecPos[i] = ReadBE< float >( buffer, position );
 	}
 
 	float vecAng[3];
 	for( int i = 0; i < 3; i++ ) //+0xc
 	{
 		position += 4;
-		Read4Bytes( seg, buffer, position );
-
-		float f;
-		memcpy( &f, &seg, sizeof( f ) );
-		vecAng[i] = f;
+		vecAng[i] = ReadBE< float >( buffer, position );
 	}
 
 	//0x20
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown3 = GetIntFromChunk( seg );
+	int unknown3 = ReadBE< int32_t >( buffer, position );
 
 	//float f;
 	//memcpy( &f, &seg, sizeof( f ) );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown4 = GetIntFromChunk( seg );
+	int unknown4 = ReadBE< int32_t >( buffer, position );
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown5 = GetIntFromChunk( seg );
+	int unknown5 = ReadBE< int32_t >( buffer, position );
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown6 = GetIntFromChunk( seg );
+	int unknown6 = ReadBE< int32_t >( buffer, position );
 
 	//Node name:
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int num = GetIntFromChunk( seg );
+	int num = ReadBE< int32_t >( buffer, position );
 	//num++;
 	std::wstring nodeName = ReadUnicode( buffer, pos + num, true );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown7 = GetIntFromChunk( seg );
+	int unknown7 = ReadBE< int32_t >( buffer, position );
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown8 = GetIntFromChunk( seg );
+	int unknown8 = ReadBE< int32_t >( buffer, position );
 	
 	RMPASpawnPoint point = RMPASpawnPoint( nodeName, id, vecPos[0], vecPos[1], vecPos[2], vecAng[0], vecAng[1], vecAng[2] );
 
@@ -303,54 +271,40 @@ RMPASpawnPoint CRMPA::ReadSpawnpoint( int pos, const std::vector<char>& buffer )
 	return point;
 }
 
-RMPARoute CRMPA::ReadRoute( int pos, const std::vector<char>& buffer )
+RMPARoute CRMPA::ReadRoute( int pos, const ByteSpan& buffer )
 {
-	unsigned char seg[] = { 0x0, 0x0, 0x0, 0x0 };
-
 	int position = pos;
-	Read4BytesReversed( seg, buffer, position );
-	int number = GetIntFromChunk( seg );
+	int number = ReadBE< int32_t >( buffer, position );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown1 = GetIntFromChunk( seg );
+	int unknown1 = ReadBE< int32_t >( buffer, position );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int ofsNextWaypointData = GetIntFromChunk( seg );
+	int ofsNextWaypointData = ReadBE< int32_t >( buffer, position );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown2 = GetIntFromChunk( seg );
+	int unknown2 = ReadBE< int32_t >( buffer, position );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int ofsSGO = GetIntFromChunk( seg );
+	int ofsSGO = ReadBE< int32_t >( buffer, position );
 
 	//Position?
 	float vecPos[3];
 	for( int i = 0; i < 3; i++ ) //+0xC
 	{
 		position += 4;
-		Read4Bytes( seg, buffer, position );
-
-		float f;
-		memcpy( &f, &seg, sizeof( f ) );
-		vecPos[i] = f;
+		vecPos[i] = ReadBE< float >( buffer, position );
 	}
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int ofsSGO2 = GetIntFromChunk( seg );
+	int ofsSGO2 = ReadBE< int32_t >( buffer, position );
 
 	position += 0x4;
-	Read4BytesReversed( seg, buffer, position );
-	int unknown3 = GetIntFromChunk( seg );
+	int unknown3 = ReadBE< int32_t >( buffer, position );
 
 	//Node name:
 	position = pos + 0x24;
-	Read4BytesReversed( seg, buffer, position );
-	int num = GetIntFromChunk( seg );
+	int num = ReadBE< int32_t >( buffer, position );
 	//num++;
 	std::wstring nodeName = ReadUnicode( buffer, pos + num, true );
 
@@ -1,4 +1,5 @@
 #pragma once
+#include "ByteStream.h"
 
 //RMPA spawnpoint
 struct RMPASpawnPoint
@@ -71,11 +72,11 @@ class CRMPA
 public:
 	int Read( const std::wstring& path );
 
-	void ReadSpawnpoints( const std::vector<char>& buffer );
-	void ReadRoutes( const std::vector<char>& buffer );
+	void ReadSpawnpoints( const ByteSpan& buffer );
+	void ReadRoutes( const ByteSpan& buffer );
 
-	RMPASpawnPoint ReadSpawnpoint( int pos, const std::vector<char>& buffer );
-	RMPARoute ReadRoute( int pos, const std::vector<char>& buffer );
+	RMPASpawnPoint ReadSpawnpoint( int pos, const ByteSpan& buffer );
+	RMPARoute ReadRoute( int pos, const ByteSpan& buffer );
 
 private:
 	std::vector< RMPASpawnPoint > spawnPoints;
@@ -2,32 +2,44 @@
 
 #include <iostream>
 #include <fstream>
+#if defined( _WIN32 )
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <locale>
 #include <codecvt>
 #include <algorithm>
+#include <unordered_map>
 
 #include <iostream>
 #include <locale>
 #include <locale.h>
 #include "util.h"
+#include "Log.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Stats.h"
 #include "SGO.h"
 #include "Middleware.h"
 #include "include/tinyxml2.h"
 
-//Read data from SGO
-void SGO::Read( const std::wstring& path )
+//SGO files are written in either byte order, the header says which
+template< typename T > static T ReadSGOValue( bool big_endian, const ByteSpan& buffer, int position )
 {
-	std::ifstream file(path + L".sgo", std::ios::binary | std::ios::ate | std::ios::in);
-
-	std::streamsize size = file.tellg( );
-	file.seekg( 0, std::ios::beg );
+	return big_endian ? ReadBE< T >( buffer, position ) : ReadLE< T >( buffer, position );
+}
 
-	std::vector<char> buffer( size );
-	if( file.read( buffer.data( ), size ) )
+//Read data from SGO
+bool SGO::Read( const std::wstring& path )
+{
+	StageTimer timer( "SGO>XML", StatStage::Read );
+	MappedFile file;
+	if( file.Open( path + L".sgo" ) )
 	{
+		ByteSpan buffer = file.Span( );
+		timer.AddBytes( buffer.size( ) );
+		timer.Next( StatStage::Parse );
 		// create xml
 		tinyxml2::XMLDocument xml;
 		xml.InsertFirstChild(xml.NewDeclaration());
@@ -39,69 +51,74 @@ void SGO::Read( const std::wstring& path )
 
 		ReadData(buffer, xmlMain, xmlHeader);
 		
+		timer.Next( StatStage::Serialize );
 		std::string outfile = WideToUTF8(path) + "_DATA.xml";
-		xml.SaveFile(outfile.c_str());
+		if (xml.SaveFile(outfile.c_str()) != tinyxml2::XML_SUCCESS)
+		{
+			LogError( ) << L"Can't write " << UTF8ToWide(outfile) << L"\n";
+			return false;
+		}
 		/*
 		tinyxml2::XMLPrinter printer;
 		xml.Accept(&printer);
 		auto xmlString = std::string{ printer.CStr() };
 
-		std::wcout << UTF8ToWide(xmlString) + L"\n";
+		LogInfo() << UTF8ToWide(xmlString) + L"\n";
 		*/
 	}
+	else
+	{
+		LogError( ) << L"Can't read " << path << L".sgo\n";
+		return false;
+	}
 
-	//Clear buffers
-	buffer.clear( );
-	file.close( );
+	//Unmap the file
+	file.Close( );
+	return true;
 }
 
-void SGO::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
+void SGO::ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
 {
 	bool big_endian = false;
 	int position = 0;
-	unsigned char seg[4];
-	// read header
-	memcpy(&seg, &buffer[0], 4U);
-	if (seg[0] == 0x53 && seg[1] == 0x47 && seg[2] == 0x4f && seg[3] == 0x00)
+	// read header, "SGO\0"
+	uint32_t magic = ReadLE<uint32_t>(buffer, 0);
+	if (magic == 0x004F4753)
 	{
 		big_endian = false;
 	}
-	else if (seg[3] == 0x53 && seg[2] == 0x47 && seg[1] == 0x4f && seg[0] == 0x00)
+	else if (magic == 0x53474F00)
 	{
 		big_endian = true;
 	}
 	// read version
-	int ver;
 	position = 0x4;
-	Read4BytesData(big_endian, seg, buffer, position);
-	// memcpy is little endian
-	memcpy(&ver, &seg, 4U);
+	int ver = ReadSGOValue<int32_t>(big_endian, buffer, position);
 	if (ver != 258)
-		std::wcout << L"This is not a file for EDF 4.1 or 5!\n";
+		LogError() << L"This is not a file for EDF 4.1 or 5!\n";
 
 	// read count
 	ReadSGOHeader(big_endian, buffer);
-	// read name
-	std::vector< SGONodeName > namenode;
+	// read name, converted once and looked up by node index
+	m_strings.Reset(buffer, big_endian);
+	std::unordered_map< int, const char* > namenode;
 	if (DataNameCount > 0)
 	{
-		namenode.resize(DataNameCount);
+		namenode.reserve(DataNameCount);
 		for (int i = 0; i < DataNameCount; i++)
 		{
 			int nodepos = DataNameOffset + (i * 0x8);
 			int nameoffset;
-			Read4BytesData(big_endian, seg, buffer, nodepos);
-			memcpy(&nameoffset, &seg, 4U);
-			namenode[i].name = ReadUnicode(buffer, nodepos + nameoffset, big_endian);
+			nameoffset = ReadSGOValue<int32_t>(big_endian, buffer, nodepos);
+			int id = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 4);
 
-			Read4BytesData(big_endian, seg, buffer, nodepos + 4);
-			memcpy(&namenode[i].id, &seg, 4U);
+			// first name wins if a node has several
+			namenode.emplace(id, m_strings.Get(nodepos + nameoffset));
 		}
 	}
 	// read data
 	std::vector< SGONode > datanode;
 	datanode.resize(DataNodeCount);
-	std::string utf8str;
 	for (int i = 0; i < DataNodeCount; i++)
 	{
 		int nodepos = DataNodeOffset + (i * 0xC);
@@ -110,71 +127,46 @@ void SGO::ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header
 		ReadSGONode(big_endian, buffer, nodepos, datanode, i, xmlNode, header, xmlHeader);
 		xmlNode->SetAttribute("index", i);
 		// write name
-		for (size_t j = 0; j < namenode.size(); j++)
-		{
-			if (namenode[j].id == i)
-			{
-				utf8str = WideToUTF8(namenode[j].name);
-				xmlNode->SetAttribute("name", utf8str.c_str());
-				break;
-			}
-		}
+		auto name = namenode.find(i);
+		if (name != namenode.end())
+			xmlNode->SetAttribute("name", name->second);
 	}
 }
 
-void SGO::Read4BytesData(bool big_endian, unsigned char *seg, const std::vector<char>& buffer, int position)
+void SGO::ReadSGOHeader( bool big_endian, const ByteSpan& buffer)
 {
-	if (big_endian)
-		Read4Bytes(seg, buffer, position);
-	else
-		Read4BytesReversed(seg, buffer, position);
-}
-
-void SGO::ReadSGOHeader( bool big_endian, const std::vector<char>& buffer)
-{
-	unsigned char seg[4];
 	// read data node count
 	int position = 0x8;
-	Read4BytesData(big_endian, seg, buffer, position);
-	memcpy(&DataNodeCount, &seg, 4U);
+	DataNodeCount = ReadSGOValue<int32_t>(big_endian, buffer, position);
 	// read data node offset
 	position = 0xC;
-	Read4BytesData(big_endian, seg, buffer, position);
-	memcpy(&DataNodeOffset, &seg, 4U);
+	DataNodeOffset = ReadSGOValue<int32_t>(big_endian, buffer, position);
 	// read data name count
 	position = 0x10;
-	Read4BytesData(big_endian, seg, buffer, position);
-	memcpy(&DataNameCount, &seg, 4U);
+	DataNameCount = ReadSGOValue<int32_t>(big_endian, buffer, position);
 	// read data name offset
 	position = 0x14;
-	Read4BytesData(big_endian, seg, buffer, position);
-	memcpy(&DataNameOffset, &seg, 4U);
+	DataNameOffset = ReadSGOValue<int32_t>(big_endian, buffer, position);
 	// read data unknown count
 	position = 0x18;
-	Read4BytesData(big_endian, seg, buffer, position);
-	memcpy(&DataUnkCount, &seg, 4U);
+	DataUnkCount = ReadSGOValue<int32_t>(big_endian, buffer, position);
 	// read data unknown offset
 	position = 0x1C;
-	Read4BytesData(big_endian, seg, buffer, position);
-	memcpy(&DataUnkOffset, &seg, 4U);
+	DataUnkOffset = ReadSGOValue<int32_t>(big_endian, buffer, position);
 }
 
-void SGO::ReadSGONode(bool big_endian, const std::vector<char>& buffer, int nodepos, std::vector<SGONode>& datanode, int i, tinyxml2::XMLElement*& xmlNode, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
+void SGO::ReadSGONode(bool big_endian, const ByteSpan& buffer, int nodepos, std::vector<SGONode>& datanode, int i, tinyxml2::XMLElement*& xmlNode, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader)
 {
 	int type = 0;
-	unsigned char seg[4];
-	Read4BytesData(big_endian, seg, buffer, nodepos);
-	memcpy(&type, &seg, 4U);
+	type = ReadSGOValue<int32_t>(big_endian, buffer, nodepos);
 	datanode[i].type = type;
 	// read value
 	switch (type) {
 	case 0:{
 		//this is an extra data
 		int ptrnum, ptroffset;
-		Read4BytesData(big_endian, seg, buffer, nodepos + 4);
-		memcpy(&ptrnum, &seg, 4U);
-		Read4BytesData(big_endian, seg, buffer, nodepos + 8);
-		memcpy(&ptroffset, &seg, 4U);
+		ptrnum = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 4);
+		ptroffset = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 8);
 
 		std::vector< SGONode > datavnode;
 		datavnode.resize(ptrnum);
@@ -192,16 +184,13 @@ void SGO::ReadSGONode(bool big_endian, const std::vector<char>& buffer, int node
 		break;
 	}
 	case 1:
-		//Read4BytesData(big_endian, seg, buffer, nodepos + 8);
-		//memcpy(&datanode[i].ivalue, &seg, 4U);
-		datanode[i].ivalue = ASMReadInt32(&buffer[nodepos + 8], big_endian);
+		datanode[i].ivalue = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 8);
 
 		xmlNode = header->InsertNewChildElement("int");
 		xmlNode->SetText(datanode[i].ivalue);
 		break;
 	case 2:
-		Read4BytesData(big_endian, seg, buffer, nodepos + 8);
-		memcpy(&datanode[i].fvalue, &seg, 4U);
+		datanode[i].fvalue = ReadSGOValue<float>(big_endian, buffer, nodepos + 8);
 
 		xmlNode = header->InsertNewChildElement("float");
 		xmlNode->SetText(datanode[i].fvalue);
@@ -209,28 +198,18 @@ void SGO::ReadSGONode(bool big_endian, const std::vector<char>& buffer, int node
 	case 3:{
 		//this is a string
 		int strsize, stroffset;
-		Read4BytesData(big_endian, seg, buffer, nodepos + 4);
-		memcpy(&strsize, &seg, 4U);
-		Read4BytesData(big_endian, seg, buffer, nodepos + 8);
-		memcpy(&stroffset, &seg, 4U);
-
-		if (strsize > 0)
-			datanode[i].strvalue = ReadUnicode(buffer, nodepos + stroffset, big_endian);
-		else
-			datanode[i].strvalue = L"";
+		strsize = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 4);
+		stroffset = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 8);
 
-		std::string utf8str = WideToUTF8(datanode[i].strvalue);
 		xmlNode = header->InsertNewChildElement("string");
-		xmlNode->SetText(utf8str.c_str());
+		xmlNode->SetText(strsize > 0 ? m_strings.Get(nodepos + stroffset) : "");
 		break;
 	}
 	case 4:{
 		// this is an extra data file
 		int filesize, fileoffset;
-		Read4BytesData(big_endian, seg, buffer, nodepos + 4);
-		memcpy(&filesize, &seg, 4U);
-		Read4BytesData(big_endian, seg, buffer, nodepos + 8);
-		memcpy(&fileoffset, &seg, 4U);
+		filesize = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 4);
+		fileoffset = ReadSGOValue<int32_t>(big_endian, buffer, nodepos + 8);
 
 		xmlNode = header->InsertNewChildElement("extra");
 
@@ -267,22 +246,32 @@ void SGO::ReadSGONode(bool big_endian, const std::vector<char>& buffer, int node
 	//xmlNode->SetAttribute("debugPos", nodepos);
 }
 
-void SGO::Write(const std::wstring& path, tinyxml2::XMLNode* header)
+bool SGO::Write(const std::wstring& path, tinyxml2::XMLNode* header)
 {
-	std::wcout << "Will output SGO file.\n";
+	LogInfo() << "Will output SGO file.\n";
 
 	tinyxml2::XMLElement* mainData = header->FirstChildElement("Main");
 
+	StageTimer timer("XML>SGO", StatStage::Build);
 	std::vector< char > bytes;
 	bytes = WriteData(mainData, header);
 
 	//Final write.
-	std::ofstream newFile(path + L".sgo", std::ios::binary | std::ios::out | std::ios::ate);
+	timer.Next(StatStage::Write);
+	std::ofstream newFile(ToFilePath(path + L".sgo"), std::ios::binary | std::ios::out | std::ios::ate);
 
 	newFile.write(bytes.data(), bytes.size());
 
 	newFile.close();
-	std::wcout << L"Conversion completed: " + path + L".sgo\n";
+	if (!newFile)
+	{
+		LogError() << L"Can't write " + path + L".sgo\n";
+		return false;
+	}
+	timer.AddBytes(bytes.size());
+	timer.Stop();
+	LogInfo() << L"Conversion completed: " + path + L".sgo\n";
+	return true;
 }
 
 std::vector< char > SGO::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNode* header)
@@ -467,15 +456,15 @@ std::vector< char > SGO::WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XML
 
 	// debug only
 	/*
-	std::wcout << L"String Size: " + ToString(int(NodeString.size())) + L"\n\n";
-
-	std::wcout << L"DataNodeCount: " + ToString(DataNodeCount) + L"\n";
-	std::wcout << L"DataNameCount: " + ToString(DataNameCount) + L"\n";
-	std::wcout << L"nodePtrNum: " + ToString(nodePtrNum) + L"\n";
-	std::wcout << L"Total Data Size: " + ToString(i_NtotalSize) + L"\n";
-	std::wcout << L"Align Data Size: " + ToString(a_nodesize) + L"\n";
-	std::wcout << L"SubDataGroup num: " + ToString(int(SubDataGroup.size())) + L"\n";
-	std::wcout << L"ExtraData num: " + ToString(int(ExtraData.size())) + L"\n";
+	LogDebug() << L"String Size: " + ToString(int(NodeString.size())) + L"\n\n";
+
+	LogDebug() << L"DataNodeCount: " + ToString(DataNodeCount) + L"\n";
+	LogDebug() << L"DataNameCount: " + ToString(DataNameCount) + L"\n";
+	LogDebug() << L"nodePtrNum: " + ToString(nodePtrNum) + L"\n";
+	LogDebug() << L"Total Data Size: " + ToString(i_NtotalSize) + L"\n";
+	LogDebug() << L"Align Data Size: " + ToString(a_nodesize) + L"\n";
+	LogDebug() << L"SubDataGroup num: " + ToString(int(SubDataGroup.size())) + L"\n";
+	LogDebug() << L"ExtraData num: " + ToString(int(ExtraData.size())) + L"\n";
 	*/
 	return bytes;
 }
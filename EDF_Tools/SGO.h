@@ -1,6 +1,7 @@
 #pragma once
 #include <map>
 #include "include/tinyxml2.h"
+#include "StringTable.h"
 
 struct SGONode
 {
@@ -10,7 +11,6 @@ struct SGONode
 	std::vector< SGONode * > ptrvalue;
 	int ivalue;
 	float fvalue;
-	std::wstring strvalue;
 	std::vector< char > data;
 };
 
@@ -31,14 +31,13 @@ struct SGOExtraData
 class SGO
 {
 public:
-	void Read( const std::wstring& path );
-	void ReadData(const std::vector<char>& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
-	void Read4BytesData(bool big_endian, unsigned char* seg, const std::vector<char>& buffer, int position);
-	void ReadSGOHeader(bool big_endian, const std::vector<char>& buffer);
-	void ReadSGONode(bool big_endian, const std::vector<char>& buffer, int nodepos, std::vector<SGONode>& datanode, int i, tinyxml2::XMLElement*& xmlNode, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
+	bool Read( const std::wstring& path );
+	void ReadData(const ByteSpan& buffer, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
+	void ReadSGOHeader(bool big_endian, const ByteSpan& buffer);
+	void ReadSGONode(bool big_endian, const ByteSpan& buffer, int nodepos, std::vector<SGONode>& datanode, int i, tinyxml2::XMLElement*& xmlNode, tinyxml2::XMLElement* header, tinyxml2::XMLElement* xmlHeader);
 
 	// Write
-	void Write(const std::wstring& path, tinyxml2::XMLNode* header);
+	bool Write(const std::wstring& path, tinyxml2::XMLNode* header);
 	std::vector< char > WriteData(tinyxml2::XMLElement* mainData, tinyxml2::XMLNode* header);
 	void GetNodeExtraData(tinyxml2::XMLElement* entry, int& nodePtrNum);
 	SGOExtraData GetExtraData(tinyxml2::XMLElement* entry, std::string dataName, tinyxml2::XMLNode* header);
@@ -49,6 +48,8 @@ private:
 	//std::map< std::wstring, SGONode * > node;
 
 	std::vector< std::string > SubDataGroup;
+	// UTF-16 names and strings of the file being read
+	UTF16StringTable m_strings;
 
 	int DataNodeCount = 0;
 	int DataNodeOffset = 0;
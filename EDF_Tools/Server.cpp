@@ -0,0 +1,443 @@
+#include "stdafx.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+#include <exception>
+#include <cstring>
+#include "util.h"
+#include "Log.h"
+#include "Batch.h"
+#include "Server.h"
+
+#if defined( _WIN32 )
+#include <Windows.h>
+typedef HANDLE ServerHandle;
+#define SERVER_NO_HANDLE INVALID_HANDLE_VALUE
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+typedef int ServerHandle;
+#define SERVER_NO_HANDLE -1
+#endif
+
+//A request longer than this isn't a path, the client is dropped
+#define SERVER_MAX_REQUEST 32768
+//How long a client waits for a pipe instance when every one is busy
+#define SERVER_BUSY_WAIT_MS 2000
+
+#if defined( _WIN32 )
+static std::wstring ServerAddress( const std::wstring& name )
+{
+	return L"\\\\.\\pipe\\" + name;
+}
+#else
+static bool ServerAddress( const std::wstring& name, sockaddr_un& address )
+{
+	std::string path = WideToUTF8( ( std::filesystem::temp_directory_path( ) / ( name + L".sock" ) ).wstring( ) );
+	if( path.size( ) >= sizeof( address.sun_path ) )
+		return false;
+
+	memset( &address, 0, sizeof( address ) );
+	address.sun_family = AF_UNIX;
+	memcpy( address.sun_path, path.c_str( ), path.size( ) + 1 );
+	return true;
+}
+#endif
+
+static ServerHandle ConnectToServer( const std::wstring& name )
+{
+#if defined( _WIN32 )
+	std::wstring address = ServerAddress( name );
+	for( int attempt = 0; attempt < 2; attempt++ )
+	{
+		HANDLE pipe = CreateFileW( address.c_str( ), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL );
+		if( pipe != INVALID_HANDLE_VALUE )
+			return pipe;
+
+		//Every instance is taken until the server opens the next one
+		if( GetLastError( ) != ERROR_PIPE_BUSY || !WaitNamedPipeW( address.c_str( ), SERVER_BUSY_WAIT_MS ) )
+			break;
+	}
+	return INVALID_HANDLE_VALUE;
+#else
+	sockaddr_un address;
+	if( !ServerAddress( name, address ) )
+		return -1;
+
+	int client = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( client < 0 )
+		return -1;
+	if( connect( client, (sockaddr*)&address, sizeof( address ) ) != 0 )
+	{
+		close( client );
+		return -1;
+	}
+	return client;
+#endif
+}
+
+static void CloseConnection( ServerHandle handle )
+{
+#if defined( _WIN32 )
+	CloseHandle( handle );
+#else
+	close( handle );
+#endif
+}
+
+static bool WriteAll( ServerHandle handle, const std::string& text )
+{
+	const char *data = text.data( );
+	size_t size = text.size( );
+	while( size )
+	{
+#if defined( _WIN32 )
+		DWORD written = 0;
+		if( !WriteFile( handle, data, (DWORD)size, &written, NULL ) )
+			return false;
+#else
+#if defined( MSG_NOSIGNAL )
+		//A client that hung up shouldn't take the server down with SIGPIPE
+		ssize_t written = send( handle, data, size, MSG_NOSIGNAL );
+#else
+		ssize_t written = send( handle, data, size, 0 );
+#endif
+		if( written <= 0 )
+			return false;
+#endif
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+//Everything up to the first newline, without it. False if the other side hangs up first.
+static bool ReadLine( ServerHandle handle, std::string& line )
+{
+	line.clear( );
+	char buffer[4096];
+	for( ;; )
+	{
+#if defined( _WIN32 )
+		DWORD read = 0;
+		if( !ReadFile( handle, buffer, sizeof( buffer ), &read, NULL ) || read == 0 )
+			return false;
+#else
+		ssize_t read = recv( handle, buffer, sizeof( buffer ), 0 );
+		if( read <= 0 )
+			return false;
+#endif
+		line.append( buffer, read );
+
+		size_t end = line.find( '\n' );
+		if( end != std::string::npos )
+		{
+			line.resize( end );
+			if( line.size( ) && line.back( ) == '\r' )
+				line.pop_back( );
+			return true;
+		}
+		if( line.size( ) > SERVER_MAX_REQUEST )
+			return false;
+	}
+}
+
+//Waits for clients, a pipe instance per client on Windows, a listening socket elsewhere
+class ServerListener
+{
+public:
+	//False if the name can't be used, or another server already has it
+	bool Open( const std::wstring& name )
+	{
+#if defined( _WIN32 )
+		m_address = ServerAddress( name );
+		m_first = true;
+		return true;
+#else
+		sockaddr_un address;
+		if( !ServerAddress( name, address ) )
+			return false;
+
+		//A socket file nobody answers on is left over from a server that didn't shut down
+		ServerHandle running = ConnectToServer( name );
+		if( running != SERVER_NO_HANDLE )
+		{
+			CloseConnection( running );
+			return false;
+		}
+		unlink( address.sun_path );
+
+		m_socket = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if( m_socket < 0 )
+			return false;
+		if( bind( m_socket, (sockaddr*)&address, sizeof( address ) ) != 0 || listen( m_socket, SOMAXCONN ) != 0 )
+		{
+			close( m_socket );
+			return false;
+		}
+		m_path = address.sun_path;
+		return true;
+#endif
+	}
+
+	//Blocks until a client connects, SERVER_NO_HANDLE if listening failed
+	ServerHandle Accept( )
+	{
+#if defined( _WIN32 )
+		for( ;; )
+		{
+			//The first instance claims the name, so a second server fails here instead of sharing it
+			DWORD mode = PIPE_ACCESS_DUPLEX | ( m_first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0 );
+			HANDLE pipe = CreateNamedPipeW( m_address.c_str( ), mode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+				PIPE_UNLIMITED_INSTANCES, 4096, 4096, 0, NULL );
+			if( pipe == INVALID_HANDLE_VALUE )
+				return SERVER_NO_HANDLE;
+			m_first = false;
+
+			if( ConnectNamedPipe( pipe, NULL ) || GetLastError( ) == ERROR_PIPE_CONNECTED )
+				return pipe;
+			CloseHandle( pipe );
+		}
+#else
+		for( ;; )
+		{
+			int client = accept( m_socket, NULL, NULL );
+			if( client >= 0 || errno != EINTR )
+				return client;
+		}
+#endif
+	}
+
+	void Close( )
+	{
+#if !defined( _WIN32 )
+		close( m_socket );
+		unlink( m_path.c_str( ) );
+#endif
+	}
+
+private:
+#if defined( _WIN32 )
+	std::wstring m_address;
+	bool m_first;
+#else
+	int m_socket;
+	std::string m_path;
+#endif
+};
+
+struct ServerQueue
+{
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque< ServerHandle > clients;
+	bool stopping;
+	bool listening;
+};
+
+//Reads the one request on a connection, converts, answers and hangs up
+static void ServeClient( ServerHandle client, const std::wstring& name, const BatchConverter& convert, ServerQueue& queue )
+{
+	std::string request;
+	if( !ReadLine( client, request ) )
+	{
+		CloseConnection( client );
+		return;
+	}
+
+	std::string reply;
+	if( request == "/STOP" )
+	{
+		reply = "ok 0";
+		{
+			std::lock_guard< std::mutex > lock( queue.lock );
+			queue.stopping = true;
+		}
+		queue.wake.notify_all( );
+
+		//The listener is blocked waiting for a client, become one so it sees the flag.
+		//Nobody can connect in the moment between two pipe instances, so try again until it has stopped.
+		for( int attempt = 0; attempt < 100; attempt++ )
+		{
+			{
+				std::lock_guard< std::mutex > lock( queue.lock );
+				if( !queue.listening )
+					break;
+			}
+
+			ServerHandle wake = ConnectToServer( name );
+			if( wake != SERVER_NO_HANDLE )
+			{
+				CloseConnection( wake );
+				break;
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+	}
+	else
+	{
+		BatchFileResult result;
+		try
+		{
+			//On this thread, the pool is already the parallelism
+			result = RunBatch( { UTF8ToWide( request ) }, convert, 1 ).files[0];
+		}
+		catch( const std::exception& )
+		{
+			result.path = std::wstring( request.begin( ), request.end( ) );
+			result.ok = false;
+			result.ms = 0.0;
+			result.error = L"path isn't valid UTF-8";
+		}
+
+		LogLine( result.ok ? LogLevel::Info : LogLevel::Warning ) << result.path << L": " << ( result.ok ? L"" : L"FAILED, " ) << (long long)result.ms << L" ms\n";
+		Log::Flush( );
+
+		reply = ( result.ok ? "ok " : "failed " ) + JSONNumber( result.ms );
+		if( !result.ok )
+		{
+			std::string error = WideToUTF8( result.error.empty( ) ? L"conversion failed" : result.error );
+			//Keep the answer on one line
+			for( char& c : error )
+			{
+				if( c == '\n' || c == '\r' )
+					c = ' ';
+			}
+			reply += " " + error;
+		}
+	}
+
+	WriteAll( client, reply + "\n" );
+#if defined( _WIN32 )
+	//Let the client read the answer before the pipe goes
+	FlushFileBuffers( client );
+	DisconnectNamedPipe( client );
+#endif
+	CloseConnection( client );
+}
+
+int RunConversionServer( const std::wstring& name, const BatchConverter& convert, int threads )
+{
+	ServerListener listener;
+	if( !listener.Open( name ) )
+	{
+		LogError( ) << L"Can't serve as " << name << L", is another server running?\n";
+		return 1;
+	}
+
+	if( threads <= 0 )
+		threads = std::thread::hardware_concurrency( );
+	if( threads <= 0 )
+		threads = 1;
+
+	ServerQueue queue;
+	queue.stopping = false;
+	queue.listening = true;
+
+	auto worker = [&]( )
+	{
+		for( ;; )
+		{
+			ServerHandle client;
+			{
+				std::unique_lock< std::mutex > lock( queue.lock );
+				queue.wake.wait( lock, [&]( ) { return queue.stopping || !queue.clients.empty( ); } );
+				//Clients that got in before the stop are still answered
+				if( queue.clients.empty( ) )
+					return;
+				client = queue.clients.front( );
+				queue.clients.pop_front( );
+			}
+			ServeClient( client, name, convert, queue );
+		}
+	};
+
+	std::vector< std::thread > pool;
+	for( int i = 0; i < threads; ++i )
+		pool.push_back( std::thread( worker ) );
+
+	LogInfo( ) << L"Serving as " << name << L" on " << threads << L" threads\n";
+	Log::Flush( );
+
+	for( ;; )
+	{
+		ServerHandle client = listener.Accept( );
+		if( client == SERVER_NO_HANDLE )
+		{
+			LogError( ) << L"Stopped listening for clients\n";
+			break;
+		}
+
+		std::lock_guard< std::mutex > lock( queue.lock );
+		if( queue.stopping )
+		{
+			CloseConnection( client );
+			break;
+		}
+		queue.clients.push_back( client );
+		queue.wake.notify_one( );
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( queue.lock );
+		queue.stopping = true;
+		queue.listening = false;
+	}
+	queue.wake.notify_all( );
+	for( size_t i = 0; i < pool.size( ); ++i )
+		pool[i].join( );
+	listener.Close( );
+
+	LogInfo( ) << L"Server stopped\n";
+	return 0;
+}
+
+//Sends one request and waits for the answer
+static bool SendRequest( const std::wstring& name, const std::string& request, std::string& reply )
+{
+	ServerHandle server = ConnectToServer( name );
+	if( server == SERVER_NO_HANDLE )
+		return false;
+
+	bool answered = WriteAll( server, request + "\n" ) && ReadLine( server, reply );
+	CloseConnection( server );
+	return answered;
+}
+
+int SendConversionRequests( const std::wstring& name, const std::vector< std::wstring >& paths )
+{
+	int failed = 0;
+	for( size_t i = 0; i < paths.size( ); ++i )
+	{
+		std::error_code error;
+		std::filesystem::path path = std::filesystem::absolute( paths[i], error );
+		std::wstring fullPath = error ? paths[i] : path.wstring( );
+
+		std::string reply;
+		if( !SendRequest( name, WideToUTF8( fullPath ), reply ) )
+		{
+			LogError( ) << L"No server answered as " << name << L"\n";
+			return -1;
+		}
+
+		bool ok = !reply.compare( 0, 3, "ok " );
+		if( !ok )
+			++failed;
+		LogLine( ok ? LogLevel::Info : LogLevel::Warning ) << fullPath << L": " << UTF8ToWide( reply ) << L"\n";
+	}
+	return failed;
+}
+
+bool StopConversionServer( const std::wstring& name )
+{
+	std::string reply;
+	return SendRequest( name, "/STOP", reply );
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Batch.h"
+
+//Pipe name on Windows, socket file name in the temp folder elsewhere
+#define SERVER_DEFAULT_NAME L"edf-tools"
+
+//Keeps one process, and with it the command tables and other per process caches, running between conversions.
+//Clients connect to a named pipe on Windows or a Unix socket elsewhere. Each connection carries one request, a UTF-8
+//path ending in a newline, answered with "ok <ms>" or "failed <ms> <error>" before the server hangs up.
+//Connections are served by a pool of threads that lives as long as the server, threads <= 0 uses one per core.
+//Returns once a client sends "/STOP" and the conversions already running have finished.
+int RunConversionServer( const std::wstring& name, const BatchConverter& convert, int threads = 0 );
+
+//Sends paths to a running server one at a time and logs the answers. Relative paths are made absolute first,
+//the server may be running in another folder. Returns how many failed, or -1 if no server could be reached.
+int SendConversionRequests( const std::wstring& name, const std::vector< std::wstring >& paths );
+//False if no server could be reached
+bool StopConversionServer( const std::wstring& name );
@@ -0,0 +1,133 @@
+#include "stdafx.h"
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include "util.h"
+#include "Log.h"
+#include "Stats.h"
+
+#if defined( _WIN32 )
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment( lib, "psapi.lib" )
+#else
+#include <sys/resource.h>
+#endif
+
+struct StageTotals
+{
+	uint64_t calls;
+	uint64_t bytes;
+	double ms;
+};
+
+static const char *s_stageNames[(int)StatStage::Count] = { "read", "parse", "build", "serialize", "compress", "decompress", "write" };
+
+struct FormatTotals
+{
+	StageTotals stages[(int)StatStage::Count];
+};
+
+static std::mutex s_statsLock;
+//Sorted by name for the report
+static std::map< std::string, FormatTotals > s_totals;
+
+bool Stats::enabled = false;
+
+void Stats::Add( const char *conversion, StatStage stage, double ms, uint64_t bytes )
+{
+	std::lock_guard< std::mutex > lock( s_statsLock );
+
+	//New entries are value initialised, so they start at 0
+	StageTotals& totals = s_totals[conversion].stages[(int)stage];
+	totals.calls++;
+	totals.bytes += bytes;
+	totals.ms += ms;
+}
+
+void Stats::Reset( )
+{
+	std::lock_guard< std::mutex > lock( s_statsLock );
+	s_totals.clear( );
+}
+
+uint64_t Stats::PeakMemory( )
+{
+#if defined( _WIN32 )
+	PROCESS_MEMORY_COUNTERS counters;
+	if( GetProcessMemoryInfo( GetCurrentProcess( ), &counters, sizeof( counters ) ) )
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+		return 0;
+#if defined( __APPLE__ )
+	return (uint64_t)usage.ru_maxrss;
+#else
+	//Linux gives kilobytes
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void Stats::PrintTable( )
+{
+	std::lock_guard< std::mutex > lock( s_statsLock );
+
+	char line[128];
+	snprintf( line, sizeof( line ), "%-10s %-11s %8s %12s %10s %10s\n", "Conversion", "Stage", "Calls", "Total ms", "Avg ms", "MB/s" );
+	LogInfo( ) << line;
+
+	for( auto& conversion : s_totals )
+	{
+		for( int stage = 0; stage < (int)StatStage::Count; stage++ )
+		{
+			const StageTotals& totals = conversion.second.stages[stage];
+			if( !totals.calls )
+				continue;
+
+			snprintf( line, sizeof( line ), "%-10s %-11s %8llu %12.3f %10.3f %10.2f\n", conversion.first.c_str( ), s_stageNames[stage],
+				(unsigned long long)totals.calls, totals.ms, totals.ms / totals.calls, MegabytesPerSecond( totals.bytes, totals.ms ) );
+			LogInfo( ) << line;
+		}
+	}
+
+	snprintf( line, sizeof( line ), "Peak memory: %.1f MB\n", PeakMemory( ) / 1048576.0 );
+	LogInfo( ) << line;
+}
+
+std::string Stats::ToJSON( )
+{
+	std::lock_guard< std::mutex > lock( s_statsLock );
+
+	std::string out = "{\n";
+	out += "\t\"peak_memory_bytes\": " + std::to_string( PeakMemory( ) ) + ",\n";
+
+	out += "\t\"stages\": [";
+	bool first = true;
+	for( auto& conversion : s_totals )
+	{
+		for( int stage = 0; stage < (int)StatStage::Count; stage++ )
+		{
+			const StageTotals& totals = conversion.second.stages[stage];
+			if( !totals.calls )
+				continue;
+
+			out += first ? "\n\t\t" : ",\n\t\t";
+			out += "{ \"conversion\": " + JSONString( UTF8ToWide( conversion.first ) );
+			out += ", \"stage\": \"" + std::string( s_stageNames[stage] ) + "\"";
+			out += ", \"calls\": " + std::to_string( totals.calls );
+			out += ", \"bytes\": " + std::to_string( totals.bytes );
+			out += ", \"ms\": " + JSONNumber( totals.ms );
+			out += ", \"mb_per_second\": " + JSONNumber( MegabytesPerSecond( totals.bytes, totals.ms ) ) + " }";
+			first = false;
+		}
+	}
+	out += "\n\t]\n}\n";
+
+	return out;
+}
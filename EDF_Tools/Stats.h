@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <chrono>
+
+//Define EDF_NO_STATS to compile the stage timers out entirely
+
+//Stages of one conversion. Readers decode and build their XML tree in a single pass, which counts as Parse.
+enum class StatStage
+{
+	Read, //Input bytes in
+	Parse, //Binary or XML text decoded
+	Build, //Output put together, the binary for writers
+	Serialize, //XML tree to text
+	Compress,
+	Decompress,
+	Write, //Output bytes out
+	Count
+};
+
+//Totals per conversion ("CAS>XML", "XML>CAS"...) and stage, from every thread
+class Stats
+{
+public:
+	//Set by --stats, nothing is recorded while it is off
+	static bool enabled;
+
+	static void Add( const char *conversion, StatStage stage, double ms, uint64_t bytes );
+	static void Reset( );
+
+	//Most memory the process has had resident so far, in bytes. 0 if the system won't say.
+	static uint64_t PeakMemory( );
+
+	//Calls, time and throughput of each stage, then the peak memory
+	static void PrintTable( );
+	static std::string ToJSON( );
+};
+
+//Times the stages of one conversion one after another. Next ends the current stage and starts the given one,
+//the last stage ends with the timer.
+class StageTimer
+{
+#if !defined( EDF_NO_STATS )
+public:
+	StageTimer( const char *conversion, StatStage stage ) : m_conversion( conversion ), m_stage( stage ), m_bytes( 0 ), m_running( false ) { Start( stage ); };
+	~StageTimer( ) { Stop( ); }
+
+	void Next( StatStage stage )
+	{
+		Stop( );
+		Start( stage );
+	}
+
+	//Bytes the current stage got through, for the throughput column
+	void AddBytes( uint64_t bytes ) { m_bytes += bytes; }
+
+	void Stop( )
+	{
+		if( !m_running )
+			return;
+
+		double ms = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now( ) - m_start ).count( );
+		Stats::Add( m_conversion, m_stage, ms, m_bytes );
+		m_running = false;
+	}
+
+private:
+	void Start( StatStage stage )
+	{
+		m_stage = stage;
+		m_bytes = 0;
+		m_running = Stats::enabled;
+		if( m_running )
+			m_start = std::chrono::steady_clock::now( );
+	}
+
+	const char *m_conversion;
+	StatStage m_stage;
+	uint64_t m_bytes;
+	bool m_running;
+	std::chrono::steady_clock::time_point m_start;
+#else
+public:
+	StageTimer( const char*, StatStage ){};
+	void Next( StatStage ){};
+	void AddBytes( uint64_t ){};
+	void Stop( ){};
+#endif
+};
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <unordered_map>
+#include "ByteStream.h"
+#include "Unicode.h"
+#include "StringTable.h"
+
+#if defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) || defined( __SSE2__ )
+#define STRINGTABLE_SSE2
+#include <emmintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#endif
+
+//Strings share blocks of this size, longer ones get a block to themselves
+#define STRINGTABLE_BLOCK_SIZE 0x10000
+
+#if defined( STRINGTABLE_SSE2 )
+static inline unsigned int LowestBit( unsigned int mask )
+{
+#if defined( _MSC_VER )
+	unsigned long index;
+	_BitScanForward( &index, mask );
+	return index;
+#else
+	return __builtin_ctz( mask );
+#endif
+}
+#endif
+
+size_t UTF16Length( const ByteSpan& buffer, size_t pos )
+{
+	if( pos >= buffer.size( ) )
+		return 0;
+
+	const char *units = buffer.data( ) + pos;
+	size_t count = ( buffer.size( ) - pos ) / 2;
+	size_t i = 0;
+
+#if defined( STRINGTABLE_SSE2 )
+	//8 units at a time, a 0 unit is 0 in either byte order
+	const __m128i zero = _mm_setzero_si128( );
+	for( ; i + 8 <= count; i += 8 )
+	{
+		__m128i v = _mm_loadu_si128( (const __m128i*)( units + i * 2 ) );
+		unsigned int mask = _mm_movemask_epi8( _mm_cmpeq_epi16( v, zero ) );
+		if( mask )
+			return i + LowestBit( mask ) / 2;
+	}
+#endif
+
+	for( ; i < count; i++ )
+	{
+		if( units[i * 2] == 0 && units[i * 2 + 1] == 0 )
+			return i;
+	}
+	return count;
+}
+
+void AppendUTF16AsUTF8( std::string& out, const ByteSpan& buffer, size_t pos, bool bigEndian )
+{
+	size_t count = UTF16Length( buffer, pos );
+	if( !count )
+		return;
+
+	size_t start = out.size( );
+	out.resize( start + count * 3 );
+	size_t written = UTF16ToUTF8( &out[start], buffer.data( ) + pos, count, bigEndian );
+	out.resize( start + written );
+}
+
+void UTF16StringTable::Reset( const ByteSpan& buffer, bool bigEndian )
+{
+	m_buffer = buffer;
+	m_bigEndian = bigEndian;
+	m_cache.clear( );
+
+	//Keep the current block for the next file
+	if( m_blocks.size( ) > 1 )
+	{
+		std::unique_ptr< char[] > last = std::move( m_blocks.back( ) );
+		m_blocks.clear( );
+		m_blocks.push_back( std::move( last ) );
+	}
+	m_used = 0;
+}
+
+char *UTF16StringTable::Allocate( size_t size )
+{
+	if( size > STRINGTABLE_BLOCK_SIZE / 4 )
+	{
+		//Goes in front of the current block so that one keeps filling up
+		std::unique_ptr< char[] > block( new char[size] );
+		char *str = block.get( );
+		m_blocks.insert( m_blocks.empty( ) ? m_blocks.end( ) : m_blocks.end( ) - 1, std::move( block ) );
+		return str;
+	}
+
+	if( m_blocks.empty( ) || size > m_capacity - m_used )
+	{
+		m_blocks.emplace_back( new char[STRINGTABLE_BLOCK_SIZE] );
+		m_capacity = STRINGTABLE_BLOCK_SIZE;
+		m_used = 0;
+	}
+
+	char *str = m_blocks.back( ).get( ) + m_used;
+	m_used += size;
+	return str;
+}
+
+const char *UTF16StringTable::Get( size_t pos )
+{
+	if( pos >= m_buffer.size( ) )
+		return "";
+
+	auto it = m_cache.find( pos );
+	if( it != m_cache.end( ) )
+		return it->second;
+
+	size_t count = UTF16Length( m_buffer, pos );
+	size_t size = count * 3 + 1;
+	char *str = Allocate( size );
+	size_t length = UTF16ToUTF8( str, m_buffer.data( ) + pos, count, m_bigEndian );
+	str[length] = 0;
+
+	//Give back what the worst case reserved but the string didn't use
+	if( m_capacity && m_blocks.back( ).get( ) + m_used == str + size )
+		m_used -= size - ( length + 1 );
+
+	m_cache.emplace( pos, str );
+	return str;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <unordered_map>
+#include "ByteStream.h"
+#include "Unicode.h"
+
+//Number of UTF-16 units from pos up to the 0 terminator, or to the end of the buffer if there is none.
+//Units are aligned to pos, so the low byte of one and the high byte of the next never make a false terminator.
+size_t UTF16Length( const ByteSpan& buffer, size_t pos );
+
+//Appends a 0 terminated UTF-16 string at pos to out as UTF-8
+void AppendUTF16AsUTF8( std::string& out, const ByteSpan& buffer, size_t pos, bool bigEndian = false );
+
+//UTF-16 strings of one file read as UTF-8, for the name tables the readers look up over and over.
+//Each offset is converted once into an arena owned by the table, so pointers stay valid until Reset or destruction.
+//The bytes it reads have to outlive the table, it keeps a view of them and not a copy.
+class UTF16StringTable
+{
+public:
+	UTF16StringTable( ) : m_bigEndian( false ), m_used( 0 ), m_capacity( 0 ){};
+	UTF16StringTable( const ByteSpan& buffer, bool bigEndian = false ) : UTF16StringTable( ) { Reset( buffer, bigEndian ); };
+
+	//Points the table at another buffer and drops every cached string
+	void Reset( const ByteSpan& buffer, bool bigEndian = false );
+
+	//0 terminated UTF-8 string at pos, "" if pos is past the end of the buffer
+	const char *Get( size_t pos );
+
+	size_t GetNumStrings( ) const { return m_cache.size( ); }
+
+private:
+	char *Allocate( size_t size );
+
+	ByteSpan m_buffer;
+	bool m_bigEndian;
+
+	std::unordered_map< size_t, const char* > m_cache;
+
+	//Strings are packed into blocks, the last one is filled up to m_used
+	std::vector< std::unique_ptr< char[] > > m_blocks;
+	size_t m_used;
+	size_t m_capacity;
+};
@@ -0,0 +1,286 @@
+#include "stdafx.h"
+
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include "ByteStream.h"
+#include "Unicode.h"
+
+#if defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) || defined( __SSE2__ )
+#define UNICODE_SSE2
+#include <emmintrin.h>
+#endif
+
+static void InvalidUnicode( )
+{
+	throw std::range_error( "Invalid UTF-8 or UTF-16 sequence" );
+}
+
+//Code point to UTF-8, c is already known to be a scalar value
+static inline char *PutUTF8( char *out, uint32_t c )
+{
+	if( c < 0x80 )
+	{
+		*out++ = (char)c;
+	}
+	else if( c < 0x800 )
+	{
+		*out++ = (char)( 0xC0 | ( c >> 6 ) );
+		*out++ = (char)( 0x80 | ( c & 0x3F ) );
+	}
+	else if( c < 0x10000 )
+	{
+		*out++ = (char)( 0xE0 | ( c >> 12 ) );
+		*out++ = (char)( 0x80 | ( ( c >> 6 ) & 0x3F ) );
+		*out++ = (char)( 0x80 | ( c & 0x3F ) );
+	}
+	else
+	{
+		*out++ = (char)( 0xF0 | ( c >> 18 ) );
+		*out++ = (char)( 0x80 | ( ( c >> 12 ) & 0x3F ) );
+		*out++ = (char)( 0x80 | ( ( c >> 6 ) & 0x3F ) );
+		*out++ = (char)( 0x80 | ( c & 0x3F ) );
+	}
+	return out;
+}
+
+//STRICT throws on unpaired surrogates instead of writing U+FFFD
+template< Endian E, bool STRICT >
+static size_t ConvertUTF16ToUTF8( char *out, const char *units, size_t count )
+{
+	char *start = out;
+	size_t i = 0;
+
+	while( i < count )
+	{
+#if defined( UNICODE_SSE2 )
+		//Names are mostly ASCII, narrow 8 units at once while they all are
+		const __m128i notASCII = _mm_set1_epi16( (short)0xFF80 );
+		const __m128i zero = _mm_setzero_si128( );
+		while( i + 8 <= count )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( units + i * 2 ) );
+			if( E != Endian::Native )
+				v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+			if( _mm_movemask_epi8( _mm_cmpeq_epi16( _mm_and_si128( v, notASCII ), zero ) ) != 0xFFFF )
+				break;
+
+			_mm_storel_epi64( (__m128i*)out, _mm_packus_epi16( v, v ) );
+			out += 8;
+			i += 8;
+		}
+		if( i >= count )
+			break;
+#endif
+
+		uint32_t c = ByteOrder::Load< E, uint16_t >( units + i * 2 );
+		i++;
+
+		if( c >= 0xD800 && c < 0xE000 )
+		{
+			uint32_t low = i < count ? ByteOrder::Load< E, uint16_t >( units + i * 2 ) : 0;
+			if( c < 0xDC00 && low >= 0xDC00 && low < 0xE000 )
+			{
+				c = 0x10000 + ( ( c - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+				i++;
+			}
+			else if( STRICT )
+				InvalidUnicode( );
+			else
+				c = 0xFFFD;
+		}
+
+		out = PutUTF8( out, c );
+	}
+
+	return out - start;
+}
+
+size_t UTF16ToUTF8( char *out, const char *units, size_t count, bool bigEndian )
+{
+	if( bigEndian )
+		return ConvertUTF16ToUTF8< Endian::Big, false >( out, units, count );
+	return ConvertUTF16ToUTF8< Endian::Little, false >( out, units, count );
+}
+
+template< Endian E >
+static size_t ConvertWideToUTF16( char *out, const wchar_t *source, size_t count )
+{
+	char *start = out;
+	for( size_t i = 0; i < count; i++ )
+	{
+		//Only a 32 bit wchar_t gets here with more than 16 bits, Windows strings carry the pair already
+		uint32_t c = (uint32_t)source[i];
+		if( c > 0xFFFF )
+		{
+			c -= 0x10000;
+			ByteOrder::Store< E, uint16_t >( out, (uint16_t)( 0xD800 + ( c >> 10 ) ) );
+			out += 2;
+			c = 0xDC00 + ( c & 0x3FF );
+		}
+		ByteOrder::Store< E, uint16_t >( out, (uint16_t)c );
+		out += 2;
+	}
+	return out - start;
+}
+
+size_t WideToUTF16( char *out, const wchar_t *source, size_t count, bool bigEndian )
+{
+	if( bigEndian )
+		return ConvertWideToUTF16< Endian::Big >( out, source, count );
+	return ConvertWideToUTF16< Endian::Little >( out, source, count );
+}
+
+//wchar_t outside of Windows, one code point per unit
+static size_t ConvertUTF32ToUTF8( char *out, const wchar_t *units, size_t count )
+{
+	char *start = out;
+	size_t i = 0;
+
+	while( i < count )
+	{
+#if defined( UNICODE_SSE2 )
+		const __m128i notASCII = _mm_set1_epi32( (int)0xFFFFFF80 );
+		const __m128i zero = _mm_setzero_si128( );
+		while( i + 4 <= count )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( units + i ) );
+			if( _mm_movemask_epi8( _mm_cmpeq_epi32( _mm_and_si128( v, notASCII ), zero ) ) != 0xFFFF )
+				break;
+
+			__m128i narrow = _mm_packus_epi16( _mm_packs_epi32( v, v ), zero );
+			int bytes = _mm_cvtsi128_si32( narrow );
+			memcpy( out, &bytes, 4 );
+			out += 4;
+			i += 4;
+		}
+		if( i >= count )
+			break;
+#endif
+
+		uint32_t c = (uint32_t)units[i++];
+		if( c > 0x10FFFF || ( c >= 0xD800 && c < 0xE000 ) )
+			InvalidUnicode( );
+
+		out = PutUTF8( out, c );
+	}
+
+	return out - start;
+}
+
+void WideToUTF8( const wchar_t *source, size_t size, std::string& out )
+{
+	//Worst case is 3 bytes per UTF-16 unit or 4 per code point
+	out.resize( size * ( sizeof( wchar_t ) == 2 ? 3 : 4 ) );
+
+	size_t written;
+	if( sizeof( wchar_t ) == 2 )
+		written = ConvertUTF16ToUTF8< Endian::Native, true >( &out[0], (const char*)source, size );
+	else
+		written = ConvertUTF32ToUTF8( &out[0], source, size );
+
+	out.resize( written );
+}
+
+void UTF8ToWide( const char *source, size_t size, std::wstring& out )
+{
+	//Every sequence gives at most as many units as it has bytes
+	out.resize( size );
+
+	const unsigned char *bytes = (const unsigned char*)source;
+	wchar_t *units = &out[0];
+	wchar_t *start = units;
+	size_t i = 0;
+
+	while( i < size )
+	{
+#if defined( UNICODE_SSE2 )
+		//Widen 16 ASCII bytes at once
+		const __m128i zero = _mm_setzero_si128( );
+		while( i + 16 <= size )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( bytes + i ) );
+			if( _mm_movemask_epi8( v ) )
+				break;
+
+			__m128i lo = _mm_unpacklo_epi8( v, zero );
+			__m128i hi = _mm_unpackhi_epi8( v, zero );
+			if( sizeof( wchar_t ) == 2 )
+			{
+				_mm_storeu_si128( (__m128i*)units, lo );
+				_mm_storeu_si128( (__m128i*)( units + 8 ), hi );
+			}
+			else
+			{
+				_mm_storeu_si128( (__m128i*)units, _mm_unpacklo_epi16( lo, zero ) );
+				_mm_storeu_si128( (__m128i*)( units + 4 ), _mm_unpackhi_epi16( lo, zero ) );
+				_mm_storeu_si128( (__m128i*)( units + 8 ), _mm_unpacklo_epi16( hi, zero ) );
+				_mm_storeu_si128( (__m128i*)( units + 12 ), _mm_unpackhi_epi16( hi, zero ) );
+			}
+			units += 16;
+			i += 16;
+		}
+		if( i >= size )
+			break;
+#endif
+
+		uint32_t c = bytes[i];
+		if( c < 0x80 )
+		{
+			*units++ = (wchar_t)c;
+			i++;
+			continue;
+		}
+
+		size_t length;
+		uint32_t min;
+		if( ( c & 0xE0 ) == 0xC0 )
+		{
+			length = 1;
+			min = 0x80;
+			c &= 0x1F;
+		}
+		else if( ( c & 0xF0 ) == 0xE0 )
+		{
+			length = 2;
+			min = 0x800;
+			c &= 0x0F;
+		}
+		else if( ( c & 0xF8 ) == 0xF0 )
+		{
+			length = 3;
+			min = 0x10000;
+			c &= 0x07;
+		}
+		else
+		{
+			InvalidUnicode( );
+			return;
+		}
+
+		if( length >= size - i )
+			InvalidUnicode( );
+		for( size_t j = 1; j <= length; j++ )
+		{
+			uint32_t next = bytes[i + j];
+			if( ( next & 0xC0 ) != 0x80 )
+				InvalidUnicode( );
+			c = ( c << 6 ) | ( next & 0x3F );
+		}
+		//Overlong forms, surrogates and anything past U+10FFFF
+		if( c < min || c > 0x10FFFF || ( c >= 0xD800 && c < 0xE000 ) )
+			InvalidUnicode( );
+		i += length + 1;
+
+		if( sizeof( wchar_t ) == 2 && c >= 0x10000 )
+		{
+			c -= 0x10000;
+			*units++ = (wchar_t)( 0xD800 + ( c >> 10 ) );
+			*units++ = (wchar_t)( 0xDC00 + ( c & 0x3FF ) );
+		}
+		else
+			*units++ = (wchar_t)c;
+	}
+
+	out.resize( units - start );
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+//Converts count UTF-16 units to UTF-8. out needs room for 3 bytes per unit, returns the bytes written.
+//Unpaired surrogates become U+FFFD, for names read out of files.
+size_t UTF16ToUTF8( char *out, const char *units, size_t count, bool bigEndian = false );
+//Converts count wchar_t units to UTF-16, returns the bytes written. out needs room for 4 bytes per unit.
+//Code points past the BMP in a 32 bit wchar_t become surrogate pairs.
+size_t WideToUTF16( char *out, const wchar_t *source, size_t count, bool bigEndian = false );
+
+//Validating conversions between UTF-8 and wchar_t strings (UTF-16 on Windows, UTF-32 elsewhere).
+//out is overwritten but keeps its capacity, so a buffer reused across calls stops allocating.
+//Invalid input throws std::range_error like std::wstring_convert did, out is left partly written.
+void UTF8ToWide( const char *source, size_t size, std::wstring& out );
+void WideToUTF8( const wchar_t *source, size_t size, std::string& out );
@@ -1,12 +1,14 @@
 #include "stdafx.h"
 
 #include <iostream>
-#include <stack>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
 #include "VMState.h"
+#include "Log.h"
 
 VMState::StaticVariable::StaticVariable(uint64_t value, bool initialized, const std::wstring& name)
 {
@@ -15,29 +17,40 @@ VMState::StaticVariable::StaticVariable(uint64_t value, bool initialized, const
     this->name = std::wstring(name);
 }
 
-VMState::VMState(std::vector<std::wstring>& variable_names)
+VMState::VMState(std::vector<std::wstring>& variable_names, size_t stack_capacity)
 {
     for (int i = 0; i < variable_names.size(); ++i)
     {
         static_RAS.push_back(StaticVariable(0xCDCDCDCDCDCDCDCD, false, variable_names[i]));
     }
-    relative_RAS.reserve(1024);
+    relative_RAS.resize(1024);
     relative_RAS_start = variable_names.size();
-    relative_RAS_idx = relative_RAS_start;
+    relative_RAS_idx = relative_RAS_start + relative_RAS.size();
+    string_base = 0;
+
+    stack.resize(stack_capacity);
+    stack_size = 0;
+
+    instructions_executed = 0;
+    instruction_limit = 0;
+    fault_instruction = 0;
+    profile = nullptr;
+    host = nullptr;
 }
 
 void VMState::printstatics() const
 {
     for (int i = 0; i < static_RAS.size(); ++i)
     {
-        printf("%ls", static_RAS[i].name.c_str());
+        LogLine line = LogInfo();
+        line << static_RAS[i].name;
         if (static_RAS[i].initialized)
         {
-            printf(" = %d;\n", static_RAS[i].value);
+            line << L" = " << static_RAS[i].value << L";\n";
         }
         else
         {
-            printf(";\n");
+            line << L";\n";
         }
     }
 }
@@ -59,480 +72,661 @@ std::wstring& VMState::printstatics(std::wstring& buf) const
     return buf;
 }
 
-void VMState::interpret(unsigned char *code_p)
+
+// Operand size from the top two bits of an opcode
+static size_t operand_size(int sizeflags)
 {
-    while (true)
+    switch (sizeflags)
     {
-        int sizeflags = *code_p & 0xC0;
-        int op = *code_p & 0x3F;
-        ++code_p;
+        case 0x40:
+            return 1;
+        case 0x80:
+            return 2;
+        case 0xC0:
+            return 4;
+        default:
+            return 0;
+    }
+}
 
-        switch (op)
+static int32_t read_sign(const unsigned char *data_p, size_t size)
+{
+    switch (size)
+    {
+        case 1:
+            return (int8_t)data_p[0];
+        case 2:
+            return (int16_t)(data_p[0] | (data_p[1] << 8));
+        case 4:
         {
-            case 0x00: // No Operation
-                break;
-            case 0x01: // Convert type of operand and store on RAS
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int32_t value = stack.top(); stack.pop();
-                int32_t RAS_idx = stack.top(); stack.pop();
-                stack.push(value);
-                int typeflags = *code_p;
-                ++code_p;
-
-                switch (typeflags)
-                {
-                    case 0b00: // int to int
-                    case 0b11: // float to float
-                        if (RAS_idx >= relative_RAS_start)
-                            relative_RAS[RAS_idx] = value;
-                        else
-                        {
-                            static_RAS[RAS_idx].value = value;
-                            static_RAS[RAS_idx].initialized = true;
-                        }
-                        break;
-                    case 0b01: // float to int
-                    {
-                        float f;
-                        memcpy(&f, &value, sizeof(float));
-                        int i = f;
-                        if (RAS_idx >= relative_RAS_start)
-                            relative_RAS[RAS_idx] = i;
-                        else
-                        {
-                            static_RAS[RAS_idx].value = i;
-                            static_RAS[RAS_idx].initialized = true;
-                        }
-                        break;
-                    }
-                    case 0b10: // int to float
-                    {
-                        float f = value;
-                        int i;
-                        memcpy(&i, &f, sizeof(float));
-                        if (RAS_idx >= relative_RAS_start)
-                            relative_RAS[RAS_idx] = i;
-                        else
-                        {
-                            static_RAS[RAS_idx].value = i;
-                            static_RAS[RAS_idx].initialized = true;
-                        }
-                        break;
-                    }
-                    default:
-                        throw BVM_unimplemented_exception();
-                }
-                break;
-            }
-            case 0x02: // Pop element off stack
-                stack.pop();
-                break;
-            case 0x03: // Copy element to stack
-            {
-                if (!stack.size()) throw BVM_stack_exception();
-                int value = stack.top();
-                stack.push(value);
-                break;
-            }
-            case 0x04: // Add two elements
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int lhs = stack.top(); stack.pop();
-                int rhs = stack.top(); stack.pop();
-                int result;
-                float lhs_f;
-                float rhs_f;
-                float result_f;
-                int typeflags = *code_p;
-                ++code_p;
-
-                switch (typeflags)
-                {
-                    case 0b00: // int + int
-                        result = lhs + rhs;
-                        break;
-                    case 0b01: // int + float
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs + rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b10: // float + int
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        result_f = lhs_f + rhs;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b11: // float + float
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs_f + rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    default:
-                        throw BVM_unimplemented_exception();
-                }
-                stack.push(result);
-                break;
-            }
-            case 0x05: // Subtract two elements
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int lhs = stack.top(); stack.pop();
-                int rhs = stack.top(); stack.pop();
-                int result;
-                float lhs_f;
-                float rhs_f;
-                float result_f;
-                int typeflags = *code_p;
-                ++code_p;
-
-                switch (typeflags)
-                {
-                    case 0b00: // int - int
-                        result = lhs - rhs;
-                        break;
-                    case 0b01: // int - float
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs - rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b10: // float - int
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        result_f = lhs_f + rhs;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b11: // float - float
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs_f + rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    default:
-                        throw BVM_unimplemented_exception();
-                }
-                stack.push(result);
-                break;
-            }
-            case 0x06: // Multiply two elements
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int lhs = stack.top(); stack.pop();
-                int rhs = stack.top(); stack.pop();
-                int result;
-                float lhs_f;
-                float rhs_f;
-                float result_f;
-                int typeflags = *code_p;
-                ++code_p;
-
-                switch (typeflags)
-                {
-                    case 0b00: // int * int
-                        result = lhs * rhs;
-                        break;
-                    case 0b01: // int * float
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs * rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b10: // float * int
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        result_f = lhs_f * rhs;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b11: // float * float
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs_f * rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    default:
-                        throw BVM_unimplemented_exception();
-                }
-                stack.push(result);
-                break;
-            }
-            case 0x07: // Divide two elements
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int lhs = stack.top(); stack.pop();
-                int rhs = stack.top(); stack.pop();
-                int result;
-                float lhs_f;
-                float rhs_f;
-                float result_f;
-                int typeflags = *code_p;
-                ++code_p;
-
-                switch (typeflags)
-                {
-                    case 0b00: // int / int
-                        result = lhs / rhs;
-                        break;
-                    case 0b01: // int / float
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs / rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b10: // float / int
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        result_f = lhs_f / rhs;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    case 0b11: // float / float
-                        memcpy(&lhs_f, &lhs, sizeof(float));
-                        memcpy(&rhs_f, &rhs, sizeof(float));
-                        result_f = lhs_f / rhs_f;
-                        memcpy(&result, &result_f, sizeof(float));
-                        break;
-                    default:
-                        throw BVM_unimplemented_exception();
-                }
-                stack.push(result);
-                break;
-            }
-            case 0x08: // Modulo two elements
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int lhs = stack.top(); stack.pop();
-                int rhs = stack.top(); stack.pop();
-                stack.push(lhs % rhs);
-                break;
-            }
-            case 0x09: // Bitwise Negation of top stack element
-            {
-                if (!stack.size()) throw BVM_stack_exception();
-                int typeflags = *code_p;
-                ++code_p;
-
-                switch (typeflags)
-                {
-                    case 0x00: // int
-                    {
-                        int i = stack.top();
-                        stack.pop();
-                        stack.push(-i);
-                        break;
-                    }
-                    case 0x01: // float
-                    {
-                        float f;
-                        int value = stack.top();
-                        memcpy(&f, &value, sizeof(float));
-                        f = -f;
-                        memcpy(&value, &f, sizeof(int));
-                        stack.pop();
-                        stack.push(value);
-                        break;
-                    }
-                    default:
-                        throw BVM_unimplemented_exception();
-                }
-                break;
-            }
-            case 0x0A: // Increment element
-            {
-                if (!stack.size()) throw BVM_stack_exception();
-                int typeflags = *code_p;
-                ++code_p;
-
-                if (typeflags | 2) // float
-                {
-                    int value = stack.top(); stack.pop();
-                    float f;
-                    memcpy(&f, &value, sizeof(float));
-                    ++f;
-                    memcpy(&value, &f, sizeof(float));
-                    stack.push(value);
-                }
-                else // int
-                {
-                    int value = stack.top(); stack.pop();
-                    stack.push(++value);
-                }
-                break;
-            }
-            case 0x0B: // Decrement element
-            {
-                if (!stack.size()) throw BVM_stack_exception();
-                int typeflags = *code_p;
-                ++code_p;
-
-                if (typeflags | 2) // float
-                {
-                    int value = stack.top(); stack.pop();
-                    float f;
-                    memcpy(&f, &value, sizeof(float));
-                    --f;
-                    memcpy(&value, &f, sizeof(float));
-                    stack.push(value);
-                }
-                else // int
-                {
-                    int value = stack.top(); stack.pop();
-                    stack.push(--value);
-                }
-                break;
-            }
-            case 0x0C: // [stack-1] >> [stack]
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int rhs = stack.top(); stack.pop();
-                int lhs = stack.top(); stack.pop();
-                stack.push(lhs >> rhs);
-                break;
-            }
-            case 0x0D: // [stack-1] << [stack]
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int rhs = stack.top(); stack.pop();
-                int lhs = stack.top(); stack.pop();
-                stack.push(lhs << rhs);
-                break;
-            }
-            case 0x0E: // [stack-1] & [stack]
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int rhs = stack.top(); stack.pop();
-                int lhs = stack.top(); stack.pop();
-                stack.push(lhs & rhs);
-                break;
-            }
-            case 0x0F: // [stack-1] | [stack]
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int rhs = stack.top(); stack.pop();
-                int lhs = stack.top(); stack.pop();
-                stack.push(lhs | rhs);
-                break;
-            }
-            case 0x10: // [stack-1] ^ [stack]
-            {
-                if (stack.size() < 2) throw BVM_stack_exception();
-                int rhs = stack.top(); stack.pop();
-                int lhs = stack.top(); stack.pop();
-                stack.push(lhs ^ rhs);
-                break;
-            }
-            case 0x11: // [stack] = ~[stack]
-            {
-                if (!stack.size()) throw BVM_stack_exception();
-                int value = stack.top(); stack.pop();
-                stack.push(~value);
-                break;
-            }
-            case 0x12: // Convert float to int
-            {
-                float f;
-                int value = stack.top(); stack.pop();
-                memcpy(&f, &value, sizeof(float));
-                stack.push(f);
-                break;
-            }
-            case 0x13: // Convert int to float
-            {
-                int value = stack.top(); stack.pop();
-                float f = value;
-                memcpy(&value, &f, sizeof(float));
-                stack.push(value);
+            int32_t result;
+            memcpy(&result, data_p, 4);
+            return result;
+        }
+        default:
+            return 0;
+    }
+}
+
+static int32_t read_zero(const unsigned char *data_p, size_t size)
+{
+    switch (size)
+    {
+        case 1:
+            return data_p[0];
+        case 2:
+            return data_p[0] | (data_p[1] << 8);
+        case 4:
+        {
+            int32_t result;
+            memcpy(&result, data_p, 4);
+            return result;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Opcodes followed by a one byte type specifier instead of a sized operand
+static bool has_typeflags(int op)
+{
+    return op == 0x01 || (op >= 0x04 && op <= 0x07) || (op >= 0x09 && op <= 0x0B) || (op >= 0x20 && op <= 0x25);
+}
+
+static uint8_t handler_for(int op, int typeflags)
+{
+    switch (op)
+    {
+        case 0x00: return BVM_NOP;
+        case 0x01: return typeflags <= 0b11 ? BVM_STORE_CONVERT : BVM_INVALID;
+        case 0x02: return BVM_POP;
+        case 0x03: return BVM_DUP;
+        case 0x04: return typeflags <= 0b11 ? BVM_ADD : BVM_INVALID;
+        case 0x05: return typeflags <= 0b11 ? BVM_SUB : BVM_INVALID;
+        case 0x06: return typeflags <= 0b11 ? BVM_MUL : BVM_INVALID;
+        case 0x07: return typeflags <= 0b11 ? BVM_DIV : BVM_INVALID;
+        case 0x08: return BVM_MOD;
+        case 0x09: return typeflags <= 0x01 ? BVM_NEG : BVM_INVALID;
+        case 0x0A: return BVM_INC;
+        case 0x0B: return BVM_DEC;
+        case 0x0C: return BVM_SHR;
+        case 0x0D: return BVM_SHL;
+        case 0x0E: return BVM_AND;
+        case 0x0F: return BVM_OR;
+        case 0x10: return BVM_XOR;
+        case 0x11: return BVM_NOT;
+        case 0x12: return BVM_FTOI;
+        case 0x13: return BVM_ITOF;
+        case 0x14: return BVM_LOAD;
+        case 0x15: return BVM_PUSH;
+        case 0x16: return BVM_STORE;
+        case 0x17: return BVM_LOAD_REL;
+        case 0x18: return BVM_PUSH_REL_INDEX;
+        case 0x19: return BVM_STORE_REL;
+        case 0x1A: return BVM_PUSH_STRING;
+        case 0x1B: return BVM_FRAME_ADD;
+        case 0x1C: return BVM_FRAME_SUB;
+        case 0x20: return typeflags <= 0b11 ? BVM_LT : BVM_INVALID;
+        case 0x21: return typeflags <= 0b11 ? BVM_LE : BVM_INVALID;
+        case 0x22: return typeflags <= 0b11 ? BVM_EQ : BVM_INVALID;
+        case 0x23: return typeflags <= 0b11 ? BVM_NE : BVM_INVALID;
+        case 0x24: return typeflags <= 0b11 ? BVM_GE : BVM_INVALID;
+        case 0x25: return typeflags <= 0b11 ? BVM_GT : BVM_INVALID;
+        case 0x26: return BVM_JZ;
+        case 0x27: return BVM_JNZ;
+        case 0x28: return BVM_JMP;
+        case 0x29: return BVM_CALL;
+        case 0x2A: return BVM_RETURN;
+        case 0x2C:
+        case 0x2D:
+        case 0x2E:
+        case 0x2F: return BVM_HOST_CALL;
+        case 0x30: return BVM_EXIT;
+        case 0x31: // The debug prints are gutted in the game, all they do is pop
+        case 0x32: return BVM_POP;
+        case 0x33: return BVM_PUSH_ONE;
+        case 0x36: return BVM_STORE_INDIRECT;
+        default: return BVM_INVALID;
+    }
+}
+
+void BVMProgram::decode(const unsigned char *code_p, size_t size, bool stop_at_exit)
+{
+    instructions.clear();
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        BVMInstruction instruction;
+        int op = code_p[pos] & 0x3F;
+        size_t length = has_typeflags(op) ? 1 : operand_size(code_p[pos] & 0xC0);
+        if (pos + 1 + length > size)
+            break;
+
+        instruction.opcode = op;
+        instruction.offset = (uint32_t)pos;
+        instruction.typeflags = 0;
+        instruction.operand = 0;
+        if (has_typeflags(op))
+            instruction.typeflags = code_p[pos + 1];
+        else if (op == 0x14 || (op >= 0x16 && op <= 0x1C) || (op >= 0x2C && op <= 0x2F))
+            instruction.operand = read_zero(code_p + pos + 1, length);
+        else
+            instruction.operand = read_sign(code_p + pos + 1, length);
+        instruction.handler = handler_for(op, instruction.typeflags);
+
+        instructions.push_back(instruction);
+        pos += 1 + length;
+
+        if (stop_at_exit && op == 0x30)
+            break;
+    }
+
+    BVMInstruction sentinel;
+    sentinel.handler = BVM_INVALID;
+    sentinel.opcode = 0xFF;
+    sentinel.typeflags = 0;
+    sentinel.operand = 0;
+    sentinel.offset = (uint32_t)pos;
+    instructions.push_back(sentinel);
+
+    // Jumps and calls are relative to their own opcode, turn them into instruction indices
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        BVMInstruction& instruction = instructions[i];
+        if (instruction.handler == BVM_JZ || instruction.handler == BVM_JNZ || instruction.handler == BVM_JMP || instruction.handler == BVM_CALL)
+            instruction.operand = find((uint32_t)(instruction.offset + instruction.operand));
+    }
+}
+
+int BVMProgram::find(uint32_t offset) const
+{
+    size_t lo = 0;
+    size_t hi = instructions.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (instructions[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // The sentinel is last and never a target
+    if (lo + 1 < instructions.size() && instructions[lo].offset == offset)
+        return (int)lo;
+    return -1;
+}
+
+static inline float as_float(int32_t value)
+{
+    float f;
+    memcpy(&f, &value, sizeof(float));
+    return f;
+}
+
+static inline int32_t as_int(float f)
+{
+    int32_t value;
+    memcpy(&value, &f, sizeof(float));
+    return value;
+}
+
+void BVMProfile::reset(const BVMProgram& program)
+{
+    hits.assign(program.instructions.size(), 0);
+    jumps_taken.assign(program.instructions.size(), 0);
+}
+
+void VMState::interpret(const unsigned char *code_p, size_t size)
+{
+    BVMProgram program;
+    program.decode(code_p, size, true);
+    run(program);
+}
+
+// Computed goto where the compiler has it, MSVC falls back to a switch
+#if defined(__GNUC__) || defined(__clang__)
+#define BVM_COMPUTED_GOTO 1
+#else
+#define BVM_COMPUTED_GOTO 0
+#endif
+
+void VMState::run(const BVMProgram& program, size_t entry)
+{
+    if (entry >= program.instructions.size())
+        throw BVM_unimplemented_exception();
+
+    if (profile)
+    {
+        if (profile->hits.size() != program.instructions.size())
+            profile->reset(program);
+        run_loop<true>(program, entry);
+    }
+    else
+        run_loop<false>(program, entry);
+}
+
+template <bool PROFILED>
+void VMState::run_loop(const BVMProgram& program, size_t entry)
+{
+    const BVMInstruction *base = program.instructions.data();
+    const BVMInstruction *ip = base + entry;
+    int32_t *stack_base = stack.data();
+    int32_t *stack_end = stack_base + stack.size();
+    int32_t *sp = stack_base + stack_size;
+    const int32_t instruction_count = (int32_t)program.instructions.size();
+    const size_t relative_RAS_top = relative_RAS_start + relative_RAS.size();
+    uint64_t count = 0;
+    uint64_t *hits = PROFILED ? profile->hits.data() : nullptr;
+    uint64_t *jumps_taken = PROFILED ? profile->jumps_taken.data() : nullptr;
+
+    // Counters and the stack pointer live in locals, write them back on the way out
+#define BVM_SYNC() { instructions_executed += count; count = 0; stack_size = sp - stack_base; }
+#define BVM_FAIL(e) { BVM_SYNC(); fault_instruction = ip - base; throw e; }
+#define BVM_NEED(n) if (sp - stack_base < (n)) BVM_FAIL(BVM_stack_exception())
+#define BVM_PUSH(value) { if (sp == stack_end) BVM_FAIL(BVM_stack_overflow_exception()); *sp++ = (value); }
+
+#if BVM_COMPUTED_GOTO
+    static void *const handlers[BVM_HANDLER_COUNT] =
+    {
+        &&L_BVM_NOP, &&L_BVM_STORE_CONVERT, &&L_BVM_POP, &&L_BVM_DUP,
+        &&L_BVM_ADD, &&L_BVM_SUB, &&L_BVM_MUL, &&L_BVM_DIV, &&L_BVM_MOD,
+        &&L_BVM_NEG, &&L_BVM_INC, &&L_BVM_DEC,
+        &&L_BVM_SHR, &&L_BVM_SHL, &&L_BVM_AND, &&L_BVM_OR, &&L_BVM_XOR, &&L_BVM_NOT,
+        &&L_BVM_FTOI, &&L_BVM_ITOF, &&L_BVM_LOAD, &&L_BVM_PUSH, &&L_BVM_STORE,
+        &&L_BVM_LOAD_REL, &&L_BVM_PUSH_REL_INDEX, &&L_BVM_STORE_REL, &&L_BVM_STORE_INDIRECT,
+        &&L_BVM_PUSH_STRING, &&L_BVM_FRAME_ADD, &&L_BVM_FRAME_SUB,
+        &&L_BVM_LT, &&L_BVM_LE, &&L_BVM_EQ, &&L_BVM_NE, &&L_BVM_GE, &&L_BVM_GT,
+        &&L_BVM_JZ, &&L_BVM_JNZ, &&L_BVM_JMP, &&L_BVM_CALL, &&L_BVM_RETURN, &&L_BVM_HOST_CALL,
+        &&L_BVM_PUSH_ONE, &&L_BVM_EXIT, &&L_BVM_INVALID
+    };
+#define BVM_OP(name) L_##name:
+#define BVM_DISPATCH() { ++count; if (PROFILED) ++hits[ip - base]; goto *handlers[ip->handler]; }
+#else
+#define BVM_OP(name) case name:
+#define BVM_DISPATCH() continue;
+#endif
+#define BVM_NEXT() { ++ip; BVM_DISPATCH() }
+#define BVM_JUMP(target) \
+    { \
+        if ((target) < 0) BVM_FAIL(BVM_unimplemented_exception()); \
+        if (instruction_limit && instructions_executed + count >= instruction_limit) BVM_FAIL(BVM_limit_exception()); \
+        if (PROFILED) ++jumps_taken[ip - base]; \
+        ip = base + (target); \
+        BVM_DISPATCH() \
+    }
+
+    // Arithmetic type specifier: bit 0 marks the deeper operand as a float, bit 1 the top one
+#define BVM_ARITH(name, op) \
+    BVM_OP(name) \
+    { \
+        BVM_NEED(2); \
+        int32_t lhs = sp[-1]; \
+        int32_t rhs = sp[-2]; \
+        int32_t result; \
+        switch (ip->typeflags) \
+        { \
+            case 0b00: result = (int32_t)((uint32_t)lhs op (uint32_t)rhs); break; \
+            case 0b01: result = as_int(lhs op as_float(rhs)); break; \
+            case 0b10: result = as_int(as_float(lhs) op rhs); break; \
+            default: result = as_int(as_float(lhs) op as_float(rhs)); break; \
+        } \
+        --sp; \
+        sp[-1] = result; \
+    } \
+    BVM_NEXT()
+
+#define BVM_COMPARE(name, op) \
+    BVM_OP(name) \
+    { \
+        BVM_NEED(2); \
+        int32_t y = sp[-1]; \
+        int32_t x = sp[-2]; \
+        bool result; \
+        if (ip->typeflags == 0) \
+            result = x op y; \
+        else \
+            result = ((ip->typeflags & 1) ? as_float(x) : (float)x) op ((ip->typeflags & 2) ? as_float(y) : (float)y); \
+        --sp; \
+        sp[-1] = result; \
+    } \
+    BVM_NEXT()
+
+#define BVM_BITWISE(name, op) \
+    BVM_OP(name) \
+    { \
+        BVM_NEED(2); \
+        int32_t rhs = sp[-1]; \
+        int32_t lhs = sp[-2]; \
+        --sp; \
+        sp[-1] = lhs op rhs; \
+    } \
+    BVM_NEXT()
+
+#if BVM_COMPUTED_GOTO
+    BVM_DISPATCH()
+#else
+    for (;;)
+    {
+        ++count;
+        if (PROFILED)
+            ++hits[ip - base];
+        switch (ip->handler)
+        {
+#endif
+
+    BVM_OP(BVM_NOP)
+        BVM_NEXT()
+
+    BVM_OP(BVM_STORE_CONVERT) // Convert type of operand and store on RAS
+    {
+        BVM_NEED(2);
+        int32_t value = sp[-1];
+        uint32_t RAS_idx = sp[-2];
+        --sp;
+        sp[-1] = value;
+
+        switch (ip->typeflags)
+        {
+            case 0b01: // float to int
+                value = (int32_t)as_float(value);
                 break;
-            }
-            case 0x14: //Load element from RAS
-            {
-                int idx = read4_zero(&code_p, sizeflags);
-                int value;
-
-                if (idx < relative_RAS_start)
-                {
-                    value = static_RAS[idx].value;
-                }
-                else
-                {
-                    value = relative_RAS[idx];
-                }
-                stack.push(value);
+            case 0b10: // int to float
+                value = as_int((float)value);
                 break;
-            }
-            case 0x15: // Read number into stack
-            {
-                stack.push(read4_sign(&code_p, sizeflags));
+            default: // int to int, float to float
                 break;
-            }
-            case 0x16: // Store stack element into RAS
-            {
-                if (!stack.size()) throw BVM_stack_exception();
-
-                int idx = read4_zero(&code_p, sizeflags);
-                int value = stack.top();
-                stack.pop();
-
-                if (idx < relative_RAS_start)
-                {
-                    static_RAS[idx].initialized = true;
-                    static_RAS[idx].value = value;
-                }
-                else
-                {
-                    relative_RAS[idx] = value;
-                }
+        }
+        if (!store(RAS_idx, value))
+            BVM_FAIL(BVM_unimplemented_exception());
+    }
+    BVM_NEXT()
+
+    BVM_OP(BVM_POP)
+        BVM_NEED(1);
+        --sp;
+        BVM_NEXT()
+
+    BVM_OP(BVM_DUP)
+    {
+        BVM_NEED(1);
+        int32_t value = sp[-1];
+        BVM_PUSH(value);
+    }
+    BVM_NEXT()
+
+    BVM_ARITH(BVM_ADD, +)
+    BVM_ARITH(BVM_SUB, -)
+    BVM_ARITH(BVM_MUL, *)
+
+    BVM_OP(BVM_DIV)
+    {
+        BVM_NEED(2);
+        int32_t lhs = sp[-1];
+        int32_t rhs = sp[-2];
+        int32_t result;
+        switch (ip->typeflags)
+        {
+            case 0b00:
+                if (rhs == 0 || (rhs == -1 && lhs == INT32_MIN))
+                    BVM_FAIL(BVM_unimplemented_exception());
+                result = lhs / rhs;
                 break;
-            }
-            case 0x30: // Stop execution
-                return;
+            case 0b01: result = as_int(lhs / as_float(rhs)); break;
+            case 0b10: result = as_int(as_float(lhs) / rhs); break;
+            default: result = as_int(as_float(lhs) / as_float(rhs)); break;
+        }
+        --sp;
+        sp[-1] = result;
+    }
+    BVM_NEXT()
+
+    BVM_OP(BVM_MOD)
+    {
+        BVM_NEED(2);
+        int32_t lhs = sp[-1];
+        int32_t rhs = sp[-2];
+        if (rhs == 0 || (rhs == -1 && lhs == INT32_MIN))
+            BVM_FAIL(BVM_unimplemented_exception());
+        --sp;
+        sp[-1] = lhs % rhs;
+    }
+    BVM_NEXT()
+
+    BVM_OP(BVM_NEG)
+        BVM_NEED(1);
+        if (ip->typeflags == 0x01)
+            sp[-1] = as_int(-as_float(sp[-1]));
+        else
+            sp[-1] = (int32_t)(0u - (uint32_t)sp[-1]);
+        BVM_NEXT()
+
+    // The type specifier isn't checked, these always work on floats
+    BVM_OP(BVM_INC)
+        BVM_NEED(1);
+        sp[-1] = as_int(as_float(sp[-1]) + 1.0f);
+        BVM_NEXT()
+
+    BVM_OP(BVM_DEC)
+        BVM_NEED(1);
+        sp[-1] = as_int(as_float(sp[-1]) - 1.0f);
+        BVM_NEXT()
+
+    BVM_BITWISE(BVM_SHR, >>)
+    BVM_BITWISE(BVM_SHL, <<)
+    BVM_BITWISE(BVM_AND, &)
+    BVM_BITWISE(BVM_OR, |)
+    BVM_BITWISE(BVM_XOR, ^)
+
+    BVM_OP(BVM_NOT)
+        BVM_NEED(1);
+        sp[-1] = ~sp[-1];
+        BVM_NEXT()
+
+    BVM_OP(BVM_FTOI)
+        BVM_NEED(1);
+        sp[-1] = (int32_t)as_float(sp[-1]);
+        BVM_NEXT()
+
+    BVM_OP(BVM_ITOF)
+        BVM_NEED(1);
+        sp[-1] = as_int((float)sp[-1]);
+        BVM_NEXT()
+
+    BVM_OP(BVM_LOAD) // Load element from RAS
+    {
+        int32_t value;
+        if (!load((uint32_t)ip->operand, value))
+            BVM_FAIL(BVM_unimplemented_exception());
+        BVM_PUSH(value);
+    }
+    BVM_NEXT()
+
+    BVM_OP(BVM_PUSH) // Read number into stack
+        BVM_PUSH(ip->operand);
+        BVM_NEXT()
+
+    BVM_OP(BVM_STORE) // Store stack element into RAS
+        BVM_NEED(1);
+        --sp;
+        if (!store((uint32_t)ip->operand, *sp))
+            BVM_FAIL(BVM_unimplemented_exception());
+        BVM_NEXT()
+
+    BVM_OP(BVM_LOAD_REL) // Load element from the current frame
+    {
+        int32_t value;
+        if (!load((uint32_t)(relative_RAS_idx + (uint32_t)ip->operand), value))
+            BVM_FAIL(BVM_unimplemented_exception());
+        BVM_PUSH(value);
+    }
+    BVM_NEXT()
+
+    BVM_OP(BVM_PUSH_REL_INDEX) // Push the RAS index of a frame element, for STORE_INDIRECT
+        BVM_PUSH((int32_t)(relative_RAS_idx + (uint32_t)ip->operand));
+        BVM_NEXT()
+
+    BVM_OP(BVM_STORE_REL) // Store stack element into the current frame
+        BVM_NEED(1);
+        --sp;
+        if (!store((uint32_t)(relative_RAS_idx + (uint32_t)ip->operand), *sp))
+            BVM_FAIL(BVM_unimplemented_exception());
+        BVM_NEXT()
+
+    BVM_OP(BVM_STORE_INDIRECT) // Store the top of the stack at the RAS index under it
+    {
+        BVM_NEED(2);
+        int32_t value = sp[-1];
+        uint32_t RAS_idx = sp[-2];
+        sp -= 2;
+        if (!store(RAS_idx, value))
+            BVM_FAIL(BVM_unimplemented_exception());
+    }
+    BVM_NEXT()
+
+    BVM_OP(BVM_PUSH_STRING)
+        BVM_PUSH((int32_t)(string_base + (uint32_t)ip->operand));
+        BVM_NEXT()
+
+    BVM_OP(BVM_FRAME_ADD) // Leave a frame
+        if ((size_t)(uint32_t)ip->operand > relative_RAS_top - relative_RAS_idx)
+            BVM_FAIL(BVM_stack_exception());
+        relative_RAS_idx += (uint32_t)ip->operand;
+        BVM_NEXT()
+
+    BVM_OP(BVM_FRAME_SUB) // Enter a frame
+        if ((size_t)(uint32_t)ip->operand > relative_RAS_idx - relative_RAS_start)
+            BVM_FAIL(BVM_stack_overflow_exception());
+        relative_RAS_idx -= (uint32_t)ip->operand;
+        BVM_NEXT()
+
+    BVM_COMPARE(BVM_LT, <)
+    BVM_COMPARE(BVM_LE, <=)
+    BVM_COMPARE(BVM_EQ, ==)
+    BVM_COMPARE(BVM_NE, !=)
+    BVM_COMPARE(BVM_GE, >=)
+    BVM_COMPARE(BVM_GT, >)
+
+    BVM_OP(BVM_JZ) // Jump if stack == 0
+        BVM_NEED(1);
+        if (*--sp == 0)
+            BVM_JUMP(ip->operand)
+        BVM_NEXT()
+
+    BVM_OP(BVM_JNZ) // Jump if stack != 0
+        BVM_NEED(1);
+        if (*--sp != 0)
+            BVM_JUMP(ip->operand)
+        BVM_NEXT()
+
+    BVM_OP(BVM_JMP)
+        BVM_JUMP(ip->operand)
+
+    BVM_OP(BVM_CALL) // The return address goes on the value stack, the callee keeps it in frame slot 0
+        BVM_PUSH((int32_t)(ip - base + 1));
+        BVM_JUMP(ip->operand)
+
+    BVM_OP(BVM_RETURN)
+    {
+        BVM_NEED(1);
+        int32_t target = *--sp;
+        if (target >= instruction_count)
+            BVM_FAIL(BVM_unimplemented_exception());
+        BVM_JUMP(target)
+    }
+
+    BVM_OP(BVM_HOST_CALL)
+    {
+        if (!host)
+            BVM_FAIL(BVM_host_exception());
+
+        // The host works on the stack through pop / push
+        BVM_SYNC();
+        fault_instruction = ip - base;
+        bool handled = host->call(*this, ip->opcode - 0x2C, (uint32_t)ip->operand);
+        sp = stack_base + stack_size;
+        if (!handled)
+            BVM_FAIL(BVM_host_exception());
+    }
+    BVM_NEXT()
+
+    BVM_OP(BVM_PUSH_ONE)
+        BVM_PUSH(1);
+        BVM_NEXT()
+
+    BVM_OP(BVM_EXIT) // Stop execution
+        BVM_SYNC();
+        return;
+
+    BVM_OP(BVM_INVALID)
+        BVM_FAIL(BVM_unimplemented_exception());
+
+#if !BVM_COMPUTED_GOTO
             default:
-                throw BVM_unimplemented_exception();
+                BVM_FAIL(BVM_unimplemented_exception());
         }
     }
+#endif
+
+#undef BVM_SYNC
+#undef BVM_FAIL
+#undef BVM_NEED
+#undef BVM_PUSH
+#undef BVM_OP
+#undef BVM_DISPATCH
+#undef BVM_NEXT
+#undef BVM_JUMP
+#undef BVM_ARITH
+#undef BVM_COMPARE
+#undef BVM_BITWISE
 }
 
-int VMState::read4_sign(unsigned char **data_p, int sizeflags) const
+bool VMState::pop(int32_t& value)
 {
-    int result;
-    switch (sizeflags)
+    if (stack_size == 0)
+        return false;
+    value = stack[--stack_size];
+    return true;
+}
+
+bool VMState::push(int32_t value)
+{
+    if (stack_size == stack.size())
+        return false;
+    stack[stack_size++] = value;
+    return true;
+}
+
+bool VMState::load(uint32_t idx, int32_t& value) const
+{
+    if (idx < relative_RAS_start)
     {
-        case 0x00:
-            return 0;
-        case 0x40:
-            memcpy(&result, *data_p, 1);
-            result <<= 24;
-            result >>= 24;
-            *data_p += 1;
-            return result;
-        case 0x80:
-            memcpy(&result, *data_p, 2);
-            result <<= 16;
-            result >>= 16;
-            *data_p += 2;
-            return result;
-        case 0xC0:
-            memcpy(&result, *data_p, 4);
-            *data_p += 4;
-            return result;
-        default:
-            return 0;
+        if (idx >= static_RAS.size())
+            return false;
+        value = (int32_t)static_RAS[idx].value;
+        return true;
     }
+
+    if (idx - relative_RAS_start >= relative_RAS.size())
+        return false;
+    value = (int32_t)relative_RAS[idx - relative_RAS_start];
+    return true;
 }
 
-uint32_t VMState::read4_zero(unsigned char **data_p, int sizeflags) const
+bool VMState::store(uint32_t idx, int32_t value)
 {
-    uint32_t result = 0;
-    switch (sizeflags)
+    if (idx < relative_RAS_start)
     {
-        case 0x00:
-            return 0;
-        case 0x40:
-            memcpy(&result, *data_p, 1);
-            *data_p += 1;
-            return result;
-        case 0x80:
-            memcpy(&result, *data_p, 2);
-            *data_p += 2;
-            return result;
-        case 0xC0:
-            memcpy(&result, *data_p, 4);
-            *data_p += 4;
-            return result;
-        default:
-            return 0;
+        if (idx >= static_RAS.size())
+            return false;
+        static_RAS[idx].value = value;
+        static_RAS[idx].initialized = true;
+        return true;
     }
-}
\ No newline at end of file
+
+    if (idx - relative_RAS_start >= relative_RAS.size())
+        return false;
+    relative_RAS[idx - relative_RAS_start] = value;
+    return true;
+}
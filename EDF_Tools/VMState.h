@@ -1,8 +1,8 @@
 #pragma once
 #include <iostream>
-#include <stack>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 
 class BVM_unimplemented_exception : public std::exception
 {
@@ -12,7 +12,7 @@ class BVM_unimplemented_exception : public std::exception
     }
 };
 
-class BVM_stack_exception : std::exception
+class BVM_stack_exception : public std::exception
 {
     virtual const char* what() const throw()
     {
@@ -20,6 +20,125 @@ class BVM_stack_exception : std::exception
     }
 };
 
+class BVM_stack_overflow_exception : public std::exception
+{
+    virtual const char* what() const throw()
+    {
+        return "Attempted to push onto a full BVM stack!";
+    }
+};
+
+class BVM_limit_exception : public std::exception
+{
+    virtual const char* what() const throw()
+    {
+        return "BVM execution went over its instruction limit!";
+    }
+};
+
+class BVM_host_exception : public std::exception
+{
+    virtual const char* what() const throw()
+    {
+        return "The host did not handle a 2C / 2D / 2E / 2F command!";
+    }
+};
+
+// Handlers the decoder maps opcodes to, in dispatch table order
+enum BVMHandler : uint8_t
+{
+    BVM_NOP,
+    BVM_STORE_CONVERT,
+    BVM_POP,
+    BVM_DUP,
+    BVM_ADD,
+    BVM_SUB,
+    BVM_MUL,
+    BVM_DIV,
+    BVM_MOD,
+    BVM_NEG,
+    BVM_INC,
+    BVM_DEC,
+    BVM_SHR,
+    BVM_SHL,
+    BVM_AND,
+    BVM_OR,
+    BVM_XOR,
+    BVM_NOT,
+    BVM_FTOI,
+    BVM_ITOF,
+    BVM_LOAD,
+    BVM_PUSH,
+    BVM_STORE,
+    BVM_LOAD_REL,
+    BVM_PUSH_REL_INDEX,
+    BVM_STORE_REL,
+    BVM_STORE_INDIRECT,
+    BVM_PUSH_STRING,
+    BVM_FRAME_ADD,
+    BVM_FRAME_SUB,
+    BVM_LT,
+    BVM_LE,
+    BVM_EQ,
+    BVM_NE,
+    BVM_GE,
+    BVM_GT,
+    BVM_JZ,
+    BVM_JNZ,
+    BVM_JMP,
+    BVM_CALL,
+    BVM_RETURN,
+    BVM_HOST_CALL,
+    BVM_PUSH_ONE,
+    BVM_EXIT,
+    BVM_INVALID,
+    BVM_HANDLER_COUNT
+};
+
+// One decoded instruction, operands are read once up front instead of on every execution
+struct BVMInstruction
+{
+    uint8_t handler;
+    uint8_t opcode;
+    uint8_t typeflags;
+    int32_t operand; // Immediate, RAS index, or instruction index for jumps and calls (-1 if the target is not an instruction)
+    uint32_t offset; // Byte offset in the decoded code
+};
+
+class BVMProgram
+{
+public:
+    // Decodes size bytes of code. With stop_at_exit the first 0x30 ends the program, as for the static initialisers.
+    // A sentinel that throws is always appended, so running off the end never reads past the instructions.
+    void decode(const unsigned char *code_p, size_t size, bool stop_at_exit = false);
+
+    // Instruction starting at a byte offset, -1 if there is none
+    int find(uint32_t offset) const;
+
+    std::vector<BVMInstruction> instructions;
+};
+
+// Execution counts gathered by VMState::run while VMState::profile is set, indexed like BVMProgram::instructions
+struct BVMProfile
+{
+    std::vector<uint64_t> hits;
+    std::vector<uint64_t> jumps_taken;
+
+    void reset(const BVMProgram& program);
+};
+
+class VMState;
+
+// Game side of the 2C / 2D / 2E / 2F opcodes. Like the game, a handler pops its own arguments and pushes any result.
+class BVMHost
+{
+public:
+    virtual ~BVMHost() {}
+
+    // language is 0 for 2C up to 3 for 2F. Returning false stops the run with BVM_host_exception.
+    virtual bool call(VMState& state, int language, uint32_t command) = 0;
+};
+
 class VMState
 {
 
@@ -34,18 +153,48 @@ public:
     };
 
     std::vector<StaticVariable> static_RAS;
+    // Function frames, relative_RAS_idx starts at the top and each call moves it down by its frame size
     std::vector<uint64_t> relative_RAS;
     size_t relative_RAS_start;
     size_t relative_RAS_idx;
-    std::stack<uint64_t> stack;
 
-    VMState(std::vector<std::wstring>& variable_names);
+    // Added to the string offsets 1A pushes, set it to the string table's file offset to read them back from the file
+    uint32_t string_base;
+
+    // Contiguous value stack, overflowing it throws instead of growing
+    std::vector<int32_t> stack;
+    size_t stack_size;
+
+    // Instructions executed by every run so far, and the cap checked on taken jumps (0 for none)
+    uint64_t instructions_executed;
+    uint64_t instruction_limit;
+
+    // Instruction index the last exception was thrown at
+    size_t fault_instruction;
+
+    // Counts every instruction and taken jump when set, run uses a separate slower loop for it
+    BVMProfile *profile;
+
+    // Answers host calls, they throw when it isn't set
+    BVMHost *host;
+
+    VMState(std::vector<std::wstring>& variable_names, size_t stack_capacity = 1024);
 
     void printstatics() const;
     std::wstring& printstatics(std::wstring& buf) const;
-    void interpret(unsigned char *code_p);
+    // Runs code up to the first exit, used for the static initialisers
+    void interpret(const unsigned char *code_p, size_t size);
+    // Runs a decoded program from an instruction index until it exits
+    void run(const BVMProgram& program, size_t entry = 0);
+
+    // Stack access for hosts, false if the stack is empty or full
+    bool pop(int32_t& value);
+    bool push(int32_t value);
 
 private:
-    int read4_sign(unsigned char **data_p, int sizeflags) const;
-    uint32_t read4_zero(unsigned char **data_p, int sizeflags) const;
-};
\ No newline at end of file
+    template <bool PROFILED> void run_loop(const BVMProgram& program, size_t entry);
+
+    // RAS access for the interpreter, false if the index is out of range
+    bool load(uint32_t idx, int32_t& value) const;
+    bool store(uint32_t idx, int32_t value);
+};
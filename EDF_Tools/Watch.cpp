@@ -0,0 +1,409 @@
+#include "stdafx.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <cstring>
+#include <cwchar>
+#include "util.h"
+#include "Log.h"
+#include "FileIO.h"
+#include "Batch.h"
+#include "Watch.h"
+
+#if defined( _WIN32 )
+#include <Windows.h>
+#elif defined( __linux__ )
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#include <filesystem>
+#include <system_error>
+
+//Without a change notification API the tree is scanned this often
+#define WATCH_POLL_MS 250
+#endif
+
+bool IsWatchSource( const std::wstring& path )
+{
+	std::wstring name = ConvertToLower( GetFileName( path ) );
+
+	//Editor backups and lock files, .#mission.txt and the like
+	if( name.empty( ) || name[0] == L'.' || name[0] == L'~' )
+		return false;
+
+	static const wchar_t *endings[] = { L"_data.xml", L"_mdb.xml", L"_cas.xml", L"_canm.xml", L".txt" };
+	for( const wchar_t *ending : endings )
+	{
+		size_t length = wcslen( ending );
+		if( name.size( ) > length && name.compare( name.size( ) - length, length, ending ) == 0 )
+			return true;
+	}
+	return false;
+}
+
+//Reports files written under a folder, subfolders included
+class DirectoryWatcher
+{
+public:
+	DirectoryWatcher( ) {};
+	~DirectoryWatcher( ) { Close( ); }
+
+	DirectoryWatcher( const DirectoryWatcher& ) = delete;
+	DirectoryWatcher& operator=( const DirectoryWatcher& ) = delete;
+
+#if defined( _WIN32 )
+	bool Open( const std::wstring& directory )
+	{
+		m_directory = directory;
+		m_handle = CreateFileW( directory.c_str( ), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL );
+		if( m_handle == INVALID_HANDLE_VALUE )
+			return false;
+
+		memset( &m_overlapped, 0, sizeof( m_overlapped ) );
+		m_overlapped.hEvent = CreateEventW( NULL, TRUE, FALSE, NULL );
+		return m_overlapped.hEvent != NULL && Queue( );
+	}
+
+	//Waits up to timeoutMs, -1 for as long as it takes, and adds what was written. False once watching fails.
+	bool Wait( int timeoutMs, std::vector< std::wstring >& changed )
+	{
+		DWORD waited = WaitForSingleObject( m_overlapped.hEvent, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs );
+		if( waited == WAIT_TIMEOUT )
+			return true;
+		if( waited != WAIT_OBJECT_0 )
+			return false;
+
+		DWORD size = 0;
+		if( !GetOverlappedResult( m_handle, &m_overlapped, &size, FALSE ) )
+			return false;
+
+		//The system drops the whole lot when the buffer overflows
+		if( size == 0 )
+			LogWarning( ) << L"Too many changes at once under " << m_directory << L", some may have been missed\n";
+
+		const char *buffer = (const char*)m_buffer;
+		for( DWORD offset = 0; size; )
+		{
+			const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION*)( buffer + offset );
+			if( info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME )
+				changed.push_back( m_directory + L"\\" + std::wstring( info->FileName, info->FileNameLength / sizeof( wchar_t ) ) );
+
+			if( !info->NextEntryOffset )
+				break;
+			offset += info->NextEntryOffset;
+		}
+		return Queue( );
+	}
+
+	void Close( )
+	{
+		if( m_handle == INVALID_HANDLE_VALUE )
+			return;
+
+		CancelIo( m_handle );
+		CloseHandle( m_handle );
+		if( m_overlapped.hEvent )
+			CloseHandle( m_overlapped.hEvent );
+		m_handle = INVALID_HANDLE_VALUE;
+	}
+
+private:
+	//Asks for the next batch of changes, they collect in the buffer until Wait reads them
+	bool Queue( )
+	{
+		ResetEvent( m_overlapped.hEvent );
+		return ReadDirectoryChangesW( m_handle, m_buffer, sizeof( m_buffer ), TRUE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE, NULL, &m_overlapped, NULL ) != FALSE;
+	}
+
+	std::wstring m_directory;
+	HANDLE m_handle = INVALID_HANDLE_VALUE;
+	OVERLAPPED m_overlapped;
+	//DWORD aligned as ReadDirectoryChangesW needs
+	DWORD m_buffer[16384];
+#elif defined( __linux__ )
+	bool Open( const std::wstring& directory )
+	{
+		m_fd = inotify_init1( IN_CLOEXEC );
+		if( m_fd < 0 )
+			return false;
+
+		std::vector< std::wstring > unused;
+		AddFolder( directory, unused );
+		return !m_folders.empty( );
+	}
+
+	//Waits up to timeoutMs, -1 for as long as it takes, and adds what was written. False once watching fails.
+	bool Wait( int timeoutMs, std::vector< std::wstring >& changed )
+	{
+		pollfd request = { m_fd, POLLIN, 0 };
+		int ready = poll( &request, 1, timeoutMs );
+		if( ready < 0 )
+			return errno == EINTR;
+		if( ready == 0 )
+			return true;
+
+		alignas( inotify_event ) char buffer[16384];
+		ssize_t size = read( m_fd, buffer, sizeof( buffer ) );
+		if( size <= 0 )
+			return size < 0 && ( errno == EINTR || errno == EAGAIN );
+
+		for( const char *next = buffer; next < buffer + size; )
+		{
+			const inotify_event *event = (const inotify_event*)next;
+			next += sizeof( inotify_event ) + event->len;
+
+			if( event->mask & IN_Q_OVERFLOW )
+			{
+				LogWarning( ) << L"Too many changes at once, some may have been missed\n";
+				continue;
+			}
+
+			auto folder = m_folders.find( event->wd );
+			if( folder == m_folders.end( ) )
+				continue;
+			//The folder is gone, or was moved away
+			if( event->mask & IN_IGNORED )
+			{
+				m_folders.erase( folder );
+				continue;
+			}
+			if( !event->len )
+				continue;
+
+			std::wstring path;
+			try
+			{
+				path = folder->second + L"/" + UTF8ToWide( event->name );
+			}
+			catch( const std::exception& )
+			{
+				//A name that isn't UTF-8 can't be handed to the converters anyway
+				continue;
+			}
+
+			if( event->mask & IN_ISDIR )
+				AddFolder( path, changed );
+			else if( event->mask & ( IN_CLOSE_WRITE | IN_MOVED_TO ) )
+				changed.push_back( path );
+		}
+		return true;
+	}
+
+	void Close( )
+	{
+		if( m_fd >= 0 )
+			close( m_fd );
+		m_fd = -1;
+		m_folders.clear( );
+	}
+
+private:
+	//inotify doesn't look into subfolders, so each one gets its own watch. Files already in a folder that just
+	//appeared were written before the watch existed and count as changed.
+	void AddFolder( const std::wstring& folder, std::vector< std::wstring >& changed )
+	{
+		int watch = inotify_add_watch( m_fd, WideToUTF8( folder ).c_str( ), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR );
+		if( watch < 0 )
+		{
+			LogWarning( ) << L"Can't watch " << folder << L"\n";
+			return;
+		}
+		m_folders[watch] = folder;
+
+		for( const std::wstring& file : ListFiles( folder, L"", false ) )
+			changed.push_back( file );
+		for( const std::wstring& subfolder : ListDirectories( folder ) )
+			AddFolder( subfolder, changed );
+	}
+
+	int m_fd = -1;
+	std::map< int, std::wstring > m_folders;
+#else
+	bool Open( const std::wstring& directory )
+	{
+		m_directory = directory;
+		Scan( nullptr );
+		return IsDirectory( directory );
+	}
+
+	//Waits up to timeoutMs, -1 for as long as it takes, and adds what was written. False once watching fails.
+	bool Wait( int timeoutMs, std::vector< std::wstring >& changed )
+	{
+		if( timeoutMs < 0 || timeoutMs > WATCH_POLL_MS )
+			timeoutMs = WATCH_POLL_MS;
+		std::this_thread::sleep_for( std::chrono::milliseconds( timeoutMs ) );
+
+		Scan( &changed );
+		return true;
+	}
+
+	void Close( ) {};
+
+private:
+	//Compares the write time of every source against the last scan
+	void Scan( std::vector< std::wstring > *changed )
+	{
+		for( const std::wstring& file : ListFiles( m_directory, L"", true ) )
+		{
+			if( !IsWatchSource( file ) )
+				continue;
+
+			std::error_code error;
+			std::filesystem::file_time_type time = std::filesystem::last_write_time( WideToUTF8( file ), error );
+			if( error )
+				continue;
+
+			auto known = m_times.find( file );
+			if( known == m_times.end( ) || known->second != time )
+			{
+				m_times[file] = time;
+				if( changed )
+					changed->push_back( file );
+			}
+		}
+	}
+
+	std::wstring m_directory;
+	std::map< std::wstring, std::filesystem::file_time_type > m_times;
+#endif
+};
+
+typedef std::chrono::steady_clock WatchClock;
+
+int RunWatch( const std::wstring& directory, const BatchConverter& convert, const WatchRebuilt& rebuilt, int threads, int debounceMs )
+{
+	DirectoryWatcher watcher;
+	if( !watcher.Open( directory ) )
+	{
+		LogError( ) << L"Can't watch " << directory << L"\n";
+		return 1;
+	}
+
+	const std::chrono::milliseconds debounce( debounceMs );
+
+	//Sources still changing, with when they last did
+	std::map< std::wstring, WatchClock::time_point > pending;
+
+	//Sources that have gone quiet, waiting for the build thread
+	std::mutex lock;
+	std::condition_variable wake;
+	std::map< std::wstring, WatchClock::time_point > ready;
+	bool stopping = false;
+
+	//Builds on its own thread so changes made meanwhile are still seen, and queued for the next round
+	std::thread builder( [&]( )
+	{
+		for( ;; )
+		{
+			std::map< std::wstring, WatchClock::time_point > sources;
+			{
+				std::unique_lock< std::mutex > guard( lock );
+				wake.wait( guard, [&]( ) { return stopping || !ready.empty( ); } );
+				if( stopping )
+					return;
+				sources.swap( ready );
+			}
+
+			std::vector< std::wstring > files;
+			for( const auto& source : sources )
+				files.push_back( source.first );
+
+			BatchSummary summary = RunBatch( files, convert, threads );
+
+			std::vector< std::wstring > done;
+			for( const BatchFileResult& result : summary.files )
+			{
+				//From the last change to the binary being written, debounce included
+				long long latency = (long long)std::chrono::duration_cast< std::chrono::milliseconds >( WatchClock::now( ) - sources[result.path] ).count( );
+
+				LogLine line( result.ok ? LogLevel::Info : LogLevel::Warning );
+				line << result.path << ( result.ok ? L": rebuilt in " : L": FAILED in " ) << (long long)result.ms << L" ms, " << latency << L" ms after the edit";
+				if( !result.error.empty( ) )
+					line << L", " << result.error;
+				line << L"\n";
+
+				if( result.ok )
+					done.push_back( result.path );
+			}
+			Log::Flush( );
+
+			if( done.size( ) && rebuilt )
+			{
+				rebuilt( done );
+				Log::Flush( );
+			}
+		}
+	} );
+
+	LogInfo( ) << L"Watching " << directory << L" for changes\n";
+	Log::Flush( );
+
+	std::vector< std::wstring > changed;
+	for( ;; )
+	{
+		//Sleep until the next pending source has been quiet long enough, or something else changes
+		int timeoutMs = -1;
+		WatchClock::time_point now = WatchClock::now( );
+		for( const auto& source : pending )
+		{
+			long long left = std::chrono::duration_cast< std::chrono::milliseconds >( source.second + debounce - now ).count( ) + 1;
+			if( left < 0 )
+				left = 0;
+			if( timeoutMs < 0 || left < timeoutMs )
+				timeoutMs = (int)left;
+		}
+
+		changed.clear( );
+		if( !watcher.Wait( timeoutMs, changed ) )
+		{
+			LogError( ) << L"Stopped watching " << directory << L"\n";
+			break;
+		}
+
+		now = WatchClock::now( );
+		for( const std::wstring& path : changed )
+		{
+			if( IsWatchSource( path ) )
+				pending[path] = now;
+		}
+
+		bool handedOver = false;
+		for( auto source = pending.begin( ); source != pending.end( ); )
+		{
+			if( now - source->second < debounce )
+			{
+				++source;
+				continue;
+			}
+
+			{
+				std::lock_guard< std::mutex > guard( lock );
+				ready[source->first] = source->second;
+			}
+			handedOver = true;
+			source = pending.erase( source );
+		}
+		if( handedOver )
+			wake.notify_one( );
+	}
+
+	{
+		std::lock_guard< std::mutex > guard( lock );
+		stopping = true;
+	}
+	wake.notify_one( );
+	builder.join( );
+	watcher.Close( );
+
+	return 1;
+}
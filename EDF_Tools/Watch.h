@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "Batch.h"
+
+//Quiet time after the last change to a file before it is rebuilt, editors often save in several writes
+#define WATCH_DEFAULT_DEBOUNCE_MS 150
+
+//True for the files watch mode rebuilds: _data.xml, _mdb.xml, _cas.xml, _canm.xml and mission .txt
+bool IsWatchSource( const std::wstring& path );
+
+//Called on the build thread with the sources that were rebuilt without errors
+typedef std::function< void( const std::vector< std::wstring >& rebuilt ) > WatchRebuilt;
+
+//Watches a folder and everything under it, inotify on Linux and ReadDirectoryChangesW on Windows.
+//Once a source hasn't changed for debounceMs it is handed to convert, on a build thread so watching carries on meanwhile.
+//Sources that change together are built together on a pool of threads, threads <= 0 uses one per core.
+//Runs until the process ends, returns 1 if the folder can't be watched.
+int RunWatch( const std::wstring& directory, const BatchConverter& convert, const WatchRebuilt& rebuilt, int threads = 0, int debounceMs = WATCH_DEFAULT_DEBOUNCE_MS );
@@ -5,58 +5,24 @@
 #include <iostream>
 #include <fstream>
 #include <codecvt>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#if defined( _WIN32 )
 #include <windows.h>
+#endif
 #include "util.h"
-#include "include/half.hpp"
+#include "Log.h"
+#include "ByteStream.h"
+#include "Unicode.h"
+#include "StringTable.h"
+#include "FileIO.h"
 
-void Read2Bytes( unsigned char *chunk, const std::vector<char>& buf, int pos )
-{
-	chunk[0] = buf[ pos + 1];
-	chunk[1] = buf[ pos ];
-}
-
-void Read2BytesReversed( unsigned char *chunk, const std::vector<char>& buf, int pos )
-{
-	chunk[0] = buf[ pos ];
-	chunk[1] = buf[ pos + 1 ];
-}
-
-void Read4Bytes(unsigned char* chunk, const std::vector<char>& buf, int pos)
-{
-	/*if( globals->endianMode )
-	{
-		Read4BytesReversed( chunk, buf, pos );
-		return;
-	}*/
-
-	chunk[3] = buf[pos];
-	chunk[2] = buf[pos + 1];
-	chunk[1] = buf[pos + 2];
-	chunk[0] = buf[pos + 3];
-}
-
-void Read4BytesReversed(unsigned char* chunk, const std::vector<char>& buf, int pos)
-{
-	chunk[0] = buf[pos];
-	chunk[1] = buf[pos + 1];
-	chunk[2] = buf[pos + 2];
-	chunk[3] = buf[pos + 3];
-}
-
-//Read specified number of bytes, which should be a multiple of 2
-void ReadNBytesReversed(unsigned char* chunk, const std::vector<char>& buf, int pos, int num)
-{
-	for (int i = num - 1; i >= 0; --i)
-	{
-		chunk[i] = buf[pos + i];
-	}
-}
-
-std::string ReadRaw(const std::vector<char>& buf, int pos, int num)
+std::string ReadRaw(const ByteSpan& buf, int pos, int num)
 {
 	std::string str="";
 	unsigned char chunk;
-	char tempbuffer[3];
+	char tempbuffer[4];
 
 	for (int i = 0; i < num; i++)
 	{
@@ -64,163 +30,43 @@ std::string ReadRaw(const std::vector<char>& buf, int pos, int num)
 		if (chunk < 0x10)
 			str += "0";
 
-		str += itoa(chunk, tempbuffer, 16);
+		snprintf(tempbuffer, sizeof(tempbuffer), "%x", chunk);
+		str += tempbuffer;
 	}
 	return str;
 }
 
-//wrong reading, do not use.
-short ReadInt16(const std::vector<char>& buf, int pos, bool swapEndian)
-{
-	char chunk[2];
-	if (swapEndian)
-	{
-		chunk[0] = buf[pos];
-		chunk[1] = buf[pos + 1];
-	}
-	else
-	{
-		chunk[0] = buf[pos + 1];
-		chunk[1] = buf[pos];
-	}
-
-	short num = 0;
-	for (int i = 0; i < 2; i++)
-	{
-		num <<= 8;
-		num |= chunk[i];
-	}
-
-	return num;
-}
-
-uint16_t ReadUInt16(const std::vector<char>& buf, int pos, bool swapEndian)
-{
-	char chunk[2];
-	if (swapEndian)
-	{
-		chunk[0] = buf[pos];
-		chunk[1] = buf[pos + 1];
-	}
-	else
-	{
-		chunk[0] = buf[pos + 1];
-		chunk[1] = buf[pos];
-	}
-
-	uint16_t num = 0;
-	for (int i = 0; i < 2; i++)
-	{
-		num <<= 8;
-		num |= chunk[i];
-	}
-
-	return num;
-}
-
-float ReadHalfFloat(const std::vector<char>& buf, int pos, bool swapEndian)
-{
-	char chunk[2];
-	if (swapEndian)
-	{
-		chunk[0] = buf[pos + 1];
-		chunk[1] = buf[pos];
-	}
-	else
-	{
-		chunk[0] = buf[pos];
-		chunk[1] = buf[pos + 1];
-	}
-
-	half_float::half hf;
-
-	memcpy(&hf, &chunk, sizeof(hf));
-
-	float f = float(hf);
-	
-	return f;
-}
-
-int GetIntFromChunk( unsigned char *chunk )
-{
-	int num = 0;
-	for (int i = 0; i < 4; i++)
-	{
-		num <<= 8;
-		num |= chunk[i];
-	}
-	return num;
-}
-
-char* IntToBytes( int i, bool flip )
-{
-	char *bytes = (char*)malloc( sizeof( char ) * 4 );
-	unsigned long n = i;
-
-	if( !flip )
-	{
-		bytes[0] = ( n >> 24 ) & 0xFF;
-		bytes[1] = ( n >> 16 ) & 0xFF;
-		bytes[2] = ( n >> 8 ) & 0xFF;
-		bytes[3] = n & 0xFF;
-	}
-	else
-	{
-		bytes[0] = n & 0xFF;
-		bytes[1] = (n >> 8) & 0xFF;
-		bytes[2] = (n >> 16) & 0xFF;
-		bytes[3] = (n >> 24) & 0xFF;
-	}
-
-	return bytes;
-}
-
-std::wstring ReadUnicode( const std::vector<char>& chunk, int pos, bool swapEndian )
+std::wstring ReadUnicode( const ByteSpan& chunk, int pos, bool swapEndian )
 {
-	if( pos > chunk.size( ) )
+	if( pos < 0 || (size_t)pos >= chunk.size( ) )
 		return L"";
 
-	unsigned int bufPos = pos;
+	size_t count = UTF16Length( chunk, pos );
+	const char *units = chunk.data( ) + pos;
 
-	std::vector< unsigned char > bytes;
-
-	int zeroCount = 0;
-
-	//Repeat until EOF, or otherwise broken
-	while( bufPos < chunk.size() )
+	std::wstring wstr;
+	wstr.reserve( count );
+	for( size_t i = 0; i < count; i++ )
 	{
-		if( swapEndian )
+		uint32_t c = swapEndian ? ByteOrder::Load< Endian::Big, uint16_t >( units + i * 2 ) : ByteOrder::Load< Endian::Little, uint16_t >( units + i * 2 );
+
+		//wchar_t holds whole code points outside of Windows
+		if( sizeof( wchar_t ) > 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < count )
 		{
-			if( bufPos % 2 )
+			uint32_t low = swapEndian ? ByteOrder::Load< Endian::Big, uint16_t >( units + i * 2 + 2 ) : ByteOrder::Load< Endian::Little, uint16_t >( units + i * 2 + 2 );
+			if( low >= 0xDC00 && low < 0xE000 )
 			{
-				bytes.push_back( chunk[bufPos] );
-				bytes.push_back( chunk[bufPos-1] );
+				c = 0x10000 + ( ( c - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+				i++;
 			}
 		}
-		else
-			bytes.push_back( chunk[bufPos] );
-
-		if( chunk[bufPos] == 0x00 )
-		{
-			zeroCount++;
-			if( zeroCount == 2 )
-				break;
-		}
-		else
-			zeroCount = 0;
-		bufPos++;
+		wstr.push_back( (wchar_t)c );
 	}
 
-	//if( bytes.size( ) == 0 );
-	//return L"";
-
-
-	std::wstring wstr(reinterpret_cast<wchar_t*>(&bytes[0]), bytes.size()/sizeof(wchar_t));
-
 	return wstr;
 }
 
-std::string ReadASCII(const std::vector<char>& chunk, int pos)
+std::string ReadASCII(const ByteSpan& chunk, int pos)
 {
 	if (pos > chunk.size())
 		return "";
@@ -283,9 +129,10 @@ std::wstring SimpleTokenise( std::wstring &input, wchar_t delim )
 //Util fn for tokenising a wstring while retaining certain data
 std::wstring Tokenise( std::wstring &input, const wchar_t delim[], wchar_t &firstDelim )
 {
+	size_t numDelims = std::wcslen( delim );
 	for( int pos = 0; pos < input.size( ); pos++ )
 	{
-		for( int i = 0; i < std::wcslen( delim ); i++ )
+		for( size_t i = 0; i < numDelims; i++ )
 		{
 			if( input[pos] == delim[i] )
 			{
@@ -306,24 +153,26 @@ std::wstring Tokenise( std::wstring &input, const wchar_t delim[], wchar_t &firs
 }
 
 //Function to kill whitespace
-std::wstring KillWhitespace( std::wstring in )
+std::wstring KillWhitespace( const std::wstring& in )
 {
-	bool isInQuote = false;
-
-	std::wstring out = in;
+	//A character is quoted when an odd number of quotes follow it
+	int quotesAfter = 0;
+	for( size_t i = 0; i < in.size( ); i++ )
+	{
+		if( in[i] == L'\"' )
+			quotesAfter++;
+	}
 
-	for( int i = in.size( ); i >= 0; i-- )
+	std::wstring out;
+	out.reserve( in.size( ) );
+	for( size_t i = 0; i < in.size( ); i++ )
 	{
-		if( ( out[i] == L' ' || out[i] == L'\t' ) && !isInQuote )
-		{
-			out.erase( i, 1 );
-			out.shrink_to_fit( );
+		if( in[i] == L'\"' )
+			quotesAfter--;
+		else if( ( in[i] == L' ' || in[i] == L'\t' ) && ( quotesAfter & 1 ) == 0 )
 			continue;
-		}
-		if( out[i] == L'\"' )
-		{
-			isInQuote = !isInQuote;
-		}
+
+		out += in[i];
 	}
 
 	return out;
@@ -343,9 +192,7 @@ std::wstring KillSpaceAndDebug(std::wstring in)
 		{
 			if (out[i - 1] != delim[12] && out[i + 1] != delim[12])
 			{
-				std::wcout << "\nMissing \",\" between 2 values:\n";
-				std::wcout << out;
-				std::wcout << "\n";
+				LogError( ) << "\nMissing \",\" between 2 values:\n" << out << "\n";
 				system("pause");
 				exit(0);
 			}
@@ -449,7 +296,7 @@ ValueType DetermineType( std::wstring input )
 ///Helper fn to read a file
 std::wstring ReadFile( const wchar_t* filename )
 {
-	std::wifstream wif( filename, std::ios::binary );
+	std::wifstream wif( ToFilePath( filename ), std::ios::binary );
 	//wif.imbue( std::locale( std::locale::empty( ), new std::codecvt_utf8<wchar_t> ) );
 
 	const unsigned long MaxCode = 0x10ffff;
@@ -463,6 +310,21 @@ std::wstring ReadFile( const wchar_t* filename )
 	return wss.str( );
 }
 
+bool WriteUTF16File( const wchar_t* filename, const std::wstring& text )
+{
+	//Same bytes codecvt_utf16 with generate_header produces, without going through a stream per character
+	std::vector< char > bytes( 2 + text.size( ) * 4 );
+	bytes[0] = (char)0xFE;
+	bytes[1] = (char)0xFF;
+	bytes.resize( 2 + WideToUTF16( bytes.data( ) + 2, text.data( ), text.size( ), true ) );
+
+	std::ofstream file( ToFilePath( filename ), std::ios::binary | std::ios::out | std::ios::trunc );
+	if( !file.write( bytes.data( ), bytes.size( ) ) )
+		return false;
+	file.close( );
+	return !file.fail( );
+}
+
 ///Replaces all instances in a string
 void FindAndReplaceAll( std::wstring & data, const std::wstring& toSearch, const std::wstring& replaceStr )
 {
@@ -508,31 +370,259 @@ void PushStringToVectorNoEnd(const std::string& strn, std::vector< char >* bytes
 	bytes->insert(bytes->end(), strn.begin(), strn.end());
 }
 
+size_t UTF16ByteSize( const std::wstring& strn )
+{
+	size_t size = strn.size( ) * 2;
+	for( size_t i = 0; i < strn.size( ); i++ )
+	{
+		if( (uint32_t)strn[i] > 0xFFFF )
+			size += 2;
+	}
+	return size;
+}
+
+size_t WriteUTF16LE( char *out, const std::wstring& strn )
+{
+	//The files hold UTF-16LE, wchar_t is only that on Windows
+	return WideToUTF16( out, strn.data( ), strn.size( ) );
+}
+
 ///Function to write a wstring to a char vector
 void PushWStringToVector( const std::wstring& strn, std::vector< char > *bytes )
 {
-	const char* strnBytes = reinterpret_cast<const char*>( &strn[0] );
+	size_t pos = bytes->size( );
+	//Resizing zero fills, which leaves the terminator
+	bytes->resize( pos + UTF16ByteSize( strn ) + 2 );
+	WriteUTF16LE( bytes->data( ) + pos, strn );
+}
+
+void CachePutInt( std::vector< char >& bytes, uint32_t value )
+{
+	char tmp[4];
+	memcpy( tmp, &value, 4 );
+	bytes.insert( bytes.end( ), tmp, tmp + 4 );
+}
 
-	int size = strn.size( ) * sizeof( strn.front( ) );
+void CachePutInt64( std::vector< char >& bytes, uint64_t value )
+{
+	char tmp[8];
+	memcpy( tmp, &value, 8 );
+	bytes.insert( bytes.end( ), tmp, tmp + 8 );
+}
 
-	for( int i = 0; i < size; i++ )
+//Length prefixed UTF-16
+void CachePutWString( std::vector< char >& bytes, const std::wstring& strn )
+{
+	CachePutInt( bytes, (uint32_t)strn.size( ) );
+	for( size_t i = 0; i < strn.size( ); ++i )
 	{
-		bytes->push_back( strnBytes[i] );
+		uint16_t c = (uint16_t)strn[i];
+		bytes.push_back( (char)( c & 0xFF ) );
+		bytes.push_back( (char)( c >> 8 ) );
 	}
-	//Zero terminate
-	bytes->push_back( 0x0 );
-	bytes->push_back( 0x0 );
+}
+
+bool CacheGetInt( const std::vector< char >& bytes, size_t& pos, uint32_t& value )
+{
+	if( pos + 4 > bytes.size( ) )
+		return false;
+	memcpy( &value, &bytes[pos], 4 );
+	pos += 4;
+	return true;
+}
+
+bool CacheGetInt64( const std::vector< char >& bytes, size_t& pos, uint64_t& value )
+{
+	if( pos + 8 > bytes.size( ) )
+		return false;
+	memcpy( &value, &bytes[pos], 8 );
+	pos += 8;
+	return true;
+}
+
+bool CacheGetWString( const std::vector< char >& bytes, size_t& pos, std::wstring& strn )
+{
+	uint32_t len;
+	if( !CacheGetInt( bytes, pos, len ) || pos + (size_t)len * 2 > bytes.size( ) )
+		return false;
+
+	strn.resize( len );
+	for( uint32_t i = 0; i < len; ++i )
+	{
+		strn[i] = (wchar_t)( (unsigned char)bytes[pos] | ( (unsigned char)bytes[pos + 1] << 8 ) );
+		pos += 2;
+	}
+	return true;
+}
+
+void CachePutBytes( std::vector< char >& bytes, const std::vector< char >& data )
+{
+	CachePutInt( bytes, (uint32_t)data.size( ) );
+	bytes.insert( bytes.end( ), data.begin( ), data.end( ) );
+}
+
+bool CacheGetBytes( const std::vector< char >& bytes, size_t& pos, std::vector< char >& data )
+{
+	uint32_t len;
+	if( !CacheGetInt( bytes, pos, len ) || pos + len > bytes.size( ) )
+		return false;
+
+	data.assign( bytes.begin( ) + pos, bytes.begin( ) + pos + len );
+	pos += len;
+	return true;
+}
+
+bool CacheReadFile( const std::wstring& path, std::vector< char >& bytes )
+{
+	std::ifstream file( ToFilePath( path ), std::ios::binary | std::ios::ate );
+
+	std::streamsize size = file.tellg( );
+	if( size <= 0 )
+		return false;
+	file.seekg( 0, std::ios::beg );
+
+	bytes.resize( (size_t)size );
+	return (bool)file.read( bytes.data( ), size );
+}
+
+void CacheWriteFile( const std::wstring& path, const std::vector< char >& bytes )
+{
+	std::ofstream file( ToFilePath( path ), std::ios::binary | std::ios::out | std::ios::trunc );
+	if( file.is_open( ) )
+		file.write( bytes.data( ), bytes.size( ) );
+}
+
+//FNV-1a over UTF-16 code units, the same on every platform
+std::string JSONString( const std::wstring& text )
+{
+	std::string utf8 = WideToUTF8( text );
+	std::string out = "\"";
+	for( size_t i = 0; i < utf8.size( ); i++ )
+	{
+		unsigned char c = utf8[i];
+		if( c == '"' || c == '\\' )
+		{
+			out += '\\';
+			out += c;
+		}
+		else if( c < 0x20 )
+		{
+			char escaped[8];
+			snprintf( escaped, sizeof( escaped ), "\\u%04x", c );
+			out += escaped;
+		}
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+std::string JSONNumber( double value )
+{
+	char number[32];
+	snprintf( number, sizeof( number ), "%.3f", value );
+	return number;
+}
+
+double MegabytesPerSecond( uint64_t bytes, double ms )
+{
+	return ms > 0.0 ? ( bytes / 1048576.0 ) / ( ms / 1000.0 ) : 0.0;
+}
+
+uint64_t HashWString( const std::wstring& strn, uint64_t hash )
+{
+	for( size_t i = 0; i < strn.size( ); ++i )
+	{
+		uint16_t c = (uint16_t)strn[i];
+		hash = ( hash ^ ( c & 0xFF ) ) * 1099511628211ULL;
+		hash = ( hash ^ ( c >> 8 ) ) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool ProgressReporter::enabled = true;
+int ProgressReporter::intervalMs = 100;
+
+static long long ProgressNowMs( )
+{
+	using namespace std::chrono;
+	return duration_cast< milliseconds >( steady_clock::now( ).time_since_epoch( ) ).count( );
+}
+
+ProgressReporter::ProgressReporter( int total )
+{
+	m_total = total;
+	m_current = 0;
+	m_lastPrint = ProgressNowMs( );
+}
+
+void ProgressReporter::Update( int current )
+{
+	m_current = current;
+	if( !enabled )
+		return;
+
+	long long now = ProgressNowMs( );
+	if( now - m_lastPrint < intervalMs )
+		return;
+	m_lastPrint = now;
+
+	if( m_total > 0 )
+		LogInfo( ) << L"\r" << m_current << L"     in " << m_total;
+	else
+		LogInfo( ) << L"\r" << m_current;
+	//The count has no newline, so it has to be pushed out
+	Log::Flush( );
+}
+
+void ProgressReporter::Finish( )
+{
+	if( !enabled )
+		return;
+
+	if( m_total > 0 )
+		LogInfo( ) << L"\r" << m_current << L"     in " << m_total;
+	else
+		LogInfo( ) << L"\r" << m_current;
 }
 
 //Convert UTF8 to wide string
 std::wstring UTF8ToWide(const std::string& source)
 {
-	std::wstring_convert<std::codecvt_utf8<wchar_t>> conv;
-	return conv.from_bytes(source);
+	std::wstring out;
+	UTF8ToWide(source.data(), source.size(), out);
+	return out;
+}
+
+std::wstring UTF8ToWide(const char* source)
+{
+	std::wstring out;
+	if (source)
+		UTF8ToWide(source, strlen(source), out);
+	return out;
 }
 
 std::string WideToUTF8(const std::wstring& source)
 {
-	std::wstring_convert<std::codecvt_utf8<wchar_t>> conv;
-	return conv.to_bytes(source);
+	std::string out;
+	WideToUTF8(source.data(), source.size(), out);
+	return out;
+}
+
+void UTF8ToWide(const std::string& source, std::wstring& out)
+{
+	UTF8ToWide(source.data(), source.size(), out);
+}
+
+void UTF8ToWide(const char* source, std::wstring& out)
+{
+	if (source)
+		UTF8ToWide(source, strlen(source), out);
+	else
+		out.clear();
+}
+
+void WideToUTF8(const std::wstring& source, std::string& out)
+{
+	WideToUTF8(source.data(), source.size(), out);
 }
@@ -1,28 +1,14 @@
 #pragma once
+#include "ByteStream.h"
 
-void Read2Bytes( unsigned char *chunk, const std::vector<char>& buf, int pos );
-void Read2BytesReversed( unsigned char *chunk, const std::vector<char>& buf, int pos );
-void Read4Bytes(unsigned char* chunk, const std::vector<char>& buf, int pos);
-void Read4BytesReversed(unsigned char* chunk, const std::vector<char>& buf, int pos);
-//Read specified number of bytes, which should be a multiple of 2
-void ReadNBytesReversed(unsigned char* chunk, const std::vector<char>& buf, int pos, int num);
-
-std::string ReadRaw(const std::vector<char>& buf, int pos, int num);
-//wrong reading, do not use.
-short ReadInt16(const std::vector<char>& buf, int pos, bool swapEndian = false);
-uint16_t ReadUInt16(const std::vector<char>& buf, int pos, bool swapEndian = false);
-//Poor performance as a float and should not be used
-float ReadHalfFloat(const std::vector<char>& buf, int pos, bool swapEndian = false);
-
-int GetIntFromChunk( unsigned char *chunk );
-// Functions cannot be used to read float.
-char* IntToBytes( int i, bool flip = true );
+std::string ReadRaw(const ByteSpan& buf, int pos, int num);
 
 std::wstring ToString( int i );
 std::wstring ToString( float f );
 
-std::wstring ReadUnicode( const std::vector<char>& chunk, int pos, bool swapEndian = false );
-std::string ReadASCII(const std::vector<char>& chunk, int pos);
+//0 terminated UTF-16 at pos, big endian when swapEndian is set. StringTable.h reads straight to UTF-8.
+std::wstring ReadUnicode( const ByteSpan& chunk, int pos, bool swapEndian = false );
+std::string ReadASCII(const ByteSpan& chunk, int pos);
 
 //Util fn for simple tokenisation
 std::wstring SimpleTokenise( std::wstring &input, wchar_t delim );
@@ -31,7 +17,7 @@ std::wstring SimpleTokenise( std::wstring &input, wchar_t delim );
 std::wstring Tokenise( std::wstring &input, const wchar_t delim[], wchar_t &firstDelim );
 
 //Function to kill whitespace
-std::wstring KillWhitespace( std::wstring in );
+std::wstring KillWhitespace( const std::wstring& in );
 //Function to kill whitespace and throw error
 std::wstring KillSpaceAndDebug(std::wstring in);
 
@@ -40,6 +26,10 @@ void PushStringToVector(const std::string& strn, std::vector< char >* bytes);
 //Function to write a string to a char vector, but no tail
 void PushStringToVectorNoEnd(const std::string& strn, std::vector< char >* bytes);
 //Function to write a wstring to a char vector
+//Bytes strn takes as UTF-16, without the terminator
+size_t UTF16ByteSize( const std::wstring& strn );
+//Writes strn as UTF-16LE with no terminator, out needs UTF16ByteSize( strn ) bytes. Returns the bytes written.
+size_t WriteUTF16LE( char *out, const std::wstring& strn );
 void PushWStringToVector( const std::wstring& strn, std::vector< char > *bytes );
 
 //Checks if a string is a valid int
@@ -68,17 +58,66 @@ ValueType DetermineType( std::wstring input );
 
 //Helper fn to read a file
 std::wstring ReadFile( const wchar_t* filename );
+//Writes text as UTF-16 BE with a BOM, the format ReadFile expects. False if the file can't be written.
+bool WriteUTF16File( const wchar_t* filename, const std::wstring& text );
 
 //Replaces all instances in a string
 void FindAndReplaceAll( std::wstring & data, const std::wstring& toSearch, const std::wstring& replaceStr );
 void FindAndReplaceAll(std::string& data, const std::string& toSearch, const std::string& replaceStr);
 
-//Convert UTF8 to wide string
+//Little endian helpers for the binary caches, the Get functions fail on truncated data
+void CachePutInt( std::vector< char >& bytes, uint32_t value );
+void CachePutInt64( std::vector< char >& bytes, uint64_t value );
+//Length prefixed UTF-16
+void CachePutWString( std::vector< char >& bytes, const std::wstring& strn );
+void CachePutBytes( std::vector< char >& bytes, const std::vector< char >& data );
+bool CacheGetInt( const std::vector< char >& bytes, size_t& pos, uint32_t& value );
+bool CacheGetInt64( const std::vector< char >& bytes, size_t& pos, uint64_t& value );
+bool CacheGetWString( const std::vector< char >& bytes, size_t& pos, std::wstring& strn );
+bool CacheGetBytes( const std::vector< char >& bytes, size_t& pos, std::vector< char >& data );
+//Whole file, false if it is missing or empty
+bool CacheReadFile( const std::wstring& path, std::vector< char >& bytes );
+//A cache that can't be written is not an error, it just gets rebuilt next time
+void CacheWriteFile( const std::wstring& path, const std::vector< char >& bytes );
+
+//Quoted UTF-8 JSON string with quotes, backslashes and control characters escaped
+std::string JSONString( const std::wstring& text );
+//Fixed 3 decimals, so timings line up between runs
+std::string JSONNumber( double value );
+
+//Throughput for the timing reports, 0 when ms is too short to measure
+double MegabytesPerSecond( uint64_t bytes, double ms );
+
+//64 bit FNV-1a, pass the previous result to hash several strings
+uint64_t HashWString( const std::wstring& strn, uint64_t hash = 14695981039346656037ULL );
+
+//Rate limited "\r<count>" progress output for per-record loops
+class ProgressReporter
+{
+public:
+	ProgressReporter( int total = 0 );
+	//Prints at most every ProgressReporter::intervalMs milliseconds
+	void Update( int current );
+	//Prints the final count
+	void Finish( );
+
+	//Off in batch mode, where the console would dominate the run time
+	static bool enabled;
+	static int intervalMs;
+
+private:
+	int m_total;
+	int m_current;
+	long long m_lastPrint;
+};
+
+//Convert UTF8 to wide string, invalid input throws std::range_error
 std::wstring UTF8ToWide(const std::string& source);
+//nullptr, such as a missing XML attribute, gives an empty string
+std::wstring UTF8ToWide(const char* source);
 std::string WideToUTF8(const std::wstring& source);
+//Same, into a buffer that is reused between calls
+void UTF8ToWide(const std::string& source, std::wstring& out);
+void UTF8ToWide(const char* source, std::wstring& out);
+void WideToUTF8(const std::wstring& source, std::string& out);
 
-// in ASM
-extern "C" {
-// Fast read of int32 using assembly
-int __fastcall ASMReadInt32(void const* pdata, int swapEndian = 0);
-}
@@ -1,19 +1,21 @@
 ﻿
 #include <iostream>
-#include <codecvt>
 #include "..\EDF_Tools\include\tinyxml2.h"
+#include "..\EDF_Tools\Unicode.h"
 
-//Convert UTF8 to wide string
+//Convert UTF8 to wide string, through the same transcoders as EDF_Tools
 std::wstring UTF8ToWide(const std::string& source)
 {
-	std::wstring_convert<std::codecvt_utf8<wchar_t>> conv;
-	return conv.from_bytes(source);
+	std::wstring out;
+	UTF8ToWide(source.data(), source.size(), out);
+	return out;
 }
 
 std::string WideToUTF8(const std::wstring& source)
 {
-	std::wstring_convert<std::codecvt_utf8<wchar_t>> conv;
-	return conv.to_bytes(source);
+	std::string out;
+	WideToUTF8(source.data(), source.size(), out);
+	return out;
 }
 
 void __fastcall NewFunction(tinyxml2::XMLElement* data, float scaleSize)